@@ -10,6 +10,7 @@
 
 #include <string>
 #include <vector>
+#include <chrono>
 #include "GameEngine.h"
 #include "SpaceWar.h"
 #include "SpaceWarClient.h"
@@ -18,6 +19,9 @@
 #define MENU_FONT_HEIGHT 24
 #define MENU_ITEM_PADDING 12
 
+// Time a menu spends each frame on time sliced rebuilds and updates, see BeginIncrementalRebuild()
+#define MENU_REBUILD_BUDGET_USEC 2000
+
 extern HGAMEFONT g_hMenuFont;
 extern uint64 g_ulLastReturnKeyTick;
 extern uint64 g_ulLastKeyDownTick;
@@ -36,6 +40,7 @@ public:
 
 		m_uSelectedItem = 0;
 		m_bSelectionPushed = false;
+		m_bRebuildPending = false;
 
 		if ( !g_hMenuFont )
 		{
@@ -55,11 +60,14 @@ public:
 		m_sHeading = pchHeading;
 	}
 
-	// Clear all menu entries
+	// Clear all menu entries, this also drops any time sliced rebuild in progress
 	void ClearMenuItems() 
 	{
 		m_VecMenuItems.clear();
 		m_uSelectedItem = 0;
+
+		m_bRebuildPending = false;
+		m_VecRebuildItems.clear();
 	}
 
 	// Add a menu item to the menu
@@ -68,6 +76,58 @@ public:
 		m_VecMenuItems.push_back( item );
 	}
 
+	// Number of items in the menu
+	uint32 GetMenuItemCount() { return (uint32)m_VecMenuItems.size(); }
+
+	// Insert a menu item before the given index (or at the end), the same item stays selected
+	void InsertMenuItem( uint32 uIndex, MenuItem_t item )
+	{
+		if ( uIndex > m_VecMenuItems.size() )
+			uIndex = (uint32)m_VecMenuItems.size();
+
+		if ( uIndex <= m_uSelectedItem && m_uSelectedItem < m_VecMenuItems.size() )
+			m_uSelectedItem++;
+
+		m_VecMenuItems.insert( m_VecMenuItems.begin() + uIndex, item );
+	}
+
+	// Changes the text of the items matching key, including ones from a time sliced rebuild
+	// that hasn't finished yet.  Returns false if there weren't any.  This is a linear search,
+	// long menus should queue their updates and apply them from BUpdateStep() instead.
+	bool BUpdateMenuItem( const T &key, const std::string &sText )
+	{
+		bool bFound = false;
+		for ( unsigned int i = 0; i < m_VecMenuItems.size(); i++ )
+		{
+			if ( BMenuItemsMatch( m_VecMenuItems[i].second, key ) )
+			{
+				m_VecMenuItems[i].first = sText;
+				bFound = true;
+			}
+		}
+
+		for ( unsigned int i = 0; i < m_VecRebuildItems.size(); i++ )
+		{
+			if ( BMenuItemsMatch( m_VecRebuildItems[i].second, key ) )
+			{
+				m_VecRebuildItems[i].first = sText;
+				bFound = true;
+			}
+		}
+
+		return bFound;
+	}
+
+	// Starts a time sliced rebuild, for menus that can run to thousands of items.  Each frame
+	// RunFrame() calls BRebuildStep() until it returns true or MENU_REBUILD_BUDGET_USEC is up.
+	// The items it adds with AddRebuildMenuItem() replace the current ones once it's done, until
+	// then the old list stays up and usable.
+	void BeginIncrementalRebuild()
+	{
+		m_VecRebuildItems.clear();
+		m_bRebuildPending = true;
+	}
+
 	void PushSelectedItem()
 	{
 		if ( m_VecMenuItems.size() )
@@ -86,7 +146,7 @@ public:
 			// find the item and set it as selected if it exists
 			for ( unsigned int i = 0; i < m_VecMenuItems.size(); i++ )
 			{
-				if ( !memcmp( &m_VecMenuItems[i].second, &m_selection, sizeof( m_selection ) ) )
+				if ( BMenuItemsMatch( m_VecMenuItems[i].second, m_selection ) )
 				{
 					m_uSelectedItem = i;
 					break;
@@ -103,6 +163,8 @@ public:
 		// menu to "go back to main menu" you don't end up immediately registering a return in the
 		// main menu afterwards.
 
+		RunIncrementalRebuild();
+
 		// check if the enter key is down, if it is take action
 		if ( m_pGameEngine->BIsKeyDown( VK_RETURN ) || 
 			m_pGameEngine->BIsControllerActionActive( eControllerDigitalAction_MenuSelect ) )
@@ -227,7 +289,65 @@ public:
 		}
 	}
 
+protected:
+	// Adds the next few items of a time sliced rebuild, returns true once they are all added
+	virtual bool BRebuildStep() { return true; }
+
+	// Works through a few of the updates a menu has queued for its current items, returns true
+	// once there are none left.  Runs in the same budget, when no rebuild is pending.
+	virtual bool BUpdateStep() { return true; }
+
+	const MenuItem_t &GetMenuItem( uint32 uIndex ) { return m_VecMenuItems[uIndex]; }
+
+	void SetMenuItemText( uint32 uIndex, const std::string &sText )
+	{
+		m_VecMenuItems[uIndex].first = sText;
+	}
+
+	// Add an item to the list a time sliced rebuild is putting together
+	void AddRebuildMenuItem( MenuItem_t item )
+	{
+		m_VecRebuildItems.push_back( item );
+	}
+
+	// Whether two items are the same entry, for keeping the selection and for keyed updates.
+	// Menus whose item data has padding or fields that don't identify it should override this.
+	virtual bool BMenuItemsMatch( const T &lhs, const T &rhs )
+	{
+		return !memcmp( &lhs, &rhs, sizeof( T ) );
+	}
+
 private:
+	// Works on a pending time sliced rebuild for up to MENU_REBUILD_BUDGET_USEC, swapping the
+	// new items in when it completes, then spends what's left of the budget on queued updates
+	void RunIncrementalRebuild()
+	{
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds( MENU_REBUILD_BUDGET_USEC );
+
+		if ( m_bRebuildPending )
+		{
+			while ( !BRebuildStep() )
+			{
+				if ( std::chrono::steady_clock::now() >= deadline )
+					return;
+			}
+
+			m_bRebuildPending = false;
+
+			PushSelectedItem();
+			m_VecMenuItems.swap( m_VecRebuildItems );
+			m_VecRebuildItems.clear();
+			m_uSelectedItem = 0;
+			PopSelectedItem();
+		}
+
+		while ( !BUpdateStep() )
+		{
+			if ( std::chrono::steady_clock::now() >= deadline )
+				return;
+		}
+	}
+
 	// Game engine instance
 	IGameEngine *m_pGameEngine;
 
@@ -243,6 +363,10 @@ private:
 	// pushed selection
 	bool m_bSelectionPushed;
 	T m_selection;
+
+	// Items from a time sliced rebuild that hasn't finished yet
+	bool m_bRebuildPending;
+	std::vector< MenuItem_t > m_VecRebuildItems;
 };
 
 #endif // MAINMENU_H
@@ -0,0 +1,468 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Headless load generator, runs space war servers against scripted
+//			bot clients over the loopback transport and reports throughput
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "BotSwarm.h"
+#include "SpaceWarServer.h"
+#include "gameengineheadless.h"
+#include <algorithm>
+
+// Bytes of fake compressed voice per packet, roughly what Steam voice produces per 100ms
+#define BOT_VOICE_PACKET_BYTES 120
+#define BOT_VOICE_PACKET_INTERVAL_MS 100
+
+// How long a bot holds a scripted maneuver
+#define BOT_MANEUVER_MIN_MS 300
+#define BOT_MANEUVER_MAX_MS 1500
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CMeteredTransport::CMeteredTransport( CLoopbackNetwork *pNetwork, const SteamNetworkingIdentity &identityLocal, TransportStats_t *pStats )
+	: CLoopbackTransport( pNetwork, identityLocal )
+{
+	m_pStats = pStats;
+}
+
+
+EResult CMeteredTransport::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+{
+	EResult res = CLoopbackTransport::SendMessageToConnection( hConn, pData, cbData, nSendFlags, pOutMessageNumber );
+	if ( res == k_EResultOK )
+	{
+		m_pStats->m_cbSent += cbData;
+		m_pStats->m_cMsgsSent++;
+	}
+	return res;
+}
+
+
+int CMeteredTransport::ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	int nMessages = CLoopbackTransport::ReceiveMessagesOnConnection( hConn, ppOutMessages, nMaxMessages );
+	MeterReceived( ppOutMessages, nMessages );
+	return nMessages;
+}
+
+
+int CMeteredTransport::ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	int nMessages = CLoopbackTransport::ReceiveMessagesOnPollGroup( hPollGroup, ppOutMessages, nMaxMessages );
+	MeterReceived( ppOutMessages, nMessages );
+	return nMessages;
+}
+
+
+void CMeteredTransport::MeterReceived( SteamNetworkingMessage_t **ppMessages, int nMessages )
+{
+	SteamNetworkingMicroseconds usecNow = CLoopbackNetwork::GetTimestamp();
+	for ( int i = 0; i < nMessages; ++i )
+	{
+		m_pStats->m_cbReceived += ppMessages[i]->GetSize();
+		m_pStats->m_cMsgsReceived++;
+		m_pStats->m_vecLatencyUsec.push_back( (uint32)( usecNow - ppMessages[i]->GetTimeReceived() ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor, starts connecting right away
+//-----------------------------------------------------------------------------
+CSwarmBot::CSwarmBot( IGameEngine *pGameEngine, CLoopbackNetwork *pNetwork, uint32 unBotIndex, const SteamNetworkingIdentity &identityServer )
+{
+	m_pGameEngine = pGameEngine;
+	m_unBotIndex = unBotIndex;
+	m_unRandomState = 0x9E3779B9u ^ ( unBotIndex * 2654435761u );
+	m_SteamIDLocal = CSteamID( 1000 + unBotIndex, k_EUniversePublic, k_EAccountTypeIndividual );
+
+	m_bAuthenticated = false;
+	m_uPlayerShipIndex = 0;
+	memset( &m_UpdateData, 0, sizeof( m_UpdateData ) );
+	m_ulNextManeuverTick = 0;
+	m_ulLastClientUpdateTick = 0;
+	m_bTalking = false;
+	m_ulNextTalkToggleTick = m_pGameEngine->GetGameTickCount() + RandomInt( 5000 );
+	m_ulLastVoiceTick = 0;
+
+	char rgchName[64];
+	sprintf_safe( rgchName, "Bot %u", unBotIndex );
+	m_UpdateData.SetPlayerName( rgchName );
+
+	SteamNetworkingIdentity identityLocal;
+	identityLocal.SetSteamID( m_SteamIDLocal );
+	m_pTransport = new CMeteredTransport( pNetwork, identityLocal, &m_Stats );
+	m_pTransport->SetListener( this );
+
+	m_hConnServer = m_pTransport->Connect( identityServer );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CSwarmBot::~CSwarmBot()
+{
+	if ( m_hConnServer != k_HSteamNetConnection_Invalid )
+		m_pTransport->CloseConnection( m_hConnServer, k_EDRClientDisconnect, nullptr, false );
+	delete m_pTransport;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Simple xorshift PRNG, returns [0, unMax)
+//-----------------------------------------------------------------------------
+uint32 CSwarmBot::RandomInt( uint32 unMax )
+{
+	m_unRandomState ^= m_unRandomState << 13;
+	m_unRandomState ^= m_unRandomState >> 17;
+	m_unRandomState ^= m_unRandomState << 5;
+	return unMax ? m_unRandomState % unMax : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Handle any connection status change
+//-----------------------------------------------------------------------------
+void CSwarmBot::OnNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback )
+{
+	ESteamNetworkingConnectionState eState = pCallback->m_info.m_eState;
+	if ( eState == k_ESteamNetworkingConnectionState_ClosedByPeer || eState == k_ESteamNetworkingConnectionState_ProblemDetectedLocally )
+	{
+		// Server dropped us (full, rejected or exiting), we're done
+		m_pTransport->CloseConnection( pCallback->m_hConn, pCallback->m_info.m_eEndReason, nullptr, false );
+		if ( pCallback->m_hConn == m_hConnServer )
+		{
+			m_hConnServer = k_HSteamNetConnection_Invalid;
+			m_bAuthenticated = false;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run a frame for the bot
+//-----------------------------------------------------------------------------
+void CSwarmBot::RunFrame()
+{
+	m_pTransport->RunCallbacks();
+	ReceiveNetworkData();
+
+	if ( !m_bAuthenticated )
+		return;
+
+	UpdateControls();
+	SendLocalUpdate();
+	SendVoiceData();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Receives incoming network data, same handling as CSpaceWarClient::ReceiveNetworkData
+// for the messages that matter to a bot
+//-----------------------------------------------------------------------------
+void CSwarmBot::ReceiveNetworkData()
+{
+	if ( m_hConnServer == k_HSteamNetConnection_Invalid )
+		return;
+
+	SteamNetworkingMessage_t *msgs[32];
+	int res = m_pTransport->ReceiveMessagesOnConnection( m_hConnServer, msgs, 32 );
+	for ( int i = 0; i < res; i++ )
+	{
+		SteamNetworkingMessage_t *message = msgs[i];
+		if ( message->GetSize() < sizeof( DWORD ) )
+		{
+			message->Release();
+			continue;
+		}
+
+		EMessage eMsg = (EMessage)LittleDWord( *(DWORD*)message->GetData() );
+		switch ( eMsg )
+		{
+		case k_EMsgServerSendInfo:
+			{
+				// Server knows about us, start authenticating.  There is no ticket on the loopback
+				// transport, the server trusts the connection identity.
+				MsgClientBeginAuthentication_t msg;
+				msg.SetToken( "", 0 );
+				msg.SetSteamID( m_SteamIDLocal.ConvertToUint64() );
+				m_pTransport->SendMessageToConnection( m_hConnServer, &msg, sizeof( msg ), k_nSteamNetworkingSend_Reliable, nullptr );
+			}
+			break;
+
+		case k_EMsgServerPassAuthentication:
+			if ( message->GetSize() == sizeof( MsgServerPassAuthentication_t ) )
+			{
+				MsgServerPassAuthentication_t *pMsg = (MsgServerPassAuthentication_t*)message->GetData();
+				m_uPlayerShipIndex = pMsg->GetPlayerPosition();
+				m_bAuthenticated = true;
+			}
+			break;
+
+		case k_EMsgServerFailAuthentication:
+		case k_EMsgServerExiting:
+			m_bAuthenticated = false;
+			break;
+
+		default:
+			// World updates, voice from other players etc. only count towards the stats
+			break;
+		}
+
+		message->Release();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pick a new maneuver every so often: turn, thrust and fire at random
+//-----------------------------------------------------------------------------
+void CSwarmBot::UpdateControls()
+{
+	uint64 ulNow = m_pGameEngine->GetGameTickCount();
+	if ( ulNow < m_ulNextManeuverTick )
+		return;
+
+	m_ulNextManeuverTick = ulNow + BOT_MANEUVER_MIN_MS + RandomInt( BOT_MANEUVER_MAX_MS - BOT_MANEUVER_MIN_MS );
+
+	uint32 unTurn = RandomInt( 3 );
+	m_UpdateData.SetTurnLeftPressed( unTurn == 1 );
+	m_UpdateData.SetTurnRightPressed( unTurn == 2 );
+	m_UpdateData.SetForwardThrustersPressed( RandomInt( 100 ) < 60 );
+	m_UpdateData.SetReverseThrustersPressed( false );
+	m_UpdateData.SetFirePressed( RandomInt( 100 ) < 40 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Send our input at the same rate a real client does
+//-----------------------------------------------------------------------------
+void CSwarmBot::SendLocalUpdate()
+{
+	uint64 ulNow = m_pGameEngine->GetGameTickCount();
+	if ( ulNow - m_ulLastClientUpdateTick < 1000.0f/CLIENT_UPDATE_SEND_RATE )
+		return;
+
+	m_ulLastClientUpdateTick = ulNow;
+
+	MsgClientSendLocalUpdate_t msg;
+	msg.SetShipPosition( m_uPlayerShipIndex );
+	memcpy( msg.AccessUpdateData(), &m_UpdateData, sizeof( ClientSpaceWarUpdateData_t ) );
+	m_pTransport->SendMessageToConnection( m_hConnServer, &msg, sizeof( msg ), k_nSteamNetworkingSend_Unreliable, nullptr );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Talk in bursts, sending junk voice payloads for the server to relay
+//-----------------------------------------------------------------------------
+void CSwarmBot::SendVoiceData()
+{
+	uint64 ulNow = m_pGameEngine->GetGameTickCount();
+	if ( ulNow >= m_ulNextTalkToggleTick )
+	{
+		m_bTalking = !m_bTalking;
+		m_ulNextTalkToggleTick = ulNow + ( m_bTalking ? 1000 + RandomInt( 3000 ) : 3000 + RandomInt( 10000 ) );
+	}
+
+	if ( !m_bTalking || ulNow - m_ulLastVoiceTick < BOT_VOICE_PACKET_INTERVAL_MS )
+		return;
+
+	m_ulLastVoiceTick = ulNow;
+
+	MsgVoiceChatData_t msg;
+	uint8 buffer[ sizeof( msg ) + BOT_VOICE_PACKET_BYTES ];
+	msg.SetDataLength( BOT_VOICE_PACKET_BYTES );
+	memcpy( buffer, &msg, sizeof( msg ) );
+	for ( uint32 i = 0; i < BOT_VOICE_PACKET_BYTES; ++i )
+		buffer[ sizeof( msg ) + i ] = (uint8)RandomInt( 256 );
+
+	m_pTransport->SendMessageToConnection( m_hConnServer, buffer, sizeof( buffer ), k_nSteamNetworkingSend_UnreliableNoDelay, nullptr );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Print p50/p90/p99/max of a sample set
+//-----------------------------------------------------------------------------
+static void PrintPercentiles( const char *pchLabel, std::vector<uint32> &vecSamples )
+{
+	if ( vecSamples.empty() )
+	{
+		printf( "%-28s no samples\n", pchLabel );
+		return;
+	}
+
+	std::sort( vecSamples.begin(), vecSamples.end() );
+	size_t cSamples = vecSamples.size();
+	printf( "%-28s p50 %8u  p90 %8u  p99 %8u  max %8u  (%u samples)\n", pchLabel,
+		vecSamples[ cSamples * 50 / 100 ], vecSamples[ cSamples * 90 / 100 ], vecSamples[ cSamples * 99 / 100 ],
+		vecSamples[ cSamples - 1 ], (uint32)cSamples );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pull an integer argument like "-botswarm 200" off the command line
+//-----------------------------------------------------------------------------
+static uint32 GetCommandLineInt( const char *pchCmdLine, const char *pchParam, uint32 unDefault )
+{
+	const char *pchFound = strstr( pchCmdLine, pchParam );
+	while ( pchFound )
+	{
+		// make sure we matched the whole parameter, not a prefix of a longer one
+		const char *pchValue = pchFound + strlen( pchParam );
+		if ( *pchValue == ' ' )
+		{
+			int nValue = atoi( pchValue + 1 );
+			return nValue > 0 ? (uint32)nValue : unDefault;
+		}
+		pchFound = strstr( pchValue, pchParam );
+	}
+	return unDefault;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run servers and bots in lock step at the normal frame rate and report.
+//
+//	-botswarm <bots>			number of bots, they fill servers MAX_PLAYERS_PER_SERVER at a time
+//	-botswarm_seconds <secs>	how long to run for (default 30)
+//	-metricsfile <path>			have the servers write their metrics (handled by RealMain)
+//	-recordmatch <path>			have the servers record their matches (handled by RealMain)
+//-----------------------------------------------------------------------------
+int RunBotSwarm( const char *pchCmdLine, const char *pchMetricsFile, const char *pchRecordFile )
+{
+	uint32 cBots = GetCommandLineInt( pchCmdLine, "-botswarm", 64 );
+	uint32 cSeconds = GetCommandLineInt( pchCmdLine, "-botswarm_seconds", 30 );
+	uint32 cServers = ( cBots + MAX_PLAYERS_PER_SERVER - 1 ) / MAX_PLAYERS_PER_SERVER;
+
+	printf( "Bot swarm: %u bots on %u servers for %u seconds\n", cBots, cServers, cSeconds );
+
+	CGameEngineHeadless *pGameEngine = new CGameEngineHeadless();
+	CLoopbackNetwork *pNetwork = new CLoopbackNetwork();
+
+	std::vector<TransportStats_t> vecServerStats( cServers );
+	std::vector<CMeteredTransport *> vecServerTransports;
+	std::vector<SteamNetworkingIdentity> vecServerIdentities;
+	std::vector<CSpaceWarServer *> vecServers;
+	for ( uint32 i = 0; i < cServers; ++i )
+	{
+		SteamNetworkingIdentity identity;
+		identity.SetSteamID( CSteamID( 1 + i, k_EUniversePublic, k_EAccountTypeGameServer ) );
+		vecServerIdentities.push_back( identity );
+
+		CMeteredTransport *pTransport = new CMeteredTransport( pNetwork, identity, &vecServerStats[i] );
+		vecServerTransports.push_back( pTransport );
+		vecServers.push_back( new CSpaceWarServer( pGameEngine, pTransport ) );
+
+		char rgchFileName[1024];
+		if ( pchMetricsFile )
+		{
+			if ( cServers > 1 )
+				sprintf_safe( rgchFileName, "%s.%u", pchMetricsFile, i );
+			else
+				sprintf_safe( rgchFileName, "%s", pchMetricsFile );
+			vecServers.back()->SetMetricsFile( rgchFileName );
+		}
+
+		if ( pchRecordFile )
+		{
+			if ( cServers > 1 )
+				sprintf_safe( rgchFileName, "%s.%u", pchRecordFile, i );
+			else
+				sprintf_safe( rgchFileName, "%s", pchRecordFile );
+			if ( !vecServers.back()->StartRecording( rgchFileName ) )
+				printf( "Failed to record to %s\n", rgchFileName );
+		}
+	}
+
+	std::vector<CSwarmBot *> vecBots;
+	for ( uint32 i = 0; i < cBots; ++i )
+		vecBots.push_back( new CSwarmBot( pGameEngine, pNetwork, i, vecServerIdentities[ i / MAX_PLAYERS_PER_SERVER ] ) );
+
+	std::vector<uint32> vecServerTickUsec;
+	std::vector<uint32> vecFrameUsec;
+	uint32 cFrames = 0;
+	uint32 cFramesOverBudget = 0;
+	const uint32 unFrameBudgetUsec = 1000000 / MAX_CLIENT_AND_SERVER_FPS;
+
+	pGameEngine->UpdateGameTickCount();
+	uint64 ulEndTick = pGameEngine->GetGameTickCount() + (uint64)cSeconds * 1000;
+	while ( pGameEngine->GetGameTickCount() < ulEndTick )
+	{
+		pGameEngine->UpdateGameTickCount();
+		SteamNetworkingMicroseconds usecFrameStart = CLoopbackNetwork::GetTimestamp();
+
+		for ( uint32 i = 0; i < cBots; ++i )
+			vecBots[i]->RunFrame();
+
+		for ( uint32 i = 0; i < cServers; ++i )
+		{
+			SteamNetworkingMicroseconds usecTickStart = CLoopbackNetwork::GetTimestamp();
+			vecServers[i]->ReceiveNetworkData();
+			vecServers[i]->RunFrame();
+			vecServerTickUsec.push_back( (uint32)( CLoopbackNetwork::GetTimestamp() - usecTickStart ) );
+		}
+
+		uint32 unFrameUsec = (uint32)( CLoopbackNetwork::GetTimestamp() - usecFrameStart );
+		vecFrameUsec.push_back( unFrameUsec );
+		if ( unFrameUsec > unFrameBudgetUsec )
+			++cFramesOverBudget;
+		++cFrames;
+
+		while ( pGameEngine->BSleepForFrameRateLimit( MAX_CLIENT_AND_SERVER_FPS ) )
+		{
+			// nothing to do, just wait out the frame
+		}
+	}
+
+	// Gather client side numbers before tearing anything down
+	uint32 cAuthenticated = 0;
+	TransportStats_t botTotals;
+	for ( uint32 i = 0; i < cBots; ++i )
+	{
+		TransportStats_t &stats = vecBots[i]->GetStats();
+		if ( vecBots[i]->BAuthenticated() )
+			++cAuthenticated;
+		botTotals.m_cbSent += stats.m_cbSent;
+		botTotals.m_cbReceived += stats.m_cbReceived;
+		botTotals.m_cMsgsSent += stats.m_cMsgsSent;
+		botTotals.m_cMsgsReceived += stats.m_cMsgsReceived;
+		botTotals.m_vecLatencyUsec.insert( botTotals.m_vecLatencyUsec.end(), stats.m_vecLatencyUsec.begin(), stats.m_vecLatencyUsec.end() );
+	}
+
+	std::vector<uint32> vecServerLatencyUsec;
+	for ( uint32 i = 0; i < cServers; ++i )
+		vecServerLatencyUsec.insert( vecServerLatencyUsec.end(), vecServerStats[i].m_vecLatencyUsec.begin(), vecServerStats[i].m_vecLatencyUsec.end() );
+
+	// Servers first so they can say goodbye, then the bots
+	for ( uint32 i = 0; i < cServers; ++i )
+	{
+		delete vecServers[i];
+		delete vecServerTransports[i];
+	}
+	for ( uint32 i = 0; i < cBots; ++i )
+		delete vecBots[i];
+	delete pNetwork;
+	delete pGameEngine;
+
+	printf( "%u frames, %u over the %u us budget (%.1f%%), %u/%u bots in game at the end\n",
+		cFrames, cFramesOverBudget, unFrameBudgetUsec, cFrames ? 100.0f * cFramesOverBudget / cFrames : 0.0f, cAuthenticated, cBots );
+	PrintPercentiles( "server tick (us)", vecServerTickUsec );
+	PrintPercentiles( "whole frame (us)", vecFrameUsec );
+	PrintPercentiles( "client->server latency (us)", vecServerLatencyUsec );
+	PrintPercentiles( "server->client latency (us)", botTotals.m_vecLatencyUsec );
+
+	if ( cBots && cSeconds )
+	{
+		float flClientSeconds = (float)cBots * cSeconds;
+		printf( "per client up:   %8.2f KB/s %8.1f msgs/s\n", botTotals.m_cbSent / 1024.0f / flClientSeconds, botTotals.m_cMsgsSent / flClientSeconds );
+		printf( "per client down: %8.2f KB/s %8.1f msgs/s\n", botTotals.m_cbReceived / 1024.0f / flClientSeconds, botTotals.m_cMsgsReceived / flClientSeconds );
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Headless load generator, runs space war servers against scripted
+//			bot clients over the loopback transport and reports throughput
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef BOTSWARM_H
+#define BOTSWARM_H
+
+#include <vector>
+
+#include "GameEngine.h"
+#include "SpaceWar.h"
+#include "Messages.h"
+#include "SpaceWarTransport.h"
+
+//-----------------------------------------------------------------------------
+// Purpose: Traffic counters for one transport endpoint
+//-----------------------------------------------------------------------------
+struct TransportStats_t
+{
+	uint64 m_cbSent;
+	uint64 m_cbReceived;
+	uint32 m_cMsgsSent;
+	uint32 m_cMsgsReceived;
+
+	// Microseconds each received message sat in the queue before the app picked it up
+	std::vector<uint32> m_vecLatencyUsec;
+
+	TransportStats_t() : m_cbSent( 0 ), m_cbReceived( 0 ), m_cMsgsSent( 0 ), m_cMsgsReceived( 0 ) {}
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Wraps a loopback transport and counts what goes through it
+//-----------------------------------------------------------------------------
+class CMeteredTransport : public CLoopbackTransport
+{
+public:
+	CMeteredTransport( CLoopbackNetwork *pNetwork, const SteamNetworkingIdentity &identityLocal, TransportStats_t *pStats );
+
+	virtual EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber );
+	virtual int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+	virtual int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+
+private:
+	void MeterReceived( SteamNetworkingMessage_t **ppMessages, int nMessages );
+
+	TransportStats_t *m_pStats;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: A scripted player.  Speaks the same protocol as CSpaceWarClient (the
+// wire structs in Messages.h) but has no ship, renderer or Steam dependency.
+//-----------------------------------------------------------------------------
+class CSwarmBot : public ISpaceWarTransportListener
+{
+public:
+	CSwarmBot( IGameEngine *pGameEngine, CLoopbackNetwork *pNetwork, uint32 unBotIndex, const SteamNetworkingIdentity &identityServer );
+	~CSwarmBot();
+
+	// Pump the transport, handle server messages and send our input
+	void RunFrame();
+
+	bool BAuthenticated() { return m_bAuthenticated; }
+	TransportStats_t &GetStats() { return m_Stats; }
+
+	virtual void OnNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback );
+
+private:
+	void ReceiveNetworkData();
+	void UpdateControls();
+	void SendLocalUpdate();
+	void SendVoiceData();
+
+	// Tiny per-bot PRNG so runs are repeatable
+	uint32 RandomInt( uint32 unMax );
+
+	IGameEngine *m_pGameEngine;
+	uint32 m_unBotIndex;
+	uint32 m_unRandomState;
+	CSteamID m_SteamIDLocal;
+
+	TransportStats_t m_Stats;
+	CMeteredTransport *m_pTransport;
+	HSteamNetConnection m_hConnServer;
+
+	bool m_bAuthenticated;
+	uint32 m_uPlayerShipIndex;
+
+	// Current scripted input, held until m_ulNextManeuverTick
+	ClientSpaceWarUpdateData_t m_UpdateData;
+	uint64 m_ulNextManeuverTick;
+	uint64 m_ulLastClientUpdateTick;
+
+	// Voice chat, talking in bursts
+	bool m_bTalking;
+	uint64 m_ulNextTalkToggleTick;
+	uint64 m_ulLastVoiceTick;
+};
+
+
+// Entry point for -botswarm, returns a process exit code.  With a metrics or record file
+// each server writes there, suffixed with the server index if there's more than one.
+int RunBotSwarm( const char *pchCmdLine, const char *pchMetricsFile = NULL, const char *pchRecordFile = NULL );
+
+#endif // BOTSWARM_H
@@ -24,6 +24,21 @@ typedef int HGAMETEXTURE;
 // Typedef for voice channels
 typedef int HGAMEVOICECHANNEL;
 
+// Vertex for vector art, drawn two at a time as lines (see BDrawTransformedLines)
+struct VectorEntityVertex_t
+{
+	float x, y;
+	DWORD color;
+};
+
+// Point for the static GPU scrolled point sets (see HCreateScrollingPoints)
+struct ScrollingPointVertex_t
+{
+	float x, y;
+	float speed;	// pixels moved up per unit of scroll
+	DWORD color;
+};
+
 // BDrawText position flags
 #define TEXTPOS_TOP                      0x00000000
 #define TEXTPOS_LEFT                     0x00000000
@@ -138,12 +153,39 @@ public:
 	// Flush the line buffer
 	virtual bool BFlushLineBuffer() = 0;
 
+	// Rotate (given the sin/cos of the angle) and translate a block of vertexes and draw them as lines, two
+	// vertexes per line.  If pdwOverrideColor is set it is used instead of the vertex colors.  Engines with a
+	// CPU side line buffer override this to transform straight into it, the default goes through BDrawLine.
+	virtual bool BDrawTransformedLines( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, float flSin, float flCos,
+		float xPos, float yPos, const DWORD *pdwOverrideColor )
+	{
+		for ( uint32 i = 0; i + 1 < cVertexes; i += 2 )
+		{
+			const VectorEntityVertex_t &v0 = pVertexes[i];
+			const VectorEntityVertex_t &v1 = pVertexes[i+1];
+			if ( !BDrawLine( flCos*v0.x - flSin*v0.y + xPos, flSin*v0.x + flCos*v0.y + yPos, pdwOverrideColor ? *pdwOverrideColor : v0.color,
+				flCos*v1.x - flSin*v1.y + xPos, flSin*v1.x + flCos*v1.y + yPos, pdwOverrideColor ? *pdwOverrideColor : v1.color ) )
+				return false;
+		}
+		return true;
+	}
+
 	// Draw a point, the engine itself will manage batching these (although you can explicitly flush if you need to)
 	virtual bool BDrawPoint( float xPos, float yPos, DWORD dwColor ) = 0;
 
 	// Flush the point buffer
 	virtual bool BFlushPointBuffer() = 0;
 
+	// Upload a set of points once for drawing with BDrawScrollingPoints.  Returns 0 if the engine can't
+	// animate points on the GPU, callers should then draw them with BDrawPoint themselves.
+	virtual HGAMEVERTBUF HCreateScrollingPoints( const ScrollingPointVertex_t *pPoints, uint32 cPoints ) { return 0; }
+
+	// Draw the whole set in one call, each point moved up by flScroll * speed and wrapped into [0, flWrapHeight)
+	virtual bool BDrawScrollingPoints( HGAMEVERTBUF hPoints, float flScroll, float flWrapHeight ) { return false; }
+
+	// Free a set from HCreateScrollingPoints
+	virtual void ReleaseScrollingPoints( HGAMEVERTBUF hPoints ) {}
+
 	// Draw a filled quad
 	virtual bool BDrawFilledRect( float xPos0, float yPos0, float xPos1, float yPos1, DWORD dwColor ) = 0;
 
@@ -39,19 +39,13 @@ public:
 		{
 			CSteamID steamIDLobbyMember = SteamMatchmaking()->GetLobbyMemberByIndex( steamIDLobby, i ) ;
 
-			// we get the details of a user from the ISteamFriends interface
-			const char *pchName = SteamFriends()->GetFriendPersonaName( steamIDLobbyMember );
 			// we may not know the name of the other users in the lobby immediately; but we'll receive
-			// a PersonaStateUpdate_t callback when they do, and we'll rebuild the list then
-			if ( pchName && *pchName )
+			// a PersonaStateUpdate_t callback when they do, and we'll add them to the list then
+			std::string sMenuText;
+			if ( BGetMemberMenuText( steamIDLobby, steamIDLobbyMember, sMenuText ) )
 			{
-				const char *pchReady = SteamMatchmaking()->GetLobbyMemberData( steamIDLobby, steamIDLobbyMember, "ready" );
-				bool bReady = ( pchReady && atoi( pchReady ) == 1);
 				LobbyMenuItem_t menuItem = { steamIDLobbyMember, LobbyMenuItem_t::k_ELobbyMenuItemUser };
-
-				char rgchMenuText[256];
-				sprintf_safe( rgchMenuText, "%s %s", pchName, bReady ? "(READY)" : "" );
-				AddMenuItem( MenuItem_t( std::string( rgchMenuText ), menuItem ) );
+				AddMenuItem( MenuItem_t( sMenuText, menuItem ) );
 			}
 		}
 
@@ -97,6 +91,44 @@ public:
 		// reset selection
 		PopSelectedItem();
 	}
+
+	// Refreshes a lobby member's entry after their details changed, only rebuilding the
+	// menu for a member who isn't in it yet
+	void UpdateMember( const CSteamID &steamIDLobby, const CSteamID &steamIDLobbyMember )
+	{
+		std::string sMenuText;
+		if ( !BGetMemberMenuText( steamIDLobby, steamIDLobbyMember, sMenuText ) )
+			return;
+
+		LobbyMenuItem_t menuItem = { steamIDLobbyMember, LobbyMenuItem_t::k_ELobbyMenuItemUser };
+		if ( !BUpdateMenuItem( menuItem, sMenuText ) )
+			Rebuild( steamIDLobby );
+	}
+
+protected:
+	// Lobby member entries are identified by the user, the other fields and padding don't matter
+	virtual bool BMenuItemsMatch( const LobbyMenuItem_t &lhs, const LobbyMenuItem_t &rhs )
+	{
+		return lhs.m_eCommand == rhs.m_eCommand && lhs.m_steamIDUser == rhs.m_steamIDUser && lhs.m_steamIDLobby == rhs.m_steamIDLobby;
+	}
+
+private:
+	// Text for a lobby member's entry, false if we don't know their name yet
+	bool BGetMemberMenuText( const CSteamID &steamIDLobby, const CSteamID &steamIDLobbyMember, std::string &sMenuText )
+	{
+		// we get the details of a user from the ISteamFriends interface
+		const char *pchName = SteamFriends()->GetFriendPersonaName( steamIDLobbyMember );
+		if ( !pchName || !*pchName )
+			return false;
+
+		const char *pchReady = SteamMatchmaking()->GetLobbyMemberData( steamIDLobby, steamIDLobbyMember, "ready" );
+		bool bReady = ( pchReady && atoi( pchReady ) == 1);
+
+		char rgchMenuText[256];
+		sprintf_safe( rgchMenuText, "%s %s", pchName, bReady ? "(READY)" : "" );
+		sMenuText = rgchMenuText;
+		return true;
+	}
 };
 
 
@@ -152,8 +184,8 @@ void CLobby::OnPersonaStateChange( PersonaStateChange_t *pCallback )
 	if ( !SteamFriends()->IsUserInSource( pCallback->m_ulSteamID, m_steamIDLobby ) )
 		return;
 
-	// rebuild the menu
-	m_pMenu->Rebuild( m_steamIDLobby );
+	// update just their entry
+	m_pMenu->UpdateMember( m_steamIDLobby, pCallback->m_ulSteamID );
 }
 
 
@@ -259,6 +291,13 @@ public:
 		// reset selection
 		PopSelectedItem();
 	}
+
+protected:
+	// Lobbies are identified by their steamID and what selecting them does, not the struct padding
+	virtual bool BMenuItemsMatch( const LobbyBrowserMenuItem_t &lhs, const LobbyBrowserMenuItem_t &rhs )
+	{
+		return lhs.m_eStateToTransitionTo == rhs.m_eStateToTransitionTo && lhs.m_steamIDLobby == rhs.m_steamIDLobby;
+	}
 };
 
 
@@ -373,8 +412,12 @@ void CLobbyBrowser::OnLobbyDataUpdatedCallback( LobbyDataUpdate_t *pCallback )
 			if ( pchLobbyName[0] )
 			{
 				sprintf_safe( iter->m_rgchName, "%s", pchLobbyName );
-				// update the menu
-				m_pMenu->Rebuild( m_ListLobbies );
+				// update the lobby's entry in the menu
+				LobbyBrowserMenuItem_t data;
+				data.m_eStateToTransitionTo = k_EClientJoiningLobby;
+				data.m_steamIDLobby = iter->m_steamIDLobby;
+				if ( !m_pMenu->BUpdateMenuItem( data, iter->m_rgchName ) )
+					m_pMenu->Rebuild( m_ListLobbies );
 			}
 			return;
 		}
@@ -27,6 +27,10 @@
 #endif
 
 #include "SpaceWarClient.h"
+#include "BotSwarm.h"
+#include "Profiler.h"
+#include "MatchReplay.h"
+#include "WorkshopItemFile.h"
 
 //-----------------------------------------------------------------------------
 // Purpose: Wrapper around SteamAPI_WriteMiniDump which can be used directly 
@@ -112,10 +116,33 @@ bool ParseCommandLine( const char *pchCmdLine, const char **ppchServerAddress, c
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Copies the word following a parameter like "-metricsfile stats.prom",
+// returns false if the parameter isn't there
+//-----------------------------------------------------------------------------
+static bool GetCommandLineString( const char *pchCmdLine, const char *pchParam, char *pchValue, uint32 cchValue )
+{
+	pchValue[0] = 0;
+	const char *pchFound = strstr( pchCmdLine, pchParam );
+	if ( !pchFound || pchFound[ strlen( pchParam ) ] != ' ' )
+		return false;
+
+	const char *pchStart = pchFound + strlen( pchParam ) + 1;
+	uint32 cchCopy = 0;
+	while ( pchStart[cchCopy] && pchStart[cchCopy] != ' ' && cchCopy < cchValue - 1 )
+	{
+		pchValue[cchCopy] = pchStart[cchCopy];
+		++cchCopy;
+	}
+	pchValue[cchCopy] = 0;
+	return cchCopy > 0;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Main loop code shared between all platforms
 //-----------------------------------------------------------------------------
-void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const char *pchLobbyID, bool bShowTimer )
+void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const char *pchLobbyID, bool bShowTimer, const char *pchMetricsFile, const char *pchRecordFile )
 {
 	// Make sure it initialized ok
 	if ( pGameEngine->BReadyForUse() )
@@ -124,6 +151,8 @@ void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const
 		CSpaceWarClient *pGameClient = new CSpaceWarClient( pGameEngine );
 
 		pGameClient->SetShowTimer( bShowTimer );
+		pGameClient->SetServerMetricsFile( pchMetricsFile );
+		pGameClient->SetServerRecordFile( pchRecordFile );
 
 		// Black background
 		pGameEngine->SetBackgroundColor( 0, 0, 0, 0 );
@@ -140,11 +169,21 @@ void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const
 		{
 			if ( pGameEngine->StartFrame() )
 			{
-				pGameEngine->UpdateGameTickCount();
+				int64 usecFrameStart = CProfiler::GetTimestamp();
+				{
+					PROFILE_SCOPE( "Frame" );
+					pGameEngine->UpdateGameTickCount();
+
+					// Run a game frame
+					pGameClient->RunFrame();
+
+					PROFILE_SCOPE( "GameEngine::EndFrame" );
+					pGameEngine->EndFrame();
+				}
 
-				// Run a game frame
-				pGameClient->RunFrame();
-				pGameEngine->EndFrame();
+				// Only the work up to presenting counts toward the frame, network pumping while we
+				// wait out the frame rate limit is attributed to the next one
+				CProfiler::EndFrame( (uint32)( CProfiler::GetTimestamp() - usecFrameStart ) );
 
 				// Sleep to limit frame rate
 				while( pGameEngine->BSleepForFrameRateLimit( MAX_CLIENT_AND_SERVER_FPS ) )
@@ -168,6 +207,42 @@ void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const
 //-----------------------------------------------------------------------------
 static int RealMain( const char *pchCmdLine, HINSTANCE hInstance, int nCmdShow )
 {	
+	// -metricsfile <path> has any server we run write Prometheus style metrics to <path>
+	char rgchMetricsFile[1024];
+	const char *pchMetricsFile = GetCommandLineString( pchCmdLine, "-metricsfile", rgchMetricsFile, sizeof( rgchMetricsFile ) ) ? rgchMetricsFile : NULL;
+
+	// -recordmatch <path> has any server we run record its match to <path>
+	char rgchRecordFile[1024];
+	const char *pchRecordFile = GetCommandLineString( pchCmdLine, "-recordmatch", rgchRecordFile, sizeof( rgchRecordFile ) ) ? rgchRecordFile : NULL;
+
+	// Re-simulate a recorded match, headless
+	char rgchReplayFile[1024];
+	if ( GetCommandLineString( pchCmdLine, "-replay", rgchReplayFile, sizeof( rgchReplayFile ) ) )
+		return RunMatchReplay( rgchReplayFile );
+
+	// Convert a workshopitem.txt to the binary workshopitem.bin next to it
+	char rgchWorkshopItemFile[1024];
+	if ( GetCommandLineString( pchCmdLine, "-convertworkshopitem", rgchWorkshopItemFile, sizeof( rgchWorkshopItemFile ) ) )
+	{
+		char rgchBinaryFile[1024];
+		sprintf_safe( rgchBinaryFile, "%s", rgchWorkshopItemFile );
+		char *pchExtension = strrchr( rgchBinaryFile, '.' );
+		if ( pchExtension && !strcmp( pchExtension, ".txt" ) )
+			*pchExtension = 0;
+		strncat( rgchBinaryFile, ".bin", sizeof( rgchBinaryFile ) - strlen( rgchBinaryFile ) - 1 );
+
+		if ( !BConvertWorkshopItemToBinary( rgchWorkshopItemFile, rgchBinaryFile ) )
+		{
+			OutputDebugString( "Failed to convert workshop item\n" );
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Headless load test against local servers, needs neither Steam nor a window
+	if ( strstr( pchCmdLine, "-botswarm" ) )
+		return RunBotSwarm( pchCmdLine, pchMetricsFile, pchRecordFile );
+
 	if ( SteamAPI_RestartAppIfNecessary( k_uAppIdInvalid ) )
 	{
 		// if Steam is not running or the game wasn't started through Steam, SteamAPI_RestartAppIfNecessary starts the 
@@ -235,6 +310,10 @@ static int RealMain( const char *pchCmdLine, HINSTANCE hInstance, int nCmdShow )
 
 	bool bShowTimer = !!strstr( pchCmdLine, "-timer" );
 
+	// -profile records zone timings, logs slow frames and writes a trace on exit
+	bool bProfile = !!strstr( pchCmdLine, "-profile" );
+	CProfiler::SetEnabled( bProfile );
+
 	// do a DRM self check
 	Steamworks_SelfCheck();
 
@@ -275,7 +354,14 @@ static int RealMain( const char *pchCmdLine, HINSTANCE hInstance, int nCmdShow )
 	SteamInput()->SetInputActionManifestFilePath( rgchFullPath );
 
 	// This call will block and run until the game exits
-	RunGameLoop( pGameEngine, pchServerAddress, pchLobbyID, bShowTimer );
+	RunGameLoop( pGameEngine, pchServerAddress, pchLobbyID, bShowTimer, pchMetricsFile, pchRecordFile );
+
+	if ( bProfile )
+	{
+		CProfiler::DumpZoneStats();
+		if ( !CProfiler::WriteChromeTrace( "spacewar_trace.json" ) )
+			OutputDebugString( "Failed writing spacewar_trace.json\n" );
+	}
 
 	// Shutdown the SteamAPI
 	SteamAPI_Shutdown();
@@ -0,0 +1,482 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Recording of server matches and replaying them through the server
+//			simulation
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "MatchReplay.h"
+#include "SpaceWarServer.h"
+#include "gameengineheadless.h"
+#include "Profiler.h"
+#include <algorithm>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CMatchRecorder::CMatchRecorder( IGameEngine *pGameEngine )
+{
+	m_pGameEngine = pGameEngine;
+	m_pFile = NULL;
+	m_ulLastTickCount = 0;
+	m_ulLastKeyframeTickCount = 0;
+	memset( m_rgLastClientUpdate, 0, sizeof( m_rgLastClientUpdate ) );
+	memset( &m_LastServerUpdate, 0, sizeof( m_LastServerUpdate ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CMatchRecorder::~CMatchRecorder()
+{
+	if ( m_pFile )
+		fclose( m_pFile );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Create the file and write the header
+//-----------------------------------------------------------------------------
+bool CMatchRecorder::BOpen( const char *pchFileName, uint64 ulStartTickCount )
+{
+	if ( m_pFile )
+		return false;
+
+	m_pFile = fopen( pchFileName, "wb" );
+	if ( !m_pFile )
+		return false;
+
+	ReplayFileHeader_t header;
+	memset( &header, 0, sizeof( header ) );
+	header.m_unMagic = REPLAY_FILE_MAGIC;
+	header.m_unVersion = REPLAY_FILE_VERSION;
+	header.m_unMaxPlayers = MAX_PLAYERS_PER_SERVER;
+	header.m_cubClientUpdate = sizeof( ClientSpaceWarUpdateData_t );
+	header.m_cubServerUpdate = sizeof( ServerSpaceWarUpdateData_t );
+	header.m_ulStartTickCount = ulStartTickCount;
+	header.m_nViewportWidth = m_pGameEngine->GetViewportWidth();
+	header.m_nViewportHeight = m_pGameEngine->GetViewportHeight();
+	fwrite( &header, sizeof( header ), 1, m_pFile );
+
+	m_ulLastTickCount = ulStartTickCount;
+	m_ulLastKeyframeTickCount = ulStartTickCount;
+	return true;
+}
+
+
+void CMatchRecorder::WriteByte( uint8 ub )
+{
+	fputc( ub, m_pFile );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Seven bits at a time, high bit set on all but the last byte
+//-----------------------------------------------------------------------------
+void CMatchRecorder::WriteVarInt( uint64 ulValue )
+{
+	while ( ulValue >= 0x80 )
+	{
+		WriteByte( (uint8)( ulValue | 0x80 ) );
+		ulValue >>= 7;
+	}
+	WriteByte( (uint8)ulValue );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Store a struct as its XOR against the previous one, as alternating
+// runs of unchanged (zero) bytes and changed bytes.  Updates pPrevious.
+//-----------------------------------------------------------------------------
+void CMatchRecorder::WriteDelta( const void *pData, void *pPrevious, uint32 cubData )
+{
+	const uint8 *pubData = (const uint8 *)pData;
+	uint8 *pubPrevious = (uint8 *)pPrevious;
+
+	uint32 unPos = 0;
+	while ( unPos < cubData )
+	{
+		uint32 unZeroStart = unPos;
+		while ( unPos < cubData && pubData[unPos] == pubPrevious[unPos] )
+			++unPos;
+
+		// A changed run ends at the next pair of unchanged bytes, a single one isn't worth splitting for
+		uint32 unChangedStart = unPos;
+		while ( unPos < cubData && !( pubData[unPos] == pubPrevious[unPos] && ( unPos + 1 == cubData || pubData[unPos + 1] == pubPrevious[unPos + 1] ) ) )
+			++unPos;
+
+		WriteVarInt( unChangedStart - unZeroStart );
+		WriteVarInt( unPos - unChangedStart );
+		for ( uint32 i = unChangedStart; i < unPos; ++i )
+			WriteByte( pubData[i] ^ pubPrevious[i] );
+	}
+
+	memcpy( pPrevious, pData, cubData );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Note the clock moving, if it has, before writing anything that happened at the new time
+//-----------------------------------------------------------------------------
+void CMatchRecorder::SyncClock()
+{
+	uint64 ulTickCount = m_pGameEngine->GetGameTickCount();
+	if ( ulTickCount == m_ulLastTickCount )
+		return;
+
+	WriteByte( k_EReplayRecordTick );
+	WriteVarInt( ulTickCount - m_ulLastTickCount );
+	WriteVarInt( m_pGameEngine->GetGameTicksFrameDelta() );
+	m_ulLastTickCount = ulTickCount;
+}
+
+
+void CMatchRecorder::RecordRunFrame()
+{
+	if ( !m_pFile )
+		return;
+
+	SyncClock();
+	WriteByte( k_EReplayRecordRunFrame );
+}
+
+
+void CMatchRecorder::RecordPlayerAdded( uint32 uShipPosition, uint64 ulSteamID )
+{
+	if ( !m_pFile || uShipPosition >= MAX_PLAYERS_PER_SERVER )
+		return;
+
+	SyncClock();
+	WriteByte( k_EReplayRecordPlayerAdded );
+	WriteByte( (uint8)uShipPosition );
+	WriteVarInt( ulSteamID );
+}
+
+
+void CMatchRecorder::RecordPlayerRemoved( uint32 uShipPosition )
+{
+	if ( !m_pFile || uShipPosition >= MAX_PLAYERS_PER_SERVER )
+		return;
+
+	SyncClock();
+	WriteByte( k_EReplayRecordPlayerRemoved );
+	WriteByte( (uint8)uShipPosition );
+}
+
+
+void CMatchRecorder::RecordClientUpdate( uint32 uShipPosition, const ClientSpaceWarUpdateData_t &updateData )
+{
+	if ( !m_pFile || uShipPosition >= MAX_PLAYERS_PER_SERVER )
+		return;
+
+	SyncClock();
+	WriteByte( k_EReplayRecordClientUpdate );
+	WriteByte( (uint8)uShipPosition );
+	WriteDelta( &updateData, &m_rgLastClientUpdate[uShipPosition], sizeof( updateData ) );
+}
+
+
+bool CMatchRecorder::BWantsKeyframe()
+{
+	return m_pFile && m_pGameEngine->GetGameTickCount() - m_ulLastKeyframeTickCount >= REPLAY_KEYFRAME_INTERVAL_MS;
+}
+
+
+void CMatchRecorder::RecordKeyframe( const ServerSpaceWarUpdateData_t &updateData )
+{
+	if ( !m_pFile )
+		return;
+
+	SyncClock();
+	WriteByte( k_EReplayRecordKeyframe );
+	WriteDelta( &updateData, &m_LastServerUpdate, sizeof( updateData ) );
+	fflush( m_pFile );
+
+	m_ulLastKeyframeTickCount = m_pGameEngine->GetGameTickCount();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CMatchReplayReader::CMatchReplayReader()
+{
+	m_unReadPos = 0;
+	m_ulTickCount = 0;
+	memset( &m_Header, 0, sizeof( m_Header ) );
+	memset( m_rgLastClientUpdate, 0, sizeof( m_rgLastClientUpdate ) );
+	memset( &m_LastServerUpdate, 0, sizeof( m_LastServerUpdate ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Load the file and check it was written by a compatible build
+//-----------------------------------------------------------------------------
+bool CMatchReplayReader::BOpen( const char *pchFileName )
+{
+	FILE *pFile = fopen( pchFileName, "rb" );
+	if ( !pFile )
+		return false;
+
+	uint8 rgubBuffer[4096];
+	size_t cubRead;
+	while ( ( cubRead = fread( rgubBuffer, 1, sizeof( rgubBuffer ), pFile ) ) > 0 )
+		m_vecData.insert( m_vecData.end(), rgubBuffer, rgubBuffer + cubRead );
+	fclose( pFile );
+
+	if ( m_vecData.size() < sizeof( m_Header ) )
+		return false;
+
+	memcpy( &m_Header, &m_vecData[0], sizeof( m_Header ) );
+	m_unReadPos = sizeof( m_Header );
+	m_ulTickCount = m_Header.m_ulStartTickCount;
+
+	return m_Header.m_unMagic == REPLAY_FILE_MAGIC &&
+		m_Header.m_unVersion == REPLAY_FILE_VERSION &&
+		m_Header.m_unMaxPlayers == MAX_PLAYERS_PER_SERVER &&
+		m_Header.m_cubClientUpdate == sizeof( ClientSpaceWarUpdateData_t ) &&
+		m_Header.m_cubServerUpdate == sizeof( ServerSpaceWarUpdateData_t );
+}
+
+
+bool CMatchReplayReader::BReadByte( uint8 *pub )
+{
+	if ( m_unReadPos >= m_vecData.size() )
+		return false;
+
+	*pub = m_vecData[m_unReadPos++];
+	return true;
+}
+
+
+bool CMatchReplayReader::BReadVarInt( uint64 *pulValue )
+{
+	*pulValue = 0;
+	for ( uint32 unShift = 0; unShift < 64; unShift += 7 )
+	{
+		uint8 ub;
+		if ( !BReadByte( &ub ) )
+			return false;
+
+		*pulValue |= (uint64)( ub & 0x7f ) << unShift;
+		if ( !( ub & 0x80 ) )
+			return true;
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Undo CMatchRecorder::WriteDelta
+//-----------------------------------------------------------------------------
+bool CMatchReplayReader::BReadDelta( void *pData, void *pPrevious, uint32 cubData )
+{
+	uint8 *pubPrevious = (uint8 *)pPrevious;
+
+	uint64 unPos = 0;
+	while ( unPos < cubData )
+	{
+		uint64 cubUnchanged, cubChanged;
+		if ( !BReadVarInt( &cubUnchanged ) || !BReadVarInt( &cubChanged ) )
+			return false;
+		if ( cubUnchanged + cubChanged == 0 || unPos + cubUnchanged + cubChanged > cubData )
+			return false;
+
+		unPos += cubUnchanged;
+		for ( uint64 i = 0; i < cubChanged; ++i )
+		{
+			uint8 ub;
+			if ( !BReadByte( &ub ) )
+				return false;
+			pubPrevious[unPos++] ^= ub;
+		}
+	}
+
+	memcpy( pData, pPrevious, cubData );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Decode the next record
+//-----------------------------------------------------------------------------
+bool CMatchReplayReader::BReadRecord( ReplayRecord_t *pRecord )
+{
+	uint8 ubType;
+	if ( !BReadByte( &ubType ) )
+		return false;
+
+	pRecord->m_eType = (EReplayRecord)ubType;
+	switch ( pRecord->m_eType )
+	{
+	case k_EReplayRecordTick:
+	{
+		uint64 ulTickDelta;
+		if ( !BReadVarInt( &ulTickDelta ) || !BReadVarInt( &pRecord->m_ulFrameDelta ) )
+			return false;
+		m_ulTickCount += ulTickDelta;
+		pRecord->m_ulTickCount = m_ulTickCount;
+		return true;
+	}
+
+	case k_EReplayRecordRunFrame:
+		return true;
+
+	case k_EReplayRecordPlayerAdded:
+	{
+		uint8 ubShipPosition;
+		if ( !BReadByte( &ubShipPosition ) || ubShipPosition >= MAX_PLAYERS_PER_SERVER )
+			return false;
+		pRecord->m_uShipPosition = ubShipPosition;
+		return BReadVarInt( &pRecord->m_ulSteamID );
+	}
+
+	case k_EReplayRecordPlayerRemoved:
+	{
+		uint8 ubShipPosition;
+		if ( !BReadByte( &ubShipPosition ) || ubShipPosition >= MAX_PLAYERS_PER_SERVER )
+			return false;
+		pRecord->m_uShipPosition = ubShipPosition;
+		return true;
+	}
+
+	case k_EReplayRecordClientUpdate:
+	{
+		uint8 ubShipPosition;
+		if ( !BReadByte( &ubShipPosition ) || ubShipPosition >= MAX_PLAYERS_PER_SERVER )
+			return false;
+		pRecord->m_uShipPosition = ubShipPosition;
+		return BReadDelta( &pRecord->m_ClientUpdate, &m_rgLastClientUpdate[ubShipPosition], sizeof( pRecord->m_ClientUpdate ) );
+	}
+
+	case k_EReplayRecordKeyframe:
+		return BReadDelta( &pRecord->m_ServerUpdate, &m_LastServerUpdate, sizeof( pRecord->m_ServerUpdate ) );
+
+	default:
+		return false;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Re-simulate a recorded match.  The server runs on a loopback transport
+// with no clients, a headless engine whose clock is driven by the recording, and
+// no frame rate limit.
+//-----------------------------------------------------------------------------
+int RunMatchReplay( const char *pchFileName )
+{
+	CMatchReplayReader reader;
+	if ( !reader.BOpen( pchFileName ) )
+	{
+		printf( "Replay: %s is missing or was not recorded by this build\n", pchFileName );
+		return EXIT_FAILURE;
+	}
+
+	const ReplayFileHeader_t &header = reader.GetHeader();
+
+	CGameEngineHeadless *pGameEngine = new CGameEngineHeadless( 1 );
+	pGameEngine->SetViewportSize( header.m_nViewportWidth, header.m_nViewportHeight );
+	pGameEngine->SetGameTickCount( header.m_ulStartTickCount, 0 );
+
+	CLoopbackNetwork *pNetwork = new CLoopbackNetwork();
+	SteamNetworkingIdentity identity;
+	identity.SetSteamID( CSteamID( 1, k_EUniversePublic, k_EAccountTypeGameServer ) );
+	CLoopbackTransport *pTransport = new CLoopbackTransport( pNetwork, identity );
+	CSpaceWarServer *pServer = new CSpaceWarServer( pGameEngine, pTransport );
+
+	std::vector<uint32> vecFrameUsec;
+	uint32 cKeyframesMatched = 0;
+	uint32 cKeyframesDiverged = 0;
+	int nFirstDivergedFrame = -1;
+	int64 usecStart = CProfiler::GetTimestamp();
+
+	ReplayRecord_t record;
+	bool bCorrupt = false;
+	while ( !reader.BAtEnd() )
+	{
+		if ( !reader.BReadRecord( &record ) )
+		{
+			bCorrupt = true;
+			break;
+		}
+
+		switch ( record.m_eType )
+		{
+		case k_EReplayRecordTick:
+			pGameEngine->SetGameTickCount( record.m_ulTickCount, record.m_ulFrameDelta );
+			break;
+
+		case k_EReplayRecordRunFrame:
+		{
+			int64 usecFrameStart = CProfiler::GetTimestamp();
+			pServer->RunFrame();
+			vecFrameUsec.push_back( (uint32)( CProfiler::GetTimestamp() - usecFrameStart ) );
+			break;
+		}
+
+		case k_EReplayRecordPlayerAdded:
+			pServer->m_rgClientData[record.m_uShipPosition] = ClientConnectionData_t();
+			pServer->m_rgClientData[record.m_uShipPosition].m_bActive = true;
+			pServer->m_rgClientData[record.m_uShipPosition].m_SteamIDUser = CSteamID( record.m_ulSteamID );
+			pServer->ActivatePlayer( record.m_uShipPosition );
+			break;
+
+		case k_EReplayRecordPlayerRemoved:
+			pServer->RemovePlayerFromServer( record.m_uShipPosition, k_EDRClientDisconnect );
+			break;
+
+		case k_EReplayRecordClientUpdate:
+			pServer->OnReceiveClientUpdateData( record.m_uShipPosition, &record.m_ClientUpdate );
+			break;
+
+		case k_EReplayRecordKeyframe:
+		{
+			ServerSpaceWarUpdateData_t updateData;
+			pServer->BuildUpdateData( &updateData );
+			if ( memcmp( &updateData, &record.m_ServerUpdate, sizeof( updateData ) ) == 0 )
+			{
+				++cKeyframesMatched;
+			}
+			else
+			{
+				if ( !cKeyframesDiverged )
+					nFirstDivergedFrame = (int)vecFrameUsec.size();
+				++cKeyframesDiverged;
+			}
+			break;
+		}
+		}
+	}
+
+	int64 usecElapsed = CProfiler::GetTimestamp() - usecStart;
+	uint64 ulGameMilliseconds = pGameEngine->GetGameTickCount() - header.m_ulStartTickCount;
+
+	delete pServer;
+	delete pTransport;
+	delete pNetwork;
+	delete pGameEngine;
+
+	printf( "Replay %s: %u bytes, %u frames, %.1f s of game time in %.3f s (%.0fx real time)\n", pchFileName,
+		reader.GetFileSize(), (uint32)vecFrameUsec.size(), ulGameMilliseconds / 1000.0, usecElapsed / 1000000.0,
+		usecElapsed ? ulGameMilliseconds * 1000.0 / usecElapsed : 0.0 );
+	if ( bCorrupt )
+		printf( "Replay stopped early, the rest of the file is truncated or corrupt\n" );
+
+	if ( !vecFrameUsec.empty() )
+	{
+		std::sort( vecFrameUsec.begin(), vecFrameUsec.end() );
+		size_t cFrames = vecFrameUsec.size();
+		printf( "Server frame (us): p50 %u  p99 %u  max %u\n", vecFrameUsec[ cFrames * 50 / 100 ], vecFrameUsec[ cFrames * 99 / 100 ], vecFrameUsec[ cFrames - 1 ] );
+	}
+
+	if ( cKeyframesDiverged )
+		printf( "Keyframes: %u matched, %u diverged, first at frame %d\n", cKeyframesMatched, cKeyframesDiverged, nFirstDivergedFrame );
+	else
+		printf( "Keyframes: all %u matched\n", cKeyframesMatched );
+
+	return cKeyframesDiverged ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Recording of server matches and replaying them through the server
+//			simulation.
+//
+//	A replay file is a header followed by an append-only stream of records in
+//	the order the server saw them: clock changes, players joining and leaving,
+//	client input and the point in each frame where simulation starts.  Feeding
+//	the same stream to a fresh CSpaceWarServer on a simulated clock reproduces
+//	the match, and the periodic keyframes of world state let the player check
+//	that it did.
+//
+//	Client inputs and keyframes are stored XOR'd against the previous one of
+//	their kind and run length encoded, so an unchanged input costs a few bytes.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef MATCHREPLAY_H
+#define MATCHREPLAY_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "GameEngine.h"
+#include "SpaceWar.h"
+
+#define REPLAY_FILE_MAGIC 0x50525753	// "SWRP"
+#define REPLAY_FILE_VERSION 1
+
+// How often the recorder stores a full world state keyframe
+#define REPLAY_KEYFRAME_INTERVAL_MS 1000
+
+enum EReplayRecord
+{
+	k_EReplayRecordTick = 1,			// the game clock moved
+	k_EReplayRecordRunFrame = 2,		// server simulation for this frame starts here
+	k_EReplayRecordPlayerAdded = 3,		// a player passed authentication and got a ship
+	k_EReplayRecordPlayerRemoved = 4,	// a player left or was kicked (timeouts are re-simulated, not recorded)
+	k_EReplayRecordClientUpdate = 5,	// input from a player
+	k_EReplayRecordKeyframe = 6,		// world state at the end of a frame
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Fixed size start of every replay file
+//-----------------------------------------------------------------------------
+struct ReplayFileHeader_t
+{
+	uint32 m_unMagic;
+	uint32 m_unVersion;
+
+	// Layout checks, a replay only plays back on a build with the same structs
+	uint32 m_unMaxPlayers;
+	uint32 m_cubClientUpdate;
+	uint32 m_cubServerUpdate;
+
+	// Game clock when the server was created and the viewport it simulated in
+	uint64 m_ulStartTickCount;
+	int32 m_nViewportWidth;
+	int32 m_nViewportHeight;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One decoded record
+//-----------------------------------------------------------------------------
+struct ReplayRecord_t
+{
+	EReplayRecord m_eType;
+
+	// k_EReplayRecordTick
+	uint64 m_ulTickCount;
+	uint64 m_ulFrameDelta;
+
+	// k_EReplayRecordPlayer* and k_EReplayRecordClientUpdate
+	uint32 m_uShipPosition;
+	uint64 m_ulSteamID;
+	ClientSpaceWarUpdateData_t m_ClientUpdate;
+
+	// k_EReplayRecordKeyframe
+	ServerSpaceWarUpdateData_t m_ServerUpdate;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes a replay file for one server.  Every record first notes a
+// clock change if the game tick moved since the last record.
+//-----------------------------------------------------------------------------
+class CMatchRecorder
+{
+public:
+	CMatchRecorder( IGameEngine *pGameEngine );
+	~CMatchRecorder();
+
+	// Create the file and write the header, must happen before the server runs its first frame
+	bool BOpen( const char *pchFileName, uint64 ulStartTickCount );
+
+	void RecordRunFrame();
+	void RecordPlayerAdded( uint32 uShipPosition, uint64 ulSteamID );
+	void RecordPlayerRemoved( uint32 uShipPosition );
+	void RecordClientUpdate( uint32 uShipPosition, const ClientSpaceWarUpdateData_t &updateData );
+
+	// Keyframes are taken at the end of a frame once REPLAY_KEYFRAME_INTERVAL_MS has passed,
+	// the file is flushed with each one so a crash loses at most that much
+	bool BWantsKeyframe();
+	void RecordKeyframe( const ServerSpaceWarUpdateData_t &updateData );
+
+private:
+	void SyncClock();
+	void WriteByte( uint8 ub );
+	void WriteVarInt( uint64 ulValue );
+	void WriteDelta( const void *pData, void *pPrevious, uint32 cubData );
+
+	IGameEngine *m_pGameEngine;
+	FILE *m_pFile;
+	uint64 m_ulLastTickCount;
+	uint64 m_ulLastKeyframeTickCount;
+
+	// What inputs and keyframes get XOR'd against
+	ClientSpaceWarUpdateData_t m_rgLastClientUpdate[MAX_PLAYERS_PER_SERVER];
+	ServerSpaceWarUpdateData_t m_LastServerUpdate;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Decodes a replay file, loaded into memory up front
+//-----------------------------------------------------------------------------
+class CMatchReplayReader
+{
+public:
+	CMatchReplayReader();
+
+	bool BOpen( const char *pchFileName );
+	const ReplayFileHeader_t &GetHeader() { return m_Header; }
+
+	// Returns false if the record is truncated or corrupt
+	bool BReadRecord( ReplayRecord_t *pRecord );
+	bool BAtEnd() { return m_unReadPos >= m_vecData.size(); }
+
+	uint32 GetFileSize() { return (uint32)m_vecData.size(); }
+
+private:
+	bool BReadByte( uint8 *pub );
+	bool BReadVarInt( uint64 *pulValue );
+	bool BReadDelta( void *pData, void *pPrevious, uint32 cubData );
+
+	std::vector<uint8> m_vecData;
+	uint32 m_unReadPos;
+	ReplayFileHeader_t m_Header;
+	uint64 m_ulTickCount;
+
+	ClientSpaceWarUpdateData_t m_rgLastClientUpdate[MAX_PLAYERS_PER_SERVER];
+	ServerSpaceWarUpdateData_t m_LastServerUpdate;
+};
+
+
+// Entry point for -replay, re-simulates the match as fast as possible and reports
+// whether it matched the recording.  Returns a process exit code.
+int RunMatchReplay( const char *pchFileName );
+
+#endif // MATCHREPLAY_H
@@ -0,0 +1,183 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Lightweight scoped-zone profiler
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "Profiler.h"
+#include "SpaceWar.h"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+std::atomic<bool> CProfiler::s_bEnabled( false );
+uint32 CProfiler::s_unSpikeThresholdUsec = 1000000 / MAX_CLIENT_AND_SERVER_FPS * 2;
+std::atomic<ProfileZone_t *> CProfiler::s_pZones( NULL );
+std::atomic<ProfileThreadBuffer_t *> CProfiler::s_pThreadBuffers( NULL );
+std::atomic<uint32> CProfiler::s_unThreadCount( 0 );
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Microseconds on a monotonic clock
+//-----------------------------------------------------------------------------
+int64 CProfiler::GetTimestamp()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add a zone to the global list, safe to race from several threads
+//-----------------------------------------------------------------------------
+void CProfiler::RegisterZone( ProfileZone_t *pZone )
+{
+	if ( pZone->m_bRegistered.exchange( true ) )
+		return;
+
+	ProfileZone_t *pHead = s_pZones.load( std::memory_order_relaxed );
+	do
+	{
+		pZone->m_pNext = pHead;
+	} while ( !s_pZones.compare_exchange_weak( pHead, pZone, std::memory_order_release, std::memory_order_relaxed ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Ring for the calling thread, allocated on first use.  Buffers are
+// never freed so the trace writer can walk them after their thread is gone.
+//-----------------------------------------------------------------------------
+ProfileThreadBuffer_t *CProfiler::GetThreadBuffer()
+{
+	static thread_local ProfileThreadBuffer_t *s_pThreadBuffer = NULL;
+	if ( s_pThreadBuffer )
+		return s_pThreadBuffer;
+
+	ProfileThreadBuffer_t *pBuffer = new ProfileThreadBuffer_t;
+	pBuffer->m_unThreadIndex = s_unThreadCount.fetch_add( 1, std::memory_order_relaxed ) + 1;
+	pBuffer->m_unWritten.store( 0, std::memory_order_relaxed );
+
+	ProfileThreadBuffer_t *pHead = s_pThreadBuffers.load( std::memory_order_relaxed );
+	do
+	{
+		pBuffer->m_pNext = pHead;
+	} while ( !s_pThreadBuffers.compare_exchange_weak( pHead, pBuffer, std::memory_order_release, std::memory_order_relaxed ) );
+
+	s_pThreadBuffer = pBuffer;
+	return pBuffer;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Store one finished zone instance
+//-----------------------------------------------------------------------------
+void CProfiler::RecordEvent( ProfileZone_t *pZone, int64 usecStart, int64 usecEnd )
+{
+	if ( !pZone->m_bRegistered.load( std::memory_order_relaxed ) )
+		RegisterZone( pZone );
+
+	ProfileThreadBuffer_t *pBuffer = GetThreadBuffer();
+	uint32 unWritten = pBuffer->m_unWritten.load( std::memory_order_relaxed );
+	ProfileEvent_t &event = pBuffer->m_rgEvents[ unWritten % PROFILER_EVENTS_PER_THREAD ];
+	event.m_pZone = pZone;
+	event.m_usecStart = usecStart;
+	event.m_usecEnd = usecEnd;
+	pBuffer->m_unWritten.store( unWritten + 1, std::memory_order_release );
+
+	uint32 unUsec = (uint32)( usecEnd - usecStart );
+	uint32 unPos = pZone->m_unWindowPos.fetch_add( 1, std::memory_order_relaxed );
+	pZone->m_rgunWindowUsec[ unPos % PROFILER_ZONE_WINDOW ].store( unUsec, std::memory_order_relaxed );
+	pZone->m_ulFrameUsec.fetch_add( unUsec, std::memory_order_relaxed );
+	pZone->m_unFrameCalls.fetch_add( 1, std::memory_order_relaxed );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Close out a frame, logging where the time went if it was a spike
+//-----------------------------------------------------------------------------
+void CProfiler::EndFrame( uint32 unFrameUsec )
+{
+	if ( !BEnabled() )
+		return;
+
+	bool bSpike = unFrameUsec > s_unSpikeThresholdUsec;
+	if ( bSpike )
+	{
+		char rgchBuffer[256];
+		sprintf_safe( rgchBuffer, "Profiler: frame took %u us (threshold %u us)\n", unFrameUsec, s_unSpikeThresholdUsec );
+		OutputDebugString( rgchBuffer );
+	}
+
+	for ( ProfileZone_t *pZone = s_pZones.load( std::memory_order_acquire ); pZone; pZone = pZone->m_pNext )
+	{
+		uint64 ulUsec = pZone->m_ulFrameUsec.exchange( 0, std::memory_order_relaxed );
+		uint32 unCalls = pZone->m_unFrameCalls.exchange( 0, std::memory_order_relaxed );
+		if ( bSpike && unCalls )
+		{
+			char rgchBuffer[256];
+			sprintf_safe( rgchBuffer, "  %-40s %8llu us in %u calls\n", pZone->m_pchName, (unsigned long long)ulUsec, unCalls );
+			OutputDebugString( rgchBuffer );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Log percentiles over each zone's rolling window
+//-----------------------------------------------------------------------------
+void CProfiler::DumpZoneStats()
+{
+	std::vector<uint32> vecSamples;
+	vecSamples.reserve( PROFILER_ZONE_WINDOW );
+
+	for ( ProfileZone_t *pZone = s_pZones.load( std::memory_order_acquire ); pZone; pZone = pZone->m_pNext )
+	{
+		uint32 cSamples = std::min( pZone->m_unWindowPos.load( std::memory_order_relaxed ), (uint32)PROFILER_ZONE_WINDOW );
+		if ( !cSamples )
+			continue;
+
+		vecSamples.clear();
+		for ( uint32 i = 0; i < cSamples; ++i )
+			vecSamples.push_back( pZone->m_rgunWindowUsec[i].load( std::memory_order_relaxed ) );
+		std::sort( vecSamples.begin(), vecSamples.end() );
+
+		char rgchBuffer[256];
+		sprintf_safe( rgchBuffer, "%-40s p50 %7u  p95 %7u  p99 %7u  max %7u us\n", pZone->m_pchName,
+			vecSamples[ cSamples * 50 / 100 ], vecSamples[ cSamples * 95 / 100 ], vecSamples[ cSamples * 99 / 100 ], vecSamples[ cSamples - 1 ] );
+		OutputDebugString( rgchBuffer );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Dump the rings as complete ("X") events.  Meant to be called when
+// things are quiet (shutdown), events being overwritten while we read may come
+// out torn.
+//-----------------------------------------------------------------------------
+bool CProfiler::WriteChromeTrace( const char *pchFileName )
+{
+	FILE *pFile = fopen( pchFileName, "w" );
+	if ( !pFile )
+		return false;
+
+	fprintf( pFile, "{\"traceEvents\":[\n" );
+	bool bFirst = true;
+	for ( ProfileThreadBuffer_t *pBuffer = s_pThreadBuffers.load( std::memory_order_acquire ); pBuffer; pBuffer = pBuffer->m_pNext )
+	{
+		uint32 unWritten = pBuffer->m_unWritten.load( std::memory_order_acquire );
+		uint32 unFirst = unWritten > PROFILER_EVENTS_PER_THREAD ? unWritten - PROFILER_EVENTS_PER_THREAD : 0;
+		for ( uint32 i = unFirst; i != unWritten; ++i )
+		{
+			const ProfileEvent_t &event = pBuffer->m_rgEvents[ i % PROFILER_EVENTS_PER_THREAD ];
+			fprintf( pFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%u}",
+				bFirst ? "" : ",\n", event.m_pZone->m_pchName, (long long)event.m_usecStart,
+				(long long)( event.m_usecEnd - event.m_usecStart ), pBuffer->m_unThreadIndex );
+			bFirst = false;
+		}
+	}
+	fprintf( pFile, "\n]}\n" );
+
+	fclose( pFile );
+	return true;
+}
@@ -0,0 +1,138 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Lightweight scoped-zone profiler.
+//
+//	PROFILE_SCOPE( "name" ) times the enclosing block.  Each thread records into
+//	its own fixed size ring so recording never locks, and every zone keeps a
+//	rolling window of recent durations for percentiles.  When the profiler is
+//	off (the default) a zone costs one load and branch.
+//
+//	Call CProfiler::EndFrame() once per frame to get a breakdown logged for
+//	frames that go over the spike threshold, and WriteChromeTrace() to dump the
+//	rings in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+
+// Events kept per thread, oldest get overwritten
+#define PROFILER_EVENTS_PER_THREAD 65536
+
+// Durations kept per zone for the rolling percentiles
+#define PROFILER_ZONE_WINDOW 512
+
+//-----------------------------------------------------------------------------
+// Purpose: A named place in the code.  One static instance per PROFILE_SCOPE
+// site, registered on first use and never freed.
+//-----------------------------------------------------------------------------
+struct ProfileZone_t
+{
+	const char *m_pchName;
+	ProfileZone_t *m_pNext;
+	std::atomic<bool> m_bRegistered;
+
+	// Rolling window of durations in microseconds
+	std::atomic<uint32> m_unWindowPos;
+	std::atomic<uint32> m_rgunWindowUsec[ PROFILER_ZONE_WINDOW ];
+
+	// Time spent in the zone since the last EndFrame()
+	std::atomic<uint64> m_ulFrameUsec;
+	std::atomic<uint32> m_unFrameCalls;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: One recorded zone instance
+//-----------------------------------------------------------------------------
+struct ProfileEvent_t
+{
+	ProfileZone_t *m_pZone;
+	int64 m_usecStart;
+	int64 m_usecEnd;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: The per-thread ring.  Only the owning thread writes, m_unWritten is
+// published with release so readers see complete events.
+//-----------------------------------------------------------------------------
+struct ProfileThreadBuffer_t
+{
+	uint32 m_unThreadIndex;
+	ProfileThreadBuffer_t *m_pNext;
+	std::atomic<uint32> m_unWritten;
+	ProfileEvent_t m_rgEvents[ PROFILER_EVENTS_PER_THREAD ];
+};
+
+
+class CProfiler
+{
+public:
+	static void SetEnabled( bool bEnabled ) { s_bEnabled.store( bEnabled, std::memory_order_relaxed ); }
+	static bool BEnabled() { return s_bEnabled.load( std::memory_order_relaxed ); }
+
+	// Frames longer than this get their per-zone breakdown logged from EndFrame()
+	static void SetSpikeThresholdUsec( uint32 unUsec ) { s_unSpikeThresholdUsec = unUsec; }
+
+	// Microseconds on a monotonic clock
+	static int64 GetTimestamp();
+
+	// Recording, normally only called through CProfileScope
+	static void RegisterZone( ProfileZone_t *pZone );
+	static void RecordEvent( ProfileZone_t *pZone, int64 usecStart, int64 usecEnd );
+
+	// Call once per frame with the length of the frame that just finished
+	static void EndFrame( uint32 unFrameUsec );
+
+	// Log p50/p95/p99/max for every zone
+	static void DumpZoneStats();
+
+	// Write everything still in the rings as Chrome trace JSON
+	static bool WriteChromeTrace( const char *pchFileName );
+
+private:
+	static ProfileThreadBuffer_t *GetThreadBuffer();
+
+	static std::atomic<bool> s_bEnabled;
+	static uint32 s_unSpikeThresholdUsec;
+	static std::atomic<ProfileZone_t *> s_pZones;
+	static std::atomic<ProfileThreadBuffer_t *> s_pThreadBuffers;
+	static std::atomic<uint32> s_unThreadCount;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Times its own lifetime, use through PROFILE_SCOPE
+//-----------------------------------------------------------------------------
+class CProfileScope
+{
+public:
+	CProfileScope( ProfileZone_t *pZone )
+	{
+		m_pZone = CProfiler::BEnabled() ? pZone : NULL;
+		if ( m_pZone )
+			m_usecStart = CProfiler::GetTimestamp();
+	}
+
+	~CProfileScope()
+	{
+		if ( m_pZone )
+			CProfiler::RecordEvent( m_pZone, m_usecStart, CProfiler::GetTimestamp() );
+	}
+
+private:
+	ProfileZone_t *m_pZone;
+	int64 m_usecStart;
+};
+
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+
+// Time the rest of the enclosing scope under the given (string literal) name
+#define PROFILE_SCOPE( pchName ) \
+	static ProfileZone_t PROFILE_CONCAT( s_ProfileZone, __LINE__ ) = { pchName }; \
+	CProfileScope PROFILE_CONCAT( profileScope, __LINE__ )( &PROFILE_CONCAT( s_ProfileZone, __LINE__ ) )
+
+#endif // PROFILER_H
@@ -160,11 +160,11 @@ void CServerBrowser::ServerResponded( HServerListRequest hReq, int iServer )
 		{
 			m_ListGameServers.push_back( CGameServer( pServer ) );
 			m_nServers++;
+
+			// Add it to the menu, the servers already listed stay as they are
+			m_pMenu->AddServer( m_ListGameServers.back() );
 		}
 	}
-
-	// Rebuild menu
-	m_pMenu->Rebuild( m_ListGameServers, m_bRequestingServers );
 }
 
 
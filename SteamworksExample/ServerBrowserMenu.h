@@ -33,6 +33,15 @@ public:
 		data.m_eStateToTransitionTo = k_EClientGameMenu;
 		AddMenuItem( CServerBrowserMenu::MenuItem_t( "Return to main menu", data ) );
 	}
+
+	// Adds a server that just responded, above "Return to main menu" at the end of the list
+	void AddServer( CGameServer &server )
+	{
+		ServerBrowserMenuData_t data;
+		data.m_eStateToTransitionTo = k_EClientGameConnecting;
+		data.m_steamIDGameServer = server.GetSteamID();
+		InsertMenuItem( GetMenuItemCount() - 1, MenuItem_t( server.GetDisplayString(), data ) );
+	}
 };
 
 #endif // SERVERBROWSERMENU_H
\ No newline at end of file
@@ -0,0 +1,227 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Counters and histograms describing a running space war server
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "ServerMetrics.h"
+
+static const uint32 k_rgunTickBucketUsec[ SERVER_METRICS_TICK_BUCKETS ] =
+{
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000
+};
+
+struct MessageTypeName_t
+{
+	DWORD m_dwMessageType;
+	const char *m_pchName;
+};
+
+static const MessageTypeName_t k_rgMessageTypeNames[ SERVER_METRICS_MESSAGE_TYPES - 1 ] =
+{
+	{ k_EMsgServerSendInfo, "ServerSendInfo" },
+	{ k_EMsgServerFailAuthentication, "ServerFailAuthentication" },
+	{ k_EMsgServerPassAuthentication, "ServerPassAuthentication" },
+	{ k_EMsgServerUpdateWorld, "ServerUpdateWorld" },
+	{ k_EMsgServerExiting, "ServerExiting" },
+	{ k_EMsgServerPingResponse, "ServerPingResponse" },
+	{ k_EMsgServerPlayerHitSun, "ServerPlayerHitSun" },
+	{ k_EMsgClientBeginAuthentication, "ClientBeginAuthentication" },
+	{ k_EMsgClientSendLocalUpdate, "ClientSendLocalUpdate" },
+	{ k_EMsgP2PSendingTicket, "P2PSendingTicket" },
+	{ k_EMsgVoiceChatData, "VoiceChatData" },
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CServerMetrics::CServerMetrics()
+{
+	for ( uint32 i = 0; i <= SERVER_METRICS_TICK_BUCKETS; ++i )
+		m_rgcTicksInBucket[i].store( 0, std::memory_order_relaxed );
+	m_cTicks.store( 0, std::memory_order_relaxed );
+	m_ulTickUsecTotal.store( 0, std::memory_order_relaxed );
+
+	for ( uint32 i = 0; i < SERVER_METRICS_MESSAGE_TYPES; ++i )
+	{
+		m_rgMessageTypes[i].m_cMsgsIn.store( 0, std::memory_order_relaxed );
+		m_rgMessageTypes[i].m_cbIn.store( 0, std::memory_order_relaxed );
+		m_rgMessageTypes[i].m_cMsgsOut.store( 0, std::memory_order_relaxed );
+		m_rgMessageTypes[i].m_cbOut.store( 0, std::memory_order_relaxed );
+	}
+
+	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+		ClearConnection( i );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Map a wire message type onto its counters
+//-----------------------------------------------------------------------------
+uint32 CServerMetrics::GetMessageTypeSlot( DWORD dwMessageType )
+{
+	for ( uint32 i = 0; i < SERVER_METRICS_MESSAGE_TYPES - 1; ++i )
+	{
+		if ( k_rgMessageTypeNames[i].m_dwMessageType == dwMessageType )
+			return i;
+	}
+	return SERVER_METRICS_MESSAGE_TYPES - 1;
+}
+
+
+void CServerMetrics::RecordTick( uint32 unUsec )
+{
+	uint32 iBucket = 0;
+	while ( iBucket < SERVER_METRICS_TICK_BUCKETS && unUsec > k_rgunTickBucketUsec[iBucket] )
+		++iBucket;
+
+	m_rgcTicksInBucket[iBucket].fetch_add( 1, std::memory_order_relaxed );
+	m_cTicks.fetch_add( 1, std::memory_order_relaxed );
+	m_ulTickUsecTotal.fetch_add( unUsec, std::memory_order_relaxed );
+}
+
+
+void CServerMetrics::RecordMessageIn( DWORD dwMessageType, uint32 cbMessage )
+{
+	MessageTypeCounters_t &counters = m_rgMessageTypes[ GetMessageTypeSlot( dwMessageType ) ];
+	counters.m_cMsgsIn.fetch_add( 1, std::memory_order_relaxed );
+	counters.m_cbIn.fetch_add( cbMessage, std::memory_order_relaxed );
+}
+
+
+void CServerMetrics::RecordMessageOut( DWORD dwMessageType, uint32 cbMessage )
+{
+	MessageTypeCounters_t &counters = m_rgMessageTypes[ GetMessageTypeSlot( dwMessageType ) ];
+	counters.m_cMsgsOut.fetch_add( 1, std::memory_order_relaxed );
+	counters.m_cbOut.fetch_add( cbMessage, std::memory_order_relaxed );
+}
+
+
+void CServerMetrics::RecordConnection( uint32 uPlayerIndex, uint64 ulSteamID, const SteamNetConnectionRealTimeStatus_t &status )
+{
+	if ( uPlayerIndex >= MAX_PLAYERS_PER_SERVER )
+		return;
+
+	m_rgConnections[uPlayerIndex].m_bActive = true;
+	m_rgConnections[uPlayerIndex].m_ulSteamID = ulSteamID;
+	m_rgConnections[uPlayerIndex].m_Status = status;
+}
+
+
+void CServerMetrics::ClearConnection( uint32 uPlayerIndex )
+{
+	if ( uPlayerIndex >= MAX_PLAYERS_PER_SERVER )
+		return;
+
+	memset( &m_rgConnections[uPlayerIndex], 0, sizeof( m_rgConnections[uPlayerIndex] ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Write everything we have in the Prometheus text exposition format
+//-----------------------------------------------------------------------------
+void CServerMetrics::WriteMetrics( FILE *pFile )
+{
+	// Tick duration, buckets are cumulative and in seconds as Prometheus expects
+	fprintf( pFile, "# HELP spacewar_server_tick_seconds Time spent in CSpaceWarServer::RunFrame.\n" );
+	fprintf( pFile, "# TYPE spacewar_server_tick_seconds histogram\n" );
+	uint64 cCumulative = 0;
+	for ( uint32 i = 0; i < SERVER_METRICS_TICK_BUCKETS; ++i )
+	{
+		cCumulative += m_rgcTicksInBucket[i].load( std::memory_order_relaxed );
+		fprintf( pFile, "spacewar_server_tick_seconds_bucket{le=\"%g\"} %llu\n", k_rgunTickBucketUsec[i] / 1000000.0, (unsigned long long)cCumulative );
+	}
+	cCumulative += m_rgcTicksInBucket[SERVER_METRICS_TICK_BUCKETS].load( std::memory_order_relaxed );
+	fprintf( pFile, "spacewar_server_tick_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)cCumulative );
+	fprintf( pFile, "spacewar_server_tick_seconds_sum %g\n", m_ulTickUsecTotal.load( std::memory_order_relaxed ) / 1000000.0 );
+	fprintf( pFile, "spacewar_server_tick_seconds_count %llu\n", (unsigned long long)m_cTicks.load( std::memory_order_relaxed ) );
+
+	// Traffic per message type
+	fprintf( pFile, "# HELP spacewar_server_messages_total Messages handled by the server.\n" );
+	fprintf( pFile, "# TYPE spacewar_server_messages_total counter\n" );
+	for ( uint32 i = 0; i < SERVER_METRICS_MESSAGE_TYPES; ++i )
+	{
+		const char *pchType = i < SERVER_METRICS_MESSAGE_TYPES - 1 ? k_rgMessageTypeNames[i].m_pchName : "Other";
+		fprintf( pFile, "spacewar_server_messages_total{direction=\"in\",type=\"%s\"} %llu\n", pchType, (unsigned long long)m_rgMessageTypes[i].m_cMsgsIn.load( std::memory_order_relaxed ) );
+		fprintf( pFile, "spacewar_server_messages_total{direction=\"out\",type=\"%s\"} %llu\n", pchType, (unsigned long long)m_rgMessageTypes[i].m_cMsgsOut.load( std::memory_order_relaxed ) );
+	}
+
+	fprintf( pFile, "# HELP spacewar_server_bytes_total Message payload bytes handled by the server.\n" );
+	fprintf( pFile, "# TYPE spacewar_server_bytes_total counter\n" );
+	for ( uint32 i = 0; i < SERVER_METRICS_MESSAGE_TYPES; ++i )
+	{
+		const char *pchType = i < SERVER_METRICS_MESSAGE_TYPES - 1 ? k_rgMessageTypeNames[i].m_pchName : "Other";
+		fprintf( pFile, "spacewar_server_bytes_total{direction=\"in\",type=\"%s\"} %llu\n", pchType, (unsigned long long)m_rgMessageTypes[i].m_cbIn.load( std::memory_order_relaxed ) );
+		fprintf( pFile, "spacewar_server_bytes_total{direction=\"out\",type=\"%s\"} %llu\n", pchType, (unsigned long long)m_rgMessageTypes[i].m_cbOut.load( std::memory_order_relaxed ) );
+	}
+
+	// Per connection, as of the last sample
+	fprintf( pFile, "# HELP spacewar_connection_ping_seconds Round trip time to the player.\n" );
+	fprintf( pFile, "# TYPE spacewar_connection_ping_seconds gauge\n" );
+	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	{
+		if ( m_rgConnections[i].m_bActive )
+			fprintf( pFile, "spacewar_connection_ping_seconds{player=\"%u\",steamid=\"%llu\"} %g\n", i, (unsigned long long)m_rgConnections[i].m_ulSteamID, m_rgConnections[i].m_Status.m_nPing / 1000.0 );
+	}
+
+	fprintf( pFile, "# HELP spacewar_connection_quality Fraction of packets delivered, 1 is perfect.\n" );
+	fprintf( pFile, "# TYPE spacewar_connection_quality gauge\n" );
+	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	{
+		if ( !m_rgConnections[i].m_bActive )
+			continue;
+		fprintf( pFile, "spacewar_connection_quality{player=\"%u\",steamid=\"%llu\",side=\"local\"} %g\n", i, (unsigned long long)m_rgConnections[i].m_ulSteamID, m_rgConnections[i].m_Status.m_flConnectionQualityLocal );
+		fprintf( pFile, "spacewar_connection_quality{player=\"%u\",steamid=\"%llu\",side=\"remote\"} %g\n", i, (unsigned long long)m_rgConnections[i].m_ulSteamID, m_rgConnections[i].m_Status.m_flConnectionQualityRemote );
+	}
+
+	fprintf( pFile, "# HELP spacewar_connection_pending_bytes Bytes queued to send to the player.\n" );
+	fprintf( pFile, "# TYPE spacewar_connection_pending_bytes gauge\n" );
+	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	{
+		if ( !m_rgConnections[i].m_bActive )
+			continue;
+		fprintf( pFile, "spacewar_connection_pending_bytes{player=\"%u\",steamid=\"%llu\",reliability=\"reliable\"} %d\n", i, (unsigned long long)m_rgConnections[i].m_ulSteamID, m_rgConnections[i].m_Status.m_cbPendingReliable );
+		fprintf( pFile, "spacewar_connection_pending_bytes{player=\"%u\",steamid=\"%llu\",reliability=\"unreliable\"} %d\n", i, (unsigned long long)m_rgConnections[i].m_ulSteamID, m_rgConnections[i].m_Status.m_cbPendingUnreliable );
+	}
+
+	fprintf( pFile, "# HELP spacewar_connection_queue_seconds How long a message sent now would wait in the queue.\n" );
+	fprintf( pFile, "# TYPE spacewar_connection_queue_seconds gauge\n" );
+	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	{
+		if ( m_rgConnections[i].m_bActive )
+			fprintf( pFile, "spacewar_connection_queue_seconds{player=\"%u\",steamid=\"%llu\"} %g\n", i, (unsigned long long)m_rgConnections[i].m_ulSteamID, m_rgConnections[i].m_Status.m_usecQueueTime / 1000000.0 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replace the stats file with a fresh snapshot
+//-----------------------------------------------------------------------------
+bool CServerMetrics::BWriteStatsFile( const char *pchFileName )
+{
+	char rgchTempFileName[1024];
+	sprintf_safe( rgchTempFileName, "%s.tmp", pchFileName );
+
+	FILE *pFile = fopen( rgchTempFileName, "w" );
+	if ( !pFile )
+		return false;
+
+	WriteMetrics( pFile );
+	bool bWritten = !ferror( pFile );
+	fclose( pFile );
+
+	// rename() won't replace an existing file on Windows
+#ifdef _WIN32
+	if ( bWritten )
+		remove( pchFileName );
+#endif
+	if ( !bWritten || rename( rgchTempFileName, pchFileName ) != 0 )
+	{
+		remove( rgchTempFileName );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,87 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Counters and histograms describing a running space war server,
+//			written out in the Prometheus text format
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+#include <atomic>
+
+#include "SpaceWar.h"
+#include "Messages.h"
+#include "steam/steamnetworkingtypes.h"
+
+// Upper bounds of the tick duration histogram buckets in microseconds, plus an implicit +Inf
+#define SERVER_METRICS_TICK_BUCKETS 10
+
+// Message types we keep separate counters for, the last one catches anything unknown
+#define SERVER_METRICS_MESSAGE_TYPES 12
+
+// How often a server with a metrics file set rewrites it
+#define SERVER_METRICS_WRITE_INTERVAL_MS 5000
+
+//-----------------------------------------------------------------------------
+// Purpose: Traffic for one message type
+//-----------------------------------------------------------------------------
+struct MessageTypeCounters_t
+{
+	std::atomic<uint64> m_cMsgsIn;
+	std::atomic<uint64> m_cbIn;
+	std::atomic<uint64> m_cMsgsOut;
+	std::atomic<uint64> m_cbOut;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Last sampled state of one player connection
+//-----------------------------------------------------------------------------
+struct ConnectionMetrics_t
+{
+	bool m_bActive;
+	uint64 m_ulSteamID;
+	SteamNetConnectionRealTimeStatus_t m_Status;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Metrics for one server.  Every counter is a relaxed atomic with a
+// single writer (the tick thread), so recording never takes a lock and a
+// snapshot can be read from anywhere, at worst a few increments stale.
+//-----------------------------------------------------------------------------
+class CServerMetrics
+{
+public:
+	CServerMetrics();
+
+	// Recording, called from the server tick
+	void RecordTick( uint32 unUsec );
+	void RecordMessageIn( DWORD dwMessageType, uint32 cbMessage );
+	void RecordMessageOut( DWORD dwMessageType, uint32 cbMessage );
+	void RecordConnection( uint32 uPlayerIndex, uint64 ulSteamID, const SteamNetConnectionRealTimeStatus_t &status );
+	void ClearConnection( uint32 uPlayerIndex );
+
+	// Prometheus text exposition format, written to a temp file and renamed into
+	// place so scrapers (e.g. node_exporter's textfile collector) never see half a file
+	bool BWriteStatsFile( const char *pchFileName );
+
+private:
+	void WriteMetrics( FILE *pFile );
+
+	// Slot in m_rgMessageTypes for a message type, unknown types share the last slot
+	static uint32 GetMessageTypeSlot( DWORD dwMessageType );
+
+	std::atomic<uint64> m_rgcTicksInBucket[ SERVER_METRICS_TICK_BUCKETS + 1 ];
+	std::atomic<uint64> m_cTicks;
+	std::atomic<uint64> m_ulTickUsecTotal;
+
+	MessageTypeCounters_t m_rgMessageTypes[ SERVER_METRICS_MESSAGE_TYPES ];
+
+	// Sampled and written from the tick thread, not shared
+	ConnectionMetrics_t m_rgConnections[ MAX_PLAYERS_PER_SERVER ];
+};
+
+#endif // SERVERMETRICS_H
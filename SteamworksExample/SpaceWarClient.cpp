@@ -27,6 +27,8 @@
 #include "ItemStore.h"
 #include "OverlayExamples.h"
 #include "timeline.h"
+#include "Profiler.h"
+#include "WorkshopItemFile.h"
 #ifdef WIN32
 #include <direct.h>
 #else
@@ -99,11 +101,17 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	m_ulPingSentTime = 0;
 	m_bSentWebOpen = false;
 	m_bShowTimer = false;
+	m_rgchServerMetricsFile[0] = 0;
+	m_rgchServerRecordFile[0] = 0;
 	m_unTicksAtLaunch = 0;
 	m_hTimerFont = 0;
 	m_hConnServer = k_HSteamNetConnection_Invalid;
 	m_unTicksAtLaunch = Plat_GetTicks();
 
+	// Talk to servers over Steam networking, connection changes come back through OnNetConnectionStatusChanged
+	m_pTransport = new CSteamNetworkingTransport( false );
+	m_pTransport->SetListener( this );
+
 	// Initialize the peer to peer connection process
 	SteamNetworkingUtils()->InitRelayNetworkAccess();
 
@@ -140,11 +148,7 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	// Initialize sun
 	m_pSun = new CSun( pGameEngine );
 
-	m_nNumWorkshopItems = 0;
-	for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
-	{
-		m_rgpWorkshopItems[i] = NULL;
-	}
+	m_pWorkshopItemLoader = new CWorkshopItemLoader();
 
 	// initialize P2P auth engine
 	m_pP2PAuthedGame = new CP2PAuthedGame( m_pGameEngine );
@@ -241,14 +245,16 @@ CSpaceWarClient::~CSpaceWarClient()
 		}
 	}
 	
-	for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
-	{
-		if ( m_rgpWorkshopItems[i] )
-		{
-			delete m_rgpWorkshopItems[i];
-			m_rgpWorkshopItems[i] = NULL;
-		}
-	}
+	// Stop the loader first so nothing new turns up
+	delete m_pWorkshopItemLoader;
+	m_pWorkshopItemLoader = NULL;
+
+	for ( size_t i = 0; i < m_vecWorkshopItems.size(); ++i )
+		delete m_vecWorkshopItems[i];
+	m_vecWorkshopItems.clear();
+
+	delete m_pTransport;
+	m_pTransport = NULL;
 }
 
 
@@ -289,7 +295,7 @@ void CSpaceWarClient::DisconnectFromServer()
 	}
 
 	if ( m_hConnServer != k_HSteamNetConnection_Invalid )
-		SteamNetworkingSockets()->CloseConnection( m_hConnServer, k_EDRClientDisconnect, nullptr, false );
+		m_pTransport->CloseConnection( m_hConnServer, k_EDRClientDisconnect, nullptr, false );
 	m_steamIDGameServer = CSteamID();
 	m_steamIDGameServerFromBrowser = CSteamID();
 	m_hConnServer = k_HSteamNetConnection_Invalid;
@@ -306,7 +312,7 @@ void CSpaceWarClient::OnReceiveServerInfo( CSteamID steamIDGameServer, bool bVAC
 	m_steamIDGameServer = steamIDGameServer;
 
 	SteamNetConnectionInfo_t info;
-	SteamNetworkingSockets()->GetConnectionInfo( m_hConnServer, &info );
+	m_pTransport->GetConnectionInfo( m_hConnServer, &info );
 	m_unServerIP = info.m_addrRemote.GetIPv4();
 	m_usServerPort = info.m_addrRemote.m_port;
 
@@ -589,7 +595,7 @@ void CSpaceWarClient::SetConnectionFailureText( const char *pchErrorText )
 //-----------------------------------------------------------------------------
 bool CSpaceWarClient::BSendServerData( const void *pData, uint32 nSizeOfData, int nSendFlags )
 {
-	EResult res = SteamNetworkingSockets()->SendMessageToConnection( m_hConnServer, pData, nSizeOfData, nSendFlags, nullptr );
+	EResult res = m_pTransport->SendMessageToConnection( m_hConnServer, pData, nSizeOfData, nSendFlags, nullptr );
 	switch (res)
 	{
 		case k_EResultOK:
@@ -660,7 +666,7 @@ void CSpaceWarClient::InitiateServerConnection( CSteamID steamIDGameServer )
 	SteamNetworkingIdentity identity;
 	identity.SetSteamID(steamIDGameServer);
 
-	m_hConnServer = SteamNetworkingSockets()->ConnectP2P( identity, 0, 0, nullptr );
+	m_hConnServer = m_pTransport->Connect( identity );
 	if ( m_pVoiceChat )
 		m_pVoiceChat->m_hConnServer = m_hConnServer;
 	if ( m_pP2PAuthedGame )
@@ -699,7 +705,7 @@ void CSpaceWarClient::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 		m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer)
 	{
 		// close the connection with the server
-		SteamNetworkingSockets()->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
+		m_pTransport->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
 		switch (m_info.m_eEndReason)
 		{
 		case k_EDRServerReject:
@@ -718,7 +724,7 @@ void CSpaceWarClient::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 	{
 		// failed, error out
 		OutputDebugString("Failed to make P2P connection, quiting server\n");
-		SteamNetworkingSockets()->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
+		m_pTransport->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
 		OnReceiveServerExiting();
 	}
 }
@@ -729,13 +735,18 @@ void CSpaceWarClient::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 //-----------------------------------------------------------------------------
 void CSpaceWarClient::ReceiveNetworkData()
 {
+	PROFILE_SCOPE( "CSpaceWarClient::ReceiveNetworkData" );
+
+	// Deliver connection status changes from non-Steam transports
+	m_pTransport->RunCallbacks();
+
 	if ( !SteamNetworkingSockets() )
 		return;
 	if ( m_hConnServer == k_HSteamNetConnection_Invalid )
 		return;
 
 	SteamNetworkingMessage_t* msgs[32];
-	int res = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_hConnServer, msgs, 32);
+	int res = m_pTransport->ReceiveMessagesOnConnection(m_hConnServer, msgs, 32);
 	for (int i = 0; i < res; i++)
 	{
 		SteamNetworkingMessage_t* message = msgs[i];
@@ -1038,7 +1049,7 @@ void CSpaceWarClient::OnMenuSelection( LobbyMenuItem_t selection )
 		SteamMatchmaking()->SetLobbyData( m_steamIDLobby, "game_starting", "1" );
 		
 		// start a local game server
-		m_pServer = new CSpaceWarServer( m_pGameEngine );
+		CreateLocalServer();
 		// we'll have to wait until the game server connects to the Steam server back-end 
 		// before telling all the lobby members to join (so that the NAT traversal code has a path to contact the game server)
 		OutputDebugString( "Game server being created; game will start soon.\n" );
@@ -1416,9 +1427,14 @@ void CSpaceWarClient::RunOccasionally()
 //-----------------------------------------------------------------------------
 void CSpaceWarClient::RunFrame()
 {
+	PROFILE_SCOPE( "CSpaceWarClient::RunFrame" );
+
 	// Get any new data off the network to begin with
 	ReceiveNetworkData();
 
+	// Pick up workshop items that finished loading
+	ReceiveWorkshopItems();
+
 	RenderTimer();
 
 	if ( m_eConnectedStatus != k_EClientNotConnected && m_pGameEngine->GetGameTickCount() - m_ulLastNetworkDataReceivedTime > MILLISECONDS_CONNECTION_TIMEOUT )
@@ -1444,7 +1460,10 @@ void CSpaceWarClient::RunFrame()
 	}
 
 	// Run Steam client callbacks
-	SteamAPI_RunCallbacks();
+	{
+		PROFILE_SCOPE( "SteamAPI_RunCallbacks" );
+		SteamAPI_RunCallbacks();
+	}
 
 	// Do work that runs infrequently. we do this every second.
 	static time_t tLastCheck = 0;
@@ -1645,7 +1664,7 @@ void CSpaceWarClient::RunFrame()
 		m_pStarField->Render();
 		if ( !m_pServer )
 		{
-			m_pServer = new CSpaceWarServer( m_pGameEngine );
+			CreateLocalServer();
 		}
 
 		if ( m_pServer && m_pServer->IsConnectedToSteam() )
@@ -1695,11 +1714,8 @@ void CSpaceWarClient::RunFrame()
 				m_rgpShips[i]->RunFrame();
 		}
 
-		for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
-		{
-			if (m_rgpWorkshopItems[i])
-				m_rgpWorkshopItems[i]->RunFrame();
-		}
+		for ( size_t i = 0; i < m_vecWorkshopItems.size(); ++i )
+			m_vecWorkshopItems[i]->RunFrame();
 
 
 		DrawHUDText();
@@ -1831,6 +1847,9 @@ void CSpaceWarClient::RunFrame()
 	case k_EClientGameDraw:
 	case k_EClientGameWinner:
 	case k_EClientGameActive:
+	{
+		PROFILE_SCOPE( "CSpaceWarClient::RenderEntities" );
+
 		// Now render all the objects
 		m_pSun->Render();
 		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
@@ -1839,13 +1858,11 @@ void CSpaceWarClient::RunFrame()
 				m_rgpShips[i]->Render();
 		}
 
-		for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
-		{
-			if ( m_rgpWorkshopItems[i] )
-				m_rgpWorkshopItems[i]->Render();
-		}
+		for ( size_t i = 0; i < m_vecWorkshopItems.size(); ++i )
+			m_vecWorkshopItems[i]->Render();
 
 		break;
+	}
 	default:
 		// Any needed drawing was already done above before server updates
 		break;
@@ -1853,6 +1870,46 @@ void CSpaceWarClient::RunFrame()
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Set the metrics file for locally started servers, from -metricsfile
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::SetServerMetricsFile( const char *pchFileName )
+{
+	m_rgchServerMetricsFile[0] = 0;
+	if ( pchFileName )
+	{
+		strncpy( m_rgchServerMetricsFile, pchFileName, sizeof( m_rgchServerMetricsFile ) - 1 );
+		m_rgchServerMetricsFile[ sizeof( m_rgchServerMetricsFile ) - 1 ] = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set the replay file for locally started servers, from -recordmatch
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::SetServerRecordFile( const char *pchFileName )
+{
+	m_rgchServerRecordFile[0] = 0;
+	if ( pchFileName )
+	{
+		strncpy( m_rgchServerRecordFile, pchFileName, sizeof( m_rgchServerRecordFile ) - 1 );
+		m_rgchServerRecordFile[ sizeof( m_rgchServerRecordFile ) - 1 ] = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Start a game server in this process
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::CreateLocalServer()
+{
+	m_pServer = new CSpaceWarServer( m_pGameEngine );
+	m_pServer->SetMetricsFile( m_rgchServerMetricsFile );
+	if ( m_rgchServerRecordFile[0] && !m_pServer->StartRecording( m_rgchServerRecordFile ) )
+		OutputDebugString( "Failed to start recording the match\n" );
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Draws the timer, if -timer was present on the command line
 //-----------------------------------------------------------------------------
@@ -2437,57 +2494,10 @@ void CSpaceWarClient::ExecCommandLineConnect( const char *pchServerAddress, cons
 
 
 //-----------------------------------------------------------------------------
-// Purpose: parse CWorkshopItem from text file
-//-----------------------------------------------------------------------------
-CWorkshopItem *CSpaceWarClient::LoadWorkshopItemFromFile( const char *pszFileName )
-{
-	FILE *file = fopen( pszFileName, "rt");
-	if (!file)
-		return NULL;
-
-	CWorkshopItem *pItem = NULL;
-
-	char szLine[1024];
-
-	if ( fgets(szLine, sizeof(szLine), file) )
-	{
-		float flXPos, flYPos, flXVelocity, flYVelocity;
-		// initialize object
-		if ( sscanf(szLine, "%f %f %f %f", &flXPos, &flYPos, &flXVelocity, &flYVelocity) )
-		{
-			pItem = new CWorkshopItem( m_pGameEngine, 0 );
-
-			pItem->SetPosition( flXPos, flYPos );
-			pItem->SetVelocity( flXVelocity, flYVelocity );
-
-			while (!feof(file))
-			{
-				float xPos0, yPos0, xPos1, yPos1;
-				DWORD dwColor;
-				if ( fgets(szLine, sizeof(szLine), file) &&
-                     sscanf(szLine, "%f %f %f %f %x", &xPos0, &yPos0, &xPos1, &yPos1, &dwColor) >= 5 )
-				{
-					// Add a line to the entity
-					pItem->AddLine(xPos0, yPos0, xPos1, yPos1, dwColor);
-				}
-			}
-		}
-	}
-
-	fclose(file);
-
-	return pItem;
-}
-
-
-//-----------------------------------------------------------------------------
-// Purpose: load a Workshop item by PublishFileID
+// Purpose: queue a Workshop item to be loaded by PublishFileID
 //-----------------------------------------------------------------------------
 bool CSpaceWarClient::LoadWorkshopItem( PublishedFileId_t workshopItemID )
 {
-	if ( m_nNumWorkshopItems == MAX_WORKSHOP_ITEMS )
-		return false; // too much
-
 	uint32 unItemState = SteamUGC()->GetItemState( workshopItemID );
 
 	if ( !(unItemState & k_EItemStateInstalled) )
@@ -2500,29 +2510,21 @@ bool CSpaceWarClient::LoadWorkshopItem( PublishedFileId_t workshopItemID )
 	if ( !SteamUGC()->GetItemInstallInfo( workshopItemID, &unSizeOnDisk, szItemFolder, sizeof(szItemFolder), &unTimeStamp ) )
 		return false;
 
-	char szFile[1024];
 	if( unItemState & k_EItemStateLegacyItem )
 	{
 		// szItemFolder just points directly to the item for legacy items that were published with the RemoteStorage API.
-		_snprintf( szFile, sizeof( szFile ), "%s", szItemFolder );
+		m_pWorkshopItemLoader->QueueLoad( workshopItemID, szItemFolder );
 	}
 	else
 	{
-		_snprintf( szFile, sizeof( szFile ), "%s/workshopitem.txt", szItemFolder );
+		// Prefer the binary version if the item ships one
+		char szFile[1024];
+		char szFallbackFile[1024];
+		_snprintf( szFile, sizeof( szFile ), "%s/workshopitem.bin", szItemFolder );
+		_snprintf( szFallbackFile, sizeof( szFallbackFile ), "%s/workshopitem.txt", szItemFolder );
+		m_pWorkshopItemLoader->QueueLoad( workshopItemID, szFile, szFallbackFile );
 	}
 
-	CWorkshopItem *pItem = LoadWorkshopItemFromFile( szFile );
-
-	if ( !pItem )
-		return false;
-	
-	pItem->m_ItemDetails.m_nPublishedFileId = workshopItemID;
-	m_rgpWorkshopItems[m_nNumWorkshopItems++] = pItem;
-
-	// get Workshop item details
-	SteamAPICall_t hSteamAPICall = SteamUGC()->RequestUGCDetails( workshopItemID, 60 );
-	pItem->m_SteamCallResultUGCDetails.Set(hSteamAPICall, pItem, &CWorkshopItem::OnUGCDetailsResult);
-	
 	return true;
 }
 
@@ -2532,49 +2534,88 @@ bool CSpaceWarClient::LoadWorkshopItem( PublishedFileId_t workshopItemID )
 //-----------------------------------------------------------------------------
 void CSpaceWarClient::LoadWorkshopItems()
 {
-	// reset workshop Items
-	for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
+	// reset workshop Items, including any still loading
+	m_pWorkshopItemLoader->CancelAll();
+	for ( size_t i = 0; i < m_vecWorkshopItems.size(); ++i )
+		delete m_vecWorkshopItems[i];
+	m_vecWorkshopItems.clear();
+
+	uint32 numSubscribedItems = SteamUGC()->GetNumSubscribedItems();
+	if ( numSubscribedItems )
 	{
-		if ( m_rgpWorkshopItems[i] )
+		std::vector< PublishedFileId_t > vecSubscribedItems( numSubscribedItems );
+		numSubscribedItems = SteamUGC()->GetSubscribedItems( &vecSubscribedItems[0], numSubscribedItems );
+
+		// load all subscribed workshop items
+		for ( uint32 iSubscribedItem=0; iSubscribedItem<numSubscribedItems; iSubscribedItem++ )
 		{
-			delete m_rgpWorkshopItems[i];
-			m_rgpWorkshopItems[i] = NULL;
+			PublishedFileId_t workshopItemID = vecSubscribedItems[iSubscribedItem];
+			LoadWorkshopItem( workshopItemID );
 		}
 	}
 
-	m_nNumWorkshopItems = 0; // load default test item
+	// load local test item 
+	m_pWorkshopItemLoader->QueueLoad( k_PublishedFileIdInvalid, "workshop/workshopitem.bin", "workshop/workshopitem.txt" );
+}
 
-	PublishedFileId_t vecSubscribedItems[MAX_WORKSHOP_ITEMS];
 
-	int numSubscribedItems = SteamUGC()->GetSubscribedItems( vecSubscribedItems, MAX_WORKSHOP_ITEMS );
-	
-	if ( numSubscribedItems > MAX_WORKSHOP_ITEMS )
-		numSubscribedItems = MAX_WORKSHOP_ITEMS; // crop
-	
-	// load all subscribed workshop items
-	for ( int iSubscribedItem=0; iSubscribedItem<numSubscribedItems; iSubscribedItem++ )
+//-----------------------------------------------------------------------------
+// Purpose: create entities for workshop items that finished loading
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::ReceiveWorkshopItems()
+{
+	WorkshopItemLoad_t load;
+	while ( m_pWorkshopItemLoader->BGetCompletedLoad( &load ) )
 	{
-		PublishedFileId_t workshopItemID = vecSubscribedItems[iSubscribedItem];
-		LoadWorkshopItem( workshopItemID );
+		if ( load.m_bSuccess )
+			AddWorkshopItem( load );
 	}
+}
 
-	// load local test item 
-	if ( m_nNumWorkshopItems < MAX_WORKSHOP_ITEMS )
+
+//-----------------------------------------------------------------------------
+// Purpose: turn a finished load into a CWorkshopItem
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::AddWorkshopItem( WorkshopItemLoad_t &load )
+{
+	CWorkshopItem *pItem = new CWorkshopItem( m_pGameEngine, 0 );
+	pItem->SetPosition( load.m_Header.m_flXPos, load.m_Header.m_flYPos );
+	pItem->SetVelocity( load.m_Header.m_flXVelocity, load.m_Header.m_flYVelocity );
+	pItem->SetVertexes( load.m_vecVertexes );
+
+	if ( load.m_nPublishedFileId == k_PublishedFileIdInvalid )
 	{
-		CWorkshopItem *pItem = LoadWorkshopItemFromFile("workshop/workshopitem.txt");
+		strncpy( pItem->m_ItemDetails.m_rgchTitle, "Test Item", k_cchPublishedDocumentTitleMax );
+		strncpy( pItem->m_ItemDetails.m_rgchDescription, "This is a local test item for debugging", k_cchPublishedDocumentDescriptionMax );
+		m_vecWorkshopItems.push_back( pItem );
+		return;
+	}
+
+	pItem->m_ItemDetails.m_nPublishedFileId = load.m_nPublishedFileId;
 
-		if ( pItem )
+	// An update to an item we already have replaces it
+	bool bReplaced = false;
+	for ( size_t i = 0; i < m_vecWorkshopItems.size(); ++i )
+	{
+		if ( m_vecWorkshopItems[i]->m_ItemDetails.m_nPublishedFileId == load.m_nPublishedFileId )
 		{
-			strncpy( pItem->m_ItemDetails.m_rgchTitle, "Test Item", k_cchPublishedDocumentTitleMax );
-			strncpy( pItem->m_ItemDetails.m_rgchDescription, "This is a local test item for debugging", k_cchPublishedDocumentDescriptionMax );
-			m_rgpWorkshopItems[m_nNumWorkshopItems++] = pItem;
+			delete m_vecWorkshopItems[i];
+			m_vecWorkshopItems[i] = pItem;
+			bReplaced = true;
+			break;
 		}
 	}
+	if ( !bReplaced )
+		m_vecWorkshopItems.push_back( pItem );
+
+	// get Workshop item details
+	SteamAPICall_t hSteamAPICall = SteamUGC()->RequestUGCDetails( load.m_nPublishedFileId, 60 );
+	pItem->m_SteamCallResultUGCDetails.Set(hSteamAPICall, pItem, &CWorkshopItem::OnUGCDetailsResult);
 }
 
 
 //-----------------------------------------------------------------------------
-// Purpose: new Workshop was installed, load it instantly
+// Purpose: new Workshop was installed, queue it for loading
 //-----------------------------------------------------------------------------
 void CSpaceWarClient::OnWorkshopItemInstalled( ItemInstalled_t *pParam )
 {
@@ -2658,12 +2699,9 @@ void CSpaceWarClient::DrawWorkshopItems()
 	rect.top = 64;
 	rect.bottom = 96;
 	
-	for (int iSubscribedItem = 0; iSubscribedItem < MAX_WORKSHOP_ITEMS; iSubscribedItem++)
+	for ( uint32 iSubscribedItem = 0; iSubscribedItem < m_vecWorkshopItems.size(); iSubscribedItem++ )
 	{
-		CWorkshopItem *pItem = m_rgpWorkshopItems[ iSubscribedItem ];
-
-		if ( !pItem )
-			continue;
+		CWorkshopItem *pItem = m_vecWorkshopItems[ iSubscribedItem ];
 
 		rect.top += 32;
 		rect.bottom += 32;
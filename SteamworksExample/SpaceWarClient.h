@@ -20,6 +20,7 @@
 #include "musicplayer.h"
 #include "steam/isteamnetworkingsockets.h"
 #include "steam/isteamnetworkingutils.h"
+#include "SpaceWarTransport.h"
 
 // Forward class declaration
 class CConnectingMenu;
@@ -40,6 +41,8 @@ class CRemotePlayList;
 class CItemStore;
 class COverlayExamples;
 class CTimeline;
+class CWorkshopItemLoader;
+struct WorkshopItemLoad_t;
 
 // Height of the HUD font
 #define HUD_FONT_HEIGHT 18
@@ -105,8 +108,6 @@ struct RemotePlayListMenuItem_t
 	uint32 m_unSessionID;
 };
 
-#define MAX_WORKSHOP_ITEMS 16
-
 // a Steam Workshop item
 class CWorkshopItem : public CVectorEntity
 {
@@ -158,7 +159,7 @@ struct OverlayExample_t
 };
 
 
-class CSpaceWarClient 
+class CSpaceWarClient : public ISpaceWarTransportListener
 {
 public:
 	//Constructor
@@ -258,6 +259,12 @@ public:
 
 	void SetShowTimer( bool bShowTimer ) { m_bShowTimer = bShowTimer; }
 
+	// Any server we start locally writes its metrics here
+	void SetServerMetricsFile( const char *pchFileName );
+
+	// Any server we start locally records its match here
+	void SetServerRecordFile( const char *pchFileName );
+
 	uint32 GetLastGamePhaseID() const { return m_unLastGamePhaseID; }
 	uint64 GetLastCrashIntoSunEvent() const { return m_ulLastCrashIntoSunEvent;  }
 private:
@@ -318,9 +325,12 @@ private:
 	// Sets the player scores in the game phase
 	void UpdateScoreInGamePhase( bool bFinal );
 
-	// load a workshop item from file
+	// queue a workshop item to be loaded from disk
 	bool LoadWorkshopItem( PublishedFileId_t workshopItemID );
-	CWorkshopItem *LoadWorkshopItemFromFile( const char *pszFileName );
+
+	// create entities for workshop items the background loader has finished with
+	void ReceiveWorkshopItems();
+	void AddWorkshopItem( WorkshopItemLoad_t &load );
 
 	// draw the in-game store
 	void DrawInGameStore();
@@ -384,6 +394,9 @@ private:
 	HAuthTicket m_hAuthTicket;
 	HSteamNetConnection m_hConnServer;
 
+	// What we talk to the server through
+	ISpaceWarTransport *m_pTransport;
+
 	// keep track of if we opened the overlay for a gamewebcallback
 	bool m_bSentWebOpen;
 
@@ -392,6 +405,13 @@ private:
 	uint32 m_unTicksAtLaunch;
 	HGAMEFONT m_hTimerFont;
 
+	// Passed on to local servers, empty for none
+	char m_rgchServerMetricsFile[1024];
+	char m_rgchServerRecordFile[1024];
+
+	// Create the local server with the options above
+	void CreateLocalServer();
+
 	// simple class to marshal callbacks from pinging a game server
 	class CGameServerPing : public ISteamMatchmakingPingResponse
 	{
@@ -447,8 +467,10 @@ private:
 	CSun *m_pSun;
 
 	// Steam Workshop items
-	CWorkshopItem *m_rgpWorkshopItems[ MAX_WORKSHOP_ITEMS ];
-	int m_nNumWorkshopItems; // items in m_rgpWorkshopItem
+	std::vector< CWorkshopItem * > m_vecWorkshopItems;
+
+	// Reads workshop item files off the main thread
+	CWorkshopItemLoader *m_pWorkshopItemLoader;
 
 	// Main menu instance
 	CMainMenu *m_pMainMenu;
@@ -540,7 +562,7 @@ private:
 	CHTMLSurface *m_pHTMLSurface;
 
 	// Called when we get new connections, or the state of a connection changes
-	STEAM_CALLBACK(CSpaceWarClient, OnNetConnectionStatusChanged, SteamNetConnectionStatusChangedCallback_t);
+	virtual void OnNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback );
 
 	// ipc failure handler
 	STEAM_CALLBACK( CSpaceWarClient, OnIPCFailure, IPCFailure_t );
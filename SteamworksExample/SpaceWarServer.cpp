@@ -8,6 +8,9 @@
 #include "stdafx.h"
 #include "SpaceWarServer.h"
 #include "SpaceWarClient.h"
+#include "SpaceWarTransport.h"
+#include "Profiler.h"
+#include "MatchReplay.h"
 #include "stdlib.h"
 #include "time.h"
 #include <math.h>
@@ -16,10 +19,15 @@
 //-----------------------------------------------------------------------------
 // Purpose: Constructor -- note the syntax for setting up Steam API callback handlers
 //-----------------------------------------------------------------------------
-CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine ) 
+CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport ) 
 {
 	m_bConnectedToSteam = false;
 
+	// With no transport given we run over Steam and own the transport, otherwise the caller does
+	m_pTransport = pTransport;
+	m_bOwnsTransport = ( pTransport == NULL );
+	m_bUseSteam = ( pTransport == NULL || pTransport->BSteamBacked() );
+
 
 	const char *pchGameDir = "spacewar";
 	uint32 unIP = INADDR_ANY;
@@ -38,14 +46,18 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 	// !FIXME! We need a way to pass the dedicated server flag here!
 
 	SteamErrMsg errMsg = { 0 };
-	if ( SteamGameServer_InitEx( unIP, SPACEWAR_SERVER_PORT, usMasterServerUpdaterPort, eMode, SPACEWAR_SERVER_VERSION, &errMsg ) != k_ESteamAPIInitResult_OK )
+	if ( !m_bUseSteam )
+	{
+		// Private transport (eg. loopback), there is no Steam game server to log on with
+	}
+	else if ( SteamGameServer_InitEx( unIP, SPACEWAR_SERVER_PORT, usMasterServerUpdaterPort, eMode, SPACEWAR_SERVER_VERSION, &errMsg ) != k_ESteamAPIInitResult_OK )
 	{
 		OutputDebugString( "SteamGameServer_Init call failed: " );
 		OutputDebugString( errMsg );
 		OutputDebugString( "\n" );
 	}
 
-	if ( SteamGameServer() )
+	if ( m_bUseSteam && SteamGameServer() )
 	{
 
 		// Set the "game dir".
@@ -79,7 +91,7 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 			SteamGameServer()->SetAdvertiseServerActive( true );
 		#endif
 	}
-	else
+	else if ( m_bUseSteam )
 	{
 		OutputDebugString( "SteamGameServer() interface is invalid\n" );
 	}
@@ -98,6 +110,10 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 	m_uPlayerWhoWonGame = 0;
 	m_ulStateTransitionTime = m_pGameEngine->GetGameTickCount();
 	m_ulLastServerUpdateTick = 0;
+	m_ulLastMetricsWriteTick = 0;
+	m_pRecorder = NULL;
+	m_ulCreatedTickCount = m_pGameEngine->GetGameTickCount();
+	m_bHasRunFrame = false;
 
 	// zero the client connection data
 	memset( &m_rgClientData, 0, sizeof( m_rgClientData ) );
@@ -112,11 +128,15 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 	// Initialize ships
 	ResetPlayerShips();
 
+	if ( m_bOwnsTransport )
+		m_pTransport = new CSteamNetworkingTransport( true );
+	m_pTransport->SetListener( this );
+
 	// create the listen socket for listening for players connecting
-	m_hListenSocket = SteamGameServerNetworkingSockets()->CreateListenSocketP2P(0, 0, nullptr);
+	m_hListenSocket = m_pTransport->CreateListenSocket();
 
 	// create the poll group
-	m_hNetPollGroup = SteamGameServerNetworkingSockets()->CreatePollGroup();
+	m_hNetPollGroup = m_pTransport->CreatePollGroup();
 }
 
 
@@ -140,8 +160,18 @@ CSpaceWarServer::~CSpaceWarServer()
 		}
 	}
 
-	SteamGameServerNetworkingSockets()->CloseListenSocket(m_hListenSocket);
-	SteamGameServerNetworkingSockets()->DestroyPollGroup(m_hNetPollGroup);
+	delete m_pRecorder;
+	m_pRecorder = NULL;
+
+	m_pTransport->CloseListenSocket(m_hListenSocket);
+	m_pTransport->DestroyPollGroup(m_hNetPollGroup);
+	m_pTransport->SetListener( NULL );
+	if ( m_bOwnsTransport )
+		delete m_pTransport;
+	m_pTransport = NULL;
+
+	if ( !m_bUseSteam )
+		return;
 
 	// Disconnect from the steam servers
 	SteamGameServer()->LogOff();
@@ -179,30 +209,30 @@ void CSpaceWarServer::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 			{
 
 				// Found one.  "Accept" the connection.
-				EResult res = SteamGameServerNetworkingSockets()->AcceptConnection( hConn );
+				EResult res = m_pTransport->AcceptConnection( hConn );
 				if ( res != k_EResultOK )
 				{
 					char msg[ 256 ];
 					sprintf( msg, "AcceptConnection returned %d", res );
 					OutputDebugString( msg );
-					SteamGameServerNetworkingSockets()->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Failed to accept connection", false );
+					m_pTransport->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Failed to accept connection", false );
 					return;
 				}
 
 				m_rgPendingClientData[i].m_hConn = hConn;
 
 				// add the user to the poll group
-				SteamGameServerNetworkingSockets()->SetConnectionPollGroup(hConn, m_hNetPollGroup);
+				m_pTransport->SetConnectionPollGroup(hConn, m_hNetPollGroup);
 
 				// Send them the server info as a reliable message
 				MsgServerSendInfo_t msg;
-				msg.SetSteamIDServer(SteamGameServer()->GetSteamID().ConvertToUint64());
+				msg.SetSteamIDServer(GetSteamID().ConvertToUint64());
 				#ifdef USE_GS_AUTH_API
 					// You can only make use of VAC when using the Steam authentication system
-					msg.SetSecure(SteamGameServer()->BSecure());
+					msg.SetSecure(m_bUseSteam && SteamGameServer()->BSecure());
 				#endif
 				msg.SetServerName(m_sServerName.c_str());
-				SteamGameServerNetworkingSockets()->SendMessageToConnection( hConn, &msg, sizeof(MsgServerSendInfo_t), k_nSteamNetworkingSend_Reliable, nullptr );
+				SendMessageToConnection( hConn, &msg, sizeof(MsgServerSendInfo_t), k_nSteamNetworkingSend_Reliable, nullptr );
 
 				return;
 			}
@@ -210,7 +240,7 @@ void CSpaceWarServer::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 
 		// No empty slots.  Server full!
 		OutputDebugString("Rejecting connection; server full");
-		SteamGameServerNetworkingSockets()->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Server full!", false );
+		m_pTransport->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Server full!", false );
 	}
 	// Check if a client has disconnected
 	else if ((eOldState == k_ESteamNetworkingConnectionState_Connecting || eOldState == k_ESteamNetworkingConnectionState_Connected) &&
@@ -226,6 +256,8 @@ void CSpaceWarServer::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 			if (m_rgClientData[i].m_SteamIDUser == info.m_identityRemote.GetSteamID())//pCallback->m_steamIDRemote)
 			{
 				OutputDebugString("Disconnected dropped user\n");
+				if ( m_pRecorder )
+					m_pRecorder->RecordPlayerRemoved( i );
 				RemovePlayerFromServer(i, k_EDRClientDisconnect);
 				break;
 			}
@@ -243,7 +275,7 @@ bool CSpaceWarServer::BSendDataToClient( uint32 uShipIndex, char *pData, uint32
 		return false;
 
 	int64 messageOut;
-	if (!SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Unreliable, &messageOut))
+	if (!SendMessageToConnection(m_rgClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Unreliable, &messageOut))
 	{
 		OutputDebugString("Failed sending data to a client\n");
 			return false;
@@ -262,7 +294,7 @@ bool CSpaceWarServer::BSendDataToPendingClient( uint32 uShipIndex, char *pData,
 		return false;
 
 	int64 messageOut;
-	if (!SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgPendingClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Unreliable, &messageOut))
+	if (!SendMessageToConnection(m_rgPendingClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Unreliable, &messageOut))
 	{
 		OutputDebugString("Failed sending data to a client\n");
 		return false;
@@ -299,7 +331,8 @@ void CSpaceWarServer::OnClientBeginAuthentication(CSteamID steamIDClient, HSteam
 	// We are full (or will be if the pending players auth), deny new login
 	if ( nPendingOrActivePlayerCount >= MAX_PLAYERS_PER_SERVER )
 	{
-		SteamGameServerNetworkingSockets()->CloseConnection(connectionID, k_EDRServerFull, "Server full", false);
+		m_pTransport->CloseConnection(connectionID, k_EDRServerFull, "Server full", false);
+		return;
 	}
 
 	// If we get here there is room, add the player as pending
@@ -308,12 +341,21 @@ void CSpaceWarServer::OnClientBeginAuthentication(CSteamID steamIDClient, HSteam
 		if (!m_rgPendingClientData[i].m_bActive)
 		{
 			m_rgPendingClientData[i].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
+			if ( !m_bUseSteam )
+			{
+				// No Steam back-end to ask, trust the identity the transport gave us
+				m_rgPendingClientData[i].m_SteamIDUser = steamIDClient;
+				m_rgPendingClientData[i].m_bActive = true;
+				m_rgPendingClientData[i].m_hConn = connectionID;
+				OnAuthCompleted(true, i);
+				break;
+			}
 #ifdef USE_GS_AUTH_API
 			// authenticate the user with the Steam back-end servers
 			EBeginAuthSessionResult res = SteamGameServer()->BeginAuthSession(pToken, uTokenLen, steamIDClient);
 			if (res != k_EBeginAuthSessionResultOK)
 			{
-				SteamGameServerNetworkingSockets()->CloseConnection(connectionID, k_EDRServerReject, "BeginAuthSession failed", false);
+				m_pTransport->CloseConnection(connectionID, k_EDRServerReject, "BeginAuthSession failed", false);
 				break;
 			}
 
@@ -349,17 +391,17 @@ void CSpaceWarServer::OnAuthCompleted( bool bAuthSuccessful, uint32 iPendingAuth
 	{
 #ifdef USE_GS_AUTH_API
 		// Tell the GS the user is leaving the server
-		SteamGameServer()->EndAuthSession( m_rgPendingClientData[iPendingAuthIndex].m_SteamIDUser );
+		if ( m_bUseSteam )
+			SteamGameServer()->EndAuthSession( m_rgPendingClientData[iPendingAuthIndex].m_SteamIDUser );
 #endif
 		// Send a deny for the client, and zero out the pending data
 		MsgServerFailAuthentication_t msg;
 		int64 outMessage;
-		SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgPendingClientData[iPendingAuthIndex].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &outMessage);
+		SendMessageToConnection(m_rgPendingClientData[iPendingAuthIndex].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &outMessage);
 		m_rgPendingClientData[iPendingAuthIndex] = ClientConnectionData_t();
 		return;
 	}
 
-	bool bAddedOk = false;
 	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i ) 
 	{
 		if ( !m_rgClientData[i].m_bActive )
@@ -367,40 +409,49 @@ void CSpaceWarServer::OnAuthCompleted( bool bAuthSuccessful, uint32 iPendingAuth
 			// copy over the data from the pending array
 			memcpy( &m_rgClientData[i], &m_rgPendingClientData[iPendingAuthIndex], sizeof( ClientConnectionData_t ) );
 			m_rgPendingClientData[iPendingAuthIndex] = ClientConnectionData_t();
-			m_rgClientData[i].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
 
-			// Add a new ship, make it dead immediately
-			AddPlayerShip( i );
-			m_rgpShips[i]->SetDisabled( true );
+			ActivatePlayer( i );
 
 			MsgServerPassAuthentication_t msg;
 			msg.SetPlayerPosition( i );
 			BSendDataToClient( i, (char*)&msg, sizeof( msg ) );
 
-			bAddedOk = true;
-
 			break;
 		}
 	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Give a newly authenticated player a ship.  Everything the simulation
+// depends on happens here, so replays can add players the same way.
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::ActivatePlayer( uint32 uShipPosition )
+{
+	if ( m_pRecorder )
+		m_pRecorder->RecordPlayerAdded( uShipPosition, m_rgClientData[uShipPosition].m_SteamIDUser.ConvertToUint64() );
+
+	m_rgClientData[uShipPosition].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
 
-	// If we just successfully added the player, check if they are #2 so we can restart the round
-	if ( bAddedOk )
+	// Add a new ship, make it dead immediately
+	AddPlayerShip( uShipPosition );
+	m_rgpShips[uShipPosition]->SetDisabled( true );
+
+	// Check if they are #2 so we can restart the round
+	uint32 uPlayers = 0;
+	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i ) 
 	{
-		uint32 uPlayers = 0;
-		for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i ) 
-		{
-			if ( m_rgClientData[i].m_bActive )
-				++uPlayers;
-		}
+		if ( m_rgClientData[i].m_bActive )
+			++uPlayers;
+	}
 
-		// If we just got the second player, immediately reset round as a draw.  This will prevent
-		// the existing player getting a win, and it will cause a new round to start right off
-		// so that the one player can't just float around not letting the new one get into the game.
-		if ( uPlayers == 2 )
-		{
-			if ( m_eGameState != k_EServerWaitingForPlayers )
-				SetGameState( k_EServerDraw );
-		}
+	// If we just got the second player, immediately reset round as a draw.  This will prevent
+	// the existing player getting a win, and it will cause a new round to start right off
+	// so that the one player can't just float around not letting the new one get into the game.
+	if ( uPlayers == 2 )
+	{
+		if ( m_eGameState != k_EServerWaitingForPlayers )
+			SetGameState( k_EServerDraw );
 	}
 }
 
@@ -496,11 +547,12 @@ void CSpaceWarServer::RemovePlayerFromServer( uint32 uShipPosition, EDisconnectR
 	m_rguPlayerScores[uShipPosition] = 0;
 
 	// close the hNet connection
-	SteamGameServerNetworkingSockets()->CloseConnection( m_rgClientData[uShipPosition].m_hConn, reason, nullptr, false);
+	m_pTransport->CloseConnection( m_rgClientData[uShipPosition].m_hConn, reason, nullptr, false);
 
 #ifdef USE_GS_AUTH_API
 	// Tell the GS the user is leaving the server
-	SteamGameServer()->EndAuthSession( m_rgClientData[uShipPosition].m_SteamIDUser );
+	if ( m_bUseSteam )
+		SteamGameServer()->EndAuthSession( m_rgClientData[uShipPosition].m_SteamIDUser );
 #endif
 	m_rgClientData[uShipPosition] = ClientConnectionData_t();
 }
@@ -550,8 +602,10 @@ void CSpaceWarServer::SetGameState( EServerGameState eState )
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::ReceiveNetworkData()
 {
+	PROFILE_SCOPE( "CSpaceWarServer::ReceiveNetworkData" );
+
 	SteamNetworkingMessage_t* msgs[128];
-	int numMessages = SteamGameServerNetworkingSockets()->ReceiveMessagesOnPollGroup(m_hNetPollGroup, msgs, 128);
+	int numMessages = m_pTransport->ReceiveMessagesOnPollGroup(m_hNetPollGroup, msgs, 128);
 	for (int idxMsg = 0; idxMsg < numMessages; idxMsg++)
 	{
 		SteamNetworkingMessage_t* message = msgs[idxMsg];
@@ -567,6 +621,7 @@ void CSpaceWarServer::ReceiveNetworkData()
 		}
 
 		EMessage eMsg = (EMessage)LittleDWord(*(DWORD*)message->GetData());
+		m_Metrics.RecordMessageIn( eMsg, message->GetSize() );
 
 		switch (eMsg)
 		{
@@ -638,7 +693,7 @@ void CSpaceWarServer::ReceiveNetworkData()
 					// Mutate the message, replacing the destination SteamID with the sender's SteamID
 					msgP2PSendingTicket.SetSteamID( message->m_identityPeer.GetSteamID64() );
 
-					SteamNetworkingSockets()->SendMessageToConnection( m_rgClientData[j].m_hConn, &msgP2PSendingTicket, sizeof(msgP2PSendingTicket), k_nSteamNetworkingSend_Reliable, nullptr );
+					SendMessageToConnection( m_rgClientData[j].m_hConn, &msgP2PSendingTicket, sizeof(msgP2PSendingTicket), k_nSteamNetworkingSend_Reliable, nullptr );
 					break;
 				}
 			}
@@ -667,12 +722,24 @@ void CSpaceWarServer::ReceiveNetworkData()
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::RunFrame()
 {
+	PROFILE_SCOPE( "CSpaceWarServer::RunFrame" );
+	int64 usecTickStart = CProfiler::GetTimestamp();
+
 	// Run any Steam Game Server API callbacks
-	SteamGameServer_RunCallbacks();
+	if ( m_bUseSteam )
+		SteamGameServer_RunCallbacks();
+
+	// Deliver connection status changes from non-Steam transports
+	m_pTransport->RunCallbacks();
 
 	// Update our server details
 	SendUpdatedServerDetailsToSteam();
 
+	// Everything above only reacts to the outside world, a replay starts the frame from here
+	m_bHasRunFrame = true;
+	if ( m_pRecorder )
+		m_pRecorder->RecordRunFrame();
+
 	// Timeout stale player connections, also update player count data
 	uint32 uPlayerCount = 0;
 	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
@@ -753,6 +820,44 @@ void CSpaceWarServer::RunFrame()
 
 	// Send client updates (will internal limit itself to the tick rate desired)
 	SendUpdateDataToAllClients();
+
+	if ( m_pRecorder && m_pRecorder->BWantsKeyframe() )
+	{
+		ServerSpaceWarUpdateData_t updateData;
+		BuildUpdateData( &updateData );
+		m_pRecorder->RecordKeyframe( updateData );
+	}
+
+	m_Metrics.RecordTick( (uint32)( CProfiler::GetTimestamp() - usecTickStart ) );
+
+	if ( !m_sMetricsFile.empty() && m_pGameEngine->GetGameTickCount() - m_ulLastMetricsWriteTick >= SERVER_METRICS_WRITE_INTERVAL_MS )
+	{
+		m_ulLastMetricsWriteTick = m_pGameEngine->GetGameTickCount();
+		WriteMetrics();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Sample per-connection status and write out everything we've collected
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::WriteMetrics()
+{
+	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	{
+		SteamNetConnectionRealTimeStatus_t status;
+		if ( m_rgClientData[i].m_bActive && m_pTransport->GetConnectionRealTimeStatus( m_rgClientData[i].m_hConn, &status ) == k_EResultOK )
+			m_Metrics.RecordConnection( i, m_rgClientData[i].m_SteamIDUser.ConvertToUint64(), status );
+		else
+			m_Metrics.ClearConnection( i );
+	}
+
+	if ( !m_Metrics.BWriteStatsFile( m_sMetricsFile.c_str() ) )
+	{
+		char rgch[1024];
+		sprintf_safe( rgch, "Failed writing server metrics to %s\n", m_sMetricsFile.c_str() );
+		OutputDebugString( rgch );
+	}
 }
 
 
@@ -761,6 +866,8 @@ void CSpaceWarServer::RunFrame()
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::SendUpdateDataToAllClients()
 {
+	PROFILE_SCOPE( "CSpaceWarServer::SendUpdateDataToAllClients" );
+
 	// Limit the rate at which we update, even if our internal frame rate is higher
 	if ( m_pGameEngine->GetGameTickCount() - m_ulLastServerUpdateTick < 1000.0f/SERVER_UPDATE_SEND_RATE )
 		return;
@@ -768,32 +875,75 @@ void CSpaceWarServer::SendUpdateDataToAllClients()
 	m_ulLastServerUpdateTick = m_pGameEngine->GetGameTickCount();
 
 	MsgServerUpdateWorld_t msg;
+	BuildUpdateData( msg.AccessUpdateData() );
+
+	for( int i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	{
+		if ( !m_rgClientData[i].m_bActive ) 
+			continue;
 
-	msg.AccessUpdateData()->SetServerGameState( m_eGameState );
+		BSendDataToClient( i, (char*)&msg, sizeof( msg ) );
+	}
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Snapshot of the world as clients see it.  Zeroed first so that slots
+// without a ship compare equal between a recording and its replay.
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::BuildUpdateData( ServerSpaceWarUpdateData_t *pUpdateData )
+{
+	memset( pUpdateData, 0, sizeof( *pUpdateData ) );
+
+	pUpdateData->SetServerGameState( m_eGameState );
 	for( int i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
 	{
-		msg.AccessUpdateData()->SetPlayerActive( i, m_rgClientData[i].m_bActive );
-		msg.AccessUpdateData()->SetPlayerScore( i, m_rguPlayerScores[i]  );
-		msg.AccessUpdateData()->SetPlayerSteamID( i, m_rgClientData[i].m_SteamIDUser.ConvertToUint64() );
+		pUpdateData->SetPlayerActive( i, m_rgClientData[i].m_bActive );
+		pUpdateData->SetPlayerScore( i, m_rguPlayerScores[i]  );
+		pUpdateData->SetPlayerSteamID( i, m_rgClientData[i].m_SteamIDUser.ConvertToUint64() );
 
 		if ( m_rgpShips[i] )
 		{
-			m_rgpShips[i]->BuildServerUpdate( msg.AccessUpdateData()->AccessShipUpdateData( i ) );
+			m_rgpShips[i]->BuildServerUpdate( pUpdateData->AccessShipUpdateData( i ) );
 		}
 	}
 
-	msg.AccessUpdateData()->SetPlayerWhoWon( m_uPlayerWhoWonGame );
-	
-	for( int i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
-	{
-		if ( !m_rgClientData[i].m_bActive ) 
-			continue;
+	pUpdateData->SetPlayerWhoWon( m_uPlayerWhoWonGame );
+}
 
-		BSendDataToClient( i, (char*)&msg, sizeof( msg ) );
+
+//-----------------------------------------------------------------------------
+// Purpose: Start writing a replay of this server's match
+//-----------------------------------------------------------------------------
+bool CSpaceWarServer::StartRecording( const char *pchFileName )
+{
+	// Replays start from a freshly created server
+	if ( m_pRecorder || m_bHasRunFrame )
+		return false;
+
+	m_pRecorder = new CMatchRecorder( m_pGameEngine );
+	if ( !m_pRecorder->BOpen( pchFileName, m_ulCreatedTickCount ) )
+	{
+		delete m_pRecorder;
+		m_pRecorder = NULL;
+		return false;
 	}
+	return true;
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Send through the transport, counting the message by type
+//-----------------------------------------------------------------------------
+EResult CSpaceWarServer::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+{
+	EResult res = m_pTransport->SendMessageToConnection( hConn, pData, cbData, nSendFlags, pOutMessageNumber );
+	if ( res == k_EResultOK && cbData >= sizeof( DWORD ) )
+		m_Metrics.RecordMessageOut( LittleDWord( *(const DWORD *)pData ), cbData );
+	return res;
+}
+
 
 void CSpaceWarServer::SendMessageToAll( HSteamNetConnection hConnIgnore, const void* pubData, uint32 cubData)
 {
@@ -801,7 +951,7 @@ void CSpaceWarServer::SendMessageToAll( HSteamNetConnection hConnIgnore, const v
 	{
 		if ( m_rgClientData[i].m_hConn != k_HSteamNetConnection_Invalid && m_rgClientData[i].m_hConn != hConnIgnore )
 		{
-			SteamNetworkingSockets()->SendMessageToConnection(m_rgClientData[i].m_hConn, pubData, cubData, k_nSteamNetworkingSend_UnreliableNoDelay, nullptr );
+			SendMessageToConnection(m_rgClientData[i].m_hConn, pubData, cubData, k_nSteamNetworkingSend_UnreliableNoDelay, nullptr );
 		}
 	}
 }
@@ -813,6 +963,9 @@ void CSpaceWarServer::OnReceiveClientUpdateData( uint32 uShipIndex, ClientSpaceW
 {
 	if ( m_rgClientData[uShipIndex].m_bActive && m_rgpShips[uShipIndex] )
 	{
+		if ( m_pRecorder )
+			m_pRecorder->RecordClientUpdate( uShipIndex, *pUpdateData );
+
 		m_rgClientData[uShipIndex].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
 		m_rgpShips[uShipIndex]->OnReceiveClientUpdate( pUpdateData );
 	}
@@ -999,6 +1152,9 @@ void CSpaceWarServer::SendUpdatedServerDetailsToSteam()
 	}
 	m_sServerName = rgchServerName;
 
+	if ( !m_bUseSteam )
+		return;
+
 	//
 	// Set state variables, relevant to any master server updates or client pings
 	//
@@ -1080,6 +1236,13 @@ void CSpaceWarServer::OnValidateAuthTicketResponse( ValidateAuthTicketResponse_t
 CSteamID CSpaceWarServer::GetSteamID()
 {
 #ifdef USE_GS_AUTH_API
+	if ( !m_bUseSteam )
+	{
+		// Use whatever identity the transport gave us
+		SteamNetworkingIdentity identity;
+		m_pTransport->GetIdentity( &identity );
+		return identity.GetSteamID();
+	}
 	return SteamGameServer()->GetSteamID();
 #else
 	// this is a placeholder steam id to use when not making use of Steam auth or matchmaking
@@ -1103,11 +1266,13 @@ void CSpaceWarServer::KickPlayerOffServer( CSteamID steamID )
 		if ( m_rgClientData[i].m_SteamIDUser == steamID )
 		{
 			OutputDebugString( "Kicking player\n" );
+			if ( m_pRecorder )
+				m_pRecorder->RecordPlayerRemoved( i );
 			RemovePlayerFromServer( i, k_EDRClientKicked);
 			// send him a kick message
 			MsgServerFailAuthentication_t msg;
 			int64 outMessage;
-			SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgClientData[i].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &outMessage);
+			SendMessageToConnection(m_rgClientData[i].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &outMessage);
 		}
 		else
 		{
@@ -17,9 +17,12 @@
 #include "steam/isteamnetworkingsockets.h" 
 #include "steam/steamclientpublic.h"
 #include "Messages.h"
+#include "SpaceWarTransport.h"
+#include "ServerMetrics.h"
 
 // Forward declaration
 class CSpaceWarClient;
+class CMatchRecorder;
 
 struct ClientConnectionData_t
 {
@@ -35,11 +38,11 @@ struct ClientConnectionData_t
 	}
 };
 
-class CSpaceWarServer
+class CSpaceWarServer : public ISpaceWarTransportListener
 {
 public:
-	//Constructor
-	CSpaceWarServer( IGameEngine *pEngine );
+	//Constructor, pass a transport to run over something other than Steam (the caller keeps ownership)
+	CSpaceWarServer( IGameEngine *pEngine, ISpaceWarTransport *pTransport = NULL );
 
 	// Destructor
 	~CSpaceWarServer();
@@ -69,7 +72,16 @@ public:
 	bool IsConnectedToSteam()		{ return m_bConnectedToSteam; }
 	CSteamID GetSteamID();
 
+	// Periodically write tick, traffic and connection metrics to this file (Prometheus text format)
+	void SetMetricsFile( const char *pchFileName ) { m_sMetricsFile = pchFileName ? pchFileName : ""; }
+
+	// Record the match for replay with -replay, only possible before the first RunFrame()
+	bool StartRecording( const char *pchFileName );
+
 private:
+	// Replays drive the server through the same entry points the network does
+	friend int RunMatchReplay( const char *pchFileName );
+
 	//
 	// Various callback functions that Steam will call to let us know about events related to our
 	// connection to the Steam servers for authentication purposes.
@@ -97,8 +109,8 @@ private:
 	STEAM_GAMESERVER_CALLBACK( CSpaceWarServer, OnValidateAuthTicketResponse, ValidateAuthTicketResponse_t );
 
 	// client connection state
-	// All connection changes are handled through this callback
-	STEAM_GAMESERVER_CALLBACK(CSpaceWarServer, OnNetConnectionStatusChanged, SteamNetConnectionStatusChangedCallback_t);
+	// All connection changes are handled through this callback, the transport forwards it
+	virtual void OnNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback );
 
 	// Function to tell Steam about our servers details
 	void SendUpdatedServerDetailsToSteam();
@@ -119,15 +131,27 @@ private:
 	// Adds/initializes a new player ship at the given position
 	void AddPlayerShip( uint32 uShipPosition );
 
+	// Bring an authenticated player in m_rgClientData into the game
+	void ActivatePlayer( uint32 uShipPosition );
+
 	// Removes a player from the server
 	void RemovePlayerFromServer( uint32 uShipPosition, EDisconnectReason reason);
 
 	// Send world update to all clients
 	void SendUpdateDataToAllClients();
 
+	// Fill in the world state clients get sent
+	void BuildUpdateData( ServerSpaceWarUpdateData_t *pUpdateData );
+
 	// Send the same message to all clients, except the ignored connection if any
 	void SendMessageToAll( HSteamNetConnection hConnIgnore, const void* pubData, uint32 cubData );
 
+	// Every send goes through here so it gets counted
+	EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber );
+
+	// Sample the player connections and rewrite the metrics file
+	void WriteMetrics();
+
 	// Track whether our server is connected to Steam ok (meaning we can restrict who plays based on 
 	// ownership and VAC bans, etc...)
 	bool m_bConnectedToSteam;
@@ -173,6 +197,23 @@ private:
 
 	// Poll group used to receive messages from all clients at once
 	HSteamNetPollGroup m_hNetPollGroup;
+
+	// What we send and receive through
+	ISpaceWarTransport *m_pTransport;
+	bool m_bOwnsTransport;
+
+	// False when running on a private transport, in which case there is no Steam game server
+	bool m_bUseSteam;
+
+	// Always collected, only written out when m_sMetricsFile is set
+	CServerMetrics m_Metrics;
+	std::string m_sMetricsFile;
+	uint64 m_ulLastMetricsWriteTick;
+
+	// Match recording, if any
+	CMatchRecorder *m_pRecorder;
+	uint64 m_ulCreatedTickCount;
+	bool m_bHasRunFrame;
 };
 
 
@@ -0,0 +1,691 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Transport abstraction used by the space war client and server
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "SpaceWarTransport.h"
+#include <chrono>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CSteamNetworkingTransport::CSteamNetworkingTransport( bool bGameServer )
+{
+	m_bGameServer = bGameServer;
+	m_pListener = NULL;
+
+	if ( m_bGameServer )
+		m_CallbackStatusChangedGameServer.Register( this, &CSteamNetworkingTransport::OnSteamNetConnectionStatusChanged );
+	else
+		m_CallbackStatusChanged.Register( this, &CSteamNetworkingTransport::OnSteamNetConnectionStatusChanged );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CSteamNetworkingTransport::~CSteamNetworkingTransport()
+{
+	m_CallbackStatusChanged.Unregister();
+	m_CallbackStatusChangedGameServer.Unregister();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The sockets interface we wrap
+//-----------------------------------------------------------------------------
+ISteamNetworkingSockets *CSteamNetworkingTransport::Sockets()
+{
+	return m_bGameServer ? SteamGameServerNetworkingSockets() : SteamNetworkingSockets();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Forward Steam's status change callback to our listener
+//-----------------------------------------------------------------------------
+void CSteamNetworkingTransport::OnSteamNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback )
+{
+	if ( m_pListener )
+		m_pListener->OnNetConnectionStatusChanged( pCallback );
+}
+
+
+bool CSteamNetworkingTransport::GetIdentity( SteamNetworkingIdentity *pIdentity )
+{
+	return Sockets() && Sockets()->GetIdentity( pIdentity );
+}
+
+
+HSteamListenSocket CSteamNetworkingTransport::CreateListenSocket()
+{
+	return Sockets()->CreateListenSocketP2P( 0, 0, nullptr );
+}
+
+
+bool CSteamNetworkingTransport::CloseListenSocket( HSteamListenSocket hSocket )
+{
+	return Sockets()->CloseListenSocket( hSocket );
+}
+
+
+HSteamNetConnection CSteamNetworkingTransport::Connect( const SteamNetworkingIdentity &identityRemote )
+{
+	return Sockets()->ConnectP2P( identityRemote, 0, 0, nullptr );
+}
+
+
+EResult CSteamNetworkingTransport::AcceptConnection( HSteamNetConnection hConn )
+{
+	return Sockets()->AcceptConnection( hConn );
+}
+
+
+bool CSteamNetworkingTransport::CloseConnection( HSteamNetConnection hConn, int nReason, const char *pszDebug, bool bEnableLinger )
+{
+	return Sockets()->CloseConnection( hConn, nReason, pszDebug, bEnableLinger );
+}
+
+
+bool CSteamNetworkingTransport::GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo )
+{
+	return Sockets()->GetConnectionInfo( hConn, pInfo );
+}
+
+
+EResult CSteamNetworkingTransport::GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus )
+{
+	return Sockets()->GetConnectionRealTimeStatus( hConn, pStatus, 0, NULL );
+}
+
+
+HSteamNetPollGroup CSteamNetworkingTransport::CreatePollGroup()
+{
+	return Sockets()->CreatePollGroup();
+}
+
+
+bool CSteamNetworkingTransport::DestroyPollGroup( HSteamNetPollGroup hPollGroup )
+{
+	return Sockets()->DestroyPollGroup( hPollGroup );
+}
+
+
+bool CSteamNetworkingTransport::SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup )
+{
+	return Sockets()->SetConnectionPollGroup( hConn, hPollGroup );
+}
+
+
+EResult CSteamNetworkingTransport::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+{
+	return Sockets()->SendMessageToConnection( hConn, pData, cbData, nSendFlags, pOutMessageNumber );
+}
+
+
+int CSteamNetworkingTransport::ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	return Sockets()->ReceiveMessagesOnConnection( hConn, ppOutMessages, nMaxMessages );
+}
+
+
+int CSteamNetworkingTransport::ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	return Sockets()->ReceiveMessagesOnPollGroup( hPollGroup, ppOutMessages, nMaxMessages );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Message object handed out by the loopback transport.  The SDK struct
+// has a protected destructor, so we derive to be able to new/delete it.
+//-----------------------------------------------------------------------------
+struct LoopbackMessage_t : public SteamNetworkingMessage_t
+{
+	LoopbackMessage_t( const void *pData, uint32 cbData )
+	{
+		m_pData = malloc( cbData );
+		memcpy( m_pData, pData, cbData );
+		m_cbSize = (int)cbData;
+		m_conn = k_HSteamNetConnection_Invalid;
+		m_identityPeer.Clear();
+		m_nConnUserData = 0;
+		m_usecTimeReceived = 0;
+		m_nMessageNumber = 0;
+		m_pfnFreeData = NULL;
+		m_pfnRelease = &LoopbackMessage_t::ReleaseMessage;
+		m_nChannel = 0;
+		m_nFlags = 0;
+		m_nUserData = 0;
+		m_idxLane = 0;
+	}
+
+	~LoopbackMessage_t()
+	{
+		free( m_pData );
+	}
+
+	static void ReleaseMessage( SteamNetworkingMessage_t *pMsg )
+	{
+		delete static_cast<LoopbackMessage_t *>( pMsg );
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CLoopbackNetwork::CLoopbackNetwork()
+{
+	// Zero is k_HSteamNetConnection_Invalid etc, so start handing out handles at 1
+	m_unNextHandle = 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Monotonic microsecond clock for message timestamps
+//-----------------------------------------------------------------------------
+SteamNetworkingMicroseconds CLoopbackNetwork::GetTimestamp()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor, frees anything the endpoints left behind
+//-----------------------------------------------------------------------------
+CLoopbackNetwork::~CLoopbackNetwork()
+{
+	while ( !m_mapConnections.empty() )
+		FreeConnection( m_mapConnections.begin()->first );
+
+	for ( std::map<HSteamNetPollGroup, PollGroup_t>::iterator iter = m_mapPollGroups.begin(); iter != m_mapPollGroups.end(); ++iter )
+	{
+		for ( size_t i = 0; i < iter->second.m_queueMessages.size(); ++i )
+			iter->second.m_queueMessages[i]->Release();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Look up a connection handle, which must belong to the given endpoint
+//-----------------------------------------------------------------------------
+CLoopbackNetwork::Connection_t *CLoopbackNetwork::FindConnection( CLoopbackTransport *pOwner, HSteamNetConnection hConn )
+{
+	std::map<HSteamNetConnection, Connection_t>::iterator iter = m_mapConnections.find( hConn );
+	if ( iter == m_mapConnections.end() || iter->second.m_pOwner != pOwner )
+		return NULL;
+	return &iter->second;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Look up a poll group handle, which must belong to the given endpoint
+//-----------------------------------------------------------------------------
+CLoopbackNetwork::PollGroup_t *CLoopbackNetwork::FindPollGroup( CLoopbackTransport *pOwner, HSteamNetPollGroup hPollGroup )
+{
+	std::map<HSteamNetPollGroup, PollGroup_t>::iterator iter = m_mapPollGroups.find( hPollGroup );
+	if ( iter == m_mapPollGroups.end() || iter->second.m_pOwner != pOwner )
+		return NULL;
+	return &iter->second;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Fill in the connection info struct the same way Steam would for a P2P connection
+//-----------------------------------------------------------------------------
+void CLoopbackNetwork::FillConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo )
+{
+	const Connection_t &conn = m_mapConnections[hConn];
+
+	memset( pInfo, 0, sizeof( *pInfo ) );
+	pInfo->m_identityRemote = conn.m_identityRemote;
+	pInfo->m_hListenSocket = conn.m_hListenSocket;
+	pInfo->m_addrRemote.SetIPv6LocalHost();
+	pInfo->m_eState = conn.m_eState;
+	pInfo->m_eEndReason = conn.m_eEndReason;
+	strncpy( pInfo->m_szEndDebug, conn.m_szEndDebug, sizeof( pInfo->m_szEndDebug ) - 1 );
+	snprintf( pInfo->m_szConnectionDescription, sizeof( pInfo->m_szConnectionDescription ), "loopback #%u", hConn );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move a connection to a new state and queue the callback on its owner
+//-----------------------------------------------------------------------------
+void CLoopbackNetwork::SetConnectionState( HSteamNetConnection hConn, ESteamNetworkingConnectionState eState )
+{
+	Connection_t &conn = m_mapConnections[hConn];
+	if ( conn.m_eState == eState )
+		return;
+
+	SteamNetConnectionStatusChangedCallback_t callback;
+	callback.m_hConn = hConn;
+	callback.m_eOldState = conn.m_eState;
+
+	conn.m_eState = eState;
+	FillConnectionInfo( hConn, &callback.m_info );
+
+	conn.m_pOwner->m_vecPendingStatus.push_back( callback );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Drop one end of a connection along with anything still queued on it
+//-----------------------------------------------------------------------------
+void CLoopbackNetwork::FreeConnection( HSteamNetConnection hConn )
+{
+	std::map<HSteamNetConnection, Connection_t>::iterator iter = m_mapConnections.find( hConn );
+	if ( iter == m_mapConnections.end() )
+		return;
+
+	for ( size_t i = 0; i < iter->second.m_queueMessages.size(); ++i )
+		iter->second.m_queueMessages[i]->Release();
+
+	// Messages that already went to a poll group stay there, like with Steam
+	m_mapConnections.erase( iter );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: An endpoint is going away, close everything it still has open
+//-----------------------------------------------------------------------------
+void CLoopbackNetwork::DetachTransport( CLoopbackTransport *pTransport )
+{
+	std::vector<HSteamNetConnection> vecConnections;
+	for ( std::map<HSteamNetConnection, Connection_t>::iterator iter = m_mapConnections.begin(); iter != m_mapConnections.end(); ++iter )
+	{
+		if ( iter->second.m_pOwner == pTransport )
+			vecConnections.push_back( iter->first );
+	}
+	for ( size_t i = 0; i < vecConnections.size(); ++i )
+		pTransport->CloseConnection( vecConnections[i], k_ESteamNetConnectionEnd_App_Generic, "Endpoint destroyed", false );
+
+	std::map<HSteamListenSocket, CLoopbackTransport *>::iterator iterSocket = m_mapListenSockets.begin();
+	while ( iterSocket != m_mapListenSockets.end() )
+	{
+		if ( iterSocket->second == pTransport )
+			m_mapListenSockets.erase( iterSocket++ );
+		else
+			++iterSocket;
+	}
+
+	std::map<HSteamNetPollGroup, PollGroup_t>::iterator iterGroup = m_mapPollGroups.begin();
+	while ( iterGroup != m_mapPollGroups.end() )
+	{
+		if ( iterGroup->second.m_pOwner == pTransport )
+		{
+			for ( size_t i = 0; i < iterGroup->second.m_queueMessages.size(); ++i )
+				iterGroup->second.m_queueMessages[i]->Release();
+			m_mapPollGroups.erase( iterGroup++ );
+		}
+		else
+		{
+			++iterGroup;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CLoopbackTransport::CLoopbackTransport( CLoopbackNetwork *pNetwork, const SteamNetworkingIdentity &identityLocal )
+{
+	m_pNetwork = pNetwork;
+	m_identityLocal = identityLocal;
+	m_pListener = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CLoopbackTransport::~CLoopbackTransport()
+{
+	m_pNetwork->DetachTransport( this );
+}
+
+
+bool CLoopbackTransport::GetIdentity( SteamNetworkingIdentity *pIdentity )
+{
+	*pIdentity = m_identityLocal;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Deliver queued status changes.  Handlers may connect, close, etc. which
+// queues more changes, those get delivered next time around.
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::RunCallbacks()
+{
+	if ( m_vecPendingStatus.empty() )
+		return;
+
+	std::vector<SteamNetConnectionStatusChangedCallback_t> vecStatus;
+	vecStatus.swap( m_vecPendingStatus );
+
+	for ( size_t i = 0; i < vecStatus.size(); ++i )
+	{
+		if ( m_pListener )
+			m_pListener->OnNetConnectionStatusChanged( &vecStatus[i] );
+	}
+}
+
+
+HSteamListenSocket CLoopbackTransport::CreateListenSocket()
+{
+	HSteamListenSocket hSocket = m_pNetwork->AllocHandle();
+	m_pNetwork->m_mapListenSockets[hSocket] = this;
+	return hSocket;
+}
+
+
+bool CLoopbackTransport::CloseListenSocket( HSteamListenSocket hSocket )
+{
+	std::map<HSteamListenSocket, CLoopbackTransport *>::iterator iter = m_pNetwork->m_mapListenSockets.find( hSocket );
+	if ( iter == m_pNetwork->m_mapListenSockets.end() || iter->second != this )
+		return false;
+
+	// Like Steam, closing the listen socket closes everything accepted on it
+	std::vector<HSteamNetConnection> vecConnections;
+	for ( std::map<HSteamNetConnection, CLoopbackNetwork::Connection_t>::iterator iterConn = m_pNetwork->m_mapConnections.begin(); iterConn != m_pNetwork->m_mapConnections.end(); ++iterConn )
+	{
+		if ( iterConn->second.m_pOwner == this && iterConn->second.m_hListenSocket == hSocket )
+			vecConnections.push_back( iterConn->first );
+	}
+	for ( size_t i = 0; i < vecConnections.size(); ++i )
+		CloseConnection( vecConnections[i], k_ESteamNetConnectionEnd_App_Generic, "Listen socket closed", false );
+
+	m_pNetwork->m_mapListenSockets.erase( iter );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Connect to the endpoint with the given identity, which needs an open listen socket
+//-----------------------------------------------------------------------------
+HSteamNetConnection CLoopbackTransport::Connect( const SteamNetworkingIdentity &identityRemote )
+{
+	HSteamListenSocket hListenSocket = k_HSteamListenSocket_Invalid;
+	CLoopbackTransport *pRemote = NULL;
+	for ( std::map<HSteamListenSocket, CLoopbackTransport *>::iterator iter = m_pNetwork->m_mapListenSockets.begin(); iter != m_pNetwork->m_mapListenSockets.end(); ++iter )
+	{
+		if ( iter->second->m_identityLocal == identityRemote )
+		{
+			hListenSocket = iter->first;
+			pRemote = iter->second;
+			break;
+		}
+	}
+
+	HSteamNetConnection hConnLocal = m_pNetwork->AllocHandle();
+	CLoopbackNetwork::Connection_t &connLocal = m_pNetwork->m_mapConnections[hConnLocal];
+	connLocal.m_pOwner = this;
+	connLocal.m_hPeer = k_HSteamNetConnection_Invalid;
+	connLocal.m_hListenSocket = k_HSteamListenSocket_Invalid;
+	connLocal.m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+	connLocal.m_identityRemote = identityRemote;
+	connLocal.m_eState = k_ESteamNetworkingConnectionState_None;
+	connLocal.m_eEndReason = k_ESteamNetConnectionEnd_Invalid;
+	connLocal.m_szEndDebug[0] = 0;
+	connLocal.m_nNextMessageNumber = 1;
+
+	m_pNetwork->SetConnectionState( hConnLocal, k_ESteamNetworkingConnectionState_Connecting );
+
+	if ( !pRemote )
+	{
+		// Nobody listening, fail the same way an unreachable P2P peer would
+		connLocal.m_eEndReason = k_ESteamNetConnectionEnd_Misc_PeerSentNoConnection;
+		strncpy( connLocal.m_szEndDebug, "No loopback listener", sizeof( connLocal.m_szEndDebug ) - 1 );
+		m_pNetwork->SetConnectionState( hConnLocal, k_ESteamNetworkingConnectionState_ProblemDetectedLocally );
+		return hConnLocal;
+	}
+
+	HSteamNetConnection hConnRemote = m_pNetwork->AllocHandle();
+	CLoopbackNetwork::Connection_t &connRemote = m_pNetwork->m_mapConnections[hConnRemote];
+	connRemote.m_pOwner = pRemote;
+	connRemote.m_hPeer = hConnLocal;
+	connRemote.m_hListenSocket = hListenSocket;
+	connRemote.m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+	connRemote.m_identityRemote = m_identityLocal;
+	connRemote.m_eState = k_ESteamNetworkingConnectionState_None;
+	connRemote.m_eEndReason = k_ESteamNetConnectionEnd_Invalid;
+	connRemote.m_szEndDebug[0] = 0;
+	connRemote.m_nNextMessageNumber = 1;
+
+	connLocal.m_hPeer = hConnRemote;
+
+	m_pNetwork->SetConnectionState( hConnRemote, k_ESteamNetworkingConnectionState_Connecting );
+	return hConnLocal;
+}
+
+
+EResult CLoopbackTransport::AcceptConnection( HSteamNetConnection hConn )
+{
+	CLoopbackNetwork::Connection_t *pConn = m_pNetwork->FindConnection( this, hConn );
+	if ( !pConn || pConn->m_hListenSocket == k_HSteamListenSocket_Invalid )
+		return k_EResultInvalidParam;
+	if ( pConn->m_eState != k_ESteamNetworkingConnectionState_Connecting || pConn->m_hPeer == k_HSteamNetConnection_Invalid )
+		return k_EResultInvalidState;
+
+	HSteamNetConnection hPeer = pConn->m_hPeer;
+	m_pNetwork->SetConnectionState( hConn, k_ESteamNetworkingConnectionState_Connected );
+	m_pNetwork->SetConnectionState( hPeer, k_ESteamNetworkingConnectionState_Connected );
+	return k_EResultOK;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Free our end and tell the other end it was closed by the peer
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::CloseConnection( HSteamNetConnection hConn, int nReason, const char *pszDebug, bool bEnableLinger )
+{
+	CLoopbackNetwork::Connection_t *pConn = m_pNetwork->FindConnection( this, hConn );
+	if ( !pConn )
+		return false;
+
+	HSteamNetConnection hPeer = pConn->m_hPeer;
+	if ( hPeer != k_HSteamNetConnection_Invalid )
+	{
+		CLoopbackNetwork::Connection_t &connPeer = m_pNetwork->m_mapConnections[hPeer];
+		connPeer.m_hPeer = k_HSteamNetConnection_Invalid;
+		connPeer.m_eEndReason = nReason;
+		strncpy( connPeer.m_szEndDebug, pszDebug ? pszDebug : "", sizeof( connPeer.m_szEndDebug ) - 1 );
+		connPeer.m_szEndDebug[ sizeof( connPeer.m_szEndDebug ) - 1 ] = 0;
+		m_pNetwork->SetConnectionState( hPeer, k_ESteamNetworkingConnectionState_ClosedByPeer );
+	}
+
+	m_pNetwork->FreeConnection( hConn );
+
+	// Drop any status changes still queued for this handle, it's gone now
+	for ( size_t i = 0; i < m_vecPendingStatus.size(); )
+	{
+		if ( m_vecPendingStatus[i].m_hConn == hConn )
+			m_vecPendingStatus.erase( m_vecPendingStatus.begin() + i );
+		else
+			++i;
+	}
+	return true;
+}
+
+
+bool CLoopbackTransport::GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo )
+{
+	if ( !m_pNetwork->FindConnection( this, hConn ) )
+		return false;
+
+	m_pNetwork->FillConnectionInfo( hConn, pInfo );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: There's no wire, so ping is zero and quality perfect.  The send queue
+// is whatever we've sent that the other end hasn't pulled out of its queue yet.
+//-----------------------------------------------------------------------------
+EResult CLoopbackTransport::GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus )
+{
+	CLoopbackNetwork::Connection_t *pConn = m_pNetwork->FindConnection( this, hConn );
+	if ( !pConn )
+		return k_EResultNoConnection;
+
+	memset( pStatus, 0, sizeof( *pStatus ) );
+	pStatus->m_eState = pConn->m_eState;
+	pStatus->m_flConnectionQualityLocal = 1.0f;
+	pStatus->m_flConnectionQualityRemote = 1.0f;
+	if ( pConn->m_hPeer == k_HSteamNetConnection_Invalid )
+		return k_EResultOK;
+
+	// Messages for the peer sit either on its connection or in its poll group mixed with other connections
+	CLoopbackNetwork::Connection_t &connPeer = m_pNetwork->m_mapConnections[pConn->m_hPeer];
+	CLoopbackNetwork::PollGroup_t *pPollGroup = m_pNetwork->FindPollGroup( connPeer.m_pOwner, connPeer.m_hPollGroup );
+	const std::deque<SteamNetworkingMessage_t *> &queueMessages = pPollGroup ? pPollGroup->m_queueMessages : connPeer.m_queueMessages;
+
+	SteamNetworkingMicroseconds usecOldest = 0;
+	for ( size_t i = 0; i < queueMessages.size(); ++i )
+	{
+		SteamNetworkingMessage_t *pMsg = queueMessages[i];
+		if ( pMsg->m_conn != pConn->m_hPeer )
+			continue;
+
+		if ( pMsg->m_nFlags & k_nSteamNetworkingSend_Reliable )
+			pStatus->m_cbPendingReliable += pMsg->GetSize();
+		else
+			pStatus->m_cbPendingUnreliable += pMsg->GetSize();
+
+		if ( !usecOldest )
+			usecOldest = pMsg->m_usecTimeReceived;
+	}
+
+	if ( usecOldest )
+		pStatus->m_usecQueueTime = CLoopbackNetwork::GetTimestamp() - usecOldest;
+
+	return k_EResultOK;
+}
+
+
+HSteamNetPollGroup CLoopbackTransport::CreatePollGroup()
+{
+	HSteamNetPollGroup hPollGroup = m_pNetwork->AllocHandle();
+	m_pNetwork->m_mapPollGroups[hPollGroup].m_pOwner = this;
+	return hPollGroup;
+}
+
+
+bool CLoopbackTransport::DestroyPollGroup( HSteamNetPollGroup hPollGroup )
+{
+	CLoopbackNetwork::PollGroup_t *pPollGroup = m_pNetwork->FindPollGroup( this, hPollGroup );
+	if ( !pPollGroup )
+		return false;
+
+	for ( size_t i = 0; i < pPollGroup->m_queueMessages.size(); ++i )
+		pPollGroup->m_queueMessages[i]->Release();
+
+	for ( std::map<HSteamNetConnection, CLoopbackNetwork::Connection_t>::iterator iter = m_pNetwork->m_mapConnections.begin(); iter != m_pNetwork->m_mapConnections.end(); ++iter )
+	{
+		if ( iter->second.m_hPollGroup == hPollGroup )
+			iter->second.m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+	}
+
+	m_pNetwork->m_mapPollGroups.erase( hPollGroup );
+	return true;
+}
+
+
+bool CLoopbackTransport::SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup )
+{
+	CLoopbackNetwork::Connection_t *pConn = m_pNetwork->FindConnection( this, hConn );
+	if ( !pConn )
+		return false;
+
+	CLoopbackNetwork::PollGroup_t *pPollGroup = NULL;
+	if ( hPollGroup != k_HSteamNetPollGroup_Invalid )
+	{
+		pPollGroup = m_pNetwork->FindPollGroup( this, hPollGroup );
+		if ( !pPollGroup )
+			return false;
+	}
+
+	pConn->m_hPollGroup = hPollGroup;
+
+	// Anything already received moves over to the group
+	if ( pPollGroup )
+	{
+		pPollGroup->m_queueMessages.insert( pPollGroup->m_queueMessages.end(), pConn->m_queueMessages.begin(), pConn->m_queueMessages.end() );
+		pConn->m_queueMessages.clear();
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Copy the message straight into the receive queue of the other end
+//-----------------------------------------------------------------------------
+EResult CLoopbackTransport::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+{
+	CLoopbackNetwork::Connection_t *pConn = m_pNetwork->FindConnection( this, hConn );
+	if ( !pConn )
+		return k_EResultInvalidParam;
+	if ( cbData > k_cbMaxSteamNetworkingSocketsMessageSizeSend )
+		return k_EResultInvalidParam;
+	if ( pConn->m_hPeer == k_HSteamNetConnection_Invalid )
+		return k_EResultNoConnection;
+	if ( pConn->m_eState != k_ESteamNetworkingConnectionState_Connected )
+		return k_EResultInvalidState;
+
+	int64 nMessageNumber = pConn->m_nNextMessageNumber++;
+	if ( pOutMessageNumber )
+		*pOutMessageNumber = nMessageNumber;
+
+	CLoopbackNetwork::Connection_t &connPeer = m_pNetwork->m_mapConnections[pConn->m_hPeer];
+
+	LoopbackMessage_t *pMsg = new LoopbackMessage_t( pData, cbData );
+	pMsg->m_conn = pConn->m_hPeer;
+	pMsg->m_identityPeer = m_identityLocal;
+	pMsg->m_nMessageNumber = nMessageNumber;
+	pMsg->m_nFlags = nSendFlags;
+	pMsg->m_usecTimeReceived = CLoopbackNetwork::GetTimestamp();
+
+	CLoopbackNetwork::PollGroup_t *pPollGroup = m_pNetwork->FindPollGroup( connPeer.m_pOwner, connPeer.m_hPollGroup );
+	if ( pPollGroup )
+		pPollGroup->m_queueMessages.push_back( pMsg );
+	else
+		connPeer.m_queueMessages.push_back( pMsg );
+
+	return k_EResultOK;
+}
+
+
+int CLoopbackTransport::ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	CLoopbackNetwork::Connection_t *pConn = m_pNetwork->FindConnection( this, hConn );
+	if ( !pConn )
+		return -1;
+
+	int nMessages = 0;
+	while ( nMessages < nMaxMessages && !pConn->m_queueMessages.empty() )
+	{
+		ppOutMessages[nMessages++] = pConn->m_queueMessages.front();
+		pConn->m_queueMessages.pop_front();
+	}
+	return nMessages;
+}
+
+
+int CLoopbackTransport::ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	CLoopbackNetwork::PollGroup_t *pPollGroup = m_pNetwork->FindPollGroup( this, hPollGroup );
+	if ( !pPollGroup )
+		return -1;
+
+	int nMessages = 0;
+	while ( nMessages < nMaxMessages && !pPollGroup->m_queueMessages.empty() )
+	{
+		ppOutMessages[nMessages++] = pPollGroup->m_queueMessages.front();
+		pPollGroup->m_queueMessages.pop_front();
+	}
+	return nMessages;
+}
@@ -0,0 +1,225 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Transport abstraction used by the space war client and server
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef SPACEWARTRANSPORT_H
+#define SPACEWARTRANSPORT_H
+
+#include <map>
+#include <deque>
+#include <vector>
+
+#include "steam/isteamnetworkingsockets.h"
+#include "steam/steamnetworkingtypes.h"
+
+class CLoopbackNetwork;
+
+//-----------------------------------------------------------------------------
+// Purpose: Receives connection status changes from a transport.  The callback
+// struct is the same one ISteamNetworkingSockets posts, so handlers don't care
+// which transport produced it.
+//-----------------------------------------------------------------------------
+class ISpaceWarTransportListener
+{
+public:
+	virtual ~ISpaceWarTransportListener() {}
+
+	virtual void OnNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback ) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The slice of ISteamNetworkingSockets that the client and server use.
+// Messages returned from the receive calls must be freed with Release() as usual.
+//-----------------------------------------------------------------------------
+class ISpaceWarTransport
+{
+public:
+	virtual ~ISpaceWarTransport() {}
+
+	// True if this transport runs over Steam, in which case the owner is also expected
+	// to use the Steam game server / user interfaces for authentication
+	virtual bool BSteamBacked() = 0;
+
+	// Who we are on this transport
+	virtual bool GetIdentity( SteamNetworkingIdentity *pIdentity ) = 0;
+
+	// Set who gets connection status changes
+	virtual void SetListener( ISpaceWarTransportListener *pListener ) = 0;
+
+	// Dispatch any queued status changes to the listener, call once per frame
+	virtual void RunCallbacks() = 0;
+
+	virtual HSteamListenSocket CreateListenSocket() = 0;
+	virtual bool CloseListenSocket( HSteamListenSocket hSocket ) = 0;
+
+	virtual HSteamNetConnection Connect( const SteamNetworkingIdentity &identityRemote ) = 0;
+	virtual EResult AcceptConnection( HSteamNetConnection hConn ) = 0;
+	virtual bool CloseConnection( HSteamNetConnection hConn, int nReason, const char *pszDebug, bool bEnableLinger ) = 0;
+	virtual bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo ) = 0;
+
+	// Ping, quality and send queue state, lanes aren't used by the game so they aren't exposed
+	virtual EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus ) = 0;
+
+	virtual HSteamNetPollGroup CreatePollGroup() = 0;
+	virtual bool DestroyPollGroup( HSteamNetPollGroup hPollGroup ) = 0;
+	virtual bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup ) = 0;
+
+	virtual EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber ) = 0;
+	virtual int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages ) = 0;
+	virtual int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages ) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Transport over ISteamNetworkingSockets (either the client or the game
+// server instance).  Status changes come in through the Steam callback system.
+//-----------------------------------------------------------------------------
+class CSteamNetworkingTransport : public ISpaceWarTransport
+{
+public:
+	CSteamNetworkingTransport( bool bGameServer );
+	virtual ~CSteamNetworkingTransport();
+
+	virtual bool BSteamBacked() { return true; }
+	virtual bool GetIdentity( SteamNetworkingIdentity *pIdentity );
+	virtual void SetListener( ISpaceWarTransportListener *pListener ) { m_pListener = pListener; }
+	virtual void RunCallbacks() {}
+
+	virtual HSteamListenSocket CreateListenSocket();
+	virtual bool CloseListenSocket( HSteamListenSocket hSocket );
+
+	virtual HSteamNetConnection Connect( const SteamNetworkingIdentity &identityRemote );
+	virtual EResult AcceptConnection( HSteamNetConnection hConn );
+	virtual bool CloseConnection( HSteamNetConnection hConn, int nReason, const char *pszDebug, bool bEnableLinger );
+	virtual bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo );
+	virtual EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus );
+
+	virtual HSteamNetPollGroup CreatePollGroup();
+	virtual bool DestroyPollGroup( HSteamNetPollGroup hPollGroup );
+	virtual bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup );
+
+	virtual EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber );
+	virtual int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+	virtual int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+
+private:
+	ISteamNetworkingSockets *Sockets();
+
+	void OnSteamNetConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback );
+
+	bool m_bGameServer;
+	ISpaceWarTransportListener *m_pListener;
+
+	// Only one of these is registered, depending on which Steam instance we talk to
+	CCallbackManual< CSteamNetworkingTransport, SteamNetConnectionStatusChangedCallback_t, false > m_CallbackStatusChanged;
+	CCallbackManual< CSteamNetworkingTransport, SteamNetConnectionStatusChangedCallback_t, true > m_CallbackStatusChangedGameServer;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: In-process transport endpoint.  Every endpoint attached to the same
+// CLoopbackNetwork can connect to any other one by identity, which lets a single
+// process run servers and lots of synthetic clients without Steam.
+//
+// Delivery is immediate and lossless, status changes are delivered from RunCallbacks().
+// The "pending" bytes in the real time status are what the peer hasn't received yet.
+// m_usecTimeReceived is stamped from CLoopbackNetwork::GetTimestamp() when the message is queued.
+// Not thread safe, all endpoints on a network must be pumped from one thread.
+//-----------------------------------------------------------------------------
+class CLoopbackTransport : public ISpaceWarTransport
+{
+public:
+	CLoopbackTransport( CLoopbackNetwork *pNetwork, const SteamNetworkingIdentity &identityLocal );
+	virtual ~CLoopbackTransport();
+
+	virtual bool BSteamBacked() { return false; }
+	virtual bool GetIdentity( SteamNetworkingIdentity *pIdentity );
+	virtual void SetListener( ISpaceWarTransportListener *pListener ) { m_pListener = pListener; }
+	virtual void RunCallbacks();
+
+	virtual HSteamListenSocket CreateListenSocket();
+	virtual bool CloseListenSocket( HSteamListenSocket hSocket );
+
+	virtual HSteamNetConnection Connect( const SteamNetworkingIdentity &identityRemote );
+	virtual EResult AcceptConnection( HSteamNetConnection hConn );
+	virtual bool CloseConnection( HSteamNetConnection hConn, int nReason, const char *pszDebug, bool bEnableLinger );
+	virtual bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo );
+	virtual EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus );
+
+	virtual HSteamNetPollGroup CreatePollGroup();
+	virtual bool DestroyPollGroup( HSteamNetPollGroup hPollGroup );
+	virtual bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup );
+
+	virtual EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber );
+	virtual int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+	virtual int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+
+private:
+	friend class CLoopbackNetwork;
+
+	CLoopbackNetwork *m_pNetwork;
+	SteamNetworkingIdentity m_identityLocal;
+	ISpaceWarTransportListener *m_pListener;
+
+	// Status changes waiting for RunCallbacks()
+	std::vector<SteamNetConnectionStatusChangedCallback_t> m_vecPendingStatus;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The shared state behind a set of loopback endpoints
+//-----------------------------------------------------------------------------
+class CLoopbackNetwork
+{
+public:
+	CLoopbackNetwork();
+	~CLoopbackNetwork();
+
+	// Clock used to stamp m_usecTimeReceived on delivered messages
+	static SteamNetworkingMicroseconds GetTimestamp();
+
+private:
+	friend class CLoopbackTransport;
+
+	struct Connection_t
+	{
+		CLoopbackTransport *m_pOwner;
+		HSteamNetConnection m_hPeer;			// the other end, invalid once it has been closed
+		HSteamListenSocket m_hListenSocket;		// set on the accepting end
+		HSteamNetPollGroup m_hPollGroup;
+		SteamNetworkingIdentity m_identityRemote;
+		ESteamNetworkingConnectionState m_eState;
+		int m_eEndReason;
+		char m_szEndDebug[ k_cchSteamNetworkingMaxConnectionCloseReason ];
+		int64 m_nNextMessageNumber;
+		std::deque<SteamNetworkingMessage_t *> m_queueMessages;	// only used while not in a poll group
+	};
+
+	struct PollGroup_t
+	{
+		CLoopbackTransport *m_pOwner;
+		std::deque<SteamNetworkingMessage_t *> m_queueMessages;
+	};
+
+	uint32 AllocHandle() { return m_unNextHandle++; }
+
+	Connection_t *FindConnection( CLoopbackTransport *pOwner, HSteamNetConnection hConn );
+	PollGroup_t *FindPollGroup( CLoopbackTransport *pOwner, HSteamNetPollGroup hPollGroup );
+
+	// Change state and queue the status callback on the owning endpoint
+	void SetConnectionState( HSteamNetConnection hConn, ESteamNetworkingConnectionState eState );
+	void FillConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo );
+	void FreeConnection( HSteamNetConnection hConn );
+	void DetachTransport( CLoopbackTransport *pTransport );
+
+	uint32 m_unNextHandle;
+	std::map<HSteamListenSocket, CLoopbackTransport *> m_mapListenSockets;
+	std::map<HSteamNetConnection, Connection_t> m_mapConnections;
+	std::map<HSteamNetPollGroup, PollGroup_t> m_mapPollGroups;
+};
+
+#endif // SPACEWARTRANSPORT_H
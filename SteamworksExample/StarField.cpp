@@ -15,31 +15,61 @@
 CStarField::CStarField( IGameEngine *pGameEngine )
 {
 	m_pGameEngine = pGameEngine;
+	m_hStarPoints = 0;
 
 	Init();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CStarField::~CStarField()
+{
+	if ( m_hStarPoints )
+		m_pGameEngine->ReleaseScrollingPoints( m_hStarPoints );
+}
+
 void CStarField::Init()
 {
-	StarVertex_t StarVertex;
+	ScrollingPointVertex_t StarVertex;
 	m_nWidth = m_pGameEngine->GetViewportWidth();
 	m_nHeight = m_pGameEngine->GetViewportHeight();
 
 	m_VecStars.clear();
+	if ( m_hStarPoints )
+	{
+		m_pGameEngine->ReleaseScrollingPoints( m_hStarPoints );
+		m_hStarPoints = 0;
+	}
+
+	// Keep the same density on bigger displays
+	int nStars = (int)( (int64)STARFIELD_STAR_COUNT * m_nWidth * m_nHeight / STARFIELD_REFERENCE_AREA );
+	nStars = MAX( nStars, STARFIELD_STAR_COUNT );
 	
 	// Generate star field data
-	for( int i=0; i < STARFIELD_STAR_COUNT; ++i )
+	for( int i=0; i < nStars; ++i )
 	{
 		int32 nRand = (rand()%(255-50))+50; //value between 50 and 255 for shades of gray
 		StarVertex.color = D3DCOLOR_ARGB( 255, nRand, nRand, nRand );
 		
 		StarVertex.x = (float)(rand()%m_nWidth);
 		StarVertex.y = (float)(rand()%m_nHeight);
+
+		// Brighter stars are closer so they move faster
+		StarVertex.speed = (float)nRand / (4.0f * 255.0f);
 		
 		m_VecStars.push_back( StarVertex );
 		
 		// bugbug jmccaskey - sometimes make "big stars" which are 4 points right next to each other?
 	}
+
+	// Upload once and let the engine animate them, if it can't we draw a random
+	// subset ourselves so the CPU cost doesn't grow with the window
+	m_hStarPoints = m_pGameEngine->HCreateScrollingPoints( &m_VecStars[0], (uint32)m_VecStars.size() );
+	if ( m_hStarPoints )
+		m_VecStars.clear();
+	else if ( m_VecStars.size() > STARFIELD_STAR_COUNT )
+		m_VecStars.resize( STARFIELD_STAR_COUNT );
 }
 
 //-----------------------------------------------------------------------------
@@ -54,12 +84,15 @@ void CStarField::Render()
 	
 	static int counter;	// per starfield draw..
 	counter++;
+
+	if ( m_hStarPoints && m_pGameEngine->BDrawScrollingPoints( m_hStarPoints, (float)counter, (float)m_nHeight ) )
+		return;
 	
 	for( size_t i = 0; i < m_VecStars.size(); ++i )
 	{
 		float x = m_VecStars[i].x;
 		float y = m_VecStars[i].y;
-		float scoot = (float)counter * (float)(m_VecStars[i].color & 0xFF) / (4.0f * 255.0f);
+		float scoot = (float)counter * m_VecStars[i].speed;
 		float newy = y - scoot;					// make things float up
 		while( newy < 0.0f ) newy += m_nHeight;	// keep it on screen
 		
@@ -67,4 +100,4 @@ void CStarField::Render()
 	}
 
 	m_pGameEngine->BFlushPointBuffer();
-}
\ No newline at end of file
+}
@@ -11,13 +11,10 @@
 #include <vector>
 #include "GameEngine.h"
 
+// Stars at the default 1024x768 window size.  When the engine can scroll them on the GPU
+// the count scales up with the viewport area, otherwise it stays at this.
 #define STARFIELD_STAR_COUNT 600
-
-struct StarVertex_t
-{
-	float x, y;
-	DWORD color;
-};
+#define STARFIELD_REFERENCE_AREA ( 1024 * 768 )
 
 class CStarField
 {
@@ -25,6 +22,9 @@ public:
 	// Constructor
 	CStarField( IGameEngine *pGameEngine );
 
+	// Destructor
+	~CStarField();
+
 	// Render the star field
 	void Render();
 
@@ -39,8 +39,11 @@ private:
 	// Game engine instance we are running under
 	IGameEngine *m_pGameEngine;
 
-	// Vector for starfield data
-	std::vector<StarVertex_t> m_VecStars;
+	// Vector for starfield data, only kept for drawing on the CPU if the engine can't do it
+	std::vector<ScrollingPointVertex_t> m_VecStars;
+
+	// The stars uploaded to the engine, 0 if we're drawing them ourselves
+	HGAMEVERTBUF m_hStarPoints;
 };
 
 #endif // STARFIELD_H
\ No newline at end of file
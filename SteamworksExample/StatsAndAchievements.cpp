@@ -18,7 +18,7 @@
 #define ACHDISP_IMG_SIZE 64
 #define ACHDISP_IMG_PAD 10
 
-#define _ACH_ID( id, name ) { id, #id, name, "", 0, 0 }
+#define _ACH_ID( id, name ) { id, #id, name, "", 0, 0, false }
 
 Achievement_t g_rgAchievements[] = 
 {
@@ -49,7 +49,14 @@ CStatsAndAchievements::CStatsAndAchievements( IGameEngine *pGameEngine )
 	m_pSteamUserStats = SteamUserStats();
 
 	m_bStatsValid = false;
+	m_unDirtyStats = 0;
+	m_bAchievementsDirty = false;
 	m_bStoreStats = false;
+	m_ulStoreStatsTick = 0;
+	m_unStoreCoalesceMilliseconds = STATS_STORE_COALESCE_MS;
+	m_unStoreRetryMilliseconds = STATS_STORE_RETRY_MIN_MS;
+	m_flPendingAvgSpeedFeet = 0;
+	m_flPendingAvgSpeedSeconds = 0;
 
 	m_flGameFeetTraveled = 0;
 
@@ -108,7 +115,6 @@ void CStatsAndAchievements::OnGameStateChange( EClientGameState eNewState )
 	case k_EClientGameStartServer:
 	case k_EClientGameMenu:
 	case k_EClientGameQuitMenu:
-	case k_EClientGameExiting:
 	case k_EClientGameInstructions:
 	case k_EClientGameConnecting:
 	case k_EClientGameConnectionFailure:
@@ -119,13 +125,23 @@ void CStatsAndAchievements::OnGameStateChange( EClientGameState eNewState )
 		m_flGameFeetTraveled = 0;
 		m_ulTickCountGameStart = m_pGameEngine->GetGameTickCount();
 		break;
+	case k_EClientGameExiting:
+		// Don't leave anything waiting on the coalesce window
+		StoreStatsIfNecessary( true );
+		break;
 	case k_EClientFindInternetServers:
 		break;	
 	case k_EClientGameWinner:
 		if ( SpaceWarClient()->BLocalPlayerWonLastGame() )
+		{
 			m_nTotalNumWins++;
+			MarkStatsDirty( k_EStatNumWins );
+		}
 		else
+		{
 			m_nTotalNumLosses++;
+			MarkStatsDirty( k_EStatNumLosses );
+		}
 		// fall through
 	case k_EClientGameDraw:
 
@@ -137,13 +153,19 @@ void CStatsAndAchievements::OnGameStateChange( EClientGameState eNewState )
 
 		// New max?
 		if ( m_flGameFeetTraveled > m_flMaxFeetTraveled )
+		{
 			m_flMaxFeetTraveled = m_flGameFeetTraveled;
+			MarkStatsDirty( k_EStatMaxFeetTraveled );
+		}
 
 		// Calc game duration
 		m_flGameDurationSeconds = ( m_pGameEngine->GetGameTickCount() - m_ulTickCountGameStart ) / 1000.0;
 
-		// We want to update stats the next frame.
-		m_bStoreStats = true;
+		// Average speed is fed per game, hold on to this one until the next store
+		m_flPendingAvgSpeedFeet += m_flGameFeetTraveled;
+		m_flPendingAvgSpeedSeconds += m_flGameDurationSeconds;
+
+		MarkStatsDirty( k_EStatNumGames | k_EStatFeetTraveled | k_EStatAverageSpeed );
 
 		break;
 	}
@@ -201,40 +223,100 @@ void CStatsAndAchievements::UnlockAchievement( Achievement_t &achievement )
 	// the icon may change once it's unlocked
 	achievement.m_iIconImage = 0;
 
-	// mark it down
-	m_pSteamUserStats->SetAchievement( achievement.m_pchAchievementID );
+	// mark it down, it's sent along with the next stats store
+	achievement.m_bUnlockPending = true;
+	m_bAchievementsDirty = true;
+	MarkStatsDirty( 0 );
+}
 
-	// Store stats end of frame
-	m_bStoreStats = true;
+//-----------------------------------------------------------------------------
+// Purpose: Note that stats changed, they get stored once the coalesce window
+// has passed so a burst of changes goes out as one StoreStats()
+//-----------------------------------------------------------------------------
+void CStatsAndAchievements::MarkStatsDirty( uint32 unStatFlags )
+{
+	m_unDirtyStats |= unStatFlags;
+
+	// Start the window with the first change, later changes ride along
+	if ( !m_bStoreStats )
+	{
+		m_bStoreStats = true;
+		m_ulStoreStatsTick = m_pGameEngine->GetGameTickCount() + m_unStoreCoalesceMilliseconds;
+	}
 }
 
 //-----------------------------------------------------------------------------
 // Purpose: Store stats in the Steam database
 //-----------------------------------------------------------------------------
-void CStatsAndAchievements::StoreStatsIfNecessary()
+void CStatsAndAchievements::StoreStatsIfNecessary( bool bForce )
 {
-	if ( m_bStoreStats )
+	if ( !m_bStoreStats || !m_pSteamUserStats )
+		return;
+
+	if ( !bForce && m_pGameEngine->GetGameTickCount() < m_ulStoreStatsTick )
+		return;
+
+	// Push changes into the local stats cache, these stay set even if the store below
+	// fails so a retry only has to store again
+	if ( m_bAchievementsDirty )
 	{
-		// already set any achievements in UnlockAchievement
+		for ( int iAch = 0; iAch < ARRAYSIZE( g_rgAchievements ); ++iAch )
+		{
+			Achievement_t &ach = g_rgAchievements[iAch];
+			if ( ach.m_bUnlockPending )
+			{
+				m_pSteamUserStats->SetAchievement( ach.m_pchAchievementID );
+				ach.m_bUnlockPending = false;
+			}
+		}
+		m_bAchievementsDirty = false;
+	}
 
-		// set stats
+	if ( m_unDirtyStats & k_EStatNumGames )
 		m_pSteamUserStats->SetStat( "NumGames", m_nTotalGamesPlayed );
+	if ( m_unDirtyStats & k_EStatNumWins )
 		m_pSteamUserStats->SetStat( "NumWins", m_nTotalNumWins );
+	if ( m_unDirtyStats & k_EStatNumLosses )
 		m_pSteamUserStats->SetStat( "NumLosses", m_nTotalNumLosses );
+	if ( m_unDirtyStats & k_EStatFeetTraveled )
 		m_pSteamUserStats->SetStat( "FeetTraveled", m_flTotalFeetTraveled );
+	if ( m_unDirtyStats & k_EStatMaxFeetTraveled )
 		m_pSteamUserStats->SetStat( "MaxFeetTraveled", m_flMaxFeetTraveled );
-		// Update average feet / second stat
-		m_pSteamUserStats->UpdateAvgRateStat( "AverageSpeed", m_flGameFeetTraveled, m_flGameDurationSeconds );
+	if ( ( m_unDirtyStats & k_EStatAverageSpeed ) && m_flPendingAvgSpeedSeconds > 0 )
+	{
+		// Update average feet / second stat with every game since the last store
+		m_pSteamUserStats->UpdateAvgRateStat( "AverageSpeed", m_flPendingAvgSpeedFeet, m_flPendingAvgSpeedSeconds );
 		// The averaged result is calculated for us
 		m_pSteamUserStats->GetStat( "AverageSpeed", &m_flAverageSpeed );
+	}
+	m_flPendingAvgSpeedFeet = 0;
+	m_flPendingAvgSpeedSeconds = 0;
+	m_unDirtyStats = 0;
 
-		bool bSuccess = m_pSteamUserStats->StoreStats();
-		// If this failed, we never sent anything to the server, try
-		// again later.
-		m_bStoreStats = !bSuccess;
+	bool bSuccess = m_pSteamUserStats->StoreStats();
+	if ( bSuccess )
+	{
+		// Stays set until OnUserStatsStored tells us how it went
+		m_bStoreStats = false;
+	}
+	else
+	{
+		// We never sent anything to the server, try again later
+		ScheduleStoreRetry();
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: A store failed, try it again after backing off
+//-----------------------------------------------------------------------------
+void CStatsAndAchievements::ScheduleStoreRetry()
+{
+	m_bStoreStats = true;
+	m_ulStoreStatsTick = m_pGameEngine->GetGameTickCount() + m_unStoreRetryMilliseconds;
+
+	m_unStoreRetryMilliseconds = MIN( m_unStoreRetryMilliseconds * 2, STATS_STORE_RETRY_MAX_MS );
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: We have stats data from Steam. It is authoritative, so update
@@ -277,6 +359,7 @@ void CStatsAndAchievements::OnUserStatsStored( UserStatsStored_t *pCallback )
 		if ( k_EResultOK == pCallback->m_eResult )
 		{
 			OutputDebugString( "StoreStats - success\n" );
+			m_unStoreRetryMilliseconds = STATS_STORE_RETRY_MIN_MS;
 		}
 		else if ( k_EResultInvalidParam == pCallback->m_eResult )
 		{
@@ -291,6 +374,9 @@ void CStatsAndAchievements::OnUserStatsStored( UserStatsStored_t *pCallback )
 			sprintf_safe( buffer, "StoreStats - failed, %d\n", pCallback->m_eResult );
 			buffer[ sizeof(buffer) - 1 ] = 0;
 			OutputDebugString( buffer );
+
+			// The values are still set locally, they just need storing again
+			ScheduleStoreRetry();
 		}
 	}
 }
@@ -418,14 +504,14 @@ void CStatsAndAchievements::Render()
 
 		m_pGameEngine->BDrawString( m_hDisplayFont, rect, D3DCOLOR_ARGB( 255, 25, 200, 25 ), TEXTPOS_LEFT|TEXTPOS_VCENTER, "Inventory" );
 
-		std::list<CSpaceWarItem *>::const_iterator iter;
-		for ( iter = SpaceWarLocalInventory()->GetItemList().begin(); iter != SpaceWarLocalInventory()->GetItemList().end(); ++iter )
+		const std::vector<CSpaceWarItem> &vecItems = SpaceWarLocalInventory()->GetItemList();
+		for ( size_t i = 0; i < vecItems.size(); ++i )
 		{
 			rect.top = pxVertOffset;
 			rect.bottom = rect.top + ACHDISP_FONT_HEIGHT;
 			pxVertOffset = rect.bottom + ACHDISP_VERT_SPACING;
 
-			DrawInventory( rect, ( *iter )->GetItemId() );
+			DrawInventory( rect, vecItems[i].GetItemId() );
 		}
 
 
@@ -29,8 +29,29 @@ struct Achievement_t
 	char m_rgchDescription[256];
 	bool m_bAchieved;
 	int m_iIconImage;
+
+	// Unlocked locally, goes to Steam with the next stats flush
+	bool m_bUnlockPending;
+};
+
+// Stats we persist, as bits so we can track which ones need writing
+enum EStatFlags
+{
+	k_EStatNumGames = 1 << 0,
+	k_EStatNumWins = 1 << 1,
+	k_EStatNumLosses = 1 << 2,
+	k_EStatFeetTraveled = 1 << 3,
+	k_EStatMaxFeetTraveled = 1 << 4,
+	k_EStatAverageSpeed = 1 << 5,
 };
 
+// Changes are held this long so everything that changes together goes in one StoreStats()
+#define STATS_STORE_COALESCE_MS 2000
+
+// Retry delay after a failed store, doubles each time up to the max
+#define STATS_STORE_RETRY_MIN_MS 1000
+#define STATS_STORE_RETRY_MAX_MS 60000
+
 class ISteamUser;
 class CSpaceWarClient;
 
@@ -56,6 +77,9 @@ public:
 	float GetGameFeetTraveled() { return m_flGameFeetTraveled; }
 	double GetGameDurationSeconds() { return m_flGameDurationSeconds; }
 
+	// How long changed stats are held before being stored, 0 stores on the next frame
+	void SetStoreStatsCoalesceWindow( uint32 unMilliseconds ) { m_unStoreCoalesceMilliseconds = unMilliseconds; }
+
 	STEAM_CALLBACK( CStatsAndAchievements, OnUserStatsStored, UserStatsStored_t, m_CallbackUserStatsStored );
 	STEAM_CALLBACK( CStatsAndAchievements, OnAchievementStored, UserAchievementStored_t, m_CallbackAchievementStored );
 	
@@ -68,7 +92,9 @@ private:
 	void UnlockAchievement( Achievement_t &achievement );
 
 	// Store stats
-	void StoreStatsIfNecessary();
+	void MarkStatsDirty( uint32 unStatFlags );
+	void StoreStatsIfNecessary( bool bForce = false );
+	void ScheduleStoreRetry();
 
 	// Render helpers
 	void DrawAchievementInfo( RECT &rect, Achievement_t &ach );
@@ -93,9 +119,24 @@ private:
 	// Did we get the stats from Steam?
 	bool m_bStatsValid;
 
-	// Should we store stats this frame?
+	// EStatFlags that have changed since we last pushed them with SetStat
+	uint32 m_unDirtyStats;
+
+	// Achievement unlocks waiting for the flush
+	bool m_bAchievementsDirty;
+
+	// Something has been set locally but not yet successfully stored
 	bool m_bStoreStats;
 
+	// When the pending changes get stored, and the backoff for failed stores
+	uint64 m_ulStoreStatsTick;
+	uint32 m_unStoreCoalesceMilliseconds;
+	uint32 m_unStoreRetryMilliseconds;
+
+	// Average speed samples from games that haven't been pushed yet
+	float m_flPendingAvgSpeedFeet;
+	double m_flPendingAvgSpeedSeconds;
+
 	// Current Stat details
 	float m_flGameFeetTraveled;
 	uint64 m_ulTickCountGameStart;
@@ -31,6 +31,9 @@ CVectorEntity::CVectorEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius
 	m_flYVelocity = 0.0;
 	m_bDisableCollisions = false;
 	m_flRotationDeltaLastFrame = 0.0;
+	m_flRotationCached = 0.0;
+	m_flSinRotation = 0.0;
+	m_flCosRotation = 1.0;
 
 	// we should have at least one frame Run before
 	// anyone asks for a delta, so this shouldn't cause
@@ -74,6 +77,15 @@ void CVectorEntity::ClearVertexes()
 	m_VecVertexes.clear();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Replace our geometry in one go
+//-----------------------------------------------------------------------------
+void CVectorEntity::SetVertexes( std::vector< VectorEntityVertex_t > &vecVertexes )
+{
+	m_VecVertexes.swap( vecVertexes );
+	vecVertexes.clear();
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Set the current position for the object
 //-----------------------------------------------------------------------------
@@ -174,52 +186,7 @@ void CVectorEntity::RunFrame()
 //-----------------------------------------------------------------------------
 void CVectorEntity::Render()
 {
-	// Compute values which will be used for rotation below
-	float flSinRotation = (float)sin(m_flAccumulatedRotation);
-	float flCosRotation = (float)cos(m_flAccumulatedRotation);
-
-	if ( m_VecVertexes.size() < 2 )
-		return;
-
-	// Iterate our vector of vertexes 2 at a time drawing lines
-	for( size_t i=0; i < m_VecVertexes.size() - 1; ++i )
-	{
-		DWORD dwColor0, dwColor1;
-		float xPos0, yPos0, xPos1, yPos1;
-		float xPrime0, yPrime0, xPrime1, yPrime1;
-
-		// Grab the first point and apply rotation and translation
-		xPos0 = m_VecVertexes[i].x;
-		yPos0 = m_VecVertexes[i].y;
-		dwColor0 = m_VecVertexes[i].color;
-
-		// Apply any needed rotation
-		xPrime0 = flCosRotation*xPos0 - flSinRotation*yPos0;
-		yPrime0 = flSinRotation*xPos0 + flCosRotation*yPos0;
-
-		// Apply translation to current position
-		xPrime0 += m_flXPos;
-		yPrime0 += m_flYPos;
-
-		// Next vertex, we use 2 per iteration
-		++i;
-
-		// Grab the second point and apply rotation and translation
-		xPos1 = m_VecVertexes[i].x;
-		yPos1 = m_VecVertexes[i].y;
-		dwColor1 = m_VecVertexes[i].color;
-
-		// Apply any needed rotation
-		xPrime1 = flCosRotation*xPos1 - flSinRotation*yPos1;
-		yPrime1 = flSinRotation*xPos1 + flCosRotation*yPos1;
-
-		// Apply translation to current position
-		xPrime1 += m_flXPos;
-		yPrime1 += m_flYPos;
-
-		// Have the game engine draw the actual line (it batches these operations)
-		m_pGameEngine->BDrawLine( xPrime0, yPrime0, dwColor0, xPrime1, yPrime1, dwColor1 );
-	}
+	RenderLines( NULL );
 }
 
 //-----------------------------------------------------------------------------
@@ -227,49 +194,28 @@ void CVectorEntity::Render()
 //-----------------------------------------------------------------------------
 void CVectorEntity::Render(DWORD overrideColor)
 {
-	// Compute values which will be used for rotation below
-	float flSinRotation = (float)sin(m_flAccumulatedRotation);
-	float flCosRotation = (float)cos(m_flAccumulatedRotation);
-
-	// Iterate our vector of vertexes 2 at a time drawing lines
-	for( size_t i=0; i < m_VecVertexes.size() - 1; ++i )
-	{
-		DWORD dwColor0, dwColor1;
-		float xPos0, yPos0, xPos1, yPos1;
-		float xPrime0, yPrime0, xPrime1, yPrime1;
-
-		// Grab the first point and apply rotation and translation
-		xPos0 = m_VecVertexes[i].x;
-		yPos0 = m_VecVertexes[i].y;
-		dwColor0 = overrideColor;
-
-		// Apply any needed rotation
-		xPrime0 = flCosRotation*xPos0 - flSinRotation*yPos0;
-		yPrime0 = flSinRotation*xPos0 + flCosRotation*yPos0;
-
-		// Apply translation to current position
-		xPrime0 += m_flXPos;
-		yPrime0 += m_flYPos;
-
-		// Next vertex, we use 2 per iteration
-		++i;
-
-		// Grab the second point and apply rotation and translation
-		xPos1 = m_VecVertexes[i].x;
-		yPos1 = m_VecVertexes[i].y;
-		dwColor1 = overrideColor;
-
-		// Apply any needed rotation
-		xPrime1 = flCosRotation*xPos1 - flSinRotation*yPos1;
-		yPrime1 = flSinRotation*xPos1 + flCosRotation*yPos1;
+	RenderLines( &overrideColor );
+}
 
-		// Apply translation to current position
-		xPrime1 += m_flXPos;
-		yPrime1 += m_flYPos;
+//-----------------------------------------------------------------------------
+// Purpose: Hand all our lines to the game engine in one go, it applies the rotation
+// and translation as it copies them into its line buffer
+//-----------------------------------------------------------------------------
+void CVectorEntity::RenderLines( const DWORD *pdwOverrideColor )
+{
+	if ( m_VecVertexes.size() < 2 )
+		return;
 
-		// Have the game engine draw the actual line (it batches these operations)
-		m_pGameEngine->BDrawLine( xPrime0, yPrime0, dwColor0, xPrime1, yPrime1, dwColor1 );
+	// Most entities don't rotate most frames, so only redo the trig when we have
+	if ( m_flAccumulatedRotation != m_flRotationCached )
+	{
+		m_flRotationCached = m_flAccumulatedRotation;
+		m_flSinRotation = (float)sin(m_flAccumulatedRotation);
+		m_flCosRotation = (float)cos(m_flAccumulatedRotation);
 	}
+
+	m_pGameEngine->BDrawTransformedLines( &m_VecVertexes[0], (uint32)m_VecVertexes.size(), m_flSinRotation, m_flCosRotation,
+		m_flXPos, m_flYPos, pdwOverrideColor );
 }
 
 //-----------------------------------------------------------------------------
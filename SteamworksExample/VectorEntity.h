@@ -12,12 +12,6 @@
 #include "GameEngine.h"
 #include <vector>
 
-struct VectorEntityVertex_t
-{
-	float x, y;
-	DWORD color;
-};
-
 #define DEFAULT_MAXIMUM_VELOCITY 450.0f
 
 #define PI_VALUE 3.14159265f
@@ -77,6 +71,10 @@ public:
 	// Clear all lines in the entity
 	void ClearVertexes();
 
+	// Replace all lines in the entity with a block of vertexes (two per line), takes the
+	// contents of vecVertexes rather than copying them
+	void SetVertexes( std::vector< VectorEntityVertex_t > &vecVertexes );
+
 	// Set the objects current position
 	void SetPosition(float xPos, float yPos);
 
@@ -113,9 +111,17 @@ protected:
 	IGameEngine *m_pGameEngine;
 
 private:
+	// Draw our lines rotated and translated to our current position, optionally all in one color
+	void RenderLines( const DWORD *pdwOverrideColor );
+
 	// Vector of points (always built 2 at a time so it's actually lines)
 	std::vector< VectorEntityVertex_t > m_VecVertexes;
 
+	// sin/cos of m_flRotationCached, only recomputed when the accumulated rotation changes
+	float m_flRotationCached;
+	float m_flSinRotation;
+	float m_flCosRotation;
+
 	// Previous position
 	float m_flXPosLastFrame;
 	float m_flYPosLastFrame;
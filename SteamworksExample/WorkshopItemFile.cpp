@@ -0,0 +1,368 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Workshop item vector art files
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "WorkshopItemFile.h"
+#include "SpaceWar.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CMappedFile::CMappedFile()
+{
+	m_pubData = NULL;
+	m_cubData = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Map the whole file read only
+//-----------------------------------------------------------------------------
+bool CMappedFile::BOpen( const char *pchFileName )
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA( pchFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( m_hFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER liSize;
+	if ( !GetFileSizeEx( m_hFile, &liSize ) || liSize.QuadPart == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( !m_hMapping )
+	{
+		Close();
+		return false;
+	}
+
+	m_pubData = (const uint8 *)MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( !m_pubData )
+	{
+		Close();
+		return false;
+	}
+	m_cubData = liSize.QuadPart;
+#else
+	int fd = open( pchFileName, O_RDONLY );
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size == 0 )
+	{
+		close( fd );
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file
+	void *pData = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( pData == MAP_FAILED )
+		return false;
+
+	m_pubData = (const uint8 *)pData;
+	m_cubData = st.st_size;
+#endif
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unmap
+//-----------------------------------------------------------------------------
+void CMappedFile::Close()
+{
+#ifdef _WIN32
+	if ( m_pubData )
+		UnmapViewOfFile( m_pubData );
+	if ( m_hMapping )
+		CloseHandle( m_hMapping );
+	if ( m_hFile != INVALID_HANDLE_VALUE )
+		CloseHandle( m_hFile );
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#else
+	if ( m_pubData )
+		munmap( (void *)m_pubData, m_cubData );
+#endif
+	m_pubData = NULL;
+	m_cubData = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Check a mapped file is a complete binary workshop item
+//-----------------------------------------------------------------------------
+const WorkshopItemFileHeader_t *GetWorkshopItemBinaryHeader( CMappedFile &file )
+{
+	if ( file.GetSize() < sizeof( WorkshopItemFileHeader_t ) )
+		return NULL;
+
+	const WorkshopItemFileHeader_t *pHeader = (const WorkshopItemFileHeader_t *)file.GetData();
+	if ( LittleDWord( pHeader->m_unMagic ) != WORKSHOP_ITEM_BINARY_MAGIC ||
+		LittleDWord( pHeader->m_unVersion ) != WORKSHOP_ITEM_BINARY_VERSION ||
+		LittleDWord( pHeader->m_cubVertex ) != sizeof( VectorEntityVertex_t ) )
+		return NULL;
+
+	uint32 unVertexCount = LittleDWord( pHeader->m_unVertexCount );
+	if ( unVertexCount > WORKSHOP_ITEM_MAX_VERTEXES || ( unVertexCount & 1 ) ||
+		file.GetSize() < sizeof( WorkshopItemFileHeader_t ) + (uint64)unVertexCount * sizeof( VectorEntityVertex_t ) )
+		return NULL;
+
+	return pHeader;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Parse the text format
+//-----------------------------------------------------------------------------
+bool BReadWorkshopItemText( const char *pchFileName, WorkshopItemFileHeader_t *pHeader, std::vector< VectorEntityVertex_t > &vecVertexes )
+{
+	FILE *file = fopen( pchFileName, "rt" );
+	if ( !file )
+		return false;
+
+	bool bSuccess = false;
+	char szLine[1024];
+
+	vecVertexes.clear();
+	memset( pHeader, 0, sizeof( *pHeader ) );
+
+	if ( fgets( szLine, sizeof( szLine ), file ) )
+	{
+		// initialize object
+		if ( sscanf( szLine, "%f %f %f %f", &pHeader->m_flXPos, &pHeader->m_flYPos, &pHeader->m_flXVelocity, &pHeader->m_flYVelocity ) )
+		{
+			bSuccess = true;
+
+			while ( !feof( file ) )
+			{
+				VectorEntityVertex_t vert0, vert1;
+				if ( fgets( szLine, sizeof( szLine ), file ) &&
+					sscanf( szLine, "%f %f %f %f %x", &vert0.x, &vert0.y, &vert1.x, &vert1.y, &vert0.color ) >= 5 )
+				{
+					vert1.color = vert0.color;
+					vecVertexes.push_back( vert0 );
+					vecVertexes.push_back( vert1 );
+				}
+			}
+		}
+	}
+
+	fclose( file );
+
+	pHeader->m_unVertexCount = (uint32)vecVertexes.size();
+	return bSuccess;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Load either format
+//-----------------------------------------------------------------------------
+bool BLoadWorkshopItemFile( const char *pchFileName, WorkshopItemFileHeader_t *pHeader, std::vector< VectorEntityVertex_t > &vecVertexes )
+{
+	CMappedFile file;
+	if ( !file.BOpen( pchFileName ) )
+		return false;
+
+	// Binary items are a straight copy out of the mapping
+	const WorkshopItemFileHeader_t *pFileHeader = GetWorkshopItemBinaryHeader( file );
+	if ( pFileHeader )
+	{
+		*pHeader = *pFileHeader;
+		pHeader->m_unVertexCount = LittleDWord( pFileHeader->m_unVertexCount );
+
+		const VectorEntityVertex_t *pVertexes = (const VectorEntityVertex_t *)( pFileHeader + 1 );
+		vecVertexes.assign( pVertexes, pVertexes + pHeader->m_unVertexCount );
+		return true;
+	}
+	file.Close();
+
+	// Otherwise it should be the text format
+	return BReadWorkshopItemText( pchFileName, pHeader, vecVertexes );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Convert a text item to the binary format
+//-----------------------------------------------------------------------------
+bool BConvertWorkshopItemToBinary( const char *pchTextFileName, const char *pchBinaryFileName )
+{
+	WorkshopItemFileHeader_t header;
+	std::vector< VectorEntityVertex_t > vecVertexes;
+	if ( !BReadWorkshopItemText( pchTextFileName, &header, vecVertexes ) )
+		return false;
+
+	if ( vecVertexes.size() > WORKSHOP_ITEM_MAX_VERTEXES )
+		return false;
+
+	header.m_unMagic = LittleDWord( WORKSHOP_ITEM_BINARY_MAGIC );
+	header.m_unVersion = LittleDWord( WORKSHOP_ITEM_BINARY_VERSION );
+	header.m_cubVertex = LittleDWord( (uint32)sizeof( VectorEntityVertex_t ) );
+	header.m_unVertexCount = LittleDWord( header.m_unVertexCount );
+
+	// Write to a temp file and rename so a reader never maps half a file
+	char szTempFileName[1024];
+	sprintf_safe( szTempFileName, "%s.tmp", pchBinaryFileName );
+
+	FILE *file = fopen( szTempFileName, "wb" );
+	if ( !file )
+		return false;
+
+	bool bSuccess = fwrite( &header, sizeof( header ), 1, file ) == 1;
+	if ( bSuccess && !vecVertexes.empty() )
+		bSuccess = fwrite( &vecVertexes[0], sizeof( VectorEntityVertex_t ), vecVertexes.size(), file ) == vecVertexes.size();
+	if ( fclose( file ) != 0 )
+		bSuccess = false;
+
+	// rename() won't replace an existing file on Windows
+#ifdef _WIN32
+	if ( bSuccess )
+		remove( pchBinaryFileName );
+#endif
+	if ( !bSuccess || rename( szTempFileName, pchBinaryFileName ) != 0 )
+	{
+		remove( szTempFileName );
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CWorkshopItemLoader::CWorkshopItemLoader()
+{
+	m_unGeneration = 0;
+	m_bQuit = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor, waits for the current file to finish
+//-----------------------------------------------------------------------------
+CWorkshopItemLoader::~CWorkshopItemLoader()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_Mutex );
+		m_bQuit = true;
+	}
+	m_WakeUp.notify_one();
+
+	if ( m_Thread.joinable() )
+		m_Thread.join();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Queue a file to be loaded
+//-----------------------------------------------------------------------------
+void CWorkshopItemLoader::QueueLoad( PublishedFileId_t nPublishedFileId, const char *pchFileName, const char *pchFallbackFileName )
+{
+	WorkshopItemLoad_t load;
+	load.m_nPublishedFileId = nPublishedFileId;
+	load.m_sFileName = pchFileName;
+	if ( pchFallbackFileName )
+		load.m_sFallbackFileName = pchFallbackFileName;
+	load.m_bSuccess = false;
+	memset( &load.m_Header, 0, sizeof( load.m_Header ) );
+
+	{
+		std::lock_guard< std::mutex > lock( m_Mutex );
+		load.m_unGeneration = m_unGeneration;
+		m_dequePending.push_back( std::move( load ) );
+
+		if ( !m_Thread.joinable() )
+			m_Thread = std::thread( &CWorkshopItemLoader::ThreadFunc, this );
+	}
+	m_WakeUp.notify_one();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Drop everything not yet collected
+//-----------------------------------------------------------------------------
+void CWorkshopItemLoader::CancelAll()
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	++m_unGeneration;
+	m_dequePending.clear();
+	m_dequeCompleted.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Collect one finished load
+//-----------------------------------------------------------------------------
+bool CWorkshopItemLoader::BGetCompletedLoad( WorkshopItemLoad_t *pLoad )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	if ( m_dequeCompleted.empty() )
+		return false;
+
+	*pLoad = std::move( m_dequeCompleted.front() );
+	m_dequeCompleted.pop_front();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Loader thread, works through the pending queue
+//-----------------------------------------------------------------------------
+void CWorkshopItemLoader::ThreadFunc()
+{
+	std::unique_lock< std::mutex > lock( m_Mutex );
+	for ( ;; )
+	{
+		m_WakeUp.wait( lock, [this] { return m_bQuit || !m_dequePending.empty(); } );
+		if ( m_bQuit )
+			return;
+
+		WorkshopItemLoad_t load = std::move( m_dequePending.front() );
+		m_dequePending.pop_front();
+
+		// Don't hold the lock over the disk access
+		lock.unlock();
+
+		load.m_bSuccess = BLoadWorkshopItemFile( load.m_sFileName.c_str(), &load.m_Header, load.m_vecVertexes );
+		if ( !load.m_bSuccess && !load.m_sFallbackFileName.empty() )
+			load.m_bSuccess = BLoadWorkshopItemFile( load.m_sFallbackFileName.c_str(), &load.m_Header, load.m_vecVertexes );
+
+		lock.lock();
+		if ( load.m_unGeneration == m_unGeneration )
+			m_dequeCompleted.push_back( std::move( load ) );
+	}
+}
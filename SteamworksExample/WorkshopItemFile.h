@@ -0,0 +1,148 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Workshop item vector art files.
+//
+//	workshopitem.txt is the authoring format: a "xpos ypos xvel yvel" line
+//	followed by one "x0 y0 x1 y1 color" line per segment.  workshopitem.bin holds
+//	the same thing as a fixed header followed by the vertexes exactly as
+//	CVectorEntity stores them, so loading is a map and a single copy instead of
+//	a sscanf per line.  Binary files are little endian like everything else we
+//	write to disk.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef WORKSHOPITEMFILE_H
+#define WORKSHOPITEMFILE_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "VectorEntity.h"
+
+#define WORKSHOP_ITEM_BINARY_MAGIC 0x41565753 // 'SWVA'
+#define WORKSHOP_ITEM_BINARY_VERSION 1
+
+// Sanity limit so a corrupt count can't have us allocate the world
+#define WORKSHOP_ITEM_MAX_VERTEXES ( 1024 * 1024 )
+
+#pragma pack( push, 1 )
+struct WorkshopItemFileHeader_t
+{
+	uint32 m_unMagic;
+	uint32 m_unVersion;
+
+	// Size of a vertex when written, so a layout change can't be misread
+	uint32 m_cubVertex;
+
+	// Number of VectorEntityVertex_t following the header, two per line
+	uint32 m_unVertexCount;
+
+	float m_flXPos;
+	float m_flYPos;
+	float m_flXVelocity;
+	float m_flYVelocity;
+};
+#pragma pack( pop )
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read only view of a whole file, memory mapped where we can
+//-----------------------------------------------------------------------------
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	bool BOpen( const char *pchFileName );
+	void Close();
+
+	const uint8 *GetData() { return m_pubData; }
+	uint64 GetSize() { return m_cubData; }
+
+private:
+	const uint8 *m_pubData;
+	uint64 m_cubData;
+
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#endif
+};
+
+
+// Returns the header if the mapped file is a valid binary workshop item, vertexes follow it
+const WorkshopItemFileHeader_t *GetWorkshopItemBinaryHeader( CMappedFile &file );
+
+// Parse the text format, fills in everything in the header but magic/version/size
+bool BReadWorkshopItemText( const char *pchFileName, WorkshopItemFileHeader_t *pHeader, std::vector< VectorEntityVertex_t > &vecVertexes );
+
+// Load either format, binary files through a mapping
+bool BLoadWorkshopItemFile( const char *pchFileName, WorkshopItemFileHeader_t *pHeader, std::vector< VectorEntityVertex_t > &vecVertexes );
+
+// Convert a text item to the binary format
+bool BConvertWorkshopItemToBinary( const char *pchTextFileName, const char *pchBinaryFileName );
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One item going through CWorkshopItemLoader
+//-----------------------------------------------------------------------------
+struct WorkshopItemLoad_t
+{
+	PublishedFileId_t m_nPublishedFileId;
+
+	// Tried in order, the fallback may be empty
+	std::string m_sFileName;
+	std::string m_sFallbackFileName;
+
+	// Filled in by the loader
+	bool m_bSuccess;
+	WorkshopItemFileHeader_t m_Header;
+	std::vector< VectorEntityVertex_t > m_vecVertexes;
+
+	// CWorkshopItemLoader generation this was queued in
+	uint32 m_unGeneration;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads and parses workshop item files on a background thread so
+// the frame never waits on disk.  Loads finish in the order they were queued,
+// the thread is started on the first QueueLoad().
+//-----------------------------------------------------------------------------
+class CWorkshopItemLoader
+{
+public:
+	CWorkshopItemLoader();
+	~CWorkshopItemLoader();
+
+	// Queue a file to be loaded, pchFallbackFileName is tried if the first one doesn't load
+	void QueueLoad( PublishedFileId_t nPublishedFileId, const char *pchFileName, const char *pchFallbackFileName = NULL );
+
+	// Drop everything queued, in flight or finished but not yet collected
+	void CancelAll();
+
+	// Collect one finished load (successful or not), returns false when there are none
+	bool BGetCompletedLoad( WorkshopItemLoad_t *pLoad );
+
+private:
+	void ThreadFunc();
+
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+
+	// Both protected by m_Mutex
+	std::deque< WorkshopItemLoad_t > m_dequePending;
+	std::deque< WorkshopItemLoad_t > m_dequeCompleted;
+
+	// Bumped by CancelAll() so loads already in flight get thrown away
+	uint32 m_unGeneration;
+	bool m_bQuit;
+};
+
+#endif // WORKSHOPITEMFILE_H
@@ -105,6 +105,14 @@
 //ConVar	gl_bufmode( "gl_bufmode", "1" );
 int gl_bufmode = 1;
 
+	// gl_buffer_ring: non zero means dynamic vertex/index/pixel buffers use a persistently mapped ring
+	// when the renderer has ARB_buffer_storage + ARB_sync.  gl_buffer_ring_windows is the depth of that ring.
+
+//ConVar	gl_buffer_ring( "gl_buffer_ring", "1" );
+//ConVar	gl_buffer_ring_windows( "gl_buffer_ring_windows", "3" );
+int gl_buffer_ring = 1;
+int gl_buffer_ring_windows = 3;
+
 CGLMBuffer::CGLMBuffer( GLMContext *ctx, EGLMBufferType type, uint size, uint options )
 {
 	m_ctx = ctx;
@@ -128,6 +136,14 @@ CGLMBuffer::CGLMBuffer( GLMContext *ctx, EGLMBufferType type, uint size, uint op
 	m_enableExplicitFlush = false;
 	m_dirtyMinOffset = m_dirtyMaxOffset = 0;								// adjust/grow on lock, clear on unlock
 
+	m_ring = false;
+	m_ringWindows = 0;
+	m_ringWindowSize = 0;
+	m_ringWindow = 0;
+	m_ringBase = 0;
+	m_ringPtr = NULL;
+	m_ringFences = NULL;
+
 	m_ctx->CheckCurrent();
 	m_revision = rand();
 
@@ -149,24 +165,62 @@ CGLMBuffer::CGLMBuffer( GLMContext *ctx, EGLMBufferType type, uint size, uint op
 
 		m_ctx->BindBufferToCtx( m_type, this );	// causes glBindBufferARB
 
-		// buffers start out static, but if they get orphaned and gl_bufmode is non zero,
-		// then they will get flipped to dynamic.
-		
-		GLenum hint = GL_STATIC_DRAW_ARB;
-		switch(m_type)
+		// make a decision about ring mode
+		bool wantRing =	gl_buffer_ring /*.GetInt()*/
+						&& (options & GLMBufferOptionDynamic)
+						&& ( (m_type==kGLMVertexBuffer) || (m_type==kGLMIndexBuffer) || (m_type==kGLMPixelBuffer) )
+						&& m_ctx->Caps().m_hasBufferStorage;
+		if (wantRing)
 		{
-			case	kGLMVertexBuffer:		hint = (options & GLMBufferOptionDynamic) ? GL_DYNAMIC_DRAW_ARB : GL_STATIC_DRAW_ARB; break;
-			case	kGLMIndexBuffer:		hint = (options & GLMBufferOptionDynamic) ? GL_DYNAMIC_DRAW_ARB : GL_STATIC_DRAW_ARB; break;
-			case	kGLMUniformBuffer:		hint = GL_DYNAMIC_DRAW_ARB; break;	// "fwiw" - shrug
-			case	kGLMPixelBuffer:		hint = (options & GLMBufferOptionDynamic) ? GL_DYNAMIC_DRAW_ARB : GL_STATIC_DRAW_ARB; break;
+			m_ringWindows = std::max( 2, std::min( gl_buffer_ring_windows /*.GetInt()*/, 8 ) );
+			m_ringWindowSize = (m_size + 255) & ~255;		// keep every window base aligned for attrib fetch
 			
-			default:	//Assert(!"Unknown buffer type" );
-			break;
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			GLsizeiptr ringSize = (GLsizeiptr)m_ringWindowSize * m_ringWindows;
+
+			pfnglBufferStorage( m_buffGLTarget, ringSize, NULL, flags );
+			GLMCheckError();
+
+			m_ringPtr = (char*)pfnglMapBufferRange( m_buffGLTarget, 0, ringSize, flags );
+			if (m_ringPtr)
+			{
+				m_ring = true;
+				m_ringFences = (GLsync*)calloc( m_ringWindows, sizeof(GLsync) );
+				m_lastMappedAddress = (float*)m_ringPtr;
+			}
+			else
+			{
+				// storage is immutable now, so start over with a fresh name and take the orphaning path
+				m_ctx->BindBufferToCtx( m_type, NULL );
+				glDeleteBuffersARB( 1, &m_name );
+				glGenBuffersARB( 1, &m_name );
+				GLMCheckError();
+
+				m_ctx->BindBufferToCtx( m_type, this );
+			}
 		}
 
-		glBufferDataARB( m_buffGLTarget, m_size, NULL, hint );	// may ultimately need more hints to set the usage correctly (esp for streaming)
-
-		this->SetModes( false, true, true );
+		if (!m_ring)
+		{
+			// buffers start out static, but if they get orphaned and gl_bufmode is non zero,
+			// then they will get flipped to dynamic.
+			
+			GLenum hint = GL_STATIC_DRAW_ARB;
+			switch(m_type)
+			{
+				case	kGLMVertexBuffer:		hint = (options & GLMBufferOptionDynamic) ? GL_DYNAMIC_DRAW_ARB : GL_STATIC_DRAW_ARB; break;
+				case	kGLMIndexBuffer:		hint = (options & GLMBufferOptionDynamic) ? GL_DYNAMIC_DRAW_ARB : GL_STATIC_DRAW_ARB; break;
+				case	kGLMUniformBuffer:		hint = GL_DYNAMIC_DRAW_ARB; break;	// "fwiw" - shrug
+				case	kGLMPixelBuffer:		hint = (options & GLMBufferOptionDynamic) ? GL_DYNAMIC_DRAW_ARB : GL_STATIC_DRAW_ARB; break;
+				
+				default:	//Assert(!"Unknown buffer type" );
+				break;
+			}
+
+			glBufferDataARB( m_buffGLTarget, m_size, NULL, hint );	// may ultimately need more hints to set the usage correctly (esp for streaming)
+
+			this->SetModes( false, true, true );
+		}
 
 		m_ctx->BindBufferToCtx( m_type, NULL );	// unbind me
 	}
@@ -183,6 +237,20 @@ CGLMBuffer::~CGLMBuffer( )
 	}
 	else
 	{
+		if (m_ring)
+		{
+			for( uint i=0; i<m_ringWindows; i++)
+			{
+				if (m_ringFences[i])
+				{
+					pfnglDeleteSync( m_ringFences[i] );
+				}
+			}
+			free( m_ringFences );
+			m_ringFences = NULL;
+			m_ringPtr = NULL;		// deleting the buffer releases the persistent mapping
+		}
+
 		glDeleteBuffersARB( 1, &m_name );
 		GLMCheckError();
 	}
@@ -198,7 +266,7 @@ void	CGLMBuffer::SetModes			( bool asyncMap, bool explicitFlush, bool force )
 {
 	// assumes buffer is bound. called by constructor and by Lock.
 
-	if (m_pseudo)
+	if (m_pseudo || m_ring)
 	{
 		// ignore it...
 	}
@@ -222,9 +290,9 @@ void	CGLMBuffer::SetModes			( bool asyncMap, bool explicitFlush, bool force )
 
 void	CGLMBuffer::FlushRange			( uint offset, uint size )
 {
-	if (m_pseudo)
+	if (m_pseudo || m_ring)
 	{
-		// nothing to do
+		// nothing to do - ring is mapped coherent
 	}
 	else
 	{
@@ -271,6 +339,25 @@ void	CGLMBuffer::Lock( GLMBuffLockParams *params, char **addressOut )
 		
 		// dirty range is a no-op
 	}
+	else if (m_ring)
+	{
+		if (params->m_discard)
+		{
+			// discard moves to the next window rather than orphaning
+			this->RingAdvance();
+		}
+		else if (!params->m_nonblocking)
+		{
+			// a plain lock has to see the GPU finish with the live window, same as a serialized map would
+			m_ringFences[ m_ringWindow ] = pfnglFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+			this->RingWait( m_ringWindow );
+		}
+		
+		// no map, no dirty range - the ring is persistently mapped and coherent
+		m_lastMappedAddress = (float*)(m_ringPtr + m_ringBase);
+
+		resultPtr = m_ringPtr + m_ringBase + params->m_offset;
+	}
 	else
 	{
 		// perform discard if requested
@@ -342,7 +429,7 @@ void	CGLMBuffer::Unlock( void )
 
 	//Assert (m_mapped);
 
-	if (m_pseudo)
+	if (m_pseudo || m_ring)
 	{
 		// nothing to do actually
 	}
@@ -365,3 +452,42 @@ void	CGLMBuffer::Unlock( void )
 
 	m_mapped = false;
 }
+
+void	CGLMBuffer::RingAdvance( void )
+{
+	// fence the live window - it signals once every draw queued so far (and so every draw sourcing this window) has completed.
+	Assert( !m_ringFences[ m_ringWindow ] );
+	m_ringFences[ m_ringWindow ] = pfnglFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	GLMCheckError();
+	
+	m_ringWindow = (m_ringWindow + 1) % m_ringWindows;
+	m_ringBase = m_ringWindow * m_ringWindowSize;
+
+	// make sure the GPU is done with the window we're about to hand out.
+	// with enough windows this is normally already signaled.
+	this->RingWait( m_ringWindow );
+
+	m_revision++;	// revision grows on window change, same as an orphan event - attribs have to be re-pointed
+}
+
+void	CGLMBuffer::RingWait( uint window )
+{
+	GLsync fence = m_ringFences[ window ];
+	if (!fence)
+		return;
+
+	// wait in 1ms slices, flushing so the fence is guaranteed to reach the GPU
+	GLenum result;
+	do
+	{
+		result = pfnglClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 );
+	} while (result == GL_TIMEOUT_EXPIRED);
+
+	if (result == GL_WAIT_FAILED)
+	{
+		GLMCheckError();
+	}
+
+	pfnglDeleteSync( fence );
+	m_ringFences[ window ] = NULL;
+}
@@ -59,6 +59,9 @@ public:
 	
 	void	SetModes			( bool asyncMap, bool explicitFlush, bool force = false );
 	void	FlushRange			( uint offset, uint size );
+
+	void	RingAdvance			( void );
+	void	RingWait			( uint window );
 	
 	GLMContext				*m_ctx;					// link back to parent context
 	EGLMBufferType			m_type;
@@ -85,6 +88,20 @@ public:
 	// there's no need to do any fencing or multibuffering.  orphaning in particular becomes a no-op.
 	
 	char					*m_pseudoBuf;			// storage for pseudo buffer
+
+	// --------------------- persistent ring support below here (dynamic vertex/index buffers)
+	bool					m_ring;					// true if the GL buffer is an immutable, persistently mapped ring
+	
+	// in ring mode the GL buffer holds m_ringWindows copies ("windows") of the D3D-visible buffer and stays mapped for its lifetime.
+	// a discard lock fences the live window and moves to the next one instead of orphaning, so locks never map or unmap.
+	// the context adds m_ringBase to attrib and index offsets at draw time; m_revision bumps on each advance so attribs get re-pointed.
+	
+	uint					m_ringWindows;			// number of windows in the ring
+	uint					m_ringWindowSize;		// m_size rounded up to window alignment
+	uint					m_ringWindow;			// index of the live window
+	uint					m_ringBase;				// byte offset of the live window (always zero when not in ring mode)
+	char					*m_ringPtr;				// persistent mapping of the whole ring
+	GLsync					*m_ringFences;			// one per window, set when the window is retired, cleared once the GPU is done with it
 };	
 
 
@@ -23,10 +23,16 @@
 	ConVar	gl_shaderpair_cacherows_lg2( "gl_paircache_rows_lg2", "10");		// 10 is minimum
 	ConVar	gl_shaderpair_cacheways_lg2( "gl_paircache_ways_lg2", "5");		// 5 is minimum
 	ConVar	gl_shaderpair_cachelog( "gl_shaderpair_cachelog", "0" );
+	ConVar	gl_shaderpair_binarycache( "gl_shaderpair_binarycache", "1" );
+	ConVar	gl_shaderpair_binarycache_file( "gl_shaderpair_binarycache_file", "glm_programcache.bin" );
+	ConVar	gl_shaderpair_binarycache_max( "gl_shaderpair_binarycache_max", "4096" );
 #else
 	int	gl_shaderpair_cacherows_lg2 = 10;
 	int	gl_shaderpair_cacheways_lg2 = 5;
 	int	gl_shaderpair_cachelog = 0;
+	int	gl_shaderpair_binarycache = 1;										// persist linked pairs across runs (needs ARB_get_program_binary)
+	const char *gl_shaderpair_binarycache_file = "glm_programcache.bin";
+	int	gl_shaderpair_binarycache_max = 4096;								// entries kept in the file
 #endif
 
 //===============================================================================
@@ -830,6 +836,7 @@ CGLMShaderPair::CGLMShaderPair( GLMContext *ctx  )
 	memset( m_locSamplers, 0xFF, sizeof( m_locSamplers ) );
 	
 	m_valid = false;
+	m_fromBinary = false;
 	m_samplersFixed = false;	// fix them at draw time, and only do it once.
 	m_revision = 0;				// bumps to 1 once linked
 }
@@ -843,9 +850,16 @@ CGLMShaderPair::~CGLMShaderPair( )
 	}
 }
 
-bool	CGLMShaderPair::SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp )
+// program binary entry points want a GLuint; GLhandleARB is a pointer on OSX
+static inline GLuint GLMProgramName( GLhandleARB handle )
+{
+	return (GLuint)(uintptr_t)handle;
+}
+
+bool	CGLMShaderPair::SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp, CGLMPairBinaryEntry *binary )
 {
 	m_valid	= false;			// assume failure
+	m_fromBinary = false;
 	
 	// true result means successful link and query
 	bool vpgood = (vp!=NULL) && (vp->m_descs[ kGLMGLSL ].m_valid);
@@ -883,7 +897,29 @@ bool	CGLMShaderPair::SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp )
 		glAttachObjectARB(m_program, fp->m_descs[kGLMGLSL].m_object.glsl);
 		m_fragmentProg = fp;
 		GLMCheckError();
-	
+
+		// try the saved binary first.  the shader objects stay attached, so a later RefreshProgramPair can still relink from source.
+		if (binary && !binary->m_binary.empty() && m_ctx->Caps().m_hasProgramBinary)
+		{
+			pfnglProgramBinary( GLMProgramName( m_program ), binary->m_format, &binary->m_binary[0], binary->m_binary.size() );
+
+			GLint result = 0;
+			glGetObjectParameterivARB(m_program,GL_OBJECT_LINK_STATUS_ARB,&result);
+			
+			// a stale binary (driver update etc) is allowed to raise an error - eat it, we just fall back to linking
+			glGetError();
+			
+			if (result == GL_TRUE)
+			{
+				m_valid = true;
+				m_fromBinary = true;
+				m_revision++;
+			}
+		}
+	}
+
+	if (vpgood && fpgood && !m_fromBinary)
+	{
 		// force the locations for input attributes v0-vN to be at locations 0-N
 		// use the vertex attrib map to know which slots are live or not... oy!  we don't have that map yet... but it's OK.
 		// fallback - just force v0-v15 to land in locations 0-15 as a standard.
@@ -900,6 +936,13 @@ bool	CGLMShaderPair::SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp )
 			}
 		}
 			
+		// ask the driver to keep the binary around so the pair cache can save it
+		if (m_ctx->Caps().m_hasProgramBinary)
+		{
+			pfnglProgramParameteri( GLMProgramName( m_program ), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+			GLMCheckError();
+		}
+
 		// now link
 		glLinkProgramARB( m_program );
 		GLMCheckError();			
@@ -947,13 +990,31 @@ bool	CGLMShaderPair::SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp )
 			free( logString );
 		}
 	}
-	else
+	else if (!m_fromBinary)
 	{
 		// fail
 		Assert(!"Can't link these programs");
 	}
 	
-	if (m_valid)
+	if (m_fromBinary)
+	{
+		// no need to query, the binary came with its locations
+		const GLMPairBinaryMeta *meta = &binary->m_meta;
+		
+		m_locVertexParams = meta->m_locVertexParams;
+		m_locVertexInteger0 = meta->m_locVertexInteger0;
+		m_locVertexBool0 = meta->m_locVertexBool0;
+		m_locVertexBool1 = meta->m_locVertexBool1;
+		m_locVertexBool2 = meta->m_locVertexBool2;
+		m_locVertexBool3 = meta->m_locVertexBool3;
+
+		m_locFragmentParams = meta->m_locFragmentParams;
+		m_locFragmentFakeSRGBEnable = meta->m_locFragmentFakeSRGBEnable;
+		m_fakeSRGBEnableValue = -1.0f;
+
+		memcpy( m_locSamplers, meta->m_locSamplers, sizeof( m_locSamplers ) );
+	}
+	else if (m_valid)
 	{
 		m_locVertexParams = glGetUniformLocationARB( m_program, "vc");
 		GLMCheckError();
@@ -1009,6 +1070,48 @@ bool	CGLMShaderPair::SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp )
 }
 
 
+bool	CGLMShaderPair::GetProgramBinary		( CGLMPairBinaryEntry *binaryOut )
+{
+	if (!m_valid || !m_ctx->Caps().m_hasProgramBinary)
+		return false;
+
+	GLuint name = GLMProgramName( m_program );
+	
+	GLint length = 0;
+	glGetProgramiv( name, GL_PROGRAM_BINARY_LENGTH, &length );
+	GLMCheckError();
+	
+	if (length <= 0)
+		return false;
+
+	binaryOut->m_binary.resize( length );
+	
+	GLsizei written = 0;
+	pfnglGetProgramBinary( name, length, &written, &binaryOut->m_format, &binaryOut->m_binary[0] );
+	GLMCheckError();
+
+	if (written <= 0)
+		return false;
+	
+	binaryOut->m_binary.resize( written );
+
+	GLMPairBinaryMeta *meta = &binaryOut->m_meta;
+
+	meta->m_locVertexParams = m_locVertexParams;
+	meta->m_locVertexInteger0 = m_locVertexInteger0;
+	meta->m_locVertexBool0 = m_locVertexBool0;
+	meta->m_locVertexBool1 = m_locVertexBool1;
+	meta->m_locVertexBool2 = m_locVertexBool2;
+	meta->m_locVertexBool3 = m_locVertexBool3;
+
+	meta->m_locFragmentParams = m_locFragmentParams;
+	meta->m_locFragmentFakeSRGBEnable = m_locFragmentFakeSRGBEnable;
+
+	memcpy( meta->m_locSamplers, m_locSamplers, sizeof( meta->m_locSamplers ) );
+
+	return true;
+}
+
 bool	CGLMShaderPair::RefreshProgramPair		( void )
 {
 	// re-link and re-query the uniforms.
@@ -1063,6 +1166,22 @@ CGLMShaderPairCache::CGLMShaderPairCache( GLMContext *ctx  )
 	// hit counter table is same size
 	m_hits = (uint*)malloc( evictTableSize );
 	memset (m_hits, 0, evictTableSize);
+
+	// and so is the binary tier's
+	m_binaryHits = (uint*)malloc( evictTableSize );
+	memset (m_binaryHits, 0, evictTableSize);
+
+	m_binaryRejects = 0;
+	m_binaryStores = 0;
+	m_binaryEvictions = 0;
+	m_binaryDirty = false;
+	m_binaryRendererHash = 0;
+	
+	m_binaryEnable = gl_shaderpair_binarycache && gl_shaderpair_binarycache_file && gl_shaderpair_binarycache_file[0] && m_ctx->Caps().m_hasProgramBinary;
+	if (m_binaryEnable)
+	{
+		LoadBinaries();
+	}
 }
 
 CGLMShaderPairCache::~CGLMShaderPairCache( )
@@ -1072,6 +1191,11 @@ CGLMShaderPairCache::~CGLMShaderPairCache( )
 		DumpStats();
 	}
 
+	if (m_binaryEnable)
+	{
+		SaveBinaries();
+	}
+
 	// free all the built pairs
 	// free the entry table
 	bool purgeResult = this->Purge();
@@ -1094,6 +1218,12 @@ CGLMShaderPairCache::~CGLMShaderPairCache( )
 		free( m_hits );
 		m_hits = NULL;
 	}
+
+	if (m_binaryHits)
+	{
+		free( m_binaryHits );
+		m_binaryHits = NULL;
+	}
 }
 
 
@@ -1248,7 +1378,55 @@ CGLMShaderPair	*CGLMShaderPairCache::SelectShaderPair( CGLMProgram *vp, CGLMProg
 		newentry->m_fragmentProg = fp;
 		newentry->m_extraKeyBits = extraKeyBits;
 		newentry->m_pair = new CGLMShaderPair( m_ctx );
-		newentry->m_pair->SetProgramPair( vp, fp );
+
+		// before paying for a link, see if the persistent tier has this pair from a previous run
+		uint64 binaryKey = m_binaryEnable ? BinaryKey( vp, fp, extraKeyBits ) : 0;
+		CGLMPairBinaryEntry *binary = NULL;
+		
+		if (binaryKey)
+		{
+			std::map< uint64, CGLMPairBinaryEntry >::iterator binaryIter = m_binaryEntries.find( binaryKey );
+			if (binaryIter != m_binaryEntries.end())
+			{
+				binary = &binaryIter->second;
+			}
+		}
+		
+		newentry->m_pair->SetProgramPair( vp, fp, binary );
+
+		if (binary)
+		{
+			if (newentry->m_pair->m_fromBinary)
+			{
+				m_binaryHits[ rowIndex ]++;
+				binary->m_used = true;
+
+				if (loglevel >= 2)
+				{
+					printf("(binary) ");
+				}
+			}
+			else
+			{
+				// driver wouldn't take it - drop it, the fresh link below replaces it
+				m_binaryRejects++;
+				m_binaryEntries.erase( binaryKey );
+				m_binaryDirty = true;
+				binary = NULL;
+			}
+		}
+		
+		if (binaryKey && !newentry->m_pair->m_fromBinary && newentry->m_pair->m_valid)
+		{
+			CGLMPairBinaryEntry newBinary;
+			if (newentry->m_pair->GetProgramBinary( &newBinary ))
+			{
+				newBinary.m_used = true;
+				m_binaryEntries[ binaryKey ] = newBinary;
+				m_binaryStores++;
+				m_binaryDirty = true;
+			}
+		}
 
 		if (loglevel >= 2)  // say a little bit more
 		{
@@ -1375,15 +1553,19 @@ void			CGLMShaderPairCache::DumpStats			( void )
 {
 	printf("\n------------------\npair cache stats");
 	int total = 0;
+	int totalBinaryHits = 0;
 	for( int row=0; row < m_rows; row++ )
 	{
-		if ( (m_evictions[row] != 0) || (m_hits[row] != 0) )
+		if ( (m_evictions[row] != 0) || (m_hits[row] != 0) || (m_binaryHits[row] != 0) )
 		{
-			printf("\n row %d : %d evictions, %d hits",row,m_evictions[row], m_hits[row]);
+			printf("\n row %d : %d evictions, %d hits, %d binary hits",row,m_evictions[row], m_hits[row], m_binaryHits[row]);
 			total += m_evictions[row];
+			totalBinaryHits += m_binaryHits[row];
 		}
 	}
-	printf("\n\npair cache evictions: %d\n-----------------------\n",total );
+	printf("\n\npair cache evictions: %d",total );
+	printf("\nbinary tier: %s, %d entries, %d hits, %d rejects, %d stores, %d evictions\n-----------------------\n",
+		m_binaryEnable ? "on" : "off", (int)m_binaryEntries.size(), totalBinaryHits, m_binaryRejects, m_binaryStores, m_binaryEvictions );
 }
 	
 	//===============================
@@ -1446,3 +1628,204 @@ void			CGLMShaderPairCache::HashRowProbe		( CGLMPairCacheEntry *row, CGLMProgram
 	if (oldestwayOut)	*oldestwayOut = oldestway;
 }
 
+	//===============================
+
+// FNV-1a, 64 bit.  needs to be stable run to run, so no pointers or serials go in here.
+static uint64 GLMHash64( const void *data, uint size, uint64 hash = 14695981039346656037ULL )
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for( uint i=0; i < size; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64			CGLMShaderPairCache::BinaryKey			( CGLMProgram *vp, CGLMProgram *fp, uint extraKeyBits )
+{
+	// SetProgramPair swaps in the null FP when the fragment side is missing, key it the same way
+	if ( !fp || !fp->m_descs[ kGLMGLSL ].m_valid )
+	{
+		fp = m_ctx->m_nullFragmentProgram;
+	}
+
+	if ( !vp || !fp || !vp->m_text || !fp->m_text || !vp->m_descs[ kGLMGLSL ].m_textPresent || !fp->m_descs[ kGLMGLSL ].m_textPresent )
+	{
+		return 0;
+	}
+
+	GLMShaderDesc *vdesc = &vp->m_descs[ kGLMGLSL ];
+	GLMShaderDesc *fdesc = &fp->m_descs[ kGLMGLSL ];
+
+	uint64 hash = GLMHash64( vp->m_text + vdesc->m_textOffset, vdesc->m_textLength );
+	hash = GLMHash64( fp->m_text + fdesc->m_textOffset, fdesc->m_textLength, hash );
+	hash = GLMHash64( &extraKeyBits, sizeof(extraKeyBits), hash );
+
+	return hash ? hash : 1;
+}
+
+// file layout: GLMPairBinaryFileHeader, then per entry a GLMPairBinaryFileEntry followed by m_length bytes of binary
+#define GLM_PAIRBINARY_MAGIC	0x42504C47		// 'GLPB'
+#define GLM_PAIRBINARY_VERSION	1
+#define GLM_PAIRBINARY_MAXSIZE	(16*1024*1024)	// sanity limit on any one binary
+
+struct GLMPairBinaryFileHeader
+{
+	uint				m_magic;
+	uint				m_version;
+	uint64				m_rendererHash;
+	uint				m_count;
+	uint				m_pad;
+};
+
+struct GLMPairBinaryFileEntry
+{
+	uint64				m_key;
+	uint				m_format;
+	uint				m_length;
+	GLMPairBinaryMeta	m_meta;
+};
+
+void			CGLMShaderPairCache::LoadBinaries		( void )
+{
+	int loglevel = gl_shaderpair_cachelog/* .GetInt() */;
+	
+	// binaries are only good for the driver that made them
+	const char *strings[3] = { (const char*)glGetString( GL_VENDOR ), (const char*)glGetString( GL_RENDERER ), (const char*)glGetString( GL_VERSION ) };
+	m_binaryRendererHash = GLMHash64( NULL, 0 );
+	for( int i=0; i<3; i++ )
+	{
+		if (strings[i])
+		{
+			m_binaryRendererHash = GLMHash64( strings[i], strlen( strings[i] ), m_binaryRendererHash );
+		}
+	}
+
+	m_binaryEntries.clear();
+	
+	FILE *f = fopen( gl_shaderpair_binarycache_file, "rb" );
+	if (!f)
+	{
+		return;		// first run
+	}
+	
+	GLMPairBinaryFileHeader header;
+	bool ok = fread( &header, sizeof(header), 1, f ) == 1;
+	
+	if ( ok && ( header.m_magic != GLM_PAIRBINARY_MAGIC || header.m_version != GLM_PAIRBINARY_VERSION || header.m_rendererHash != m_binaryRendererHash ) )
+	{
+		if (loglevel >= 1)
+		{
+			printf("\nSSP: binary cache %s is stale, discarding", gl_shaderpair_binarycache_file );
+		}
+		m_binaryEvictions += header.m_count;
+		m_binaryDirty = true;
+		ok = false;
+	}
+
+	for( uint i=0; ok && i < header.m_count; i++ )
+	{
+		GLMPairBinaryFileEntry fileEntry;
+		if ( fread( &fileEntry, sizeof(fileEntry), 1, f ) != 1 || fileEntry.m_length == 0 || fileEntry.m_length > GLM_PAIRBINARY_MAXSIZE )
+		{
+			ok = false;
+			break;
+		}
+		
+		CGLMPairBinaryEntry &entry = m_binaryEntries[ fileEntry.m_key ];
+		entry.m_format = fileEntry.m_format;
+		entry.m_used = false;
+		entry.m_meta = fileEntry.m_meta;
+		entry.m_binary.resize( fileEntry.m_length );
+		
+		if ( fread( &entry.m_binary[0], fileEntry.m_length, 1, f ) != 1 )
+		{
+			m_binaryEntries.erase( fileEntry.m_key );
+			ok = false;
+		}
+	}
+	
+	fclose( f );
+	
+	if (!ok)
+	{
+		// truncated or corrupt - keep what we got, rewrite it clean at exit
+		m_binaryDirty = true;
+	}
+
+	if (loglevel >= 1)
+	{
+		printf("\nSSP: restored %d linked pairs from %s", (int)m_binaryEntries.size(), gl_shaderpair_binarycache_file );
+	}
+}
+
+void			CGLMShaderPairCache::SaveBinaries		( void )
+{
+	if (!m_binaryDirty)
+	{
+		return;
+	}
+
+	// trim to size - entries nobody asked for this run go first
+	int limit = gl_shaderpair_binarycache_max/* .GetInt() */;
+	for( int pass=0; pass < 2 && (int)m_binaryEntries.size() > limit; pass++ )
+	{
+		std::map< uint64, CGLMPairBinaryEntry >::iterator iter = m_binaryEntries.begin();
+		while ( iter != m_binaryEntries.end() && (int)m_binaryEntries.size() > limit )
+		{
+			if ( pass == 1 || !iter->second.m_used )
+			{
+				m_binaryEntries.erase( iter++ );
+				m_binaryEvictions++;
+			}
+			else
+			{
+				++iter;
+			}
+		}
+	}
+
+	// write to a temp name and swap it in, so a crash mid-write can't leave a torn file behind
+	char tempPath[ 1024 ];
+	snprintf( tempPath, sizeof(tempPath), "%s.tmp", gl_shaderpair_binarycache_file );
+	
+	FILE *f = fopen( tempPath, "wb" );
+	if (!f)
+	{
+		return;
+	}
+	
+	GLMPairBinaryFileHeader header;
+	memset( &header, 0, sizeof(header) );
+	header.m_magic = GLM_PAIRBINARY_MAGIC;
+	header.m_version = GLM_PAIRBINARY_VERSION;
+	header.m_rendererHash = m_binaryRendererHash;
+	header.m_count = m_binaryEntries.size();
+	
+	bool ok = fwrite( &header, sizeof(header), 1, f ) == 1;
+	
+	for( std::map< uint64, CGLMPairBinaryEntry >::iterator iter = m_binaryEntries.begin(); ok && iter != m_binaryEntries.end(); iter++ )
+	{
+		GLMPairBinaryFileEntry fileEntry;
+		memset( &fileEntry, 0, sizeof(fileEntry) );
+		fileEntry.m_key = iter->first;
+		fileEntry.m_format = iter->second.m_format;
+		fileEntry.m_length = iter->second.m_binary.size();
+		fileEntry.m_meta = iter->second.m_meta;
+		
+		ok = fwrite( &fileEntry, sizeof(fileEntry), 1, f ) == 1;
+		ok = ok && fwrite( &iter->second.m_binary[0], fileEntry.m_length, 1, f ) == 1;
+	}
+	
+	ok = (fclose( f ) == 0) && ok;
+	
+	if (ok && rename( tempPath, gl_shaderpair_binarycache_file ) == 0)
+	{
+		m_binaryDirty = false;
+	}
+	else
+	{
+		unlink( tempPath );
+	}
+}
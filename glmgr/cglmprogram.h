@@ -158,6 +158,32 @@ struct GLMShaderPairInfo
 };
 
 
+// persistent tier of the pair cache.  a linked program binary (ARB_get_program_binary) plus the post-link
+// metadata CGLMShaderPair would otherwise have to query, keyed on the GLSL text of both stages so it survives a restart.
+
+struct GLMPairBinaryMeta
+{
+	GLint					m_locVertexParams;
+	GLint					m_locVertexInteger0;
+	GLint					m_locVertexBool0;
+	GLint					m_locVertexBool1;
+	GLint					m_locVertexBool2;
+	GLint					m_locVertexBool3;
+
+	GLint					m_locFragmentParams;
+	GLint					m_locFragmentFakeSRGBEnable;
+
+	GLint					m_locSamplers[ 16 ];
+};
+
+struct CGLMPairBinaryEntry
+{
+	GLenum					m_format;				// binary format token from glGetProgramBinary
+	bool					m_used;					// restored or stored this run - unused ones go first when the file is trimmed
+	GLMPairBinaryMeta		m_meta;
+	std::vector<unsigned char>	m_binary;
+};
+
 class CGLMShaderPair					// a container for a linked GLSL shader pair, and metadata obtained post-link
 {
 
@@ -173,8 +199,12 @@ public:
 	CGLMShaderPair( GLMContext *ctx  );
 	~CGLMShaderPair( );	
 
-	bool	SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp );
+	bool	SetProgramPair			( CGLMProgram *vp, CGLMProgram *fp, CGLMPairBinaryEntry *binary = NULL );
 		// true result means successful link and query
+		// if a binary is supplied it is tried first; m_fromBinary says whether the driver took it or we fell back to a link
+
+	bool	GetProgramBinary		( CGLMPairBinaryEntry *binaryOut );
+		// retrieve the linked binary and metadata for the persistent tier.  false if the pair isn't linked or the driver declines.
 
 	bool	RefreshProgramPair		( void );
 		// re-link and re-query the uniforms
@@ -212,6 +242,7 @@ public:
 
 	// other stuff
 	bool					m_valid;				// true on successful link
+	bool					m_fromBinary;			// true if the last link was satisfied by glProgramBinary
 	bool					m_samplersFixed;		// set on first draw (can't write the uniforms until the program is in use, and we don't want to mess with cur program inside cglmprogram)
 	uint					m_revision;				// if this pair is relinked, bump this number.
 };	
@@ -265,6 +296,14 @@ protected:
 	uint			HashRowIndex		( CGLMProgram *vp, CGLMProgram *fp, uint extraKeyBits );
 	CGLMPairCacheEntry*	HashRowPtr		( uint hashRowIndex );
 	void			HashRowProbe		( CGLMPairCacheEntry *row, CGLMProgram *vp, CGLMProgram *fp, uint extraKeyBits, int *hitwayOut, int *emptywayOut, int *oldestwayOut );
+
+	//===============================
+	// persistent (program binary) tier - consulted on a miss in the linked tier above, before linking
+
+	uint64			BinaryKey			( CGLMProgram *vp, CGLMProgram *fp, uint extraKeyBits );	// 0 means "can't key this pair"
+	void			LoadBinaries		( void );
+	void			SaveBinaries		( void );
+	
 	//===============================
 
 	// common stuff
@@ -285,6 +324,17 @@ protected:
 
 	uint					*m_evictions;			// array[ m_rows ];
 	uint					*m_hits;				// array[ m_rows ];
+
+	// persistent tier
+	bool					m_binaryEnable;			// caps say we have program binaries and a cache file is configured
+	bool					m_binaryDirty;			// entries added or dropped since load - rewrite the file at shutdown
+	uint64					m_binaryRendererHash;	// vendor/renderer/version the binaries were made with
+	std::map< uint64, CGLMPairBinaryEntry >	m_binaryEntries;
+
+	uint					*m_binaryHits;			// array[ m_rows ]; misses in the linked tier satisfied from the binary tier
+	uint					m_binaryRejects;		// binaries the driver refused (relinked from source instead)
+	uint					m_binaryStores;			// new binaries captured this run
+	uint					m_binaryEvictions;		// entries dropped to respect gl_shaderpair_binarycache_max
 };	
 
 
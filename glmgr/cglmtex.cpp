@@ -410,220 +410,395 @@ bool	GLMGenTexels( GLMGenTexelParams *params )
 }
 
 
+//===============================================================================
+
+void GLMTexLayoutPackedKey::Pack( const GLMTexLayoutKey *key )
+{
+	// GL targets are all below 0x10000, flags and sample counts fit a byte, sizes are capped well under 64K
+	Assert( key->m_texGLTarget < 0x10000 );
+	Assert( (key->m_texFlags < 0x100) && (key->m_texSamples < 0x100) );
+	Assert( (key->m_xSize < 0x10000) && (key->m_ySize < 0x10000) );
+	
+	m_words[0] = key->m_texGLTarget | (key->m_texFlags << 16) | (key->m_texSamples << 24);
+	m_words[1] = key->m_texFormat;
+	m_words[2] = key->m_xSize | (key->m_ySize << 16);
+	m_words[3] = key->m_zSize;
+}
+
+uint GLMTexLayoutPackedKey::Hash( void ) const
+{
+	// FNV style word mix, then a finalizer so the low bits (which pick the slot) depend on all of it
+	uint hash = 2166136261U;
+	for( int i=0; i<4; i++ )
+	{
+		hash = (hash ^ m_words[i]) * 16777619U;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6BU;
+	hash ^= hash >> 13;
+	
+	return hash;
+}
+
+//===============================================================================
+
+#define	GLM_TEX_LAYOUT_POOL_BLOCK	(64*1024)
+
+CGLMTexLayoutPool::CGLMTexLayoutPool()
+{
+	m_blocks = NULL;
+	m_bytesUsed = 0;
+	m_bytesReserved = 0;
+}
+
+CGLMTexLayoutPool::~CGLMTexLayoutPool()
+{
+	while( m_blocks )
+	{
+		Block *next = m_blocks->m_next;
+		free( m_blocks );
+		m_blocks = next;
+	}
+}
+
+void *CGLMTexLayoutPool::Alloc( uint size )
+{
+	size = (size + 15) & ~15;
+	
+	if ( !m_blocks || (m_blocks->m_used + size > m_blocks->m_size) )
+	{
+		// start a new block.  the header is rounded up to 16 so carved pointers stay aligned.
+		// an odd huge request gets a block of its own.
+		uint headerSize = (sizeof(Block) + 15) & ~15;
+		uint blockSize = std::max( (uint)GLM_TEX_LAYOUT_POOL_BLOCK, headerSize + size );
+		
+		Block *block = (Block *)malloc( blockSize );
+		block->m_next = m_blocks;
+		block->m_size = blockSize;
+		block->m_used = headerSize;
+		m_blocks = block;
+		
+		m_bytesReserved += blockSize;
+	}
+	
+	void *result = (char*)m_blocks + m_blocks->m_used;
+	m_blocks->m_used += size;
+	m_bytesUsed += size;
+	
+	return result;
+}
+
+char *CGLMTexLayoutPool::StrDup( const char *str )
+{
+	uint len = strlen( str ) + 1;
+	char *result = (char *)Alloc( len );
+	memcpy( result, str, len );
+	
+	return result;
+}
+
 //===============================================================================
 
 CGLMTexLayoutTable::CGLMTexLayoutTable()
 {
+	m_capacityLg2 = GLM_TEX_LAYOUT_TABLE_MIN_LG2;
+	m_capacity = 1<<m_capacityLg2;
+	m_count = 0;
+	
+	m_entries = (GLMTexLayoutTableEntry*)malloc( m_capacity * sizeof(GLMTexLayoutTableEntry) );
+	memset( m_entries, 0, m_capacity * sizeof(GLMTexLayoutTableEntry) );
+	
+	m_lookups = 0;
+	m_hits = 0;
+	m_probes = 0;
+}
+
+CGLMTexLayoutTable::~CGLMTexLayoutTable()
+{
+	// layouts themselves live in m_pool
+	free( m_entries );
+}
+
+uint CGLMTexLayoutTable::FindSlot( const GLMTexLayoutPackedKey &key, uint hash )
+{
+	// table is never more than half full, so this always finds a match or a hole
+	uint mask = m_capacity-1;
+	uint slot = hash & mask;
+	
+	for(;;)
+	{
+		GLMTexLayoutTableEntry *entry = &m_entries[slot];
+		if ( !entry->m_layout )
+		{
+			return slot;
+		}
+		if ( (entry->m_hash == hash) && (entry->m_key == key) )
+		{
+			return slot;
+		}
+		
+		slot = (slot+1) & mask;
+		m_probes++;
+	}
+}
+
+void CGLMTexLayoutTable::Grow( void )
+{
+	GLMTexLayoutTableEntry	*oldEntries = m_entries;
+	uint					oldCapacity = m_capacity;
+	
+	m_capacityLg2++;
+	m_capacity = 1<<m_capacityLg2;
+	
+	m_entries = (GLMTexLayoutTableEntry*)malloc( m_capacity * sizeof(GLMTexLayoutTableEntry) );
+	memset( m_entries, 0, m_capacity * sizeof(GLMTexLayoutTableEntry) );
+	
+	// reinsert using the stored hashes, no key compares needed since every key is distinct
+	uint mask = m_capacity-1;
+	for( uint i=0; i<oldCapacity; i++ )
+	{
+		if (oldEntries[i].m_layout)
+		{
+			uint slot = oldEntries[i].m_hash & mask;
+			while( m_entries[slot].m_layout )
+			{
+				slot = (slot+1) & mask;
+			}
+			m_entries[slot] = oldEntries[i];
+		}
+	}
+	
+	free( oldEntries );
 }
 
 GLMTexLayout *CGLMTexLayoutTable::NewLayoutRef( GLMTexLayoutKey *key )
 {
-	// look up 'key' in the map and see if it's a hit, if so, bump the refcount and return
-	// if not, generate a completed layout based on the key, add to map, set refcount to 1, return that
+	// look up 'key' in the table and see if it's a hit, if so, bump the refcount and return
+	// if not, generate a completed layout based on the key, add to table, set refcount to 1, return that
 	
 	const GLMTexFormatDesc	*formatDesc = GetFormatDesc( key->m_texFormat );
 	if (!formatDesc)
 	{
 		GLMStop();	// bad news
 	}
-	bool					compression = (formatDesc->m_chunkSize > 1);
 	
-	GLMTexLayoutKeyMap::iterator p = m_layoutMap.find( *key );
-	if (p != m_layoutMap.end())
+	GLMTexLayoutPackedKey packed;
+	packed.Pack( key );
+	uint hash = packed.Hash();
+	
+	m_lookups++;
+	
+	uint slot = FindSlot( packed, hash );
+	if (m_entries[slot].m_layout)
 	{
 		// found it
-		//printf(" -hit- ");
-		GLMTexLayout *ptr = (*p).second;
+		GLMTexLayout *ptr = m_entries[slot].m_layout;
 		
 		// bump ref count
 		ptr->m_refCount++;
+		m_hits++;
 		
 		return ptr;
 	}
-	else
+	
+	// need to make a new one
+	GLMTexLayout *layout = MakeLayout( key, formatDesc );
+	
+	// keep the load at or under one half
+	if ( (m_count+1) * 2 > m_capacity )
 	{
-		//printf(" -miss- ");
-		// need to make a new one
-		// to allocate it, we need to know how big to make it (slice count)
-		
-		// figure out how many mip levels are in play
-		int mipCount = 1;
-		if (key->m_texFlags & kGLMTexMipped)
-		{
-			int largestAxis = key->m_xSize;
-			
-			if (key->m_ySize > largestAxis)
-				largestAxis = key->m_ySize;
-				
-			if (key->m_zSize > largestAxis)
-				largestAxis = key->m_zSize;
-			
-			mipCount = 0;
-			while( largestAxis > 0 )
-			{
-				mipCount ++;
-				largestAxis >>= 1;
-			}
-		}
+		Grow();
+		slot = FindSlot( packed, hash );
+	}
+	
+	m_entries[slot].m_key = packed;
+	m_entries[slot].m_hash = hash;
+	m_entries[slot].m_layout = layout;
+	m_count++;
+	
+	return layout;
+}
 
-		int faceCount = 1;
-		if (key->m_texGLTarget == GL_TEXTURE_CUBE_MAP)
-		{
-			faceCount = 6;
-		}
+GLMTexLayout *CGLMTexLayoutTable::MakeLayout( GLMTexLayoutKey *key, const GLMTexFormatDesc *formatDesc )
+{
+	// build a completed layout for 'key' with refcount 1.  caller puts it in the table.
+	// to allocate it, we need to know how big to make it (slice count)
+	
+	// figure out how many mip levels are in play
+	int mipCount = 1;
+	if (key->m_texFlags & kGLMTexMipped)
+	{
+		int largestAxis = key->m_xSize;
 		
-		int sliceCount = mipCount * faceCount;
+		if (key->m_ySize > largestAxis)
+			largestAxis = key->m_ySize;
+			
+		if (key->m_zSize > largestAxis)
+			largestAxis = key->m_zSize;
 		
-		if (key->m_texFlags & kGLMTexMultisampled)
+		mipCount = 0;
+		while( largestAxis > 0 )
 		{
-			Assert( (key->m_texGLTarget == GL_TEXTURE_2D) );
-			Assert( sliceCount == 1 );
-			
-			// assume non mipped
-			Assert( (key->m_texFlags & kGLMTexMipped) == 0 );
-			Assert( (key->m_texFlags & kGLMTexMippedAuto) == 0 );
-			
-			// assume renderable and srgb
-			Assert( (key->m_texFlags & kGLMTexRenderable) !=0 );
-			//Assert( (key->m_texFlags & kGLMTexSRGB) !=0 );			//FIXME don't assert on making depthstencil surfaces which are non srgb
-			
-			// double check sample count (FIXME need real limit check here against device/driver)
-			Assert( (key->m_texSamples==2) || (key->m_texSamples==4) || (key->m_texSamples==6) || (key->m_texSamples==8) );
+			mipCount ++;
+			largestAxis >>= 1;
 		}
-		
-		// now we know enough to allocate and populate the new tex layout.
-		
-		// malloc the new layout
-		int layoutSize = sizeof( GLMTexLayout ) + (sliceCount * sizeof( GLMTexLayoutSlice ));
-		GLMTexLayout *layout = (GLMTexLayout *)malloc( layoutSize );
-		memset( layout, 0, layoutSize );
-		
-		// clone the key in there
-		memset( &layout->m_key, 0x00, sizeof(layout->m_key) );
-		layout->m_key = *key;
+	}
 
-		// set refcount
-		layout->m_refCount = 1;
-		
-		// save the format desc
-		layout->m_format = (GLMTexFormatDesc *)formatDesc;
-		
-		// we know the mipcount from before
-		layout->m_mipCount = mipCount;
-		
-		// we know the face count too
-		layout->m_faceCount = faceCount;
-		
-		// slice count is the product
-		layout->m_sliceCount = mipCount * faceCount;
-		
-		// we can now fill in the slices.
-		GLMTexLayoutSlice	*slicePtr = &layout->m_slices[0];
-		int					storageOffset = 0;
-		
-		bool compressed = (formatDesc->m_chunkSize > 1);	// true if DXT
+	int faceCount = 1;
+	if (key->m_texGLTarget == GL_TEXTURE_CUBE_MAP)
+	{
+		faceCount = 6;
+	}
+	
+	int sliceCount = mipCount * faceCount;
+	
+	if (key->m_texFlags & kGLMTexMultisampled)
+	{
+		Assert( (key->m_texGLTarget == GL_TEXTURE_2D) );
+		Assert( sliceCount == 1 );
 		
-		for( int mip = 0; mip < mipCount; mip ++ )
-		{
-			for( int face = 0; face < faceCount; face++ )
-			{
-				// note application of chunk size which is 1 for uncompressed, and 4 for compressed tex (DXT)
-				// note also that the *dimensions* must scale down to 1
-				// but that the *storage* cannot go below 4x4.
-				// we introduce the "storage sizes" which are clamped, to compute the storage footprint.
-				
-				int storage_x,storage_y,storage_z;
-				
-				slicePtr->m_xSize = layout->m_key.m_xSize >> mip;
-				slicePtr->m_xSize = std::max( slicePtr->m_xSize, 1 );				// dimension can't go to zero
-				storage_x = std::max( slicePtr->m_xSize, formatDesc->m_chunkSize );	// storage extent can't go below chunk size
-				
-				slicePtr->m_ySize = layout->m_key.m_ySize >> mip;
-				slicePtr->m_ySize = std::max( slicePtr->m_ySize, 1 );				// dimension can't go to zero
-				storage_y = std::max( slicePtr->m_ySize, formatDesc->m_chunkSize );	// storage extent can't go below chunk size
-				
-				slicePtr->m_zSize = layout->m_key.m_zSize >> mip;
-				slicePtr->m_zSize = std::max( slicePtr->m_zSize, 1 );				// dimension can't go to zero
-				storage_z = std::max( slicePtr->m_zSize, 1);							// storage extent for Z cannot go below '1'.
-				
-				//if (compressed)  NO NO NO do not lie about the dimensionality, just fudge the storage.
-				//{
-				//	// round up to multiple of 4 in X and Y axes
-				//	slicePtr->m_xSize = (slicePtr->m_xSize+3) & (~3);
-				//	slicePtr->m_ySize = (slicePtr->m_ySize+3) & (~3);
-				//}
-				
-				int xchunks = (storage_x / formatDesc->m_chunkSize );
-				int ychunks = (storage_y / formatDesc->m_chunkSize );
-				
-				slicePtr->m_storageSize = (xchunks * ychunks * formatDesc->m_bytesPerSquareChunk) * storage_z;				
-				slicePtr->m_storageOffset = storageOffset;
-				
-				storageOffset += slicePtr->m_storageSize;
-				storageOffset = ( (storageOffset+0x0F) & (~0x0F));		// keep each MIP starting on a 16 byte boundary.
-				
-				slicePtr++;
-			}		
-		}
+		// assume non mipped
+		Assert( (key->m_texFlags & kGLMTexMipped) == 0 );
+		Assert( (key->m_texFlags & kGLMTexMippedAuto) == 0 );
 		
-		layout->m_storageTotalSize = storageOffset;
-		//printf("\n size %08x for key (x=%d y=%d z=%d, fmt=%08x, bpsc=%d)", layout->m_storageTotalSize, key->m_xSize, key->m_ySize, key->m_zSize, key->m_texFormat, formatDesc->m_bytesPerSquareChunk );
+		// assume renderable and srgb
+		Assert( (key->m_texFlags & kGLMTexRenderable) !=0 );
+		//Assert( (key->m_texFlags & kGLMTexSRGB) !=0 );			//FIXME don't assert on making depthstencil surfaces which are non srgb
 		
-		// generate summary
-		// "target, format, +/- mips, base size"
-		char scratch[1024];
+		// double check sample count (FIXME need real limit check here against device/driver)
+		Assert( (key->m_texSamples==2) || (key->m_texSamples==4) || (key->m_texSamples==6) || (key->m_texSamples==8) );
+	}
+	
+	// now we know enough to allocate and populate the new tex layout.
+	
+	// carve the new layout out of the pool
+	int layoutSize = sizeof( GLMTexLayout ) + (sliceCount * sizeof( GLMTexLayoutSlice ));
+	GLMTexLayout *layout = (GLMTexLayout *)m_pool.Alloc( layoutSize );
+	memset( layout, 0, layoutSize );
+	
+	// clone the key in there
+	memset( &layout->m_key, 0x00, sizeof(layout->m_key) );
+	layout->m_key = *key;
 
-		const char	*targetname;
-		switch( key->m_texGLTarget )
+	// set refcount
+	layout->m_refCount = 1;
+	
+	// save the format desc
+	layout->m_format = (GLMTexFormatDesc *)formatDesc;
+	
+	// we know the mipcount from before
+	layout->m_mipCount = mipCount;
+	
+	// we know the face count too
+	layout->m_faceCount = faceCount;
+	
+	// slice count is the product
+	layout->m_sliceCount = mipCount * faceCount;
+	
+	// we can now fill in the slices.
+	GLMTexLayoutSlice	*slicePtr = &layout->m_slices[0];
+	int					storageOffset = 0;
+	
+	bool compressed = (formatDesc->m_chunkSize > 1);	// true if DXT
+	
+	for( int mip = 0; mip < mipCount; mip ++ )
+	{
+		for( int face = 0; face < faceCount; face++ )
 		{
-			case GL_TEXTURE_2D:			targetname = "2D  ";		break;
-			case GL_TEXTURE_3D:			targetname = "3D  ";		break;
-			case GL_TEXTURE_CUBE_MAP:	targetname = "CUBE";		break;
-		}
-		
-		sprintf( scratch, "[%s %s %dx%dx%d mips=%d slices=%d flags=%02lX%s]",
-					targetname,
-					formatDesc->m_formatSummary,
-					layout->m_key.m_xSize, layout->m_key.m_ySize, layout->m_key.m_zSize,
-					mipCount,
-					sliceCount,
-					layout->m_key.m_texFlags,
-					(layout->m_key.m_texFlags & kGLMTexSRGB) ? " SRGB" : ""					
-				);
-		layout->m_layoutSummary = strdup( scratch );
-		//GLMPRINTF(("-D- new tex layout [ %s ]", scratch ));
-		
-		// then insert into map. disregard returned index.
-		m_layoutMap[ layout->m_key ] = layout;
-		
-		return layout;
+			// note application of chunk size which is 1 for uncompressed, and 4 for compressed tex (DXT)
+			// note also that the *dimensions* must scale down to 1
+			// but that the *storage* cannot go below 4x4.
+			// we introduce the "storage sizes" which are clamped, to compute the storage footprint.
+			
+			int storage_x,storage_y,storage_z;
+			
+			slicePtr->m_xSize = layout->m_key.m_xSize >> mip;
+			slicePtr->m_xSize = std::max( slicePtr->m_xSize, 1 );				// dimension can't go to zero
+			storage_x = std::max( slicePtr->m_xSize, formatDesc->m_chunkSize );	// storage extent can't go below chunk size
+			
+			slicePtr->m_ySize = layout->m_key.m_ySize >> mip;
+			slicePtr->m_ySize = std::max( slicePtr->m_ySize, 1 );				// dimension can't go to zero
+			storage_y = std::max( slicePtr->m_ySize, formatDesc->m_chunkSize );	// storage extent can't go below chunk size
+			
+			slicePtr->m_zSize = layout->m_key.m_zSize >> mip;
+			slicePtr->m_zSize = std::max( slicePtr->m_zSize, 1 );				// dimension can't go to zero
+			storage_z = std::max( slicePtr->m_zSize, 1);							// storage extent for Z cannot go below '1'.
+			
+			//if (compressed)  NO NO NO do not lie about the dimensionality, just fudge the storage.
+			//{
+			//	// round up to multiple of 4 in X and Y axes
+			//	slicePtr->m_xSize = (slicePtr->m_xSize+3) & (~3);
+			//	slicePtr->m_ySize = (slicePtr->m_ySize+3) & (~3);
+			//}
+			
+			int xchunks = (storage_x / formatDesc->m_chunkSize );
+			int ychunks = (storage_y / formatDesc->m_chunkSize );
+			
+			slicePtr->m_storageSize = (xchunks * ychunks * formatDesc->m_bytesPerSquareChunk) * storage_z;				
+			slicePtr->m_storageOffset = storageOffset;
+			
+			storageOffset += slicePtr->m_storageSize;
+			storageOffset = ( (storageOffset+0x0F) & (~0x0F));		// keep each MIP starting on a 16 byte boundary.
+			
+			slicePtr++;
+		}		
+	}
+	
+	layout->m_storageTotalSize = storageOffset;
+	//printf("\n size %08x for key (x=%d y=%d z=%d, fmt=%08x, bpsc=%d)", layout->m_storageTotalSize, key->m_xSize, key->m_ySize, key->m_zSize, key->m_texFormat, formatDesc->m_bytesPerSquareChunk );
+	
+	// generate summary
+	// "target, format, +/- mips, base size"
+	char scratch[1024];
+
+	const char	*targetname;
+	switch( key->m_texGLTarget )
+	{
+		case GL_TEXTURE_2D:			targetname = "2D  ";		break;
+		case GL_TEXTURE_3D:			targetname = "3D  ";		break;
+		case GL_TEXTURE_CUBE_MAP:	targetname = "CUBE";		break;
 	}
+	
+	sprintf( scratch, "[%s %s %dx%dx%d mips=%d slices=%d flags=%02lX%s]",
+				targetname,
+				formatDesc->m_formatSummary,
+				layout->m_key.m_xSize, layout->m_key.m_ySize, layout->m_key.m_zSize,
+				mipCount,
+				sliceCount,
+				layout->m_key.m_texFlags,
+				(layout->m_key.m_texFlags & kGLMTexSRGB) ? " SRGB" : ""					
+			);
+	layout->m_layoutSummary = m_pool.StrDup( scratch );
+	//GLMPRINTF(("-D- new tex layout [ %s ]", scratch ));
+	
+	return layout;
 }
 
 void CGLMTexLayoutTable::DelLayoutRef( GLMTexLayout *layout )
 {
-	// locate layout in hash, drop refcount
-
-	GLMTexLayoutKeyMap::iterator p = m_layoutMap.find( layout->m_key );
-	if (p != m_layoutMap.end())
-	{
-		// found it
-		GLMTexLayout *ptr = (*p).second;
-		
-		// drop ref count
-		ptr->m_refCount--;
-	}
+	// every layout handed out came from the table, so just drop its refcount
+	Assert( layout->m_refCount > 0 );
+	
+	layout->m_refCount--;
 }
 
 void CGLMTexLayoutTable::DumpStats( )
 {
-	for( GLMTexLayoutKeyMap::iterator p = m_layoutMap.begin(); p != m_layoutMap.end(); p++ )
+	for( uint i=0; i<m_capacity; i++ )
 	{
-		GLMTexLayout *layout = (*p).second;
+		GLMTexLayout *layout = m_entries[i].m_layout;
+		if (!layout)
+			continue;
 		
 		// print it out
 		printf("\n%05d instances %08d bytes  %08d totbytes  %s", layout->m_refCount, layout->m_storageTotalSize, (layout->m_refCount*layout->m_storageTotalSize), layout->m_layoutSummary );
 	}
+	
+	uint misses = m_lookups - m_hits;
+	printf("\n\ntex layout table: %d layouts in %d slots, %d lookups, %d hits (%.1f%%), %d misses, %.2f probes/lookup",
+		m_count, m_capacity, m_lookups, m_hits, m_lookups ? (100.0 * m_hits / m_lookups) : 0.0, misses, m_lookups ? ((double)m_probes / m_lookups) : 0.0 );
+	printf("\ntex layout memory: %d bytes table, %d bytes pool used of %d reserved\n",
+		(int)(m_capacity * sizeof(GLMTexLayoutTableEntry)), m_pool.m_bytesUsed, m_pool.m_bytesReserved );
 }
 
 #if 0
@@ -655,6 +830,7 @@ CGLMTex::CGLMTex( GLMContext *ctx, GLMTexLayout *layout, GLMTexSamplingParams *s
 	
 	// note sampling (copy values)
 	m_sampling = *sampling;
+	m_samplingSerial = 0;
 	
 	// note context owner
 	m_ctx = ctx;
@@ -760,8 +936,11 @@ CGLMTex::CGLMTex( GLMContext *ctx, GLMTexLayout *layout, GLMTexSamplingParams *s
 	// init lock count
 	// lock reqs are tracked by the owning context
 	m_lockCount = 0;
+	m_uploadsPending = 0;
+	m_preloadPending = false;
 
 	m_sliceFlags.resize( m_layout->m_sliceCount );
+	m_sliceUploadsPending.resize( m_layout->m_sliceCount, 0 );
 	for( int i=0; i< m_layout->m_sliceCount; i++)
 	{
 		m_sliceFlags[i] = 0;
@@ -983,6 +1162,8 @@ void CGLMTex::ApplySamplingParams( GLMTexSamplingParams *params, bool noCheck )
 {
 	#define DIFF(fff) (noCheck || (params->fff != m_sampling.fff))
 	
+	GLMTexSamplingParams prevSampling = m_sampling;		// to decide whether m_samplingSerial should move
+	
 	GLenum target = m_layout->m_key.m_texGLTarget;
 
 	// if the texture is compressed, and has a maxActiveMip that is >=0 but less than the mip count,
@@ -1091,6 +1272,11 @@ void CGLMTex::ApplySamplingParams( GLMTexSamplingParams *params, bool noCheck )
 		m_sampling.m_srgb	=	params->m_srgb;	// we might have to re-DL the tex if the SRGB read status changes..
 	}
 	
+	if (noCheck || memcmp( &prevSampling, &m_sampling, sizeof(m_sampling) ) )
+	{
+		m_samplingSerial++;
+	}
+	
 	#undef DIFF
 }
 
@@ -1175,7 +1361,7 @@ void CGLMTex::ReadTexels( GLMTexLockDesc *desc, bool readWholeSlice )
 int gl_enabletexsubimage = 1;
 //ConVar	gl_enabletexsubimage( "gl_enabletexsubimage", "1" );
 
-void CGLMTex::WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice, bool noDataWrite )
+void CGLMTex::WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice, bool noDataWrite, GLMTexUploadJob *staged )
 {
 	GLMRegion	writeBox;
 
@@ -1224,7 +1410,12 @@ void CGLMTex::WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice, bool noDa
 	GLenum glDataType	= format->m_glDataType;
 	
 	GLMTexLayoutSlice *slice = &m_layout->m_slices[ desc->m_sliceIndex ];		
-	void *sliceAddress = m_backing ? (m_backing + slice->m_storageOffset) : NULL;	// this would change for PBO
+	void *sliceAddress = m_backing ? (m_backing + slice->m_storageOffset) : NULL;
+	if (staged)
+	{
+		// the PBO is bound, so the "address" is an offset into it
+		sliceAddress = (void *)(uintptr_t)staged->m_dstOffset;
+	}
 
 	// allow use of subimage if the target is texture2D and it has already been teximage'd
 	bool mayUseSubImage = false;
@@ -1260,6 +1451,7 @@ void CGLMTex::WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice, bool noDa
 	if (desc->m_req.m_mip > m_maxActiveMip)
 	{
 		m_maxActiveMip = desc->m_req.m_mip;
+		m_samplingSerial++;		// LOD clamps in ApplySamplingParams depend on this
 
 		glTexParameteri( target, GL_TEXTURE_MAX_LEVEL, desc->m_req.m_mip);
 		GLMCheckError();
@@ -1268,6 +1460,7 @@ void CGLMTex::WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice, bool noDa
 	if (desc->m_req.m_mip < m_minActiveMip)
 	{
 		m_minActiveMip = desc->m_req.m_mip;
+		m_samplingSerial++;
 		
 		glTexParameteri( target, GL_TEXTURE_BASE_LEVEL, desc->m_req.m_mip);
 		GLMCheckError();
@@ -1281,27 +1474,18 @@ void CGLMTex::WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice, bool noDa
 		{
 			case D3DFMT_V8U8:
 			{
-				// figure out new size based on 3byte RGB format
-				// easy, just take the two byte size and grow it by 50%
-				expandSize = (slice->m_storageSize * 3) / 2;
-				expandTemp = (char*)malloc( expandSize );
-				
-				char *src = (char*)sliceAddress;
-				char *dst = expandTemp;
-
-				// transfer RG's to RGB's
-				while(expandSize>0)
+				// a staged slice was already expanded by the upload queue's worker
+				if (!staged)
 				{
-					*dst = *src++;	// move first byte
-					*dst = *src++;	// move second byte
-					*dst = 0xBB;	// pad third byte
+					expandSize = CGLMTexUploadQueue::StagedSize( D3DFMT_V8U8, slice->m_storageSize );
+					expandTemp = (char*)malloc( expandSize );
+					
+					CGLMTexUploadQueue::StageTexels( D3DFMT_V8U8, (char*)sliceAddress, slice->m_storageSize, expandTemp );
 					
-					expandSize -= 3;
+					// move the slice pointer
+					sliceAddress = expandTemp;
 				}
 				
-				// move the slice pointer
-				sliceAddress = expandTemp;
-				
 				// change the data format we tell GL about
 				glDataFormat = GL_RGB;
 			}
@@ -1483,6 +1667,10 @@ void CGLMTex::Lock( GLMTexLockParams *params, char** addressOut, int* yStrideOut
 	// locate appropriate slice in layout record
 	int sliceIndex = CalcSliceIndex( params->m_face, params->m_mip );
 	
+	// the upload worker may still be reading this slice's backing store.  slices don't overlap in it, so a
+	// loader locking one level at a time doesn't wait on the level it just unlocked.
+	m_ctx->FinishTexUploads( this, sliceIndex );
+	
 	GLMTexLayoutSlice *slice = &m_layout->m_slices[sliceIndex];
 
 	// obtain offset
@@ -1672,6 +1860,8 @@ void CGLMTex::Unlock( GLMTexLockParams *params )
 		// scan through all the retired locks for this texture and push the texels for each one.
 		// after each one is dispatched, remove it from the pile.
 		
+		std::vector< GLMTexLockDesc > writes;
+		
 		int j=0;
 		while( j<m_ctx->m_texLocks.size() )
 		{
@@ -1685,32 +1875,7 @@ void CGLMTex::Unlock( GLMTexLockParams *params )
 					GLMStop();
 				}
 				
-				// write the texels
-				bool fullyDirty = false;
-				
-				fullyDirty |= ((m_sliceFlags[ desc->m_sliceIndex ] & kSliceFullyDirty) != 0);
-
-				// this is not optimal and will result in full downloads on any dirty.
-				// we're papering over the fact that subimage isn't done yet.
-				// but this is safe if the slice of storage is all valid.
-				
-				// at some point we'll need to actually compare the lock box against the slice bounds.
-				
-				// fullyDirty |= (m_sliceFlags[ desc->m_sliceIndex ] & kSliceStorageValid);
-				
-				WriteTexels( desc, fullyDirty  );
-
-				// logical place to trigger preloading
-				// only do it for an RT tex, if it is not yet attached to any FBO.
-				// also, only do it if the slice number is the last slice in the tex.
-				if ( desc->m_sliceIndex == (m_layout->m_sliceCount-1) )
-				{
-					if ( !(m_layout->m_key.m_texFlags & kGLMTexRenderable) || (m_rtAttachCount==0) )
-					{
-						m_ctx->PreloadTex( this );
-						// printf("( slice %d of %d )", desc->m_sliceIndex, m_layout->m_sliceCount );
-					}
-				}
+				writes.push_back( *desc );
 
 				m_ctx->m_texLocks.erase( m_ctx->m_texLocks.begin() + j );	// remove from the pile, don't advance index
 			}
@@ -1720,6 +1885,30 @@ void CGLMTex::Unlock( GLMTexLockParams *params )
 			}
 		}
 		
+		for( j=0; j<writes.size(); j++ )
+		{
+			GLMTexLockDesc *desc = &writes[j];
+			
+			// write the texels
+			bool fullyDirty = false;
+			
+			fullyDirty |= ((m_sliceFlags[ desc->m_sliceIndex ] & kSliceFullyDirty) != 0);
+
+			// this is not optimal and will result in full downloads on any dirty.
+			// we're papering over the fact that subimage isn't done yet.
+			// but this is safe if the slice of storage is all valid.
+			
+			// at some point we'll need to actually compare the lock box against the slice bounds.
+			
+			// fullyDirty |= (m_sliceFlags[ desc->m_sliceIndex ] & kSliceStorageValid);
+			
+			if ( !m_ctx->m_texUploadQueue->Queue( this, desc, fullyDirty ) )
+			{
+				WriteTexels( desc, fullyDirty  );
+				SliceWritten( desc->m_sliceIndex );
+			}
+		}
+		
 		// clear the locked and full-dirty flags for all slices
 		for( int slice=0; slice < m_layout->m_sliceCount; slice++)
 		{
@@ -1729,6 +1918,28 @@ void CGLMTex::Unlock( GLMTexLockParams *params )
 }
 
 
+void	CGLMTex::SliceWritten( int sliceIndex )
+{
+	// logical place to trigger preloading
+	// only do it for an RT tex, if it is not yet attached to any FBO.
+	// also, only do it once the last slice in the tex has been written - and, since queued uploads
+	// are issued mip tail first, not until every queued slice has landed.
+	if ( sliceIndex == (m_layout->m_sliceCount-1) )
+	{
+		m_preloadPending = true;
+	}
+	
+	if ( m_preloadPending && !m_uploadsPending )
+	{
+		m_preloadPending = false;
+		if ( !(m_layout->m_key.m_texFlags & kGLMTexRenderable) || (m_rtAttachCount==0) )
+		{
+			m_ctx->PreloadTex( this );
+			// printf("( slice %d of %d )", sliceIndex, m_layout->m_sliceCount );
+		}
+	}
+}
+
 void	CGLMTex::ResetSRGB( bool srgb, bool noDataWrite )
 {
 	// see if requested SRGB state differs from the known one
@@ -1737,6 +1948,9 @@ void	CGLMTex::ResetSRGB( bool srgb, bool noDataWrite )
 	
 	if (srgb != wasSRGB)
 	{
+		// queued uploads were converted for the old layout, get them in first
+		m_ctx->FinishTexUploads( this );
+		
 		// we're going to need a new layout (though the storage size should be the same - check it)
 		GLMTexLayoutKey newKey = m_layout->m_key;
 		
@@ -1814,3 +2028,266 @@ void	CGLMTex::ResetSRGB( bool srgb, bool noDataWrite )
 		m_ctx->BindTexToTMU( tmu0save, 0, true );
 	}
 }
+
+//===============================================================================
+
+	// gl_texstream: non zero means texels written at unlock time are staged by a worker thread and uploaded from a PBO.
+	// needs persistently mapped buffers (m_hasBufferStorage); without them everything goes direct as before.
+	// gl_texstream_pbo_size is the size of one staging window; slices bigger than that go direct.
+
+//ConVar	gl_texstream( "gl_texstream", "1" );
+//ConVar	gl_texstream_pbo_size( "gl_texstream_pbo_size", "8388608" );
+int gl_texstream = 1;
+int gl_texstream_pbo_size = 8*1024*1024;
+
+CGLMTexUploadQueue::CGLMTexUploadQueue( GLMContext *ctx )
+{
+	m_ctx = ctx;
+	m_pbo = NULL;
+	m_pboCursor = 0;
+	m_outstanding = 0;
+	m_quit = false;
+
+	if (gl_texstream /*.GetInt()*/ && m_ctx->Caps().m_hasBufferStorage)
+	{
+		// dynamic gets it the persistently mapped ring, which is what lets the worker write into it
+		m_pbo = m_ctx->NewBuffer( kGLMPixelBuffer, gl_texstream_pbo_size /*.GetInt()*/, GLMBufferOptionDynamic );
+		if (!m_pbo->m_ring)
+		{
+			m_ctx->DelBuffer( m_pbo );
+			m_pbo = NULL;
+		}
+	}
+}
+
+CGLMTexUploadQueue::~CGLMTexUploadQueue()
+{
+	// textures still point at their jobs, so land them
+	FinishAll();
+	
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_quit = true;
+	}
+	m_wakeWorker.notify_one();
+	
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	
+	if (m_pbo)
+	{
+		m_ctx->DelBuffer( m_pbo );
+		m_pbo = NULL;
+	}
+}
+
+uint CGLMTexUploadQueue::StagedSize( D3DFORMAT format, uint srcSize )
+{
+	switch( format )
+	{
+		case D3DFMT_V8U8:	return (srcSize / 2) * 3;		// GL gets it as RGB8
+		default:			return srcSize;
+	}
+}
+
+void CGLMTexUploadQueue::StageTexels( D3DFORMAT format, const char *src, uint srcSize, char *dst )
+{
+	switch( format )
+	{
+		case D3DFMT_V8U8:
+		{
+			// transfer RG's to RGB's
+			for( uint i=0; i<srcSize; i+=2 )
+			{
+				*dst++ = *src++;	// move first byte
+				*dst++ = *src++;	// move second byte
+				*dst++ = 0xBB;		// pad third byte
+			}
+		}
+		break;
+		
+		default:
+			memcpy( dst, src, srcSize );
+		break;
+	}
+}
+
+bool CGLMTexUploadQueue::Queue( CGLMTex *tex, GLMTexLockDesc *desc, bool writeWholeSlice )
+{
+	if ( !m_pbo || !gl_texstream /*.GetInt()*/ || !tex->m_backing )
+	{
+		return false;
+	}
+	
+	GLMTexLayoutSlice *slice = &tex->m_layout->m_slices[ desc->m_sliceIndex ];
+	D3DFORMAT format = tex->m_layout->m_format->m_d3dFormat;
+	uint srcSize = slice->m_storageSize;
+	uint dstSize = StagedSize( format, srcSize );
+	
+	if (dstSize > m_pbo->m_size)
+	{
+		return false;		// won't ever fit, send it direct
+	}
+
+	GLMBuffLockParams lockreq;
+	lockreq.m_offset = (m_pboCursor + 63) & ~63;
+	lockreq.m_size = dstSize;
+	lockreq.m_nonblocking = true;
+	lockreq.m_discard = false;
+	
+	if (lockreq.m_offset + dstSize > m_pbo->m_size)
+	{
+		// window full.  everything staged in it has to be issued before the ring fences it and moves on.
+		FinishAll();
+		
+		lockreq.m_offset = 0;
+		lockreq.m_discard = true;
+	}
+	
+	// the ring stays mapped after the unlock, so the pointer is good until this window is retired
+	char *dst = NULL;
+	m_pbo->Lock( &lockreq, &dst );
+	m_pbo->Unlock();
+	m_ctx->BindBufferToCtx( kGLMPixelBuffer, NULL );		// Lock bound it - don't leave it there for direct teximages
+	
+	m_pboCursor = lockreq.m_offset + dstSize;
+	
+	GLMTexUploadJob *job = new GLMTexUploadJob;
+	job->m_tex = tex;
+	job->m_desc = *desc;
+	job->m_writeWholeSlice = writeWholeSlice;
+	job->m_src = tex->m_backing + slice->m_storageOffset;
+	job->m_srcSize = srcSize;
+	job->m_dst = dst;
+	job->m_dstOffset = m_pbo->m_ringBase + lockreq.m_offset;
+	job->m_format = format;
+	
+	// from here on GL is fed from the PBO, so client storage (which would point GL at the backing store) goes away
+	tex->m_texClientStorage = false;
+	tex->m_uploadsPending++;
+	tex->m_sliceUploadsPending[ desc->m_sliceIndex ]++;
+	m_outstanding++;
+	
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		if (!m_thread.joinable())
+		{
+			m_thread = std::thread( &CGLMTexUploadQueue::ThreadFunc, this );
+		}
+		m_pending.push_back( job );
+	}
+	m_wakeWorker.notify_one();
+	
+	return true;
+}
+
+static bool LessThan_GLMTexUploadJobMip( const GLMTexUploadJob *a, const GLMTexUploadJob *b )
+{
+	return a->m_desc.m_req.m_mip > b->m_desc.m_req.m_mip;
+}
+
+void CGLMTexUploadQueue::Service( void )
+{
+	// take everything the worker has finished in one go and issue it smallest mip first.  loaders unlock
+	// one level at a time starting from the biggest, so this is what gets the mip tail in ahead of them.
+	// stable, so repeat uploads of one slice still go in the order they were queued.
+	std::vector< GLMTexUploadJob* > batch;
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		batch.assign( m_staged.begin(), m_staged.end() );
+		m_staged.clear();
+	}
+	
+	std::stable_sort( batch.begin(), batch.end(), LessThan_GLMTexUploadJobMip );
+	
+	for( uint i=0; i<batch.size(); i++ )
+	{
+		IssueJob( batch[i] );
+	}
+}
+
+void CGLMTexUploadQueue::FinishTex( CGLMTex *tex, int sliceIndex )
+{
+	// jobs issue in queue order, so keep issuing until the last of the ones we're waiting on is out
+	while( (sliceIndex < 0) ? tex->m_uploadsPending : tex->m_sliceUploadsPending[sliceIndex] )
+	{
+		GLMTexUploadJob *job = NULL;
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			while( m_staged.empty() )
+			{
+				m_wakeContext.wait( lock );
+			}
+			job = m_staged.front();
+			m_staged.pop_front();
+		}
+		
+		IssueJob( job );
+	}
+}
+
+void CGLMTexUploadQueue::FinishAll( void )
+{
+	while( m_outstanding )
+	{
+		GLMTexUploadJob *job = NULL;
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			while( m_staged.empty() )
+			{
+				m_wakeContext.wait( lock );
+			}
+			job = m_staged.front();
+			m_staged.pop_front();
+		}
+		
+		IssueJob( job );
+	}
+}
+
+void CGLMTexUploadQueue::IssueJob( GLMTexUploadJob *job )
+{
+	CGLMTex *tex = job->m_tex;
+	
+	m_ctx->BindBufferToCtx( kGLMPixelBuffer, m_pbo );
+	tex->WriteTexels( &job->m_desc, job->m_writeWholeSlice, false, job );
+	m_ctx->BindBufferToCtx( kGLMPixelBuffer, NULL );
+	
+	tex->m_uploadsPending--;
+	tex->m_sliceUploadsPending[ job->m_desc.m_sliceIndex ]--;
+	m_outstanding--;
+	
+	tex->SliceWritten( job->m_desc.m_sliceIndex );
+	
+	delete job;
+}
+
+void CGLMTexUploadQueue::ThreadFunc( void )
+{
+	// no GL in here, just texel copies
+	std::unique_lock< std::mutex > lock( m_mutex );
+	for(;;)
+	{
+		while( !m_quit && m_pending.empty() )
+		{
+			m_wakeWorker.wait( lock );
+		}
+		if (m_quit)
+		{
+			return;
+		}
+		
+		// leave it at the front while working on it, the context only looks at m_staged
+		GLMTexUploadJob *job = m_pending.front();
+		lock.unlock();
+		
+		StageTexels( job->m_format, job->m_src, job->m_srcSize, job->m_dst );
+		
+		lock.lock();
+		m_pending.pop_front();
+		m_staged.push_back( job );
+		m_wakeContext.notify_one();
+	}
+}
@@ -14,6 +14,11 @@
 #include "glmgrbasics.h"
 #endif
 
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
 //===============================================================================
 
 // forward declarations
@@ -22,6 +27,9 @@ class	GLMContext;
 class	GLMTester;
 class	CGLMTexLayoutTable;
 class	CGLMTex;
+class	CGLMTexUploadQueue;
+class	CGLMBuffer;
+struct	GLMTexUploadJob;
 class	CGLMFBO;
 
 struct	IDirect3DSurface9;
@@ -99,22 +107,19 @@ struct GLMTexLayoutKey
 	int					m_xSize,m_ySize,m_zSize;	// size of base mip
 };
 
-struct LessThan_GLMTexLayoutKey
+// GLMTexLayoutKey squeezed into four words - this is what the layout table hashes and compares.
+// unlike the old map ordering, the sample count is part of the key.
+struct GLMTexLayoutPackedKey
 {
-	bool operator()(const GLMTexLayoutKey &a, const GLMTexLayoutKey &b) const
-	{
-		#define	DO_LESS(fff) if (a.fff != b.fff) { return (a.fff< b.fff); }
+	uint		m_words[4];
 	
-		DO_LESS(m_texGLTarget);
-		DO_LESS(m_texFormat);
-		DO_LESS(m_texFlags);
-		DO_LESS(m_xSize);
-		DO_LESS(m_ySize)
-		DO_LESS(m_zSize);
+	void		Pack( const GLMTexLayoutKey *key );
+	uint		Hash( void ) const;
 	
-		#undef DO_LESS
-		
-		return false;	// they are equal
+	bool operator==(const GLMTexLayoutPackedKey &other) const
+	{
+		return	(m_words[0] == other.m_words[0]) && (m_words[1] == other.m_words[1])
+			&&	(m_words[2] == other.m_words[2]) && (m_words[3] == other.m_words[3]);
 	}
 };
 
@@ -143,18 +148,65 @@ struct GLMTexLayout
 	GLMTexLayoutSlice	m_slices[0];				// dynamically allocated 2-d array [faces][mips]
 };
 
-typedef std::map< GLMTexLayoutKey, GLMTexLayout*, LessThan_GLMTexLayoutKey >	GLMTexLayoutKeyMap;
+// bump allocator for layouts (with their slice arrays) and summary strings.
+// layouts are never freed one at a time - DelLayoutRef only drops the refcount - so it all goes back when the table dies.
+class	CGLMTexLayoutPool
+{
+public:
+					CGLMTexLayoutPool();
+					~CGLMTexLayoutPool();
+	
+	void			*Alloc( uint size );						// 16 byte aligned, not cleared
+	char			*StrDup( const char *str );
+
+	uint			m_bytesUsed;								// handed out
+	uint			m_bytesReserved;							// malloc'd in blocks
+protected:
+	struct Block
+	{
+		Block		*m_next;
+		uint		m_size;
+		uint		m_used;
+	};
+	Block			*m_blocks;									// head is the one being carved up
+};
+
+struct GLMTexLayoutTableEntry
+{
+	GLMTexLayoutPackedKey	m_key;
+	uint					m_hash;
+	GLMTexLayout			*m_layout;						// NULL means an empty slot
+};
+
+#define	GLM_TEX_LAYOUT_TABLE_MIN_LG2	8
+
+// open addressed (linear probe) hash of every layout ever made.  entries are never removed.
 class	CGLMTexLayoutTable
 {
 public:
 					CGLMTexLayoutTable();
+					~CGLMTexLayoutTable();
 	
 	GLMTexLayout	*NewLayoutRef( GLMTexLayoutKey *key );		// pass in a pointer to layout key - receive ptr to completed layout
 	void			DelLayoutRef( GLMTexLayout *layout );		// pass in pointer to completed layout.  refcount is dropped.
 	
 	void			DumpStats( void );
 protected:
-	GLMTexLayoutKeyMap	m_layoutMap;
+	uint			FindSlot( const GLMTexLayoutPackedKey &key, uint hash );	// slot holding key, or the empty one it would go in
+	void			Grow( void );
+	GLMTexLayout	*MakeLayout( GLMTexLayoutKey *key, const GLMTexFormatDesc *formatDesc );
+	
+	GLMTexLayoutTableEntry	*m_entries;						// array[ m_capacity ]
+	uint					m_capacityLg2;
+	uint					m_capacity;
+	uint					m_count;
+	
+	CGLMTexLayoutPool		m_pool;
+	
+	// stats
+	uint					m_lookups;
+	uint					m_hits;
+	uint					m_probes;						// slots looked at past the first, over all lookups
 };
 
 //===============================================================================
@@ -232,6 +284,7 @@ protected:
 	friend class GLMContext;			// only GLMContext can make CGLMTex objects
 	friend class GLMTester;
 	friend class CGLMFBO;
+	friend class CGLMTexUploadQueue;
 
 	friend struct IDirect3DDevice9;
 	friend struct IDirect3DBaseTexture9;
@@ -249,9 +302,14 @@ protected:
 	void					ApplySamplingParams( GLMTexSamplingParams *params, bool noCheck=FALSE );
 
 	void					ReadTexels( GLMTexLockDesc *desc, bool readWholeSlice=true );
-	void					WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice=true, bool noDataWrite=false );
-		// last param lets us send NULL data ptr (only legal with uncompressed formats, beware)
+	void					WriteTexels( GLMTexLockDesc *desc, bool writeWholeSlice=true, bool noDataWrite=false, GLMTexUploadJob *staged=NULL );
+		// noDataWrite lets us send NULL data ptr (only legal with uncompressed formats, beware)
 		// this helps out ResetSRGB.
+		// staged means the upload queue left the slice in the bound PBO, already converted - source it from there.
+
+	void					SliceWritten( int sliceIndex );
+		// called once a slice's texels went to GL from an unlock - kicks off preloading once the last slice
+		// has been written and no queued uploads are left
 	
 	void					ResetSRGB( bool srgb, bool noDataWrite );
 		// re-specify texture format to match desired sRGB form
@@ -263,6 +321,7 @@ protected:
 				
 	GLMTexSamplingParams	m_sampling;		// mirror of sampling params currently embodied in the texture
 											// (consult this at draw time, in order to know if changes need to be made)
+	uint					m_samplingSerial;	// bumps whenever m_sampling or the active mip range changes - lets the context skip ApplySamplingParams
 						
 	GLMContext				*m_ctx;			// link back to parent context
 
@@ -281,11 +340,75 @@ protected:
 	char					*m_backing;		// backing storage if available
 	
 	int						m_lockCount;	// lock reqs are stored in the GLMContext for tracking
+	int						m_uploadsPending;	// slices sitting in the context's upload queue, not issued to GL yet
+	bool					m_preloadPending;	// last slice written, preload once m_uploadsPending drops to 0
 
 	std::vector<unsigned char>	m_sliceFlags;
+	std::vector<int>			m_sliceUploadsPending;	// m_uploadsPending broken down per slice
 	
 	char					*m_debugLabel;	// strdup() of debugLabel passed in, or NULL
 };
 
+//===============================================================================
+
+// asynchronous texel upload.
+// at unlock time the context thread reserves room in a persistently mapped PBO ring and queues a job;
+// a worker thread copies (and converts, for formats like V8U8) the slice from the texture's backing store
+// into that room.  the context thread then issues the PBO-sourced teximage later - whenever it comes
+// through Service(), or right away for a texture that is about to be drawn, locked, blitted or deleted.
+
+struct GLMTexUploadJob
+{
+	CGLMTex			*m_tex;
+	GLMTexLockDesc	m_desc;
+	bool			m_writeWholeSlice;
+
+	const char		*m_src;				// slice in the texture's backing store
+	uint			m_srcSize;
+	char			*m_dst;				// room in the mapped PBO
+	uint			m_dstOffset;		// where that is in the GL buffer
+	D3DFORMAT		m_format;			// decides the conversion, if any
+};
+
+class	CGLMTexUploadQueue
+{
+public:
+					CGLMTexUploadQueue( GLMContext *ctx );
+					~CGLMTexUploadQueue();
+	
+	bool			Enabled( void ) { return m_pbo != NULL; }
+
+	// true if the slice was queued.  false means the caller should just WriteTexels it now.
+	bool			Queue( CGLMTex *tex, GLMTexLockDesc *desc, bool writeWholeSlice );
+
+	void			Service( void );					// issue whatever the worker has finished, doesn't wait
+	void			FinishTex( CGLMTex *tex, int sliceIndex=-1 );	// wait for and issue everything queued for tex (or just that slice of it)
+	void			FinishAll( void );
+
+	static uint		StagedSize( D3DFORMAT format, uint srcSize );
+	static void		StageTexels( D3DFORMAT format, const char *src, uint srcSize, char *dst );
+	
+protected:
+	void			IssueJob( GLMTexUploadJob *job );
+	void			ThreadFunc( void );
+	
+	GLMContext		*m_ctx;
+	
+	CGLMBuffer		*m_pbo;								// staging ring, NULL if it couldn't be persistently mapped
+	uint			m_pboCursor;						// next free byte in the live window
+
+	uint			m_outstanding;						// jobs queued and not issued yet
+
+	// everything below m_mutex is shared with the worker
+	std::thread		m_thread;
+	std::mutex		m_mutex;
+	std::condition_variable	m_wakeWorker;
+	std::condition_variable	m_wakeContext;
+	bool			m_quit;
+	
+	std::deque< GLMTexUploadJob* >	m_pending;			// waiting for the worker, in queue order
+	std::deque< GLMTexUploadJob* >	m_staged;			// done by the worker, waiting to be issued, still in queue order
+};
+
 
 #endif
@@ -0,0 +1,454 @@
+//============ Copyright (c) Valve Corporation, All rights reserved. ============
+//
+// d3dtoglbench.cpp
+//	headless driver for the D3DToGL shader translator.
+//
+//	Feeds a corpus of DX9 shader bytecode files through D3DToGL::TranslateShader
+//	in ARB and GLSL mode, reports throughput (shaders/sec, bytes/sec) and peak
+//	memory, and diffs each translation against golden text.  No GL context is
+//	created, so this runs on a build box with no display.
+//
+//	usage: d3dtoglbench [options] shader.cso [shader.cso ...]
+//		-iters <n>		translate each shader n times per mode for timing (default 100)
+//		-golden <dir>	compare against <dir>/<name>.arb and <dir>/<name>.glsl
+//		-update			(re)write the golden files instead of comparing
+//		-arb / -glsl	only run the one translator
+//		-synth <n>		also run a generated vs_2_0 with n ALU instructions, for timing
+//						the emitters on programs longer than anything in the corpus
+//
+//	exit code is non zero if any shader failed to load, translate or match.
+//
+//===============================================================================
+
+#include "../dxabstract.h"
+#include "../dx9asmtogl2.h"
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+//===============================================================================
+// the translator only needs a handful of symbols from the rest of glmgr, supply
+// them here so the tool doesn't have to drag in the context / display code.
+
+#ifndef OSX
+// on OSX this comes from CoreServices
+extern "C" void Debugger( void )
+{
+}
+#endif
+
+int	V_stricmp( const char *s1, const char *s2 )
+{
+	return strcasecmp( s1, s2 );
+}
+
+const char* GLMDecode( GLMThing_t type, unsigned long value )
+{
+	// only reached from spew paths - no decode tables in the bench
+	static char buf[32];
+	snprintf( buf, sizeof(buf), "0x%lx", value );
+	return buf;
+}
+
+//===============================================================================
+
+enum ETranslationMode
+{
+	eModeARB,
+	eModeGLSL,
+	eModeCount
+};
+
+static const char *g_szModeNames[eModeCount] = { "arb", "glsl" };
+
+struct BenchShader_t
+{
+	std::string				m_name;			// file name without directory or extension
+	std::string				m_path;
+	std::vector<uint32>		m_code;			// bytecode, dword aligned as the translator expects
+	uint					m_byteSize;
+	bool					m_bVertexShader;
+	bool					m_bSynthetic;	// generated, no golden to check against
+};
+
+struct BenchTotals_t
+{
+	double		m_seconds;
+	uint64		m_shaders;
+	uint64		m_bytesIn;
+	uint64		m_bytesOut;
+};
+
+static double BenchTime( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+static uint64 BenchPeakMemory( void )
+{
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+#ifdef OSX
+	return (uint64)usage.ru_maxrss;				// bytes on OSX
+#else
+	return (uint64)usage.ru_maxrss * 1024;		// kilobytes elsewhere
+#endif
+}
+
+static bool ReadWholeFile( const char *path, std::string *out )
+{
+	FILE *f = fopen( path, "rb" );
+	if ( !f )
+		return false;
+
+	out->clear();
+	char buf[4096];
+	size_t n;
+	while ( ( n = fread( buf, 1, sizeof(buf), f ) ) > 0 )
+	{
+		out->append( buf, n );
+	}
+	fclose( f );
+	return true;
+}
+
+static bool WriteWholeFile( const char *path, const std::string &data )
+{
+	FILE *f = fopen( path, "wb" );
+	if ( !f )
+		return false;
+
+	bool ok = fwrite( data.data(), 1, data.size(), f ) == data.size();
+	fclose( f );
+	return ok;
+}
+
+static bool LoadShader( const char *path, BenchShader_t *pShader )
+{
+	std::string bytes;
+	if ( !ReadWholeFile( path, &bytes ) || bytes.size() < sizeof(uint32) * 2 )
+	{
+		fprintf( stderr, "%s: can't read shader bytecode\n", path );
+		return false;
+	}
+
+	pShader->m_path = path;
+	const char *pSlash = strrchr( path, '/' );
+	pShader->m_name = pSlash ? pSlash + 1 : path;
+	size_t dot = pShader->m_name.rfind( '.' );
+	if ( dot != std::string::npos && dot != 0 )
+	{
+		pShader->m_name.resize( dot );
+	}
+
+	pShader->m_byteSize = (uint)bytes.size();
+	pShader->m_code.assign( ( bytes.size() + sizeof(uint32) - 1 ) / sizeof(uint32), 0 );
+	memcpy( &pShader->m_code[0], bytes.data(), bytes.size() );
+
+	// 0xFFFF.... is a pixel shader version token, 0xFFFE.... a vertex shader
+	uint32 version = pShader->m_code[0];
+	if ( ( version & 0xFFFF0000 ) != 0xFFFF0000 && ( version & 0xFFFF0000 ) != 0xFFFE0000 )
+	{
+		fprintf( stderr, "%s: not DX9 shader bytecode (version token 0x%08x)\n", path, version );
+		return false;
+	}
+	pShader->m_bVertexShader = ( version & 0xFFFF0000 ) == 0xFFFE0000;
+	pShader->m_bSynthetic = false;
+
+	return true;
+}
+
+static uint32 SynthDestParam( D3DSHADER_PARAM_REGISTER_TYPE type, uint32 reg )
+{
+	return 0x80000000 | ( ( type << D3DSP_REGTYPE_SHIFT ) & D3DSP_REGTYPE_MASK ) | D3DSP_WRITEMASK_ALL | reg;
+}
+
+static uint32 SynthSrcParam( D3DSHADER_PARAM_REGISTER_TYPE type, uint32 reg )
+{
+	return 0x80000000 | ( ( type << D3DSP_REGTYPE_SHIFT ) & D3DSP_REGTYPE_MASK ) | D3DVS_NOSWIZZLE | reg;
+}
+
+static uint32 SynthInstruction( D3DSHADER_INSTRUCTION_OPCODE_TYPE opcode, uint32 nParams )
+{
+	return opcode | ( nParams << D3DSI_INSTLENGTH_SHIFT );
+}
+
+// vs_2_0 with one input, a chain of nInstructions mads over the temps and one output
+static void SynthesizeShader( int nInstructions, BenchShader_t *pShader )
+{
+	char name[64];
+	V_snprintf( name, sizeof(name), "synth%d", nInstructions );
+	pShader->m_name = name;
+	pShader->m_path = name;
+	pShader->m_bVertexShader = true;
+	pShader->m_bSynthetic = true;
+
+	std::vector<uint32> &code = pShader->m_code;
+	code.clear();
+	code.push_back( 0xFFFE0200 );
+
+	code.push_back( SynthInstruction( D3DSIO_DCL, 2 ) );
+	code.push_back( 0x80000000 | D3DDECLUSAGE_POSITION );
+	code.push_back( SynthDestParam( D3DSPR_INPUT, 0 ) );
+
+	code.push_back( SynthInstruction( D3DSIO_MOV, 2 ) );
+	code.push_back( SynthDestParam( D3DSPR_TEMP, 0 ) );
+	code.push_back( SynthSrcParam( D3DSPR_INPUT, 0 ) );
+
+	for ( int i = 0; i < nInstructions; i++ )
+	{
+		code.push_back( SynthInstruction( D3DSIO_MAD, 4 ) );
+		code.push_back( SynthDestParam( D3DSPR_TEMP, ( i % 7 ) + 1 ) );
+		code.push_back( SynthSrcParam( D3DSPR_TEMP, i % 7 ) );
+		code.push_back( SynthSrcParam( D3DSPR_CONST, i % 32 ) );
+		code.push_back( SynthSrcParam( D3DSPR_TEMP, ( i % 7 ) + 1 ) );
+	}
+
+	code.push_back( SynthInstruction( D3DSIO_MOV, 2 ) );
+	code.push_back( SynthDestParam( D3DSPR_RASTOUT, 0 ) );
+	code.push_back( SynthSrcParam( D3DSPR_TEMP, 1 ) );
+
+	code.push_back( D3DSIO_END );
+	pShader->m_byteSize = (uint)( code.size() * sizeof(uint32) );
+}
+
+// same option sets IDirect3DDevice9::CreateVertexShader / CreatePixelShader use, minus the caps dependent bits
+static uint32 TranslationOptions( ETranslationMode mode, bool bVertexShader )
+{
+	uint32 options = D3DToGL_OptionUseEnvParams;
+
+	if ( mode == eModeGLSL )
+	{
+		options |= D3DToGL_OptionGLSL;
+	}
+
+	if ( bVertexShader )
+	{
+		options |= D3DToGL_OptionDoFixupZ | D3DToGL_OptionDoFixupY;
+	}
+
+	return options;
+}
+
+static void Translate( D3DToGL *pTranslator, CUtlBuffer *pBuf, BenchShader_t *pShader, ETranslationMode mode )
+{
+	bool bVertexShader = false;
+	char debugLabel[256];
+
+	V_strncpy( debugLabel, pShader->m_name.c_str(), sizeof(debugLabel) - 1 );
+	debugLabel[ sizeof(debugLabel) - 1 ] = 0;
+
+	pBuf->EnsureCapacity( 50000 );		// matches maxTranslationSize in dxabstract
+	pTranslator->TranslateShader( &pShader->m_code[0], pBuf, &bVertexShader, TranslationOptions( mode, pShader->m_bVertexShader ), -1, 0, debugLabel );
+}
+
+// the translator stamps a running "trans#<n>" counter into each shader, which depends on
+// how many translations came before it - blank it out so goldens don't depend on corpus order
+static void NormalizeOutput( std::string *pText )
+{
+	size_t pos = 0;
+	while ( ( pos = pText->find( "trans#", pos ) ) != std::string::npos )
+	{
+		pos += 6;
+		size_t end = pos;
+		while ( end < pText->size() && (*pText)[end] >= '0' && (*pText)[end] <= '9' )
+		{
+			end++;
+		}
+		pText->replace( pos, end - pos, "N" );
+	}
+}
+
+// returns true if they match; otherwise prints the first differing line
+static bool CompareToGolden( const char *goldenPath, const char *output, const char *shaderName, const char *modeName )
+{
+	std::string golden;
+	if ( !ReadWholeFile( goldenPath, &golden ) )
+	{
+		fprintf( stderr, "%s (%s): missing golden file %s\n", shaderName, modeName, goldenPath );
+		return false;
+	}
+
+	if ( golden == output )
+		return true;
+
+	const char *pGolden = golden.c_str();
+	const char *pOutput = output;
+	int line = 1;
+	while ( *pGolden && *pGolden == *pOutput )
+	{
+		if ( *pGolden == '\n' )
+		{
+			++line;
+		}
+		++pGolden;
+		++pOutput;
+	}
+
+	// back up to the start of the differing line in each
+	while ( pGolden > golden.c_str() && pGolden[-1] != '\n' )
+	{
+		--pGolden;
+		--pOutput;
+	}
+
+	int goldenLen = (int)strcspn( pGolden, "\n" );
+	int outputLen = (int)strcspn( pOutput, "\n" );
+	fprintf( stderr, "%s (%s): output differs from %s at line %d\n", shaderName, modeName, goldenPath, line );
+	fprintf( stderr, "\t- %.*s\n", goldenLen, pGolden );
+	fprintf( stderr, "\t+ %.*s\n", outputLen, pOutput );
+	return false;
+}
+
+static void PrintTotals( const char *label, const BenchTotals_t &totals )
+{
+	double seconds = totals.m_seconds > 0.0 ? totals.m_seconds : 1e-9;
+	printf( "%-6s %10llu shaders  %9.3f s  %12.1f shaders/s  %9.2f MB/s in  %9.2f MB/s out\n",
+		label,
+		(unsigned long long)totals.m_shaders,
+		totals.m_seconds,
+		(double)totals.m_shaders / seconds,
+		(double)totals.m_bytesIn / seconds / ( 1024.0 * 1024.0 ),
+		(double)totals.m_bytesOut / seconds / ( 1024.0 * 1024.0 ) );
+}
+
+static void Usage( void )
+{
+	fprintf( stderr, "usage: d3dtoglbench [-iters n] [-golden dir] [-update] [-arb | -glsl] [-synth n] shader.cso [shader.cso ...]\n" );
+}
+
+int main( int argc, char **argv )
+{
+	int iterations = 100;
+	const char *goldenDir = NULL;
+	bool bUpdateGolden = false;
+	bool bRunMode[eModeCount] = { true, true };
+	std::vector< BenchShader_t > shaders;
+	int failures = 0;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[i], "-iters" ) && i + 1 < argc )
+		{
+			iterations = atoi( argv[++i] );
+		}
+		else if ( !strcmp( argv[i], "-golden" ) && i + 1 < argc )
+		{
+			goldenDir = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "-update" ) )
+		{
+			bUpdateGolden = true;
+		}
+		else if ( !strcmp( argv[i], "-arb" ) )
+		{
+			bRunMode[eModeGLSL] = false;
+		}
+		else if ( !strcmp( argv[i], "-glsl" ) )
+		{
+			bRunMode[eModeARB] = false;
+		}
+		else if ( !strcmp( argv[i], "-synth" ) && i + 1 < argc )
+		{
+			BenchShader_t shader;
+			SynthesizeShader( atoi( argv[++i] ), &shader );
+			shaders.push_back( shader );
+		}
+		else if ( argv[i][0] == '-' )
+		{
+			Usage();
+			return 2;
+		}
+		else
+		{
+			BenchShader_t shader;
+			if ( LoadShader( argv[i], &shader ) )
+			{
+				shaders.push_back( shader );
+			}
+			else
+			{
+				failures++;
+			}
+		}
+	}
+
+	if ( shaders.empty() || iterations < 1 || ( bUpdateGolden && !goldenDir ) )
+	{
+		Usage();
+		return 2;
+	}
+
+	CUtlBuffer outbuf( 3000, 50000, CUtlBuffer::TEXT_BUFFER );
+	BenchTotals_t grandTotals = { 0.0, 0, 0, 0 };
+
+	for ( int mode = 0; mode < eModeCount; mode++ )
+	{
+		if ( !bRunMode[mode] )
+			continue;
+
+		// dxabstract keeps one translator per mode, so do the same
+		D3DToGL translator;
+		BenchTotals_t totals = { 0.0, 0, 0, 0 };
+
+		for ( size_t s = 0; s < shaders.size(); s++ )
+		{
+			BenchShader_t *pShader = &shaders[s];
+
+			// first pass produces the text we check, the timed passes reuse the same buffer
+			Translate( &translator, &outbuf, pShader, (ETranslationMode)mode );
+			std::string output( outbuf.Base() );
+			NormalizeOutput( &output );
+
+			if ( goldenDir && !pShader->m_bSynthetic )
+			{
+				std::string goldenPath = std::string( goldenDir ) + "/" + pShader->m_name + "." + g_szModeNames[mode];
+				if ( bUpdateGolden )
+				{
+					if ( !WriteWholeFile( goldenPath.c_str(), output ) )
+					{
+						fprintf( stderr, "%s: can't write %s\n", pShader->m_name.c_str(), goldenPath.c_str() );
+						failures++;
+					}
+				}
+				else if ( !CompareToGolden( goldenPath.c_str(), output.c_str(), pShader->m_name.c_str(), g_szModeNames[mode] ) )
+				{
+					failures++;
+				}
+			}
+
+			double start = BenchTime();
+			for ( int i = 0; i < iterations; i++ )
+			{
+				Translate( &translator, &outbuf, pShader, (ETranslationMode)mode );
+			}
+			totals.m_seconds += BenchTime() - start;
+			totals.m_shaders += iterations;
+			totals.m_bytesIn += (uint64)pShader->m_byteSize * iterations;
+			totals.m_bytesOut += (uint64)output.size() * iterations;
+		}
+
+		PrintTotals( g_szModeNames[mode], totals );
+
+		grandTotals.m_seconds += totals.m_seconds;
+		grandTotals.m_shaders += totals.m_shaders;
+		grandTotals.m_bytesIn += totals.m_bytesIn;
+		grandTotals.m_bytesOut += totals.m_bytesOut;
+	}
+
+	PrintTotals( "total", grandTotals );
+	printf( "peak memory %.2f MB\n", (double)BenchPeakMemory() / ( 1024.0 * 1024.0 ) );
+
+	if ( failures )
+	{
+		printf( "%d failure(s)\n", failures );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+#version 120
+//SAMPLERMASK-3
+//HIGHWATER-0
+
+uniform vec4 pc[1];
+
+uniform sampler2D sampler0;
+uniform sampler2D sampler1;
+
+
+
+void main()
+{
+vec4 atomic_temp_var;
+
+// trans#N label:D3D9VRDistort
+vec4 pd0 = vec4( 0.5, -0.050000000745, 0.0, 1.0 );
+vec4 pd1 = vec4( 0.5, 0.949999988079, 0.0, 0.0 );
+vec4 r0;
+vec4 r1;
+vec4 r2;
+vec4 r3;
+r0 = texture2D( sampler1, gl_Color.xy );
+r1.xy = r0.zw + r0.xy;
+r1.zw = r1.xy * -pd1.xx + pd1.yy;
+atomic_temp_var = r1;
+atomic_temp_var.z = ( r1.z >= 0.0 ) ? pd0.z : pd0.w;
+atomic_temp_var.w = ( r1.w >= 0.0 ) ? pd0.z : pd0.w;
+r1 = atomic_temp_var;
+r1.z = dot( r1.zw, pd0.ww ) + pd0.z;
+r2.xy = r1.xy * pd0.xx + pd0.yy;
+r1.xy = r1.xy * pd0.xx;
+r3 = texture2D( sampler0, r1.xy );
+r1.x = ( r2.x >= 0.0 ) ? pd0.z : pd0.w;
+r1.y = ( r2.y >= 0.0 ) ? pd0.z : pd0.w;
+r1.x = dot( r1.xy, pd0.ww ) + r1.z;
+r1.x = clamp( r1.x, 0.0, 1.0 );
+r2 = texture2D( sampler0, r0.xy );
+r0 = texture2D( sampler0, r0.zw );
+r3.z = r0.z;
+r3.x = r2.x;
+gl_FragData[0].w = r3.w;
+gl_FragData[0].x = ( -r1.x >= 0.0 ) ? r3.x : pd0.z;
+gl_FragData[0].y = ( -r1.x >= 0.0 ) ? r3.y : pd0.z;
+gl_FragData[0].z = ( -r1.x >= 0.0 ) ? r3.z : pd0.z;
+
+}
@@ -0,0 +1,34 @@
+//============ Copyright (c) Valve Corporation, All rights reserved. ============
+//
+// ApplicationServices/ApplicationServices.h
+//	stand-in for the OSX umbrella header.  On OSX this drags in the C runtime
+//	headers glmgr relies on implicitly, so do the same here, plus the couple
+//	of CoreGraphics display types glmdisplay.h refers to.
+//
+//===============================================================================
+
+#ifndef POSIXGL_APPLICATIONSERVICES_H
+#define	POSIXGL_APPLICATIONSERVICES_H
+
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint32_t	CGDirectDisplayID;
+typedef uint32_t	CGOpenGLDisplayMask;
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#endif
@@ -0,0 +1,7 @@
+//============ Copyright (c) Valve Corporation, All rights reserved. ============
+//
+// see OpenGL/OpenGL.h
+//
+//===============================================================================
+
+#include "OpenGL.h"
@@ -0,0 +1,28 @@
+//============ Copyright (c) Valve Corporation, All rights reserved. ============
+//
+// OpenGL/OpenGL.h
+//	stand-in for the OSX framework header so the shader translator can be
+//	built headless on POSIX.  Only the types glmgr's headers mention are
+//	provided - nothing in here is callable.
+//
+//===============================================================================
+
+#ifndef POSIXGL_OPENGL_H
+#define	POSIXGL_OPENGL_H
+
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+typedef struct _CGLContextObject		*CGLContextObj;
+typedef struct _CGLPixelFormatObject	*CGLPixelFormatObj;
+typedef struct _CGLRendererInfoObject	*CGLRendererInfoObj;
+typedef int								CGLPixelFormatAttribute;
+typedef int								CGLRendererProperty;
+typedef int								CGLContextParameter;
+typedef int								CGLContextEnable;
+typedef int								CGLError;
+
+#endif
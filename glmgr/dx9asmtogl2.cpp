@@ -66,12 +66,8 @@ void PrintToBuf( CUtlBuffer &buf, const char *pFormat, ... )
 {
 	va_list marker;
 	va_start( marker, pFormat );
-	
-	char szTemp[1024];
-	V_vsnprintf( szTemp, sizeof( szTemp ), pFormat, marker );
+	buf.AppendFormatV( pFormat, marker );
 	va_end( marker );
-
-	strcat_s( (char*)buf.Base(), buf.Size(), szTemp );
 }
 
 void PrintToBuf( char *pOut, int nOutSize, const char *pFormat, ... )
@@ -1521,13 +1517,13 @@ void D3DToGL::RecordInputAndOutputPositions()
 	m_pRecordedInputTokenStart = m_pdwNextToken;
 
 	// Remember where our outputs are.
-	m_nRecordedParamCodeStrlen = V_strlen( (char*)m_pBufParamCode->Base() );
-	m_nRecordedALUCodeStrlen = V_strlen( (char*)m_pBufALUCode->Base() );
-	m_nRecordedAttribCodeStrlen = V_strlen( (char*)m_pBufAttribCode->Base() );
+	m_nRecordedParamCodeStrlen = m_pBufParamCode->TellPut();
+	m_nRecordedALUCodeStrlen = m_pBufALUCode->TellPut();
+	m_nRecordedAttribCodeStrlen = m_pBufAttribCode->TellPut();
 }
-void D3DToGL::AddTokenHexCodeToBuffer( char *pBuffer, int nSize, int nLastStrlen )
+void D3DToGL::AddTokenHexCodeToBuffer( CUtlBuffer *pBuffer, int nLastStrlen )
 {
-	int nCurStrlen = V_strlen( pBuffer );
+	int nCurStrlen = pBuffer->TellPut();
 	if ( nCurStrlen == nLastStrlen )
 		return;
 
@@ -1545,22 +1541,17 @@ void D3DToGL::AddTokenHexCodeToBuffer( char *pBuffer, int nSize, int nLastStrlen
 	strncat( szHex, "\n", sizeof(szHex) - strlen(szHex) - 1 );
 
 	// Insert the hex codes into the string.
-	int nBytesToInsert = V_strlen( szHex );
-	if ( nCurStrlen + nBytesToInsert + 1 >= nSize )
-		Error( "Buffer overflow writing token hex codes" );
-
 	if ( m_bPutHexCodesAfterLines )
 	{
 		// Put it at the end of the last line.
-		if ( pBuffer[nCurStrlen-1] == '\n' )
-			pBuffer[nCurStrlen-1] = 0;
+		if ( pBuffer->Base()[nCurStrlen-1] == '\n' )
+			pBuffer->SeekPut( nCurStrlen-1 );
 
-		strncat( pBuffer, &szHex[1], nSize - strlen( pBuffer ) - 1 );
+		pBuffer->AppendString( &szHex[1] );
 	}
 	else
 	{
-		memmove( pBuffer + nLastStrlen + nBytesToInsert, pBuffer + nLastStrlen, nCurStrlen - nLastStrlen + 1 );
-		memcpy( pBuffer + nLastStrlen, szHex, nBytesToInsert );
+		pBuffer->InsertString( nLastStrlen, szHex );
 	}
 }
 
@@ -1568,9 +1559,9 @@ void D3DToGL::AddTokenHexCode()
 {
 	if ( m_pdwNextToken > m_pRecordedInputTokenStart )
 	{
-		AddTokenHexCodeToBuffer( (char*)m_pBufParamCode->Base(), m_pBufParamCode->Size(), m_nRecordedParamCodeStrlen );
-		AddTokenHexCodeToBuffer( (char*)m_pBufALUCode->Base(), m_pBufALUCode->Size(), m_nRecordedALUCodeStrlen );
-		AddTokenHexCodeToBuffer( (char*)m_pBufAttribCode->Base(), m_pBufAttribCode->Size(), m_nRecordedAttribCodeStrlen );
+		AddTokenHexCodeToBuffer( m_pBufParamCode, m_nRecordedParamCodeStrlen );
+		AddTokenHexCodeToBuffer( m_pBufALUCode, m_nRecordedALUCodeStrlen );
+		AddTokenHexCodeToBuffer( m_pBufAttribCode, m_nRecordedAttribCodeStrlen );
 	}
 }
 
@@ -2140,22 +2131,22 @@ void D3DToGL::Handle_TEX( uint32 dwToken, bool bIsTexLDL )
 
 void D3DToGL::StrcatToHeaderCode( const char *pBuf )
 {
-	strcat_s( (char*)m_pBufHeaderCode->Base(), m_pBufHeaderCode->Size(), pBuf );
+	m_pBufHeaderCode->AppendString( pBuf );
 }
 
 void D3DToGL::StrcatToALUCode( const char *pBuf )
 {
-	strcat_s( (char*)m_pBufALUCode->Base(), m_pBufALUCode->Size(), pBuf );
+	m_pBufALUCode->AppendString( pBuf );
 }
 
 void D3DToGL::StrcatToParamCode( const char *pBuf )
 {
-	strcat_s( (char*)m_pBufParamCode->Base(), m_pBufParamCode->Size(), pBuf );
+	m_pBufParamCode->AppendString( pBuf );
 }
 
 void D3DToGL::StrcatToAttribCode( const char *pBuf )
 {
-	strcat_s( (char*)m_pBufAttribCode->Base(), m_pBufAttribCode->Size(), pBuf );
+	m_pBufAttribCode->AppendString( pBuf );
 }
 
 void D3DToGL::Handle_TexLDD( uint32 nInstruction )
@@ -2629,16 +2620,16 @@ void D3DToGL::InsertMoveInstruction( CUtlBuffer *pCode, int nARLComponent )
 	switch ( nARLComponent )
 	{
 		case ARL_DEST_X:
-			strcat_s( ( char * )pCode->Base(), pCode->Size(), m_bGLSL ? "a0 = int( va_r.x );\n" : "ARL a0.x, VA_REG.x;\n" );
+			pCode->AppendString( m_bGLSL ? "a0 = int( va_r.x );\n" : "ARL a0.x, VA_REG.x;\n" );
 			break;
 		case ARL_DEST_Y:
-			strcat_s( ( char * )pCode->Base(), pCode->Size(), m_bGLSL ? "a0 = int( va_r.y );\n" : "ARL a0.x, VA_REG.y;\n" );
+			pCode->AppendString( m_bGLSL ? "a0 = int( va_r.y );\n" : "ARL a0.x, VA_REG.y;\n" );
 			break;
 		case ARL_DEST_Z:
-			strcat_s( ( char * )pCode->Base(), pCode->Size(), m_bGLSL ? "a0 = int( va_r.z );\n" : "ARL a0.x, VA_REG.z;\n" );
+			pCode->AppendString( m_bGLSL ? "a0 = int( va_r.z );\n" : "ARL a0.x, VA_REG.z;\n" );
 			break;
 		case ARL_DEST_W:
-			strcat_s( ( char * )pCode->Base(), pCode->Size(), m_bGLSL ? "a0 = int( va_r.w );\n" : "ARL a0.x, VA_REG.w;\n" );
+			pCode->AppendString( m_bGLSL ? "a0 = int( va_r.w );\n" : "ARL a0.x, VA_REG.w;\n" );
 			break;
 	}
 }
@@ -2721,11 +2712,8 @@ int D3DToGL::TranslateShader( uint32* code, CUtlBuffer *pBufDisassembledCode, bo
 
 	// Pointers to text buffers for assembling sections of the program
 	m_pBufHeaderCode = pBufDisassembledCode;
-	char *pAttribMapStart = NULL;
-	((char*)m_pBufHeaderCode->Base())[0] = 0;
-	((char*)m_pBufAttribCode->Base())[0] = 0;
-	((char*)m_pBufParamCode->Base())[0] = 0;
-	((char*)m_pBufALUCode->Base())[0] = 0;
+	int nAttribMapStart = -1;
+	m_pBufHeaderCode->Clear();
 
 
 	for ( int i = 0; i < MAX_SHADER_CONSTANTS; i++ )
@@ -2789,7 +2777,7 @@ int D3DToGL::TranslateShader( uint32* code, CUtlBuffer *pBufDisassembledCode, bo
 	if ( ( dwToken & 0xFFFF0000 ) == 0xFFFF0000 )
 	{
 		// must explicitly enable extensions if emitting GLSL
-		V_snprintf( (char *)m_pBufHeaderCode->Base(), m_pBufHeaderCode->Size(), m_bGLSL ? "#version 120\n%s" : "!!ARBfp1.0\n%s", glslBindableUniformExtText );
+		m_pBufHeaderCode->AppendFormat( m_bGLSL ? "#version 120\n%s" : "!!ARBfp1.0\n%s", glslBindableUniformExtText );
 		m_bVertexShader = false;
 	}
 	else // vertex shader
@@ -2798,24 +2786,25 @@ int D3DToGL::TranslateShader( uint32* code, CUtlBuffer *pBufDisassembledCode, bo
 
 		if ( m_bGLSL )
 		{
-			V_snprintf( (char *)m_pBufHeaderCode->Base(), m_pBufHeaderCode->Size(), "#version 120\n%s//ATTRIBMAP-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx\n", glslBindableUniformExtText );
+			m_pBufHeaderCode->AppendFormat( "#version 120\n%s//ATTRIBMAP-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx\n", glslBindableUniformExtText );
 		}
 		else // asm
 		{
 			if ( m_bDoUserClipPlanes )
 			{
 				// include "OPTION NV_vertex_program2;"
-				V_snprintf( (char *)m_pBufHeaderCode->Base(), m_pBufHeaderCode->Size(), "!!ARBvp1.0\n#//ATTRIBMAP-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx\nOPTION NV_vertex_program2;\n" );
+				m_pBufHeaderCode->AppendFormat( "!!ARBvp1.0\n#//ATTRIBMAP-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx\nOPTION NV_vertex_program2;\n" );
 			}
 			else
 			{
 				// do not include "OPTION NV_vertex_program2;"
-				V_snprintf( (char *)m_pBufHeaderCode->Base(), m_pBufHeaderCode->Size(), "!!ARBvp1.0\n#//ATTRIBMAP-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx\n" );
+				m_pBufHeaderCode->AppendFormat( "!!ARBvp1.0\n#//ATTRIBMAP-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx-xx\n" );
 			}
 		}
 
-		// find that first '-xx' which is where the attrib map will be written later.
-		pAttribMapStart = strstr( (char *)m_pBufHeaderCode->Base(), "-xx" ) + 1;
+		// find that first '-xx' which is where the attrib map will be written later.  Keep an
+		// offset rather than a pointer, the header buffer can move as it grows.
+		nAttribMapStart = strstr( (char *)m_pBufHeaderCode->Base(), "-xx" ) + 1 - (char *)m_pBufHeaderCode->Base();
 		
 		m_bVertexShader = true;
 	}
@@ -2846,7 +2835,7 @@ int D3DToGL::TranslateShader( uint32* code, CUtlBuffer *pBufDisassembledCode, bo
 #ifdef POSIX
 		int tokenIndex = m_pdwNextToken - code;
 #endif
-		int aluCodeLength0 = V_strlen( (char *) m_pBufALUCode->Base() );
+		int aluCodeLength0 = m_pBufALUCode->TellPut();
 		
 		dwToken = GetNextToken();	// Get next dwToken in the stream
 		nInstruction = Opcode( dwToken ); // Mask out the instruction opcode
@@ -3108,7 +3097,7 @@ int D3DToGL::TranslateShader( uint32* code, CUtlBuffer *pBufDisassembledCode, bo
 		
 		if ( m_bSpew )
 		{
-			int aluCodeLength1 = V_strlen( (char *) m_pBufALUCode->Base() );
+			int aluCodeLength1 = m_pBufALUCode->TellPut();
 			if ( aluCodeLength1 != aluCodeLength0 )
 			{
 				// code was emitted
@@ -3448,7 +3437,8 @@ int D3DToGL::TranslateShader( uint32* code, CUtlBuffer *pBufDisassembledCode, bo
 
 		if ( m_bVertexShader )
 		{
-			// write attrib map into the text starting at pAttribMapStart - two hex digits per attrib
+			// write attrib map into the text starting at nAttribMapStart - two hex digits per attrib
+			char *pAttribMapStart = (char *)m_pBufHeaderCode->Base() + nAttribMapStart;
 			for( int i=0; i<16; i++ )
 			{
 				if ( m_dwAttribMap[i] != 0xFFFFFFFF )
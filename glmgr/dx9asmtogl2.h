@@ -176,7 +176,7 @@ private:
 	void StrcatToAttribCode( const char *pBuf );
 
 	// This helps write the token hex codes into the output stream for debugging.
-	void AddTokenHexCodeToBuffer( char *pBuffer, int nSize, int nLastStrlen );
+	void AddTokenHexCodeToBuffer( CUtlBuffer *pBuffer, int nLastStrlen );
 	void RecordInputAndOutputPositions();
 	void AddTokenHexCode();
 
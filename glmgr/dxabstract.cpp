@@ -413,6 +413,11 @@ IDirect3DTexture9::~IDirect3DTexture9()
 
 HRESULT IDirect3DTexture9::LockRect(UINT Level,D3DLOCKED_RECT* pLockedRect,CONST RECT* pRect,DWORD Flags)
 {
+	if (m_device)
+	{
+		m_device->FlushUPBatch();
+	}
+
 	// basically same code as in direct3dsurface9::lockrect
 	
 	GLMTexLockParams lockreq;
@@ -795,6 +800,11 @@ IDirect3DVolumeTexture9::~IDirect3DVolumeTexture9()
 
 HRESULT IDirect3DVolumeTexture9::LockBox(UINT Level,D3DLOCKED_BOX* pLockedVolume,CONST D3DBOX* pBox,DWORD Flags)
 {
+	if (m_device)
+	{
+		m_device->FlushUPBatch();
+	}
+
 	GLMTexLockParams lockreq;
 	memset( &lockreq, 0, sizeof(lockreq) );
 	
@@ -904,6 +914,11 @@ IDirect3DSurface9::~IDirect3DSurface9()
 
 HRESULT IDirect3DSurface9::LockRect(D3DLOCKED_RECT* pLockedRect,CONST RECT* pRect,DWORD Flags)
 {
+	if (m_device)
+	{
+		m_device->FlushUPBatch();
+	}
+
 	GLMTexLockParams lockreq;
 	memset( &lockreq, 0, sizeof(lockreq) );
 	
@@ -1683,6 +1698,11 @@ HRESULT IDirect3D9::CreateDevice(UINT Adapter,D3DDEVTYPE DeviceType,VD3DHWND hFo
 
 HRESULT IDirect3DQuery9::Issue(DWORD dwIssueFlags)
 {
+	if (m_device)
+	{
+		m_device->FlushUPBatch();
+	}
+
 	// Flags field for Issue
 	//	#define D3DISSUE_END (1 << 0) // Tells the runtime to issue the end of a query, changing it's state to "non-signaled".
 	//	#define D3DISSUE_BEGIN (1 << 1) // Tells the runtime to issue the beginng of a query.
@@ -2056,6 +2076,15 @@ HRESULT	IDirect3DDevice9::Create( IDirect3DDevice9Params *params )
 	memset( m_streams, 0, sizeof(m_streams) );
 	memset( m_textures, 0, sizeof(m_textures) );
 	memset( m_samplers, 0, sizeof(m_samplers) );
+	m_samplerParamsCache.clear();
+	m_recordingStateBlock = NULL;
+
+	m_upVertexRing = NULL;
+	m_upIndexRing = NULL;
+	m_upVertexCursor = m_upIndexCursor = 0;
+	memset( &m_upBatch, 0, sizeof(m_upBatch) );
+	gl.m_samplerDirtyMask = 0;
+	memset( gl.m_samplerParamsApplied, 0, sizeof(gl.m_samplerParamsApplied) );
 	
 
 	//============================================================================
@@ -2213,6 +2242,19 @@ HRESULT	IDirect3DDevice9::Create( IDirect3DDevice9Params *params )
 IDirect3DDevice9::~IDirect3DDevice9()
 {
 	GLMPRINTF(( "-D- IDirect3DDevice9::~IDirect3DDevice9 signpost" ));	// want to know when this is called, if ever
+
+	// anything still batched goes nowhere
+	m_upBatch.m_elementCount = 0;
+	if (m_upVertexRing)
+	{
+		m_upVertexRing->Release();
+		m_upVertexRing = NULL;
+	}
+	if (m_upIndexRing)
+	{
+		m_upIndexRing->Release();
+		m_upIndexRing = NULL;
+	}
 }
 
 #pragma mark ----- Basics - (IDirect3DDevice9)
@@ -2220,6 +2262,8 @@ IDirect3DDevice9::~IDirect3DDevice9()
 
 HRESULT IDirect3DDevice9::Reset(D3DPRESENT_PARAMETERS* pPresentationParameters)
 {
+	FlushUPBatch();
+
 #if DX9MODE
 	HRESULT result = S_OK;
 
@@ -2365,6 +2409,8 @@ HRESULT IDirect3DDevice9::Reset(D3DPRESENT_PARAMETERS* pPresentationParameters)
 
 HRESULT IDirect3DDevice9::SetViewport(CONST D3DVIEWPORT9* pViewport)
 {
+	FlushUPBatch();
+
 	GLMPRINTF(("-X- IDirect3DDevice9::SetViewport : minZ %f, maxZ %f",pViewport->MinZ, pViewport->MaxZ ));
 	
 	gl.m_ViewportBox.x		= pViewport->X;
@@ -2392,6 +2438,8 @@ HRESULT IDirect3DDevice9::BeginScene()
 
 HRESULT IDirect3DDevice9::EndScene()
 {
+	FlushUPBatch();
+
 	m_ctx->EndFrame();
 	return S_OK;
 }
@@ -2422,6 +2470,8 @@ int gl_blitmode = 1;
 
 HRESULT IDirect3DDevice9::Present(CONST RECT* pSourceRect,CONST RECT* pDestRect,VD3DHWND hDestWindowOverride,CONST RGNDATA* pDirtyRegion)
 {
+	FlushUPBatch();
+
 	// before attempting to present a tex, make sure it's been resolved if it was MSAA.
 		// if we push that responsibility down to m_ctx->Present, it could probably do it without an extra copy.
 		// i.e. anticipate the blit from the resolvedtex to GL_BACK, and just do that instead.
@@ -2438,12 +2488,15 @@ HRESULT IDirect3DDevice9::Present(CONST RECT* pSourceRect,CONST RECT* pDestRect,
 
 HRESULT IDirect3DDevice9::SetTexture(DWORD Stage,IDirect3DBaseTexture9* pTexture)
 {
+	FlushUPBatch();
+
 	// texture sets are sent through immediately to GLM
 	// but we also latch the value so we know which TMU's are active.
 	// whuch can help FlushSamplers do less work.
 	
 	// place new tex
 	m_textures[Stage] = pTexture;
+	gl.m_samplerDirtyMask |= (1<<Stage);		// the GL sampler params depend on the texture's mip count and sRGB-ness
 	if (!pTexture)
 	{
 		m_ctx->SetSamplerTex( Stage, NULL );
@@ -2528,6 +2581,8 @@ HRESULT IDirect3DDevice9::CreateRenderTarget(UINT Width,UINT Height,D3DFORMAT Fo
 
 HRESULT IDirect3DDevice9::SetRenderTarget(DWORD RenderTargetIndex,IDirect3DSurface9* pRenderTarget)
 {
+	FlushUPBatch();
+
 	HRESULT result = S_OK;
 
 	GLMPRINTF(("-F- SetRenderTarget index=%d, surface=%8x (tex=%8x %s)",
@@ -2694,6 +2749,8 @@ HRESULT IDirect3DDevice9::CreateDepthStencilSurface(UINT Width,UINT Height,D3DFO
 
 HRESULT IDirect3DDevice9::SetDepthStencilSurface(IDirect3DSurface9* pNewZStencil)
 {
+	FlushUPBatch();
+
 	HRESULT	result = S_OK;
 
 	GLMPRINTF(("-F- SetDepthStencilSurface, surface=%8x (tex=%8x %s)",
@@ -2774,6 +2831,8 @@ HRESULT IDirect3DDevice9::GetDepthStencilSurface(IDirect3DSurface9** ppZStencilS
 
 HRESULT IDirect3DDevice9::GetRenderTargetData(IDirect3DSurface9* pRenderTarget,IDirect3DSurface9* pDestSurface)
 {
+	FlushUPBatch();
+
 	// is it just a blit ?
 
 	this->StretchRect( pRenderTarget, NULL, pDestSurface, NULL, D3DTEXF_NONE ); // is this good enough ???
@@ -2789,6 +2848,8 @@ HRESULT IDirect3DDevice9::GetFrontBufferData(UINT iSwapChain,IDirect3DSurface9*
 
 HRESULT IDirect3DDevice9::StretchRect(IDirect3DSurface9* pSourceSurface,CONST RECT* pSourceRect,IDirect3DSurface9* pDestSurface,CONST RECT* pDestRect,D3DTEXTUREFILTERTYPE Filter)
 {
+	FlushUPBatch();
+
 	// find relevant slices in GLM tex
 
 	CGLMTex	*srcTex = pSourceSurface->m_tex;
@@ -3158,6 +3219,8 @@ IDirect3DPixelShader9::~IDirect3DPixelShader9()
 
 HRESULT IDirect3DDevice9::SetPixelShader(IDirect3DPixelShader9* pShader)
 {
+	FlushUPBatch();
+
 	if (pShader)
 	{
 		m_ctx->SetDrawingProgram( kGLMFragmentProgram, pShader->m_pixProgram );
@@ -3166,6 +3229,12 @@ HRESULT IDirect3DDevice9::SetPixelShader(IDirect3DPixelShader9* pShader)
 	{
 		m_ctx->SetDrawingProgram( kGLMFragmentProgram, NULL );
 	}
+
+	// samplers the new shader reads that the old one didn't need their sRGB check done at the next draw
+	uint oldSamplerMask = m_pixelShader ? m_pixelShader->m_pixSamplerMask : 0;
+	uint newSamplerMask = pShader ? pShader->m_pixSamplerMask : 0;
+	gl.m_samplerDirtyMask |= newSamplerMask & ~oldSamplerMask;
+
 	m_pixelShader = pShader;
 
 	return S_OK;
@@ -3173,6 +3242,8 @@ HRESULT IDirect3DDevice9::SetPixelShader(IDirect3DPixelShader9* pShader)
 
 HRESULT IDirect3DDevice9::SetPixelShaderConstantF(UINT StartRegister,CONST float* pConstantData,UINT Vector4fCount)
 {
+	FlushUPBatch();
+
 	m_ctx->SetProgramParametersF( kGLMFragmentProgram, StartRegister, (float *)pConstantData, Vector4fCount );
 
 	return S_OK;
@@ -3180,6 +3251,8 @@ HRESULT IDirect3DDevice9::SetPixelShaderConstantF(UINT StartRegister,CONST float
 
 HRESULT IDirect3DDevice9::SetPixelShaderConstantB(UINT StartRegister,CONST BOOL* pConstantData,UINT  BoolCount)
 {
+	FlushUPBatch();
+
 	GLMPRINTF(("-X- Ignoring IDirect3DDevice9::SetPixelShaderConstantB call, count was %d", BoolCount ));
 // actually no way to do this yet.
 //	m_ctx->SetProgramParametersB( kGLMFragmentProgram, StartRegister, pConstantData, BoolCount );
@@ -3189,6 +3262,8 @@ HRESULT IDirect3DDevice9::SetPixelShaderConstantB(UINT StartRegister,CONST BOOL*
 
 HRESULT IDirect3DDevice9::SetPixelShaderConstantI(UINT StartRegister,CONST int* pConstantData,UINT Vector4iCount)
 {
+	FlushUPBatch();
+
 	GLMPRINTF(("-X- Ignoring IDirect3DDevice9::SetPixelShaderConstantI call, count was %d", Vector4iCount ));
 //	m_ctx->SetProgramParametersI( kGLMFragmentProgram, StartRegister, pConstantData, Vector4iCount );
 	return S_OK;
@@ -3401,6 +3476,8 @@ IDirect3DVertexShader9::~IDirect3DVertexShader9()
 
 HRESULT IDirect3DDevice9::SetVertexShader(IDirect3DVertexShader9* pShader)
 {
+	FlushUPBatch();
+
 	if (pShader)
 	{
 		m_ctx->SetDrawingProgram( kGLMVertexProgram, pShader->m_vtxProgram );
@@ -3416,18 +3493,24 @@ HRESULT IDirect3DDevice9::SetVertexShader(IDirect3DVertexShader9* pShader)
 
 HRESULT IDirect3DDevice9::SetVertexShaderConstantF(UINT StartRegister,CONST float* pConstantData,UINT Vector4fCount)	// groups of 4 floats!
 {
+	FlushUPBatch();
+
 	m_ctx->SetProgramParametersF( kGLMVertexProgram, StartRegister, (float *)pConstantData, Vector4fCount );
 	return S_OK;
 }
 
 HRESULT IDirect3DDevice9::SetVertexShaderConstantB(UINT StartRegister,CONST BOOL* pConstantData,UINT  BoolCount)		// individual bool count!
 {
+	FlushUPBatch();
+
 	m_ctx->SetProgramParametersB( kGLMVertexProgram, StartRegister, (int *)pConstantData, BoolCount );
 	return S_OK;
 }
 
 HRESULT IDirect3DDevice9::SetVertexShaderConstantI(UINT StartRegister,CONST int* pConstantData,UINT Vector4iCount)		// groups of 4 ints!
 {
+	FlushUPBatch();
+
 	m_ctx->SetProgramParametersI( kGLMVertexProgram, StartRegister, (int *)pConstantData, Vector4iCount );
 	return S_OK;
 }
@@ -3613,6 +3696,8 @@ IDirect3DVertexDeclaration9::~IDirect3DVertexDeclaration9()
 
 HRESULT IDirect3DDevice9::SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl)
 {
+	FlushUPBatch();
+
 	// we just latch it.  At draw time we combine the current vertex decl with the current stream set and generate a vertex setup for GLM.
 	// GLM can see what the differences are and act accordingly to adjust vert attrib bindings.
 
@@ -3640,6 +3725,8 @@ HRESULT IDirect3DDevice9::GetFVF(DWORD* pFVF)
 
 HRESULT IDirect3DDevice9::SetStreamSource(UINT StreamNumber,IDirect3DVertexBuffer9* pStreamData,UINT OffsetInBytes,UINT Stride)
 {
+	FlushUPBatch();
+
 	// perfectly legal to see a vertex buffer of NULL get passed in here.
 	// so we need an array to track these.
 	// OK, we are being given the stride, we don't need to calc it..
@@ -3667,6 +3754,8 @@ HRESULT IDirect3DDevice9::SetStreamSource(UINT StreamNumber,IDirect3DVertexBuffe
 
 HRESULT IDirect3DDevice9::SetIndices(IDirect3DIndexBuffer9* pIndexData)
 {
+	FlushUPBatch();
+
 	// just latch it.
 	m_indices.m_idxBuffer = pIndexData;
 	return S_OK;
@@ -3676,6 +3765,8 @@ HRESULT IDirect3DDevice9::SetIndices(IDirect3DIndexBuffer9* pIndexData)
 #pragma mark ----- Release Handlers - (IDirect3DDevice9)
 void	IDirect3DDevice9::ReleasedTexture( IDirect3DBaseTexture9 *baseTex )
 {
+	FlushUPBatch();
+
 	// see if this texture is referenced in any of the texture units and scrub it if so.
 	for( int i=0; i<16; i++)
 	{
@@ -3689,6 +3780,8 @@ void	IDirect3DDevice9::ReleasedTexture( IDirect3DBaseTexture9 *baseTex )
 
 void	IDirect3DDevice9::ReleasedSurface( IDirect3DSurface9 *surface )
 {
+	FlushUPBatch();
+
 	for( int i=0; i<16; i++)
 	{
 		if (m_rtSurfaces[i]==surface)
@@ -3719,6 +3812,8 @@ void	IDirect3DDevice9::ReleasedSurface( IDirect3DSurface9 *surface )
 
 void	IDirect3DDevice9::ReleasedPixelShader( IDirect3DPixelShader9 *pixelShader )
 {
+	FlushUPBatch();
+
 	if ( m_pixelShader == pixelShader )
 	{
 		m_pixelShader = NULL;
@@ -3728,6 +3823,8 @@ void	IDirect3DDevice9::ReleasedPixelShader( IDirect3DPixelShader9 *pixelShader )
 
 void	IDirect3DDevice9::ReleasedVertexShader( IDirect3DVertexShader9 *vertexShader )
 {
+	FlushUPBatch();
+
 	if ( m_vertexShader == vertexShader )
 	{
 		m_vertexShader = NULL;
@@ -4120,6 +4217,16 @@ HRESULT IDirect3DDevice9::SetRenderState( D3DRENDERSTATETYPE State, DWORD Value
 	char	rsSpew = 1;
 	char	ignored = 0;
 	
+	if (m_recordingStateBlock)
+	{
+		// recorded, not applied - it gets translated when the block is compiled
+		D3DRenderStateValue rs = { State, Value };
+		m_recordingStateBlock->m_renderStates.push_back( rs );
+		return S_OK;
+	}
+
+	FlushUPBatch();
+
 	if (!g_D3DRS_INFO_unpacked_ready)
 	{
 		UnpackD3DRSITable();
@@ -4506,10 +4613,143 @@ HRESULT IDirect3DDevice9::SetRenderState( D3DRENDERSTATETYPE State, DWORD Value
 	return S_OK;
 }
 
+#pragma mark ----- State Blocks - (IDirect3DDevice9)
+
+HRESULT IDirect3DDevice9::BeginStateBlock()
+{
+	if (m_recordingStateBlock)
+	{
+		Assert( !"BeginStateBlock while already recording" );
+		return D3DERR_INVALIDCALL;
+	}
+	
+	// a pending UP batch has to go out with the state it was queued under, SetRenderState won't flush it while recording
+	FlushUPBatch();
+
+	IDirect3DStateBlock9 *block = new IDirect3DStateBlock9;
+	block->m_device = this;
+	block->m_stateDirtyMask = 0;
+	
+	m_recordingStateBlock = block;
+	return S_OK;
+}
+
+HRESULT IDirect3DDevice9::EndStateBlock( IDirect3DStateBlock9** ppSB )
+{
+	*ppSB = NULL;
+	if (!m_recordingStateBlock)
+	{
+		Assert( !"EndStateBlock without BeginStateBlock" );
+		return D3DERR_INVALIDCALL;
+	}
+
+	// CompileStateBlock replays the block through SetRenderState over scratch copies of gl, nothing may get drawn from those
+	FlushUPBatch();
+
+	IDirect3DStateBlock9 *block = m_recordingStateBlock;
+	m_recordingStateBlock = NULL;
+	
+	CompileStateBlock( block );
+	
+	*ppSB = block;
+	return S_OK;
+}
+
+// A state block is compiled by running its render states through SetRenderState twice, over copies of
+// the GL state filled with 0x00 and then 0xFF.  Every translation is a plain store, so a byte that comes
+// out the same both times was written by the block and a byte that differs was not touched.  Applying the
+// block is then a handful of memcpy's and one OR into the dirty mask, with no per-state translation.
+void IDirect3DDevice9::CompileStateBlock( IDirect3DStateBlock9 *block )
+{
+	const uint glSize = sizeof(gl);
+	std::vector< unsigned char > saved( glSize ), pass0( glSize ), pass1( glSize );
+	
+	Assert( m_upBatch.m_elementCount == 0 );
+
+	memcpy( &saved[0], &gl, glSize );
+	
+	for( int pass = 0; pass < 2; pass++ )
+	{
+		memset( &gl, pass ? 0xFF : 0x00, glSize );
+		gl.m_stateDirtyMask = 0;
+		
+		for( uint i=0; i < block->m_renderStates.size(); i++ )
+		{
+			SetRenderState( block->m_renderStates[i].m_state, block->m_renderStates[i].m_value );
+		}
+		
+		if (!pass)
+		{
+			block->m_stateDirtyMask = gl.m_stateDirtyMask;
+		}
+		
+		// the dirty mask is raised by Apply, make sure it never looks like a written byte
+		gl.m_stateDirtyMask = pass ? 0xFFFFFFFF : 0;
+		memcpy( pass ? &pass1[0] : &pass0[0], &gl, glSize );
+	}
+
+	memcpy( &gl, &saved[0], glSize );
+	
+	// coalesce the written bytes into spans
+	block->m_spans.clear();
+	block->m_values.clear();
+	
+	uint offset = 0;
+	while( offset < glSize )
+	{
+		if (pass0[offset] != pass1[offset])
+		{
+			offset++;
+			continue;
+		}
+		
+		D3DStateBlockSpan span;
+		span.m_offset = offset;
+		while( (offset < glSize) && (pass0[offset] == pass1[offset]) )
+		{
+			offset++;
+		}
+		span.m_size = offset - span.m_offset;
+		
+		block->m_spans.push_back( span );
+		block->m_values.insert( block->m_values.end(), pass0.begin() + span.m_offset, pass0.begin() + offset );
+	}
+	
+	GLMPRINTF(("-X- IDirect3DDevice9::CompileStateBlock: %d render states -> %d spans, %d bytes, dirty mask %08x", (int)block->m_renderStates.size(), (int)block->m_spans.size(), (int)block->m_values.size(), block->m_stateDirtyMask ));
+}
+
+HRESULT IDirect3DStateBlock9::Apply()
+{
+	m_device->FlushUPBatch();
+
+	unsigned char *glbase = (unsigned char *)&m_device->gl;
+	const unsigned char *values = m_values.empty() ? NULL : &m_values[0];
+	
+	for( uint i=0; i < m_spans.size(); i++ )
+	{
+		memcpy( glbase + m_spans[i].m_offset, values, m_spans[i].m_size );
+		values += m_spans[i].m_size;
+	}
+	m_device->gl.m_stateDirtyMask |= m_stateDirtyMask;
+	
+	return S_OK;
+}
+
+IDirect3DStateBlock9::~IDirect3DStateBlock9()
+{
+	if (m_device && m_device->m_recordingStateBlock == this)
+	{
+		m_device->m_recordingStateBlock = NULL;
+	}
+	m_device = NULL;
+}
+
 #pragma mark ----- Sampler States - (IDirect3DDevice9)
 
 HRESULT IDirect3DDevice9::SetSamplerState( DWORD Sampler, D3DSAMPLERSTATETYPE Type, DWORD Value )
 {
+	FlushUPBatch();
+
 	Assert(Sampler<16);
 	
 	// the D3D-to-GL translation has been moved to FlushSamplers since we want to do it at draw time
@@ -4810,14 +5050,128 @@ static GLenum dxtogl_minFilter[4][4] =		// indexed by _D3DTEXTUREFILTERTYPE on b
 		/* min = D3DTEXF_ANISOTROPIC */	{	GL_LINEAR,		GL_LINEAR_MIPMAP_NEAREST,	GL_LINEAR_MIPMAP_LINEAR,	(GLenum)-1	},		// no diff from prior row, set maxAniso to effect the sampling
 };
 
+//-----------------------------------------------------------------------------
+// Translate a D3D sampler desc into GL sampling params, for a texture with texMipCount mips.
+// Each distinct combination is only translated once, the result lives in m_samplerParamsCache.
+//-----------------------------------------------------------------------------
+const GLMTexSamplingParams *IDirect3DDevice9::GetSamplerParams( const D3DSamplerDesc *dxsamp, int texMipCount )
+{
+	D3DSamplerKey key;
+	memset( &key, 0, sizeof(key) );
+	key.m_desc = *dxsamp;
+	key.m_texMipCount = texMipCount;
+
+	D3DSamplerParamsMap::iterator iter = m_samplerParamsCache.find( key );
+	if ( iter != m_samplerParamsCache.end() )
+	{
+		return &iter->second;
+	}
+
+	if ( m_samplerParamsCache.size() >= D3D_SAMPLER_PARAMS_CACHE_LIMIT )
+	{
+		// start over - anything still pointing into the cache has to be re-sent
+		m_samplerParamsCache.clear();
+		memset( gl.m_samplerParamsApplied, 0, sizeof(gl.m_samplerParamsApplied) );
+	}
+
+	GLMTexSamplingParams *glsamp = &m_samplerParamsCache[ key ];
+	memset( glsamp, 0, sizeof(*glsamp) );
+	Assert( texMipCount >=1 );
+
+	// address modes
+	glsamp->m_addressModes[0] = dxtogl_addressMode[ dxsamp->m_addressModes[0] ];
+	glsamp->m_addressModes[1] = dxtogl_addressMode[ dxsamp->m_addressModes[1] ];
+	glsamp->m_addressModes[2] = dxtogl_addressMode[ dxsamp->m_addressModes[2] ];
+
+	// border color
+	uint dxcolor = dxsamp->m_borderColor;
+	glsamp->m_borderColor[0] =	((dxcolor >> 16) & 0xFF) / 255.0f;	//R
+	glsamp->m_borderColor[1] =	((dxcolor >>  8) & 0xFF) / 255.0f;	//G
+	glsamp->m_borderColor[2] =	((dxcolor      ) & 0xFF) / 255.0f;	//B
+	glsamp->m_borderColor[3] =	((dxcolor >> 24) & 0xFF) / 255.0f;	//A
+
+	// filter state
+	
+	// mag filter - pretty easy
+	Assert( dxsamp->m_magFilter <= D3DTEXF_ANISOTROPIC );
+	Assert( dxsamp->m_magFilter >= D3DTEXF_POINT );
+
+	glsamp->m_magFilter = dxtogl_magFilter[ dxsamp->m_magFilter ];
+	
+	// min filter - more involved
+	Assert( dxsamp->m_minFilter <= D3DTEXF_ANISOTROPIC );
+	Assert( dxsamp->m_minFilter >= D3DTEXF_POINT );
+	Assert( dxsamp->m_mipFilter <= D3DTEXF_LINEAR );
+	Assert( dxsamp->m_mipFilter >= D3DTEXF_NONE );
+
+	D3DTEXTUREFILTERTYPE mipFilterLimit = D3DTEXF_LINEAR;
+	
+	/*
+		if (GLMKnob("caps-key",NULL) > 0.0)
+		{
+			if (dxsamp->m_mipFilter > D3DTEXF_NONE)
+			{
+				// evil hack
+				glsamp->m_magFilter = GL_LINEAR_MIPMAP_NEAREST;
+			}
+		}
+
+		if (GLMKnob("option-key",NULL) > 0.0)
+		{
+			// limit to point
+			mipFilterLimit = D3DTEXF_POINT;
+		}
+		
+		if (GLMKnob("control-key",NULL) > 0.0)
+		{
+			// limit to none
+			mipFilterLimit = D3DTEXF_NONE;
+		}
+	*/
+
+	D3DTEXTUREFILTERTYPE mipFilterChoice = std::min( dxsamp->m_mipFilter, mipFilterLimit );
+	glsamp->m_minFilter = dxtogl_minFilter[ dxsamp->m_minFilter ][ mipFilterChoice ];
+	
+	// should we check for mip filtering being requested on unmipped textures ? does it matter ?
+
+	// mipmap bias
+	glsamp->m_mipmapBias = dxsamp->m_mipmapBias;
+
+	// d3d "MAX MIP LEVEL" means the *largest size* MIP that will be selected. (max size)
+	// this is the same as GL's "MIN LOD level" which means the GL_TEXTURE_MIN_LOD level. (min index)
+	
+	glsamp->m_minMipLevel = dxsamp->m_maxMipLevel;		// it says gl_minMipLevel because we're setting GL's "GL_TEXTURE_MIN_LOD" aka d3d's "maximum mip size index".
+	if (glsamp->m_minMipLevel >= texMipCount)
+	{
+		// clamp - you can't have the GL base tex level be higher than the index of the last mip
+		glsamp->m_minMipLevel = texMipCount - 1;
+	}
+
+	// d3d has no idea of a "MIN MIP LEVEL" i.e. smallest size allowed.
+	// this would be expressed in GL by setting the GL_TEXTURE_MIN_LOD meaning largest index to select.
+	// for now, just set it to the index of the last mip.
+	glsamp->m_maxMipLevel = texMipCount-1;				// d3d has no value for constraining how small we can sample.
+														// however we may need to set this more intelligently if textures are not being fully submitted.
+
+	// aniso, and check for questionable combinations
+	Assert( ((dxsamp->m_minFilter == D3DTEXF_ANISOTROPIC) && (dxsamp->m_maxAniso >= 1)) || ((dxsamp->m_minFilter < D3DTEXF_ANISOTROPIC) && (dxsamp->m_maxAniso >= 1)) );
+	glsamp->m_maxAniso = dxsamp->m_maxAniso;
+
+	// SRGB
+	glsamp->m_srgb = dxsamp->m_srgb != 0;
+
+	// shadow compare
+	glsamp->m_compareMode = dxsamp->m_shadowFilter ? GL_COMPARE_R_TO_TEXTURE_ARB : GL_NONE;
+
+	return glsamp;
+}
+
 HRESULT IDirect3DDevice9::FlushSamplers( uint mask )
 {
-	// a minor optimization we could do here would be to only write sampler state for
-	// TMU's that are active (i.e. consult m_textures)
 	uint activeSamplerMask = m_pixelShader ? m_pixelShader->m_pixSamplerMask : 0;	// if no pixel shader bound at time of draw, act like it references no samplers
 																					// (and avoid an access violation while yer at it)
 	
-	// ho, we're not clearing the dirty mask for samplers as we go... need to do that...
+	// only samplers touched by SetSamplerState / SetTexture / SetPixelShader since they were last pushed are looked at
 	uint samplerHitMask = gl.m_samplerDirtyMask & mask;
 	for( int index = 0; (index < 16) && (samplerHitMask !=0); index++)
 	{
@@ -4830,98 +5184,18 @@ HRESULT IDirect3DDevice9::FlushSamplers( uint mask )
 			// clear that dirty bit before you forget...
 			gl.m_samplerDirtyMask &= (~bitMask);
 			
-			// translate from D3D sampler desc
-			D3DSamplerDesc			*dxsamp = &m_samplers[ index ];
+			int texMipCount = m_textures[index]->m_tex->m_layout->m_mipCount;
+			const GLMTexSamplingParams *cachedsamp = GetSamplerParams( &m_samplers[ index ], texMipCount );
 			GLMTexSamplingParams	*glsamp = &gl.m_samplers[ index ];
 
-			// address modes
-			glsamp->m_addressModes[0] = dxtogl_addressMode[ dxsamp->m_addressModes[0] ];
-			glsamp->m_addressModes[1] = dxtogl_addressMode[ dxsamp->m_addressModes[1] ];
-			glsamp->m_addressModes[2] = dxtogl_addressMode[ dxsamp->m_addressModes[2] ];
-
-			// border color
-			uint dxcolor = dxsamp->m_borderColor;
-			glsamp->m_borderColor[0] =	((dxcolor >> 16) & 0xFF) / 255.0f;	//R
-			glsamp->m_borderColor[1] =	((dxcolor >>  8) & 0xFF) / 255.0f;	//G
-			glsamp->m_borderColor[2] =	((dxcolor      ) & 0xFF) / 255.0f;	//B
-			glsamp->m_borderColor[3] =	((dxcolor >> 24) & 0xFF) / 255.0f;	//A
-
-			// filter state
-			
-			// mag filter - pretty easy
-			Assert( dxsamp->m_magFilter <= D3DTEXF_ANISOTROPIC );
-			Assert( dxsamp->m_magFilter >= D3DTEXF_POINT );
-
-			glsamp->m_magFilter = dxtogl_magFilter[ dxsamp->m_magFilter ];
-			
-			// min filter - more involved
-			Assert( dxsamp->m_minFilter <= D3DTEXF_ANISOTROPIC );
-			Assert( dxsamp->m_minFilter >= D3DTEXF_POINT );
-			Assert( dxsamp->m_mipFilter <= D3DTEXF_LINEAR );
-			Assert( dxsamp->m_mipFilter >= D3DTEXF_NONE );
-
-			D3DTEXTUREFILTERTYPE mipFilterLimit = D3DTEXF_LINEAR;
-			
-			/*
-				if (GLMKnob("caps-key",NULL) > 0.0)
-				{
-					if (dxsamp->m_mipFilter > D3DTEXF_NONE)
-					{
-						// evil hack
-						glsamp->m_magFilter = GL_LINEAR_MIPMAP_NEAREST;
-					}
-				}
-
-				if (GLMKnob("option-key",NULL) > 0.0)
-				{
-					// limit to point
-					mipFilterLimit = D3DTEXF_POINT;
-				}
-				
-				if (GLMKnob("control-key",NULL) > 0.0)
-				{
-					// limit to none
-					mipFilterLimit = D3DTEXF_NONE;
-				}
-			*/
-
-			D3DTEXTUREFILTERTYPE mipFilterChoice = std::min( dxsamp->m_mipFilter, mipFilterLimit );
-			glsamp->m_minFilter = dxtogl_minFilter[ dxsamp->m_minFilter ][ mipFilterChoice ];
-			
-			// should we check for mip filtering being requested on unmipped textures ? does it matter ?
-
-			// mipmap bias
-			glsamp->m_mipmapBias = dxsamp->m_mipmapBias;
-
-			// d3d "MAX MIP LEVEL" means the *largest size* MIP that will be selected. (max size)
-			// this is the same as GL's "MIN LOD level" which means the GL_TEXTURE_MIN_LOD level. (min index)
-			
-			int texMipCount = m_textures[index]->m_tex->m_layout->m_mipCount;
-			Assert( texMipCount >=1 );
-			
-			glsamp->m_minMipLevel = dxsamp->m_maxMipLevel;		// it says gl_minMipLevel because we're setting GL's "GL_TEXTURE_MIN_LOD" aka d3d's "maximum mip size index".
-			if (glsamp->m_minMipLevel >= texMipCount)
+			// write that sampler, unless GLM already has exactly these params
+			if ( cachedsamp != gl.m_samplerParamsApplied[ index ] )
 			{
-				// clamp - you can't have the GL base tex level be higher than the index of the last mip
-				glsamp->m_minMipLevel = texMipCount - 1;
+				*glsamp = *cachedsamp;
+				m_ctx->SetSamplerParams( index, glsamp );
+				gl.m_samplerParamsApplied[ index ] = cachedsamp;
 			}
-
-			// d3d has no idea of a "MIN MIP LEVEL" i.e. smallest size allowed.
-			// this would be expressed in GL by setting the GL_TEXTURE_MIN_LOD meaning largest index to select.
-			// for now, just set it to the index of the last mip.
-			glsamp->m_maxMipLevel = texMipCount-1;				// d3d has no value for constraining how small we can sample.
-																// however we may need to set this more intelligently if textures are not being fully submitted.
-
-			// aniso, and check for questionable combinations
-			Assert( ((dxsamp->m_minFilter == D3DTEXF_ANISOTROPIC) && (dxsamp->m_maxAniso >= 1)) || ((dxsamp->m_minFilter < D3DTEXF_ANISOTROPIC) && (dxsamp->m_maxAniso >= 1)) );
-			glsamp->m_maxAniso = dxsamp->m_maxAniso;
-
-			// SRGB
-			glsamp->m_srgb = dxsamp->m_srgb != 0;
-				
-			// write that sampler.
-			m_ctx->SetSamplerParams( index, glsamp );
-			samplerHitMask ^= mask;	//turn bit off
+			samplerHitMask &= ~bitMask;	//turn bit off
 			
 			// finally, if the SRGB state of the sampler does not match the SRGB format of the underlying texture...
 			// ... and the tex is not a renderable...
@@ -4932,7 +5206,7 @@ HRESULT IDirect3DDevice9::FlushSamplers( uint mask )
 			//  fix it.
 			//	else complain ?
 			
-			if (mask & activeSamplerMask)	// don't do SRGB check on unreferenced textures.
+			if (bitMask & activeSamplerMask)	// don't do SRGB check on unreferenced textures.
 			{
 				bool texsrgb = (m_textures[index]->m_tex->m_layout->m_key.m_texFlags & kGLMTexSRGB) != 0;
 				bool mismatch = (texsrgb != glsamp->m_srgb);
@@ -5043,8 +5317,6 @@ HRESULT IDirect3DDevice9::FlushSamplers( uint mask )
 					}
 				}
 			}
-			
-			glsamp->m_compareMode = dxsamp->m_shadowFilter ? GL_COMPARE_R_TO_TEXTURE_ARB : GL_NONE;
 		}		
 	}
 	
@@ -5284,6 +5556,8 @@ HRESULT	IDirect3DDevice9::FlushGLM( void )
 
 HRESULT IDirect3DDevice9::DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType,UINT StartVertex,UINT PrimitiveCount)
 {
+	FlushUPBatch();
+
 	this->FlushStates( 0xFFFFFFFF );
 	this->FlushSamplers( 0xFFFFFFFF );
 	//this->FlushIndexBindings( );					//indices not really used..
@@ -5336,6 +5610,8 @@ HRESULT IDirect3DDevice9::DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType,UINT Star
 
 HRESULT IDirect3DDevice9::DrawIndexedPrimitive( D3DPRIMITIVETYPE Type,INT BaseVertexIndex,UINT MinVertexIndex,UINT NumVertices,UINT startIndex,UINT primCount )
 {
+	FlushUPBatch();
+
 	this->FlushStates( 0xFFFFFFFF );
 
 	this->FlushSamplers( 0xFFFFFFFF );
@@ -5377,14 +5653,280 @@ HRESULT IDirect3DDevice9::DrawIndexedPrimitive( D3DPRIMITIVETYPE Type,INT BaseVe
 	return S_OK;
 }
 
+#pragma mark ----- UP Draws - (IDirect3DDevice9)
+
+	// gl_up_coalesce: non zero means back to back UP draws of a list type with no state change in between
+	// are merged into one draw.  the ring sizes are per window, see gl_buffer_ring_windows.
+
+//ConVar	gl_up_coalesce( "gl_up_coalesce", "1" );
+//ConVar	gl_up_vertex_ring_size( "gl_up_vertex_ring_size", "1048576" );
+//ConVar	gl_up_index_ring_size( "gl_up_index_ring_size", "262144" );
+int gl_up_coalesce = 1;
+int gl_up_vertex_ring_size = 1024*1024;
+int gl_up_index_ring_size = 256*1024;
+
+static uint UPElementCount( D3DPRIMITIVETYPE type, uint primCount )
+{
+	switch(type)
+	{
+		case	D3DPT_POINTLIST:		return primCount;
+		case	D3DPT_LINELIST:			return primCount * 2;
+		case	D3DPT_TRIANGLELIST:		return primCount * 3;
+		case	D3DPT_TRIANGLESTRIP:	return primCount + 2;
+		default:						Debugger(); return 0;
+	}
+}
+
+static GLenum UPPrimitiveMode( D3DPRIMITIVETYPE type )
+{
+	switch(type)
+	{
+		case	D3DPT_POINTLIST:		return GL_POINTS;
+		case	D3DPT_LINELIST:			return GL_LINES;
+		case	D3DPT_TRIANGLELIST:		return GL_TRIANGLES;
+		case	D3DPT_TRIANGLESTRIP:	return GL_TRIANGLE_STRIP;
+		default:						Debugger(); return GL_TRIANGLES;
+	}
+}
+
+// Find room for size bytes in one of the UP rings and lock it.  Allocations are appended to the live window with
+// a no-overwrite lock.  When the window is full, the pending batch is drawn and the ring is discarded - that fences
+// the window and moves on to one the GPU is done with, so nothing still in flight is ever written over.
+char *IDirect3DDevice9::LockUPRing( bool index, uint size, uint align, uint *offsetOut )
+{
+	uint ringSize = index ? gl_up_index_ring_size : gl_up_vertex_ring_size;
+	uint *cursor = index ? &m_upIndexCursor : &m_upVertexCursor;
+	uint curSize = index	? (m_upIndexRing ? m_upIndexRing->m_idxBuffer->m_size : 0)
+							: (m_upVertexRing ? m_upVertexRing->m_vtxBuffer->m_size : 0);
+
+	uint offset = (*cursor + align - 1) & ~(align - 1);
+	DWORD flags = D3DLOCK_NOOVERWRITE;
+	
+	if (size > curSize)
+	{
+		// first use, or a draw bigger than the whole ring - (re)make it big enough
+		FlushUPBatch();
+		
+		ringSize = std::max( ringSize, size );
+		if (index)
+		{
+			if (m_upIndexRing)
+				m_upIndexRing->Release();
+			CreateIndexBuffer( ringSize, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &m_upIndexRing, NULL );
+		}
+		else
+		{
+			if (m_upVertexRing)
+				m_upVertexRing->Release();
+			CreateVertexBuffer( ringSize, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &m_upVertexRing, NULL );
+		}
+		offset = 0;
+		flags = D3DLOCK_DISCARD;
+	}
+	else if (offset + size > curSize)
+	{
+		// window full
+		FlushUPBatch();
+		
+		offset = 0;
+		flags = D3DLOCK_DISCARD;
+	}
+	
+	void *data = NULL;
+	if (index)
+	{
+		m_upIndexRing->Lock( offset, size, &data, flags );
+	}
+	else
+	{
+		m_upVertexRing->Lock( offset, size, &data, flags );
+	}
+	
+	*cursor = offset + size;
+	*offsetOut = offset;
+	return (char*)data;
+}
+
+HRESULT IDirect3DDevice9::DrawPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType,UINT PrimitiveCount,CONST void* pVertexStreamZeroData,UINT VertexStreamZeroStride)
+{
+	uint vertexCount = UPElementCount( PrimitiveType, PrimitiveCount );
+	uint vertexBytes = vertexCount * VertexStreamZeroStride;
+	if (!vertexCount)
+		return S_OK;
+	
+	// strips can't be concatenated, lists can
+	bool append =	gl_up_coalesce /*.GetInt()*/
+					&& (m_upBatch.m_elementCount != 0)
+					&& (PrimitiveType != D3DPT_TRIANGLESTRIP)
+					&& (m_upBatch.m_primType == PrimitiveType)
+					&& (!m_upBatch.m_indexed)
+					&& (m_upBatch.m_stride == VertexStreamZeroStride);
+	if (!append)
+	{
+		FlushUPBatch();
+	}
+
+	uint vertexOffset;
+	char *vertexDst = LockUPRing( false, vertexBytes, append ? 1 : 16, &vertexOffset );
+	memcpy( vertexDst, pVertexStreamZeroData, vertexBytes );
+	m_upVertexRing->Unlock();
+
+	// a window change draws the batch, in which case this one starts a new one
+	if (append && m_upBatch.m_elementCount)
+	{
+		Assert( vertexOffset == m_upBatch.m_vertexOffset + m_upBatch.m_vertexCount * m_upBatch.m_stride );
+		m_upBatch.m_vertexCount += vertexCount;
+		m_upBatch.m_elementCount += vertexCount;
+	}
+	else
+	{
+		m_upBatch.m_primType = PrimitiveType;
+		m_upBatch.m_indexed = false;
+		m_upBatch.m_index32 = false;
+		m_upBatch.m_stride = VertexStreamZeroStride;
+		m_upBatch.m_vertexOffset = vertexOffset;
+		m_upBatch.m_vertexCount = vertexCount;
+		m_upBatch.m_indexOffset = 0;
+		m_upBatch.m_elementCount = vertexCount;
+	}
+
+	if (!gl_up_coalesce /*.GetInt()*/)
+	{
+		FlushUPBatch();
+	}
+	return S_OK;
+}
+
 HRESULT IDirect3DDevice9::DrawIndexedPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType,UINT MinVertexIndex,UINT NumVertices,UINT PrimitiveCount,CONST void* pIndexData,D3DFORMAT IndexDataFormat,CONST void* pVertexStreamZeroData,UINT VertexStreamZeroStride)
 {
-	this->FlushStates( 0xFFFFFFFF );
+	uint indexCount = UPElementCount( PrimitiveType, PrimitiveCount );
+	uint vertexBytes = NumVertices * VertexStreamZeroStride;
+	if (!indexCount || !NumVertices)
+		return S_OK;
+	
+	// indices get rebased as they're copied, so a merged batch only has to stay within 16 bit indices
+	bool append =	gl_up_coalesce /*.GetInt()*/
+					&& (m_upBatch.m_elementCount != 0)
+					&& (PrimitiveType != D3DPT_TRIANGLESTRIP)
+					&& (m_upBatch.m_primType == PrimitiveType)
+					&& (m_upBatch.m_indexed)
+					&& (!m_upBatch.m_index32)
+					&& (m_upBatch.m_stride == VertexStreamZeroStride)
+					&& (m_upBatch.m_vertexCount + NumVertices <= 65536);
+	if (!append)
+	{
+		FlushUPBatch();
+	}
 
-	Debugger();
+	// only the vertices the indices can reach are copied
+	uint vertexOffset;
+	char *vertexDst = LockUPRing( false, vertexBytes, append ? 1 : 16, &vertexOffset );
+	memcpy( vertexDst, (const char *)pVertexStreamZeroData + MinVertexIndex * VertexStreamZeroStride, vertexBytes );
+	m_upVertexRing->Unlock();
+
+	bool index32 = NumVertices > 65536;
+	uint indexSize = index32 ? sizeof(uint32) : sizeof(uint16);
+	uint indexOffset;
+	char *indexDst = LockUPRing( true, indexCount * indexSize, append ? 1 : 16, &indexOffset );
+
+	// either lock can have moved a ring to a new window and drawn the batch
+	append = append && (m_upBatch.m_elementCount != 0);
+
+	uint baseVertex = append ? m_upBatch.m_vertexCount : 0;
+	int rebase = (int)baseVertex - (int)MinVertexIndex;
+	if (IndexDataFormat == D3DFMT_INDEX32)
+	{
+		const uint32 *src = (const uint32 *)pIndexData;
+		for( uint i=0; i<indexCount; i++ )
+		{
+			if (index32)
+				((uint32*)indexDst)[i] = src[i] + rebase;
+			else
+				((uint16*)indexDst)[i] = (uint16)(src[i] + rebase);
+		}
+	}
+	else
+	{
+		const uint16 *src = (const uint16 *)pIndexData;
+		for( uint i=0; i<indexCount; i++ )
+		{
+			if (index32)
+				((uint32*)indexDst)[i] = src[i] + rebase;
+			else
+				((uint16*)indexDst)[i] = (uint16)(src[i] + rebase);
+		}
+	}
+	m_upIndexRing->Unlock();
+
+	if (append)
+	{
+		Assert( vertexOffset == m_upBatch.m_vertexOffset + m_upBatch.m_vertexCount * m_upBatch.m_stride );
+		Assert( indexOffset == m_upBatch.m_indexOffset + m_upBatch.m_elementCount * sizeof(uint16) );
+		m_upBatch.m_vertexCount += NumVertices;
+		m_upBatch.m_elementCount += indexCount;
+	}
+	else
+	{
+		m_upBatch.m_primType = PrimitiveType;
+		m_upBatch.m_indexed = true;
+		m_upBatch.m_index32 = index32;
+		m_upBatch.m_stride = VertexStreamZeroStride;
+		m_upBatch.m_vertexOffset = vertexOffset;
+		m_upBatch.m_vertexCount = NumVertices;
+		m_upBatch.m_indexOffset = indexOffset;
+		m_upBatch.m_elementCount = indexCount;
+	}
+
+	if (!gl_up_coalesce /*.GetInt()*/)
+	{
+		FlushUPBatch();
+	}
 	return S_OK;
 }
 
+void IDirect3DDevice9::DrawUPBatch( void )
+{
+	D3DUPBatch batch = m_upBatch;
+	m_upBatch.m_elementCount = 0;		// first, so nothing below can come back in here
+
+	// D3D leaves stream zero (and the indices, for indexed UP draws) unset after a UP draw, so borrow them
+	m_streams[0].m_vtxBuffer	= m_upVertexRing;
+	m_streams[0].m_offset		= batch.m_vertexOffset;
+	m_streams[0].m_stride		= batch.m_stride;
+	if (batch.m_indexed)
+	{
+		m_indices.m_idxBuffer = m_upIndexRing;
+	}
+
+	this->FlushStates( 0xFFFFFFFF );
+	this->FlushSamplers( 0xFFFFFFFF );
+	if (batch.m_indexed)
+	{
+		this->FlushIndexBindings( );
+	}
+	this->FlushVertexBindings( 0 );
+	m_ctx->FlushDrawStates( true );
+
+	GLenum mode = UPPrimitiveMode( batch.m_primType );
+	if (batch.m_indexed)
+	{
+		GLenum type = batch.m_index32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+		m_ctx->DrawRangeElements( mode, 0, batch.m_vertexCount - 1, (GLsizei)batch.m_elementCount, type, (const GLvoid *)(uintptr_t)batch.m_indexOffset );
+	}
+	else
+	{
+		m_ctx->DrawArrays( mode, 0, batch.m_elementCount );
+	}
+
+	m_streams[0].m_vtxBuffer	= NULL;
+	m_streams[0].m_offset		= 0;
+	m_streams[0].m_stride		= 0;
+	if (batch.m_indexed)
+	{
+		m_indices.m_idxBuffer = NULL;
+	}
+}
+
 
 
 
@@ -5409,6 +5951,8 @@ void	d3drect_to_glmbox( D3DRECT *src, GLScissorBox_t *dst )
 
 HRESULT IDirect3DDevice9::Clear(DWORD Count,CONST D3DRECT* pRects,DWORD Flags,D3DCOLOR Color,float Z,DWORD Stencil)
 {
+	FlushUPBatch();
+
 	
 	this->FlushStates( (1<<kGLViewportBox) | (1<<kGLViewportDepthRange) );	// i.e. viewport changes..
 	m_ctx->FlushDrawStates( false );
@@ -5479,6 +6023,8 @@ HRESULT IDirect3DDevice9::LightEnable(DWORD Index,BOOL Enable)
 
 HRESULT IDirect3DDevice9::SetScissorRect(CONST RECT* pRect)
 {
+	FlushUPBatch();
+
 	int nSurfaceHeight = m_drawableFBO->m_attach[ kAttColor0 ].m_tex->m_layout->m_key.m_ySize;
 	
 	GLScissorBox_t newScissorBox = { (GLint)pRect->left, (GLint)pRect->top, (GLint)(pRect->right - pRect->left), (GLint)(pRect->bottom - pRect->top) };
@@ -5505,6 +6051,8 @@ HRESULT IDirect3DDevice9::TestCooperativeLevel()
 
 HRESULT IDirect3DDevice9::SetClipPlane(DWORD Index,CONST float* pPlane)
 {
+	FlushUPBatch();
+
 	Assert(Index<2);
 
 	// We actually push the clip plane coeffs to two places
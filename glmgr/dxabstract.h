@@ -630,6 +630,7 @@ struct IDirect3DDevice9;
 struct IDirect3DCubeTexture9;
 struct IDirect3DVertexDeclaration9;
 struct IDirect3DQuery9;
+struct IDirect3DStateBlock9;
 
 
 
@@ -1988,6 +1989,36 @@ struct IDirect3DQuery9 : public IDirect3DResource9	//was IUnknown
     HRESULT					GetData(void* pData,DWORD dwSize,DWORD dwGetDataFlags);
 };
 
+// one SetRenderState call captured between BeginStateBlock and EndStateBlock
+struct D3DRenderStateValue
+{
+	D3DRENDERSTATETYPE		m_state;
+	DWORD					m_value;
+};
+
+// a run of bytes in the device's GL state that a compiled state block overwrites
+struct D3DStateBlockSpan
+{
+	uint					m_offset;
+	uint					m_size;
+};
+
+struct IDirect3DStateBlock9 : public IUnknown
+{
+//public:
+	IDirect3DDevice9		*m_device;
+	std::vector< D3DRenderStateValue >	m_renderStates;		// as recorded, in call order
+
+	// compiled form, built by EndStateBlock: the GL state bytes the block writes, and the dirty bits they raise
+	std::vector< D3DStateBlockSpan >	m_spans;
+	std::vector< unsigned char >		m_values;
+	uint					m_stateDirtyMask;
+
+	virtual					~IDirect3DStateBlock9();
+
+	HRESULT					Apply();
+};
+
 struct IDirect3DVertexBuffer9 : public IDirect3DResource9	//was IUnknown
 {
 //public:
@@ -2087,6 +2118,20 @@ struct D3DIndexDesc
 	IDirect3DIndexBuffer9	*m_idxBuffer;
 };
 
+// UP ("user pointer") draws are copied into a pair of device owned dynamic buffers and held back, so a run
+// of them with no state change in between goes out as a single draw.  this is the one being built up.
+struct D3DUPBatch
+{
+	D3DPRIMITIVETYPE		m_primType;
+	bool					m_indexed;
+	bool					m_index32;			// 32 bit indices - only when a single draw needs more than 64K vertices
+	uint					m_stride;
+	uint					m_vertexOffset;		// byte offset of the first vertex in the vertex ring
+	uint					m_vertexCount;
+	uint					m_indexOffset;		// byte offset of the first index in the index ring
+	uint					m_elementCount;		// vertices (non indexed) or indices (indexed) to draw. 0 = nothing pending
+};
+
 // we latch sampler values until draw time and then convert them all to GL form
 // note these are similar in name to the fields of a GLMTexSamplingParams but contents are not
 // particularly in the texture filtering area
@@ -2105,6 +2150,27 @@ struct D3DSamplerDesc
 	DWORD					m_shadowFilter;		// D3DSAMP_SHADOWFILTER
 };
 
+// the GL form of a sampler depends on the D3D sampler state and on the mip count of the texture it is
+// used with (for the LOD clamps).  FlushSamplers translates each distinct combination once and keeps it.
+struct D3DSamplerKey
+{
+	D3DSamplerDesc			m_desc;
+	int						m_texMipCount;
+};
+
+struct LessThan_D3DSamplerKey
+{
+	bool operator()(const D3DSamplerKey &a, const D3DSamplerKey &b) const
+	{
+		// all fields are 32 bits wide so there is no padding to trip over
+		return memcmp( &a, &b, sizeof(D3DSamplerKey) ) < 0;
+	}
+};
+
+typedef std::map< D3DSamplerKey, GLMTexSamplingParams, LessThan_D3DSamplerKey >	D3DSamplerParamsMap;
+
+#define	D3D_SAMPLER_PARAMS_CACHE_LIMIT	4096		// drop the cache and start over if it gets this big (e.g. animated LOD bias)
+
 struct IDirect3DDevice9 : public IUnknown
 {
 public:
@@ -2122,12 +2188,20 @@ public:
 	IDirect3DVertexDeclaration9	*m_vertDecl;					// Set by SetVertexDeclaration...
 	D3DStreamDesc				m_streams[ D3D_MAX_STREAMS ];	// Set by SetStreamSource..
 	D3DIndexDesc				m_indices;						// Set by SetIndices..
+
+	IDirect3DVertexBuffer9		*m_upVertexRing;				// streaming buffers for DrawPrimitiveUP / DrawIndexedPrimitiveUP, made on first use
+	IDirect3DIndexBuffer9		*m_upIndexRing;
+	uint						m_upVertexCursor;				// end of the last allocation in each ring's live window
+	uint						m_upIndexCursor;
+	D3DUPBatch					m_upBatch;						// UP draws not yet sent to GLM
 	
 	IDirect3DVertexShader9		*m_vertexShader;				// Set by SetVertexShader...
 	IDirect3DPixelShader9		*m_pixelShader;					// Set by SetPixelShader...
 
 	IDirect3DBaseTexture9		*m_textures[16];				// set by SetTexture... NULL if stage inactive
 	D3DSamplerDesc				m_samplers[16];					// set by SetSamplerState..
+	D3DSamplerParamsMap			m_samplerParamsCache;			// translated GL sampler params, filled in by FlushSamplers
+	IDirect3DStateBlock9		*m_recordingStateBlock;			// between BeginStateBlock and EndStateBlock, else NULL
 	// GLM flavor stuff
 	GLMContext					*m_ctx;
 	CGLMFBO						*m_drawableFBO;					// this FBO should have all the attachments set to match m_rtSurfaces and m_dsSurface.
@@ -2179,6 +2253,7 @@ public:
 		
 		// samplers
 		GLMTexSamplingParams		m_samplers[ 16 ];
+		const GLMTexSamplingParams	*m_samplerParamsApplied[ 16 ];	// cache entry last sent to GLM for each sampler, NULL if none
 		
 		// bindings...hmmm...		
 
@@ -2273,9 +2348,16 @@ public:
     HRESULT SetRenderState(D3DRENDERSTATETYPE State,DWORD Value);
     HRESULT SetSamplerState(DWORD Sampler,D3DSAMPLERSTATETYPE Type,DWORD Value);
 
+	// render state blocks. while recording, SetRenderState calls go into the block instead of the device.
+	// sampler states, textures and shaders are not captured.
+	HRESULT BeginStateBlock();
+	HRESULT EndStateBlock(IDirect3DStateBlock9** ppSB);
+	void	CompileStateBlock( IDirect3DStateBlock9 *block );
+
 	// Flushing changes to GL
 	HRESULT FlushStates( uint mask );
 	HRESULT FlushSamplers( uint mask );		// push SetRenderState and SetSamplerState changes
+	const GLMTexSamplingParams *GetSamplerParams( const D3DSamplerDesc *dxsamp, int texMipCount );
 	HRESULT FlushIndexBindings( void );		// push index buffer (set index ptr)
 	HRESULT	FlushVertexBindings( uint baseVertexIndex );	// push vertex streams (set attrib ptrs)
 	HRESULT FlushGLM( void );
@@ -2283,8 +2365,14 @@ public:
 	// Draw.
     HRESULT DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType,UINT StartVertex,UINT PrimitiveCount);
     HRESULT DrawIndexedPrimitive(D3DPRIMITIVETYPE PrimitiveType,INT BaseVertexIndex,UINT MinVertexIndex,UINT NumVertices,UINT startIndex,UINT primCount);
+	HRESULT DrawPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType,UINT PrimitiveCount,CONST void* pVertexStreamZeroData,UINT VertexStreamZeroStride);
 	HRESULT DrawIndexedPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType,UINT MinVertexIndex,UINT NumVertices,UINT PrimitiveCount,CONST void* pIndexData,D3DFORMAT IndexDataFormat,CONST void* pVertexStreamZeroData,UINT VertexStreamZeroStride);
 
+	// anything that changes state a pending UP batch depends on has to send the batch first
+	void	FlushUPBatch( void )	{ if (m_upBatch.m_elementCount) DrawUPBatch(); }
+	void	DrawUPBatch( void );
+	char	*LockUPRing( bool index, uint size, uint align, uint *offsetOut );
+
 	// misc
     BOOL ShowCursor(BOOL bShow);
     HRESULT ValidateDevice(DWORD* pNumPasses);
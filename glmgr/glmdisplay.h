@@ -143,6 +143,8 @@ struct GLMRendererInfoFields
 	// other exts
 	bool	m_hasBindableUniforms;
 	bool	m_hasUniformBuffers;
+	bool	m_hasProgramBinary;			// ARB_get_program_binary - lets the shader pair cache persist linked programs
+	bool	m_hasBufferStorage;			// ARB_buffer_storage + ARB_sync - enables persistent mapped ring for dynamic buffers
 	
 	// runtime options that aren't negotiable once set
 	bool	m_hasDualShaders;			// must supply CLI arg "-glmdualshaders" or we go GLSL only
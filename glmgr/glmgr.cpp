@@ -422,6 +422,8 @@ void	GLMContext::DumpCaps( void )
 	dumpfield( m_maxAniso );
 	dumpfield( m_hasBindableUniforms );
 	dumpfield( m_hasUniformBuffers );
+	dumpfield( m_hasProgramBinary );
+	dumpfield( m_hasBufferStorage );
 	dumpfield( m_hasPerfPackage1 );
 	
 	dumpfield( m_cantBlitReliably );
@@ -533,6 +535,9 @@ void	GLMContext::DelTex( CGLMTex	*tex )
 	//hushed GLM_FUNC;
 	MakeCurrent();
 
+	// the upload worker may be reading its backing store
+	FinishTexUploads( tex );
+
 	for( int i=0; i<GLM_SAMPLER_COUNT; i++)
 	{
 		// clear out any reference in the drawing sampler array
@@ -541,6 +546,11 @@ void	GLMContext::DelTex( CGLMTex	*tex )
 			m_samplers[i].m_drawTex = NULL;
 		}
 
+		if (m_samplers[i].m_appliedTex == tex)
+		{
+			m_samplers[i].m_appliedTex = NULL;	// so a new tex at the same address can't look already applied
+		}
+
 		if (m_samplers[i].m_boundTex == tex)
 		{
 			this->BindTexToTMU( NULL, i );			
@@ -671,6 +681,9 @@ void	GLMContext::Blit2( CGLMTex *srcTex, GLMRect *srcRect, int srcFace, int srcM
 	Assert( srcFace == 0 );
 	Assert( dstFace == 0 );
 
+	FinishTexUploads( srcTex );
+	FinishTexUploads( dstTex );
+
 //	glColor4usv( foo );
 	
 	//----------------------------------------------------------------- format assessment
@@ -933,6 +946,9 @@ void	GLMContext::Blit2( CGLMTex *srcTex, GLMRect *srcRect, int srcFace, int srcM
 
 void	GLMContext::BlitTex( CGLMTex *srcTex, GLMRect *srcRect, int srcFace, int srcMip, CGLMTex *dstTex, GLMRect *dstRect, int dstFace, int dstMip, GLenum filter, bool useBlitFB )
 {
+	FinishTexUploads( srcTex );
+	FinishTexUploads( dstTex );
+
 	switch( srcTex->m_layout->m_format->m_glDataFormat )
 	{
 		case GL_BGRA:
@@ -2103,6 +2119,8 @@ void	GLMContext::BeginFrame( void )
 	m_debugFrameIndex++;
 	m_debugBatchIndex = -1;
 
+	memset( &m_texBindStats, 0, sizeof(m_texBindStats) );
+
 	// check for lang change at TOF
 	if (m_caps.m_hasDualShaders)
 	{
@@ -2416,11 +2434,14 @@ GLMContext::GLMContext( GLMDisplayParams *params )
 		DumpCaps();
 	}
 	
+	AttachStates();
+
 	SetDisplayParams( params );
 
 	m_texLayoutTable = new CGLMTexLayoutTable;
 	
 	memset( m_samplers, 0, sizeof( m_samplers ) );
+	memset( &m_texBindStats, 0, sizeof( m_texBindStats ) );
 	m_activeTexture = -1;
 	
 	m_texLocks.reserve( 16 );
@@ -2461,6 +2482,9 @@ GLMContext::GLMContext( GLMDisplayParams *params )
 	memset( m_lastKnownVertexAttribs, 0, sizeof(m_lastKnownVertexAttribs) );
 	m_lastKnownVertexAttribMask = 0;
 
+	// makes its staging PBO, which binds - so not until the bind cache above is cleared
+	m_texUploadQueue = new CGLMTexUploadQueue( this );
+
 	// make a null program for use when client asks for NULL FP
 	m_nullFragmentProgram = this->NewProgram(kGLMFragmentProgram, g_nullFragmentProgramText );
 
@@ -2613,6 +2637,12 @@ GLMContext::~GLMContext	()
 		m_pairCache = NULL;
 	}
 	
+	if (m_texUploadQueue)
+	{
+		delete m_texUploadQueue;
+		m_texUploadQueue = NULL;
+	}
+	
 	// we need a m_texTable I think..
 
 	// m_texLayoutTable can be scrubbed once we know that all the tex are freed
@@ -2863,6 +2893,11 @@ void	GLMContext::BindBufferToCtx( EGLMBufferType type, CGLMBuffer *buff, bool fo
 	}	
 }
 
+// gl_texstream_progressive: non zero lets draws go ahead with textures that still have uploads queued.
+// they sample whatever is in GL so far - smaller mips go first, so that's the mip tail.
+//ConVar	gl_texstream_progressive( "gl_texstream_progressive", "0" );
+int gl_texstream_progressive = 0;
+
 //ConVar	gl_can_mix_shader_gammas( "gl_can_mix_shader_gammas", 0 );
 int gl_can_mix_shader_gammas = 0;
 
@@ -2962,6 +2997,17 @@ void	GLMContext::FlushDrawStates( bool shadersOn )	// shadersOn = true for draw
 	}
 	// else... FlushDrawStates will work it out via flSRGBWrite in the fragment shader..
 
+	// queued texel uploads - land whatever is ready, and make sure anything about to be sampled is complete.
+	// this goes ahead of the binding pass since issuing an upload binds on TMU 0.
+	m_texUploadQueue->Service();
+	if (!gl_texstream_progressive /*.GetInt()*/)
+	{
+		for( int i=0; i<GLM_SAMPLER_COUNT; i++)
+		{
+			FinishTexUploads( m_samplers[i].m_drawTex );
+		}
+	}
+
 	// textures and sampling
 	// note we generate a mask of which samplers are running "decode sRGB" mode, to help out the shader pair cache mechanism below.
 	uint	srgbMask = 0;
@@ -2974,12 +3020,34 @@ void	GLMContext::FlushDrawStates( bool shadersOn )	// shadersOn = true for draw
 		{
 			this->BindTexToTMU( samp->m_drawTex, i );
 			samp->m_boundTex = samp->m_drawTex;
+			m_texBindStats.m_bindsIssued++;
+		}
+		else if (samp->m_drawTex)
+		{
+			m_texBindStats.m_bindsSkipped++;
 		}
 		
-		// push sampling params? it will check each one individually.
+		// push sampling params?  skip the whole thing if this TMU already applied the same params to the same tex,
+		// and nothing else (another TMU, a mip upload) has touched the tex sampling state since.
+		// otherwise ApplySamplingParams will check each one individually.
 		if (samp->m_boundTex)
 		{
-			samp->m_boundTex->ApplySamplingParams( &samp->m_samp );
+			CGLMTex *tex = samp->m_boundTex;
+			
+			if ( (tex == samp->m_appliedTex) && (tex->m_samplingSerial == samp->m_appliedSerial) && !memcmp( &samp->m_samp, &samp->m_appliedSamp, sizeof(samp->m_samp) ) )
+			{
+				m_texBindStats.m_samplerUpdatesSkipped++;
+			}
+			else
+			{
+				SelectTMU( i );		// glTexParameter lands on whatever is bound to the active TMU
+				tex->ApplySamplingParams( &samp->m_samp );
+				
+				samp->m_appliedTex		= tex;
+				samp->m_appliedSerial	= tex->m_samplingSerial;
+				samp->m_appliedSamp		= samp->m_samp;
+				m_texBindStats.m_samplerUpdatesIssued++;
+			}
 		}
 		
 		if (samp->m_samp.m_srgb)
@@ -3120,7 +3188,7 @@ void	GLMContext::FlushDrawStates( bool shadersOn )	// shadersOn = true for draw
 						glEnableVertexAttribArray( index );							// enable attribute, set pointer.
 						GLMCheckError();
 
-						glVertexAttribPointer( index, setdesc->m_datasize, setdesc->m_datatype, setdesc->m_normalized, setdesc->m_stride, (const GLvoid *)(uintptr_t)setdesc->m_offset );
+						glVertexAttribPointer( index, setdesc->m_datasize, setdesc->m_datatype, setdesc->m_normalized, setdesc->m_stride, (const GLvoid *)(uintptr_t)(setdesc->m_offset + buf->m_ringBase) );
 						GLMCheckError();
 						//GLMPRINTF(("--- GLMContext::SetVertexAttributes attr %d set to offset/stride %d/%d in buffer %d (normalized=%s)", index, setdesc->m_offset, setdesc->m_stride, setdesc->m_buffer->m_name, setdesc->m_normalized?"true":"false" ));
 					}
@@ -3427,7 +3495,7 @@ void	GLMContext::FlushDrawStates( bool shadersOn )	// shadersOn = true for draw
 								loopCurrentBuf = buf;
 							}
 
-							glVertexAttribPointer( index, newDesc->m_datasize, newDesc->m_datatype, newDesc->m_normalized, newDesc->m_stride, (const GLvoid *)(uintptr_t)newDesc->m_offset );
+							glVertexAttribPointer( index, newDesc->m_datasize, newDesc->m_datatype, newDesc->m_normalized, newDesc->m_stride, (const GLvoid *)(uintptr_t)(newDesc->m_offset + buf->m_ringBase) );
 							GLMCheckError();
 						}
 						
@@ -3969,6 +4037,9 @@ void	GLMContext::DebugDump( GLMDebugHookInfo *info, uint options, uint vertDumpM
 	{
 		GLMPRINTF(( "-D-" ));
 		GLMPRINTF(( "-D- Texture / Sampler setup" ));
+		GLMPRINTF(( "-D- (this frame: tex binds %d issued / %d skipped, sampler updates %d issued / %d skipped)",
+			m_texBindStats.m_bindsIssued, m_texBindStats.m_bindsSkipped,
+			m_texBindStats.m_samplerUpdatesIssued, m_texBindStats.m_samplerUpdatesSkipped ));
 
 		for( int i=0; i<GLM_SAMPLER_COUNT; i++ )
 		{
@@ -4927,6 +4998,11 @@ void	GLMContext::DrawRangeElements(	GLenum mode, GLuint start, GLuint end, GLsiz
 		// you have to pass actual address, not offset... shhh... secret
 		indicesActual = (void*)((uintptr_t)indicesActual + (uintptr_t)m_drawIndexBuffer->m_pseudoBuf);
 	}
+	else if (m_drawIndexBuffer->m_ring)
+	{
+		// indices are relative to the live window of the ring, not the start of the GL buffer
+		indicesActual = (void*)((uintptr_t)indicesActual + (uintptr_t)m_drawIndexBuffer->m_ringBase);
+	}
 	
 #if GLMDEBUG
 	// init debug hook information
@@ -5464,61 +5540,100 @@ void GLMContext::SetDefaultStates( void )
 	m_ClearStencil.Default();	
 }
 
+void GLMContext::AttachStates( void )
+{
+	m_stateDirtyMask = 0;
+
+	m_AlphaTestEnable.Attach		( &m_stateDirtyMask, 1<<kGLMStateAlphaTestEnable );
+	m_AlphaTestFunc.Attach			( &m_stateDirtyMask, 1<<kGLMStateAlphaTestFunc );
+	m_AlphaToCoverageEnable.Attach	( &m_stateDirtyMask, 1<<kGLMStateAlphaToCoverageEnable );
+	m_CullFaceEnable.Attach			( &m_stateDirtyMask, 1<<kGLMStateCullFaceEnable );
+	m_CullFrontFace.Attach			( &m_stateDirtyMask, 1<<kGLMStateCullFrontFace );
+	m_PolygonMode.Attach			( &m_stateDirtyMask, 1<<kGLMStatePolygonMode );
+	m_DepthBias.Attach				( &m_stateDirtyMask, 1<<kGLMStateDepthBias );
+	m_ClipPlaneEnable.Attach		( &m_stateDirtyMask, 1<<kGLMStateClipPlaneEnable );
+	m_ClipPlaneEquation.Attach		( &m_stateDirtyMask, 1<<kGLMStateClipPlaneEquation );
+	m_ScissorEnable.Attach			( &m_stateDirtyMask, 1<<kGLMStateScissorEnable );
+	m_ScissorBox.Attach				( &m_stateDirtyMask, 1<<kGLMStateScissorBox );
+	m_ViewportBox.Attach			( &m_stateDirtyMask, 1<<kGLMStateViewportBox );
+	m_ViewportDepthRange.Attach		( &m_stateDirtyMask, 1<<kGLMStateViewportDepthRange );
+	m_ColorMaskSingle.Attach		( &m_stateDirtyMask, 1<<kGLMStateColorMaskSingle );
+	m_ColorMaskMultiple.Attach		( &m_stateDirtyMask, 1<<kGLMStateColorMaskMultiple );
+	m_BlendEnable.Attach			( &m_stateDirtyMask, 1<<kGLMStateBlendEnable );
+	m_BlendFactor.Attach			( &m_stateDirtyMask, 1<<kGLMStateBlendFactor );
+	m_BlendEquation.Attach			( &m_stateDirtyMask, 1<<kGLMStateBlendEquation );
+	m_BlendColor.Attach				( &m_stateDirtyMask, 1<<kGLMStateBlendColor );
+	// m_BlendEnableSRGB stays unattached - FlushDrawStates flushes it once the FBO is known
+	m_DepthTestEnable.Attach		( &m_stateDirtyMask, 1<<kGLMStateDepthTestEnable );
+	m_DepthFunc.Attach				( &m_stateDirtyMask, 1<<kGLMStateDepthFunc );
+	m_DepthMask.Attach				( &m_stateDirtyMask, 1<<kGLMStateDepthMask );
+	m_StencilTestEnable.Attach		( &m_stateDirtyMask, 1<<kGLMStateStencilTestEnable );
+	m_StencilFunc.Attach			( &m_stateDirtyMask, 1<<kGLMStateStencilFunc );
+	m_StencilOp.Attach				( &m_stateDirtyMask, 1<<kGLMStateStencilOp );
+	m_StencilWriteMask.Attach		( &m_stateDirtyMask, 1<<kGLMStateStencilWriteMask );
+	m_ClearColor.Attach				( &m_stateDirtyMask, 1<<kGLMStateClearColor );
+	m_ClearDepth.Attach				( &m_stateDirtyMask, 1<<kGLMStateClearDepth );
+	m_ClearStencil.Attach			( &m_stateDirtyMask, 1<<kGLMStateClearStencil );
+}
+
 void GLMContext::FlushStates( bool noDefer )
 {
 	GLM_FUNC;
 	CheckCurrent();
 
-	m_AlphaTestEnable.Flush( noDefer );
-	m_AlphaTestFunc.Flush( noDefer );
-	
-	m_AlphaToCoverageEnable.Flush( noDefer );
-
-	m_CullFaceEnable.Flush( noDefer );
-	m_CullFrontFace.Flush( noDefer );
-	
-	m_PolygonMode.Flush( noDefer );
-	m_DepthBias.Flush( noDefer );
+	// only visit the state objects that went dirty since the last flush - unless told to push everything.
+	uint mask = noDefer ? ( (1<<kGLMStateBitCount) - 1 ) : m_stateDirtyMask;
+	bool clipNoDefer = noDefer;
 
 	#if GLMDEBUG
-		m_ClipPlaneEnable.Flush( true );	// always push clip state
-		m_ClipPlaneEquation.Flush( true );
-	#else
-		m_ClipPlaneEnable.Flush( noDefer );
-		m_ClipPlaneEquation.Flush( noDefer );
+		mask |= (1<<kGLMStateClipPlaneEnable) | (1<<kGLMStateClipPlaneEquation);
+		clipNoDefer = true;	// always push clip state
 	#endif
-	
-	
-	m_ScissorEnable.Flush( noDefer );	
-	m_ScissorBox.Flush( noDefer );
-	
-	m_ViewportBox.Flush( noDefer );		
-	m_ViewportDepthRange.Flush( noDefer );
-
-	m_ColorMaskSingle.Flush( noDefer );	
-	m_ColorMaskMultiple.Flush( noDefer );
 
-	m_BlendEnable.Flush( noDefer );
-	m_BlendFactor.Flush( noDefer );
-	m_BlendEquation.Flush( noDefer );
-	m_BlendColor.Flush( noDefer );
-	
-	// the next call should not occur until we're sure the proper SRGB tex format is underneath the FBO.
-	// So, we're moving it up to FlushDrawStates so it can happen at just the right time.
-	//m_BlendEnableSRGB.Flush( noDefer );
-	
-	m_DepthTestEnable.Flush( noDefer );
-	m_DepthFunc.Flush( noDefer );
-	m_DepthMask.Flush( noDefer );
-	
-	m_StencilTestEnable.Flush( noDefer );
-	m_StencilFunc.Flush( noDefer );
-	m_StencilOp.Flush( noDefer );
-	m_StencilWriteMask.Flush( noDefer );
+	m_stateDirtyMask = 0;
 
-	m_ClearColor.Flush( noDefer );
-	m_ClearDepth.Flush( noDefer );
-	m_ClearStencil.Flush( noDefer );
+	for( uint bit=0; mask; bit++, mask >>= 1 )
+	{
+		if (!(mask & 1))
+			continue;
+		
+		switch( bit )
+		{
+			case kGLMStateAlphaTestEnable:			m_AlphaTestEnable.Flush( noDefer );				break;
+			case kGLMStateAlphaTestFunc:			m_AlphaTestFunc.Flush( noDefer );				break;
+			case kGLMStateAlphaToCoverageEnable:	m_AlphaToCoverageEnable.Flush( noDefer );		break;
+			case kGLMStateCullFaceEnable:			m_CullFaceEnable.Flush( noDefer );				break;
+			case kGLMStateCullFrontFace:			m_CullFrontFace.Flush( noDefer );				break;
+			case kGLMStatePolygonMode:				m_PolygonMode.Flush( noDefer );					break;
+			case kGLMStateDepthBias:				m_DepthBias.Flush( noDefer );					break;
+			case kGLMStateClipPlaneEnable:			m_ClipPlaneEnable.Flush( clipNoDefer );			break;
+			case kGLMStateClipPlaneEquation:		m_ClipPlaneEquation.Flush( clipNoDefer );		break;
+			case kGLMStateScissorEnable:			m_ScissorEnable.Flush( noDefer );				break;
+			case kGLMStateScissorBox:				m_ScissorBox.Flush( noDefer );					break;
+			case kGLMStateViewportBox:				m_ViewportBox.Flush( noDefer );					break;
+			case kGLMStateViewportDepthRange:		m_ViewportDepthRange.Flush( noDefer );			break;
+			case kGLMStateColorMaskSingle:			m_ColorMaskSingle.Flush( noDefer );				break;
+			case kGLMStateColorMaskMultiple:		m_ColorMaskMultiple.Flush( noDefer );			break;
+			case kGLMStateBlendEnable:				m_BlendEnable.Flush( noDefer );					break;
+			case kGLMStateBlendFactor:				m_BlendFactor.Flush( noDefer );					break;
+			case kGLMStateBlendEquation:			m_BlendEquation.Flush( noDefer );				break;
+			case kGLMStateBlendColor:				m_BlendColor.Flush( noDefer );					break;
+			
+			// m_BlendEnableSRGB should not be flushed until we're sure the proper SRGB tex format is underneath the FBO.
+			// So, it's flushed up in FlushDrawStates so it can happen at just the right time.
+			
+			case kGLMStateDepthTestEnable:			m_DepthTestEnable.Flush( noDefer );				break;
+			case kGLMStateDepthFunc:				m_DepthFunc.Flush( noDefer );					break;
+			case kGLMStateDepthMask:				m_DepthMask.Flush( noDefer );					break;
+			case kGLMStateStencilTestEnable:		m_StencilTestEnable.Flush( noDefer );			break;
+			case kGLMStateStencilFunc:				m_StencilFunc.Flush( noDefer );					break;
+			case kGLMStateStencilOp:				m_StencilOp.Flush( noDefer );					break;
+			case kGLMStateStencilWriteMask:			m_StencilWriteMask.Flush( noDefer );			break;
+			case kGLMStateClearColor:				m_ClearColor.Flush( noDefer );					break;
+			case kGLMStateClearDepth:				m_ClearDepth.Flush( noDefer );					break;
+			case kGLMStateClearStencil:				m_ClearStencil.Flush( noDefer );				break;
+		}
+	}
 
 	GLMCheckError();
 }
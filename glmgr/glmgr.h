@@ -252,6 +252,44 @@ template<typename T>	void GLContextGetDefaultIndexed( T *dst, int index );
 
 //===========================================================================//
 
+// one bit per state object in the context; a state object that goes dirty on write sets its bit in the
+// context's dirty mask, so FlushStates only has to visit the objects that were actually touched.
+// enum order is flush order.
+enum EGLMStateBit
+{
+	kGLMStateAlphaTestEnable,
+	kGLMStateAlphaTestFunc,
+	kGLMStateAlphaToCoverageEnable,
+	kGLMStateCullFaceEnable,
+	kGLMStateCullFrontFace,
+	kGLMStatePolygonMode,
+	kGLMStateDepthBias,
+	kGLMStateClipPlaneEnable,
+	kGLMStateClipPlaneEquation,
+	kGLMStateScissorEnable,
+	kGLMStateScissorBox,
+	kGLMStateViewportBox,
+	kGLMStateViewportDepthRange,
+	kGLMStateColorMaskSingle,
+	kGLMStateColorMaskMultiple,
+	kGLMStateBlendEnable,
+	kGLMStateBlendFactor,
+	kGLMStateBlendEquation,
+	kGLMStateBlendColor,
+	kGLMStateDepthTestEnable,
+	kGLMStateDepthFunc,
+	kGLMStateDepthMask,
+	kGLMStateStencilTestEnable,
+	kGLMStateStencilFunc,
+	kGLMStateStencilOp,
+	kGLMStateStencilWriteMask,
+	kGLMStateClearColor,
+	kGLMStateClearDepth,
+	kGLMStateClearStencil,
+	
+	kGLMStateBitCount
+};
+
 // caching state object template.  One of these is instantiated in the context per unique struct type above
 template<typename T> class GLState
 {
@@ -260,9 +298,18 @@ template<typename T> class GLState
 		GLState<T>()
 		{
 			dirty = false;
+			dirtyMask = NULL;
+			dirtyBit = 0;
 			memset( &data, 0, sizeof(data) );
 		};
 
+		// attach: report dirty transitions into a context mask (optional - unattached objects are flushed explicitly)
+		void	Attach( uint *mask, uint bit )
+		{
+			dirtyMask = mask;
+			dirtyBit = bit;
+		};
+
 		// write: client src into cache
 		// common case is both false.  dirty is calculated, context write is deferred.
 		void	Write( T *src, bool noCompare=false, bool noDefer=false )
@@ -287,6 +334,10 @@ template<typename T> class GLState
 			{
 				Flush( true );	// dirty becomes false
 			}
+			else if (dirty && dirtyMask)
+			{
+				*dirtyMask |= dirtyBit;
+			}
 		};
 		
 		// write cache->context if dirty or forced.
@@ -338,6 +389,8 @@ template<typename T> class GLState
 	protected:
 		T		data;
 		bool	dirty;
+		uint	*dirtyMask;
+		uint	dirtyBit;
 };
 
 // caching state object template - with multiple values behind it that are indexed
@@ -349,6 +402,15 @@ template<typename T, int COUNT> class GLStateArray
 		{
 			memset( &dirty, 0, sizeof(dirty) );
 			memset( &data, 0, sizeof(data) );
+			dirtyMask = NULL;
+			dirtyBit = 0;
+		};
+
+		// attach: report dirty transitions into a context mask (any slot going dirty sets the one bit)
+		void	Attach( uint *mask, uint bit )
+		{
+			dirtyMask = mask;
+			dirtyBit = bit;
 		};
 
 		// write: client src into cache
@@ -375,6 +437,10 @@ template<typename T, int COUNT> class GLStateArray
 			{
 				FlushIndex( index, true );	// dirty becomes false
 			}
+			else if (dirty[index] && dirtyMask)
+			{
+				*dirtyMask |= dirtyBit;
+			}
 		};
 		
 		// write cache->context if dirty or forced.
@@ -455,6 +521,8 @@ template<typename T, int COUNT> class GLStateArray
 	protected:
 		T		data	[COUNT];
 		bool	dirty	[COUNT];
+		uint	*dirtyMask;
+		uint	dirtyBit;
 };
 
 
@@ -465,6 +533,22 @@ struct	GLMTexSampler
 	GLMTexSamplingParams	m_samp;
 	CGLMTex					*m_drawTex;		// tex which must be bound at time of draw
 	CGLMTex					*m_boundTex;	// tex which is actually bound now (if does not match, a rebind is needed to draw)
+
+	// what FlushDrawStates last pushed through ApplySamplingParams on this TMU.
+	// if tex, tex serial and params all still match, the sampler update is skipped outright.
+	CGLMTex					*m_appliedTex;
+	uint					m_appliedSerial;
+	GLMTexSamplingParams	m_appliedSamp;
+};
+
+// counts of texture binds / sampler updates FlushDrawStates issued vs. found redundant.
+// reset at BeginFrame, reported by DebugDump.
+struct	GLMTexBindStats
+{
+	uint					m_bindsIssued;
+	uint					m_bindsSkipped;
+	uint					m_samplerUpdatesIssued;
+	uint					m_samplerUpdatesSkipped;
 };
 
 //===========================================================================//
@@ -648,6 +732,7 @@ class	GLMContext
 	
 		// state cache/mirror
 		void	SetDefaultStates( void );
+		void	AttachStates( void );			// hook each state object up to m_stateDirtyMask
 		void	FlushStates( bool noDefer = false );
 		void	VerifyStates( void );
 
@@ -669,6 +754,13 @@ class	GLMContext
 			// texture pre-load (residency forcing) - normally done one-time but you can force it
 		void	PreloadTex( CGLMTex *tex, bool force=false );
 
+			// get any queued texel uploads for tex (or one slice of it) into GL - before GL or the backing store gets touched some other way
+		void	FinishTexUploads( CGLMTex *tex, int sliceIndex=-1 )
+		{
+			if (tex && ( (sliceIndex < 0) ? tex->m_uploadsPending : tex->m_sliceUploadsPending[sliceIndex] ))
+				m_texUploadQueue->FinishTex( tex, sliceIndex );
+		}
+
 		// samplers
 		void	SetSamplerTex( int sampler, CGLMTex *tex );
 		void	SetSamplerParams( int sampler, GLMTexSamplingParams *params );
@@ -782,6 +874,7 @@ class	GLMContext
 		friend class GLMgr;				// only GLMgr can make GLMContext objects
 		friend class GLMRendererInfo;	// only GLMgr can make GLMContext objects
 		friend class CGLMTex;			// tex needs to be able to do binds
+		friend class CGLMTexUploadQueue;	// upload queue binds its PBO
 		friend class CGLMFBO;			// fbo needs to be able to do binds
 		friend class CGLMProgram;
 		friend class CGLMShaderPair;
@@ -830,9 +923,14 @@ class	GLMContext
 
 		// texture form table
 		CGLMTexLayoutTable				*m_texLayoutTable;
+		
+		// asynchronous texel uploads
+		CGLMTexUploadQueue				*m_texUploadQueue;
 
 		// context state mirrors
 
+		uint							m_stateDirtyMask;		// (1<<EGLMStateBit) set when a state object below goes dirty, cleared by FlushStates
+
 		GLState<GLAlphaTestEnable_t>	m_AlphaTestEnable;
 		
 		GLState<GLAlphaTestFunc_t>		m_AlphaTestFunc;
@@ -880,6 +978,7 @@ class	GLMContext
 		// texture bindings and sampler setup
 		int								m_activeTexture;		// mirror for glActiveTexture
 		GLMTexSampler					m_samplers[GLM_SAMPLER_COUNT];
+		GLMTexBindStats					m_texBindStats;
 	
 		// texture lock tracking - CGLMTex objects share usage of this
 		std::vector< GLMTexLockDesc >	m_texLocks;
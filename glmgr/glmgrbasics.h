@@ -14,6 +14,11 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <OpenGL/OpenGL.h>
 #include <OpenGL/gl.h>
@@ -46,6 +51,9 @@ typedef uint32_t uint32;
 typedef int64_t int64;
 typedef uint64_t uint64;
 
+// Text buffer used as a string builder by the shader translators.  The length is tracked so
+// appends don't rescan the text, storage grows geometrically so building an N byte program is
+// linear in N, and the contents are always NUL terminated so Base() can be handed to C string code.
 class CUtlBuffer
 {
 public:
@@ -61,13 +69,19 @@ public:
 	CUtlBuffer( int growSize = 0, int initSize = 0, int nFlags = 0 )
 	{
 		// grow size and init flags are ignored.
-		m_buf.reserve( initSize );
+		m_nLength = 0;
+		m_nAllocated = initSize > 0 ? initSize : 1;
+		m_pMemory = (char *)malloc( m_nAllocated );
+		m_pMemory[0] = 0;
 	};
 	
 	CUtlBuffer( const void* pBuffer, int size, int nFlags = 0 )
 	{
-		m_buf.reserve ( size );
-		memcpy( &m_buf[0], pBuffer, size );
+		m_nLength = size;
+		m_nAllocated = size + 1;
+		m_pMemory = (char *)malloc( m_nAllocated );
+		memcpy( m_pMemory, pBuffer, size );
+		m_pMemory[size] = 0;
 	}
 
 	// This one isn't actually defined so that we catch contructors that are trying to pass a bool in as the third param.
@@ -75,45 +89,110 @@ public:
 
 	~CUtlBuffer()
 	{
+		free( m_pMemory );
 	}
 
 	char*	Base( void )
 	{
-		return &m_buf[0];
+		return m_pMemory;
 	}
 	
+	// bytes allocated, always at least TellPut()+1
 	uint32	Size( void )
 	{
-		return m_buf.size();
+		return m_nAllocated;
 	}
-	
+
+	// length of the text, not counting the terminator
+	int		TellPut( void )
+	{
+		return m_nLength;
+	}
+
+	// only ever grows, contents are preserved
 	void	EnsureCapacity( int num )
 	{
-		m_buf.resize( num );
+		if ( num > m_nAllocated )
+		{
+			m_nAllocated = std::max( num, m_nAllocated * 2 );
+			m_pMemory = (char *)realloc( m_pMemory, m_nAllocated );
+		}
+	}
+
+	void	Clear( void )
+	{
+		SeekPut( 0 );
+	}
+
+	// truncate the text to nLength bytes
+	void	SeekPut( int nLength )
+	{
+		Assert( nLength >= 0 && nLength <= m_nLength );
+		m_nLength = nLength;
+		m_pMemory[m_nLength] = 0;
+	}
+
+	void	Put( const void *pData, int nSize )
+	{
+		EnsureCapacity( m_nLength + nSize + 1 );
+		memcpy( &m_pMemory[m_nLength], pData, nSize );
+		m_nLength += nSize;
+		m_pMemory[m_nLength] = 0;
 	}
 
 	void	AppendString( const char* pString )
 	{
-		int appendlen = strlen( pString );		// count of characters, null terminator not included
-		if (Size())
+		Put( pString, strlen( pString ) );
+	}
+
+	void	AppendFormat( const char *pFormat, ... )
+	{
+		va_list marker;
+		va_start( marker, pFormat );
+		AppendFormatV( pFormat, marker );
+		va_end( marker );
+	}
+
+	void	AppendFormatV( const char *pFormat, va_list marker )
+	{
+		// try to format straight into the spare room, grow and go again if it didn't fit
+		va_list copy;
+		va_copy( copy, marker );
+		int nSpare = m_nAllocated - m_nLength;
+		int nLen = vsnprintf( &m_pMemory[m_nLength], nSpare, pFormat, copy );
+		va_end( copy );
+		if ( nLen < 0 )
 		{
-			// append to non empty string
-			EnsureCapacity( Size() + appendlen + 1);
-			//printf("\n **(a) appending \n---\n%s\n---\n to \n---\n%s\n---\n", pString, Base() );
-			strcat( Base(), pString );			// gets NULL terminated
+			m_pMemory[m_nLength] = 0;
+			return;
 		}
-		else
+		if ( nLen >= nSpare )
 		{
-			EnsureCapacity( Size() + appendlen + 1);
-			//printf("\n **(b) appending \n---\n%s\n---\n to \n---\n%s\n---\n", pString, Base() );
-			strcpy( Base(), pString );
+			EnsureCapacity( m_nLength + nLen + 1 );
+			vsnprintf( &m_pMemory[m_nLength], m_nAllocated - m_nLength, pFormat, marker );
 		}
+		m_nLength += nLen;
+	}
+
+	// splice text in at nOffset, moving everything after it along
+	void	InsertString( int nOffset, const char *pString )
+	{
+		Assert( nOffset >= 0 && nOffset <= m_nLength );
+		int nInsert = strlen( pString );
+		EnsureCapacity( m_nLength + nInsert + 1 );
+		memmove( &m_pMemory[nOffset + nInsert], &m_pMemory[nOffset], m_nLength - nOffset + 1 );
+		memcpy( &m_pMemory[nOffset], pString, nInsert );
+		m_nLength += nInsert;
 	}
 	
 private:
 	CUtlBuffer();
+	CUtlBuffer( const CUtlBuffer & );
+	CUtlBuffer &operator=( const CUtlBuffer & );
 	
-	std::vector<char> m_buf;
+	char *m_pMemory;
+	int m_nAllocated;
+	int m_nLength;
 };
 
 class CUtlString
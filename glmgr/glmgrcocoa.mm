@@ -597,6 +597,28 @@ GLMRendererInfo::GLMRendererInfo( GLMRendererInfoFields *info )
 		m_info.m_hasUniformBuffers = false;
 	}
 
+	//-------------------------------------------------------------------
+	m_info.m_hasProgramBinary = true;
+	if (!strstr(gl_ext_string, "ARB_get_program_binary"))
+	{
+		m_info.m_hasProgramBinary = false;
+	}
+	if (!pfnglGetProgramBinary || !pfnglProgramBinary || !pfnglProgramParameteri)
+	{
+		m_info.m_hasProgramBinary = false;		// advertised but no entry points, don't trust it
+	}
+
+	//-------------------------------------------------------------------
+	m_info.m_hasBufferStorage = true;
+	if (!strstr(gl_ext_string, "ARB_buffer_storage") || !strstr(gl_ext_string, "ARB_sync"))
+	{
+		m_info.m_hasBufferStorage = false;
+	}
+	if (!pfnglBufferStorage || !pfnglMapBufferRange || !pfnglFenceSync || !pfnglClientWaitSync || !pfnglDeleteSync)
+	{
+		m_info.m_hasBufferStorage = false;
+	}
+
 	//-------------------------------------------------------------------
 	// test for performance pack (10.6.4+)
 
@@ -17,6 +17,14 @@ PFNglEnableIndexedEXT pfnglEnableIndexedEXT;
 PFNglDisableIndexedEXT pfnglDisableIndexedEXT;
 PFNglGetFramebufferAttachmentParameteriv pfnglGetFramebufferAttachmentParameteriv;
 PFNglUniformBufferEXT pfnglUniformBufferEXT;
+PFNglGetProgramBinary pfnglGetProgramBinary;
+PFNglProgramBinary pfnglProgramBinary;
+PFNglProgramParameteri pfnglProgramParameteri;
+PFNglBufferStorage pfnglBufferStorage;
+PFNglMapBufferRange pfnglMapBufferRange;
+PFNglFenceSync pfnglFenceSync;
+PFNglClientWaitSync pfnglClientWaitSync;
+PFNglDeleteSync pfnglDeleteSync;
 
 // NSSymbol was deprecated in 10.5.
 #pragma clang diagnostic push
@@ -46,6 +54,16 @@ void GLMSetupExtensions( void )
 	pfnglGetFramebufferAttachmentParameteriv = (PFNglGetFramebufferAttachmentParameteriv) NSGLGetProcAddress( "glGetFramebufferAttachmentParameteriv" );
 
 	pfnglUniformBufferEXT = (PFNglUniformBufferEXT) NSGLGetProcAddress( "glUniformBufferEXT" );
+
+	pfnglGetProgramBinary = (PFNglGetProgramBinary) NSGLGetProcAddress( "glGetProgramBinary" );
+	pfnglProgramBinary = (PFNglProgramBinary) NSGLGetProcAddress( "glProgramBinary" );
+	pfnglProgramParameteri = (PFNglProgramParameteri) NSGLGetProcAddress( "glProgramParameteri" );
+
+	pfnglBufferStorage = (PFNglBufferStorage) NSGLGetProcAddress( "glBufferStorage" );
+	pfnglMapBufferRange = (PFNglMapBufferRange) NSGLGetProcAddress( "glMapBufferRange" );
+	pfnglFenceSync = (PFNglFenceSync) NSGLGetProcAddress( "glFenceSync" );
+	pfnglClientWaitSync = (PFNglClientWaitSync) NSGLGetProcAddress( "glClientWaitSync" );
+	pfnglDeleteSync = (PFNglDeleteSync) NSGLGetProcAddress( "glDeleteSync" );
 }
 
 /*
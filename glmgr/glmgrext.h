@@ -71,6 +71,34 @@
 	#define GL_UNIFORM_BUFFER_EXT             0x8DEE
 #endif
 
+#ifndef GL_ARB_get_program_binary
+	#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT	0x8257
+	#define GL_PROGRAM_BINARY_LENGTH			0x8741
+	#define GL_NUM_PROGRAM_BINARY_FORMATS		0x87FE
+	#define GL_PROGRAM_BINARY_FORMATS			0x87FF
+#endif
+
+#ifndef GL_ARB_map_buffer_range
+	#define GL_MAP_READ_BIT						0x0001
+	#define GL_MAP_WRITE_BIT					0x0002
+#endif
+
+#ifndef GL_ARB_buffer_storage
+	#define GL_MAP_PERSISTENT_BIT				0x0040
+	#define GL_MAP_COHERENT_BIT					0x0080
+#endif
+
+#ifndef GL_ARB_sync
+	typedef struct __GLsync *GLsync;
+
+	#define GL_SYNC_FLUSH_COMMANDS_BIT			0x00000001
+	#define GL_SYNC_GPU_COMMANDS_COMPLETE		0x9117
+	#define GL_ALREADY_SIGNALED					0x911A
+	#define GL_TIMEOUT_EXPIRED					0x911B
+	#define GL_CONDITION_SATISFIED				0x911C
+	#define GL_WAIT_FAILED						0x911D
+#endif
+
 // unpublished extension enums (thus the "X")
 
 // from EXT_framebuffer_multisample_blit_scaled..
@@ -99,3 +127,25 @@ extern PFNglUniformBufferEXT pfnglUniformBufferEXT;
 typedef void (*PFNglGetFramebufferAttachmentParameteriv)(GLenum target, GLenum attachment, GLenum pname, GLint *params);
 extern PFNglGetFramebufferAttachmentParameteriv pfnglGetFramebufferAttachmentParameteriv;
 
+// ARB_get_program_binary - used by the persistent tier of CGLMShaderPairCache
+typedef void (*PFNglGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, GLvoid *binary);
+typedef void (*PFNglProgramBinary)(GLuint program, GLenum binaryFormat, const GLvoid *binary, GLsizei length);
+typedef void (*PFNglProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+extern PFNglGetProgramBinary pfnglGetProgramBinary;
+extern PFNglProgramBinary pfnglProgramBinary;
+extern PFNglProgramParameteri pfnglProgramParameteri;
+
+// ARB_buffer_storage + ARB_sync - used by the persistent ring mode of CGLMBuffer
+typedef void (*PFNglBufferStorage)(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
+typedef GLvoid * (*PFNglMapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLsync (*PFNglFenceSync)(GLenum condition, GLbitfield flags);
+typedef GLenum (*PFNglClientWaitSync)(GLsync sync, GLbitfield flags, unsigned long long timeout);
+typedef void (*PFNglDeleteSync)(GLsync sync);
+
+extern PFNglBufferStorage pfnglBufferStorage;
+extern PFNglMapBufferRange pfnglMapBufferRange;
+extern PFNglFenceSync pfnglFenceSync;
+extern PFNglClientWaitSync pfnglClientWaitSync;
+extern PFNglDeleteSync pfnglDeleteSync;
+
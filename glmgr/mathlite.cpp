@@ -1,5 +1,17 @@
 #include "mathlite.h"
 
+// The batch transforms below have SSE / AVX2 paths on x86, everything else stays scalar
+#if !( defined( OSX ) && defined( __aarch64__ ) ) && ( defined( __i386__ ) || defined( __x86_64__ ) || defined( _M_IX86 ) || defined( _M_X64 ) )
+#define MATHLITE_BATCH_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define MATHLITE_BATCH_X86 0
+#endif
+
 // ------------------------------------------------------------------------------------------- //
 // Helper functions.
 // ------------------------------------------------------------------------------------------- //
@@ -1250,3 +1262,548 @@ void MatrixBuildPerspectiveOffCenterX( VMatrix& dst, double flFovX, double flAsp
 }
 
 
+//-----------------------------------------------------------------------------
+// Batch transforms
+//-----------------------------------------------------------------------------
+
+#if MATHLITE_BATCH_X86
+
+#if defined( __GNUC__ )
+#define MATHLITE_TARGET_SSE		__attribute__(( target( "sse2" ) ))
+#define MATHLITE_TARGET_AVX2	__attribute__(( target( "avx2,fma" ) ))
+#else
+#define MATHLITE_TARGET_SSE
+#define MATHLITE_TARGET_AVX2
+#endif
+
+// The kernels walk Vector arrays as packed floats
+typedef char MathLiteVectorIsPacked_t[ ( sizeof( Vector ) == 3 * sizeof( float ) && sizeof( Vector4D ) == 4 * sizeof( float ) ) ? 1 : -1 ];
+
+static MathLiteSIMDLevel_t DetectSIMDLevel()
+{
+#if defined( _MSC_VER )
+	int regs[4];
+	__cpuid( regs, 0 );
+	int nMaxLeaf = regs[0];
+
+	__cpuid( regs, 1 );
+	if ( !( regs[3] & ( 1 << 26 ) ) )		// SSE2
+		return MATHLITE_SIMD_NONE;
+
+	// FMA, OSXSAVE and AVX, plus the OS saving YMM state
+	const int nAVXBits = ( 1 << 12 ) | ( 1 << 27 ) | ( 1 << 28 );
+	if ( nMaxLeaf >= 7 && ( regs[2] & nAVXBits ) == nAVXBits && ( _xgetbv( 0 ) & 6 ) == 6 )
+	{
+		__cpuidex( regs, 7, 0 );
+		if ( regs[1] & ( 1 << 5 ) )				// AVX2
+			return MATHLITE_SIMD_AVX2;
+	}
+	return MATHLITE_SIMD_SSE;
+#else
+	__builtin_cpu_init();
+	if ( !__builtin_cpu_supports( "sse2" ) )
+		return MATHLITE_SIMD_NONE;
+	if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+		return MATHLITE_SIMD_AVX2;
+	return MATHLITE_SIMD_SSE;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// SSE
+//-----------------------------------------------------------------------------
+
+// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3  ->  x0..x3, y0..y3, z0..z3
+#define MATHLITE_DEINTERLEAVE3( type, shuf, a, b, c, x, y, z ) \
+	{ \
+		type x2y2 = shuf( b, c, _MM_SHUFFLE( 2, 1, 3, 2 ) ); \
+		type y0z0 = shuf( a, b, _MM_SHUFFLE( 1, 0, 2, 1 ) ); \
+		x = shuf( a, x2y2, _MM_SHUFFLE( 2, 0, 3, 0 ) ); \
+		y = shuf( y0z0, x2y2, _MM_SHUFFLE( 3, 1, 2, 0 ) ); \
+		z = shuf( y0z0, c, _MM_SHUFFLE( 3, 0, 3, 1 ) ); \
+	}
+
+// And back again
+#define MATHLITE_INTERLEAVE3( type, shuf, x, y, z, a, b, c ) \
+	{ \
+		type xy = shuf( x, y, _MM_SHUFFLE( 2, 0, 2, 0 ) ); \
+		type yz = shuf( y, z, _MM_SHUFFLE( 3, 1, 3, 1 ) ); \
+		type zx = shuf( z, x, _MM_SHUFFLE( 3, 1, 2, 0 ) ); \
+		a = shuf( xy, zx, _MM_SHUFFLE( 2, 0, 2, 0 ) ); \
+		b = shuf( yz, xy, _MM_SHUFFLE( 3, 1, 2, 0 ) ); \
+		c = shuf( zx, yz, _MM_SHUFFLE( 3, 1, 3, 1 ) ); \
+	}
+
+// Returns how many it did, always a multiple of 4
+MATHLITE_TARGET_SSE static int Vector3DTransform_SSE( const VMatrix& src1, const Vector *pSrc, Vector *pDst, int nCount, bool bPosition )
+{
+	__m128 m00 = _mm_set1_ps( src1[0][0] ), m01 = _mm_set1_ps( src1[0][1] ), m02 = _mm_set1_ps( src1[0][2] ), m03 = _mm_set1_ps( src1[0][3] );
+	__m128 m10 = _mm_set1_ps( src1[1][0] ), m11 = _mm_set1_ps( src1[1][1] ), m12 = _mm_set1_ps( src1[1][2] ), m13 = _mm_set1_ps( src1[1][3] );
+	__m128 m20 = _mm_set1_ps( src1[2][0] ), m21 = _mm_set1_ps( src1[2][1] ), m22 = _mm_set1_ps( src1[2][2] ), m23 = _mm_set1_ps( src1[2][3] );
+
+	const float *pIn = (const float *)pSrc;
+	float *pOut = (float *)pDst;
+	int nDone = nCount & ~3;
+	for ( int i = 0; i < nDone; i += 4, pIn += 12, pOut += 12 )
+	{
+		__m128 a = _mm_loadu_ps( pIn ), b = _mm_loadu_ps( pIn + 4 ), c = _mm_loadu_ps( pIn + 8 );
+		__m128 x, y, z;
+		MATHLITE_DEINTERLEAVE3( __m128, _mm_shuffle_ps, a, b, c, x, y, z );
+
+		__m128 rx = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m00, x ), _mm_mul_ps( m01, y ) ), _mm_mul_ps( m02, z ) );
+		__m128 ry = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m10, x ), _mm_mul_ps( m11, y ) ), _mm_mul_ps( m12, z ) );
+		__m128 rz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m20, x ), _mm_mul_ps( m21, y ) ), _mm_mul_ps( m22, z ) );
+		if ( bPosition )
+		{
+			rx = _mm_add_ps( rx, m03 );
+			ry = _mm_add_ps( ry, m13 );
+			rz = _mm_add_ps( rz, m23 );
+		}
+
+		MATHLITE_INTERLEAVE3( __m128, _mm_shuffle_ps, rx, ry, rz, a, b, c );
+		_mm_storeu_ps( pOut, a );
+		_mm_storeu_ps( pOut + 4, b );
+		_mm_storeu_ps( pOut + 8, c );
+	}
+	return nDone;
+}
+
+MATHLITE_TARGET_SSE static int Vector4DTransformPosition_SSE( const VMatrix& src1, const Vector *pSrc, Vector4D *pDst, int nCount )
+{
+	__m128 m00 = _mm_set1_ps( src1[0][0] ), m01 = _mm_set1_ps( src1[0][1] ), m02 = _mm_set1_ps( src1[0][2] ), m03 = _mm_set1_ps( src1[0][3] );
+	__m128 m10 = _mm_set1_ps( src1[1][0] ), m11 = _mm_set1_ps( src1[1][1] ), m12 = _mm_set1_ps( src1[1][2] ), m13 = _mm_set1_ps( src1[1][3] );
+	__m128 m20 = _mm_set1_ps( src1[2][0] ), m21 = _mm_set1_ps( src1[2][1] ), m22 = _mm_set1_ps( src1[2][2] ), m23 = _mm_set1_ps( src1[2][3] );
+	__m128 m30 = _mm_set1_ps( src1[3][0] ), m31 = _mm_set1_ps( src1[3][1] ), m32 = _mm_set1_ps( src1[3][2] ), m33 = _mm_set1_ps( src1[3][3] );
+
+	const float *pIn = (const float *)pSrc;
+	float *pOut = (float *)pDst;
+	int nDone = nCount & ~3;
+	for ( int i = 0; i < nDone; i += 4, pIn += 12, pOut += 16 )
+	{
+		__m128 a = _mm_loadu_ps( pIn ), b = _mm_loadu_ps( pIn + 4 ), c = _mm_loadu_ps( pIn + 8 );
+		__m128 x, y, z;
+		MATHLITE_DEINTERLEAVE3( __m128, _mm_shuffle_ps, a, b, c, x, y, z );
+
+		__m128 rx = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m00, x ), _mm_mul_ps( m01, y ) ), _mm_add_ps( _mm_mul_ps( m02, z ), m03 ) );
+		__m128 ry = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m10, x ), _mm_mul_ps( m11, y ) ), _mm_add_ps( _mm_mul_ps( m12, z ), m13 ) );
+		__m128 rz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m20, x ), _mm_mul_ps( m21, y ) ), _mm_add_ps( _mm_mul_ps( m22, z ), m23 ) );
+		__m128 rw = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m30, x ), _mm_mul_ps( m31, y ) ), _mm_add_ps( _mm_mul_ps( m32, z ), m33 ) );
+
+		_MM_TRANSPOSE4_PS( rx, ry, rz, rw );
+		_mm_storeu_ps( pOut, rx );
+		_mm_storeu_ps( pOut + 4, ry );
+		_mm_storeu_ps( pOut + 8, rz );
+		_mm_storeu_ps( pOut + 12, rw );
+	}
+	return nDone;
+}
+
+MATHLITE_TARGET_SSE static void MatrixMultiply_SSE( const VMatrix& src1, const VMatrix& src2, VMatrix& dst )
+{
+	// Everything is loaded before anything is stored, so dst can be either source
+	__m128 b0 = _mm_loadu_ps( src2.m[0] ), b1 = _mm_loadu_ps( src2.m[1] ), b2 = _mm_loadu_ps( src2.m[2] ), b3 = _mm_loadu_ps( src2.m[3] );
+	__m128 a[4] = { _mm_loadu_ps( src1.m[0] ), _mm_loadu_ps( src1.m[1] ), _mm_loadu_ps( src1.m[2] ), _mm_loadu_ps( src1.m[3] ) };
+
+	for ( int i = 0; i < 4; ++i )
+	{
+		__m128 r = _mm_mul_ps( _mm_shuffle_ps( a[i], a[i], _MM_SHUFFLE( 0, 0, 0, 0 ) ), b0 );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( a[i], a[i], _MM_SHUFFLE( 1, 1, 1, 1 ) ), b1 ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( a[i], a[i], _MM_SHUFFLE( 2, 2, 2, 2 ) ), b2 ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( a[i], a[i], _MM_SHUFFLE( 3, 3, 3, 3 ) ), b3 ) );
+		_mm_storeu_ps( dst.m[i], r );
+	}
+}
+
+// Cephes style single precision sincos, good to a couple of ulps for |x| up to a few thousand radians
+#define MATHLITE_SINCOS_FOPI	1.27323954473516f
+#define MATHLITE_SINCOS_DP1		0.78515625f
+#define MATHLITE_SINCOS_DP2		2.4187564849853515625e-4f
+#define MATHLITE_SINCOS_DP3		3.77489497744594108e-8f
+#define MATHLITE_SINCOS_S0		-1.9515295891e-4f
+#define MATHLITE_SINCOS_S1		8.3321608736e-3f
+#define MATHLITE_SINCOS_S2		-1.6666654611e-1f
+#define MATHLITE_SINCOS_C0		2.443315711809948e-5f
+#define MATHLITE_SINCOS_C1		-1.388731625493765e-3f
+#define MATHLITE_SINCOS_C2		4.166664568298827e-2f
+
+MATHLITE_TARGET_SSE static void SinCos_SSE( __m128 x, __m128 *pSin, __m128 *pCos )
+{
+	const __m128 signMask = _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) );
+
+	__m128 signSin = _mm_and_ps( x, signMask );
+	x = _mm_andnot_ps( signMask, x );
+
+	// Octant, rounded up to even
+	__m128i j = _mm_cvttps_epi32( _mm_mul_ps( x, _mm_set1_ps( MATHLITE_SINCOS_FOPI ) ) );
+	j = _mm_and_si128( _mm_add_epi32( j, _mm_set1_epi32( 1 ) ), _mm_set1_epi32( ~1 ) );
+	__m128 y = _mm_cvtepi32_ps( j );
+
+	signSin = _mm_xor_ps( signSin, _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( j, _mm_set1_epi32( 4 ) ), 29 ) ) );
+	__m128 signCos = _mm_castsi128_ps( _mm_slli_epi32( _mm_andnot_si128( _mm_sub_epi32( j, _mm_set1_epi32( 2 ) ), _mm_set1_epi32( 4 ) ), 29 ) );
+	__m128 polyMask = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( j, _mm_set1_epi32( 2 ) ), _mm_setzero_si128() ) );
+
+	// Extended precision x - y * pi/4
+	x = _mm_sub_ps( x, _mm_mul_ps( y, _mm_set1_ps( MATHLITE_SINCOS_DP1 ) ) );
+	x = _mm_sub_ps( x, _mm_mul_ps( y, _mm_set1_ps( MATHLITE_SINCOS_DP2 ) ) );
+	x = _mm_sub_ps( x, _mm_mul_ps( y, _mm_set1_ps( MATHLITE_SINCOS_DP3 ) ) );
+	__m128 z = _mm_mul_ps( x, x );
+
+	__m128 c = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( MATHLITE_SINCOS_C0 ), z ), _mm_set1_ps( MATHLITE_SINCOS_C1 ) );
+	c = _mm_add_ps( _mm_mul_ps( c, z ), _mm_set1_ps( MATHLITE_SINCOS_C2 ) );
+	c = _mm_mul_ps( _mm_mul_ps( c, z ), z );
+	c = _mm_add_ps( _mm_sub_ps( c, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) ), _mm_set1_ps( 1.0f ) );
+
+	__m128 s = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( MATHLITE_SINCOS_S0 ), z ), _mm_set1_ps( MATHLITE_SINCOS_S1 ) );
+	s = _mm_add_ps( _mm_mul_ps( s, z ), _mm_set1_ps( MATHLITE_SINCOS_S2 ) );
+	s = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( s, z ), x ), x );
+
+	// In octants 1,2 (mod 4) the polynomials swap
+	__m128 outSin = _mm_or_ps( _mm_and_ps( polyMask, s ), _mm_andnot_ps( polyMask, c ) );
+	__m128 outCos = _mm_or_ps( _mm_and_ps( polyMask, c ), _mm_andnot_ps( polyMask, s ) );
+	*pSin = _mm_xor_ps( outSin, signSin );
+	*pCos = _mm_xor_ps( outCos, signCos );
+}
+
+// Writes 4 Z rotations from their sines and cosines
+MATHLITE_TARGET_SSE static void StoreRotateZ_SSE( VMatrix *pDst, __m128 s, __m128 c )
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 row2 = _mm_set_ps( 0.0f, 1.0f, 0.0f, 0.0f );
+	const __m128 row3 = _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+	__m128 negS = _mm_sub_ps( zero, s );
+
+	// c0 -s0 c1 -s1 | c2 -s2 c3 -s3, and s0 c0 s1 c1 | s2 c2 s3 c3
+	__m128 row0[2] = { _mm_unpacklo_ps( c, negS ), _mm_unpackhi_ps( c, negS ) };
+	__m128 row1[2] = { _mm_unpacklo_ps( s, c ), _mm_unpackhi_ps( s, c ) };
+
+	for ( int i = 0; i < 4; ++i )
+	{
+		__m128 r0 = ( i & 1 ) ? _mm_movehl_ps( zero, row0[i >> 1] ) : _mm_movelh_ps( row0[i >> 1], zero );
+		__m128 r1 = ( i & 1 ) ? _mm_movehl_ps( zero, row1[i >> 1] ) : _mm_movelh_ps( row1[i >> 1], zero );
+		_mm_storeu_ps( pDst[i].m[0], r0 );
+		_mm_storeu_ps( pDst[i].m[1], r1 );
+		_mm_storeu_ps( pDst[i].m[2], row2 );
+		_mm_storeu_ps( pDst[i].m[3], row3 );
+	}
+}
+
+MATHLITE_TARGET_SSE static int MatrixBuildRotateZ_SSE( VMatrix *pDst, const float *pAngleDegrees, int nCount )
+{
+	const __m128 toRadians = _mm_set1_ps( (float)( M_PI / 180.0 ) );
+	int nDone = nCount & ~3;
+	for ( int i = 0; i < nDone; i += 4 )
+	{
+		__m128 s, c;
+		SinCos_SSE( _mm_mul_ps( _mm_loadu_ps( pAngleDegrees + i ), toRadians ), &s, &c );
+		StoreRotateZ_SSE( pDst + i, s, c );
+	}
+	return nDone;
+}
+
+//-----------------------------------------------------------------------------
+// AVX2 + FMA, 8 at a time. The 128 bit lanes each hold 4 elements so the SSE
+// shuffles carry over unchanged.
+//-----------------------------------------------------------------------------
+
+MATHLITE_TARGET_AVX2 static inline __m256 LoadLanes_AVX2( const float *pLo, const float *pHi )
+{
+	return _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( pLo ) ), _mm_loadu_ps( pHi ), 1 );
+}
+
+MATHLITE_TARGET_AVX2 static int Vector3DTransform_AVX2( const VMatrix& src1, const Vector *pSrc, Vector *pDst, int nCount, bool bPosition )
+{
+	__m256 m00 = _mm256_set1_ps( src1[0][0] ), m01 = _mm256_set1_ps( src1[0][1] ), m02 = _mm256_set1_ps( src1[0][2] ), m03 = _mm256_set1_ps( src1[0][3] );
+	__m256 m10 = _mm256_set1_ps( src1[1][0] ), m11 = _mm256_set1_ps( src1[1][1] ), m12 = _mm256_set1_ps( src1[1][2] ), m13 = _mm256_set1_ps( src1[1][3] );
+	__m256 m20 = _mm256_set1_ps( src1[2][0] ), m21 = _mm256_set1_ps( src1[2][1] ), m22 = _mm256_set1_ps( src1[2][2] ), m23 = _mm256_set1_ps( src1[2][3] );
+	if ( !bPosition )
+	{
+		m03 = m13 = m23 = _mm256_setzero_ps();
+	}
+
+	const float *pIn = (const float *)pSrc;
+	float *pOut = (float *)pDst;
+	int nDone = nCount & ~7;
+	for ( int i = 0; i < nDone; i += 8, pIn += 24, pOut += 24 )
+	{
+		// Elements 0-3 in the low lane, 4-7 in the high one
+		__m256 a = LoadLanes_AVX2( pIn, pIn + 12 ), b = LoadLanes_AVX2( pIn + 4, pIn + 16 ), c = LoadLanes_AVX2( pIn + 8, pIn + 20 );
+		__m256 x, y, z;
+		MATHLITE_DEINTERLEAVE3( __m256, _mm256_shuffle_ps, a, b, c, x, y, z );
+
+		__m256 rx = _mm256_fmadd_ps( m02, z, _mm256_fmadd_ps( m01, y, _mm256_fmadd_ps( m00, x, m03 ) ) );
+		__m256 ry = _mm256_fmadd_ps( m12, z, _mm256_fmadd_ps( m11, y, _mm256_fmadd_ps( m10, x, m13 ) ) );
+		__m256 rz = _mm256_fmadd_ps( m22, z, _mm256_fmadd_ps( m21, y, _mm256_fmadd_ps( m20, x, m23 ) ) );
+
+		MATHLITE_INTERLEAVE3( __m256, _mm256_shuffle_ps, rx, ry, rz, a, b, c );
+		_mm256_storeu_ps( pOut, _mm256_permute2f128_ps( a, b, 0x20 ) );
+		_mm256_storeu_ps( pOut + 8, _mm256_permute2f128_ps( c, a, 0x30 ) );
+		_mm256_storeu_ps( pOut + 16, _mm256_permute2f128_ps( b, c, 0x31 ) );
+	}
+	return nDone;
+}
+
+MATHLITE_TARGET_AVX2 static int Vector4DTransformPosition_AVX2( const VMatrix& src1, const Vector *pSrc, Vector4D *pDst, int nCount )
+{
+	__m256 m00 = _mm256_set1_ps( src1[0][0] ), m01 = _mm256_set1_ps( src1[0][1] ), m02 = _mm256_set1_ps( src1[0][2] ), m03 = _mm256_set1_ps( src1[0][3] );
+	__m256 m10 = _mm256_set1_ps( src1[1][0] ), m11 = _mm256_set1_ps( src1[1][1] ), m12 = _mm256_set1_ps( src1[1][2] ), m13 = _mm256_set1_ps( src1[1][3] );
+	__m256 m20 = _mm256_set1_ps( src1[2][0] ), m21 = _mm256_set1_ps( src1[2][1] ), m22 = _mm256_set1_ps( src1[2][2] ), m23 = _mm256_set1_ps( src1[2][3] );
+	__m256 m30 = _mm256_set1_ps( src1[3][0] ), m31 = _mm256_set1_ps( src1[3][1] ), m32 = _mm256_set1_ps( src1[3][2] ), m33 = _mm256_set1_ps( src1[3][3] );
+
+	const float *pIn = (const float *)pSrc;
+	float *pOut = (float *)pDst;
+	int nDone = nCount & ~7;
+	for ( int i = 0; i < nDone; i += 8, pIn += 24, pOut += 32 )
+	{
+		__m256 a = LoadLanes_AVX2( pIn, pIn + 12 ), b = LoadLanes_AVX2( pIn + 4, pIn + 16 ), c = LoadLanes_AVX2( pIn + 8, pIn + 20 );
+		__m256 x, y, z;
+		MATHLITE_DEINTERLEAVE3( __m256, _mm256_shuffle_ps, a, b, c, x, y, z );
+
+		__m256 rx = _mm256_fmadd_ps( m02, z, _mm256_fmadd_ps( m01, y, _mm256_fmadd_ps( m00, x, m03 ) ) );
+		__m256 ry = _mm256_fmadd_ps( m12, z, _mm256_fmadd_ps( m11, y, _mm256_fmadd_ps( m10, x, m13 ) ) );
+		__m256 rz = _mm256_fmadd_ps( m22, z, _mm256_fmadd_ps( m21, y, _mm256_fmadd_ps( m20, x, m23 ) ) );
+		__m256 rw = _mm256_fmadd_ps( m32, z, _mm256_fmadd_ps( m31, y, _mm256_fmadd_ps( m30, x, m33 ) ) );
+
+		// 4x4 transpose within each lane, then lanes out in element order
+		__m256 t0 = _mm256_unpacklo_ps( rx, ry ), t1 = _mm256_unpackhi_ps( rx, ry );
+		__m256 t2 = _mm256_unpacklo_ps( rz, rw ), t3 = _mm256_unpackhi_ps( rz, rw );
+		__m256 v0 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 1, 0, 1, 0 ) ), v1 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m256 v2 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) ), v3 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		_mm256_storeu_ps( pOut, _mm256_permute2f128_ps( v0, v1, 0x20 ) );
+		_mm256_storeu_ps( pOut + 8, _mm256_permute2f128_ps( v2, v3, 0x20 ) );
+		_mm256_storeu_ps( pOut + 16, _mm256_permute2f128_ps( v0, v1, 0x31 ) );
+		_mm256_storeu_ps( pOut + 24, _mm256_permute2f128_ps( v2, v3, 0x31 ) );
+	}
+	return nDone;
+}
+
+MATHLITE_TARGET_AVX2 static void MatrixMultiply_AVX2( const VMatrix& src1, const VMatrix& src2, VMatrix& dst )
+{
+	// Two rows of src1 per register, each row of src2 broadcast to both lanes
+	__m256 b0 = _mm256_broadcast_ps( (const __m128 *)src2.m[0] ), b1 = _mm256_broadcast_ps( (const __m128 *)src2.m[1] );
+	__m256 b2 = _mm256_broadcast_ps( (const __m128 *)src2.m[2] ), b3 = _mm256_broadcast_ps( (const __m128 *)src2.m[3] );
+	__m256 a01 = _mm256_loadu_ps( src1.m[0] ), a23 = _mm256_loadu_ps( src1.m[2] );
+
+	__m256 r01 = _mm256_mul_ps( _mm256_permute_ps( a01, 0x00 ), b0 );
+	r01 = _mm256_fmadd_ps( _mm256_permute_ps( a01, 0x55 ), b1, r01 );
+	r01 = _mm256_fmadd_ps( _mm256_permute_ps( a01, 0xAA ), b2, r01 );
+	r01 = _mm256_fmadd_ps( _mm256_permute_ps( a01, 0xFF ), b3, r01 );
+
+	__m256 r23 = _mm256_mul_ps( _mm256_permute_ps( a23, 0x00 ), b0 );
+	r23 = _mm256_fmadd_ps( _mm256_permute_ps( a23, 0x55 ), b1, r23 );
+	r23 = _mm256_fmadd_ps( _mm256_permute_ps( a23, 0xAA ), b2, r23 );
+	r23 = _mm256_fmadd_ps( _mm256_permute_ps( a23, 0xFF ), b3, r23 );
+
+	_mm256_storeu_ps( dst.m[0], r01 );
+	_mm256_storeu_ps( dst.m[2], r23 );
+}
+
+MATHLITE_TARGET_AVX2 static void SinCos_AVX2( __m256 x, __m256 *pSin, __m256 *pCos )
+{
+	const __m256 signMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x80000000 ) );
+
+	__m256 signSin = _mm256_and_ps( x, signMask );
+	x = _mm256_andnot_ps( signMask, x );
+
+	__m256i j = _mm256_cvttps_epi32( _mm256_mul_ps( x, _mm256_set1_ps( MATHLITE_SINCOS_FOPI ) ) );
+	j = _mm256_and_si256( _mm256_add_epi32( j, _mm256_set1_epi32( 1 ) ), _mm256_set1_epi32( ~1 ) );
+	__m256 y = _mm256_cvtepi32_ps( j );
+
+	signSin = _mm256_xor_ps( signSin, _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( j, _mm256_set1_epi32( 4 ) ), 29 ) ) );
+	__m256 signCos = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_andnot_si256( _mm256_sub_epi32( j, _mm256_set1_epi32( 2 ) ), _mm256_set1_epi32( 4 ) ), 29 ) );
+	__m256 polyMask = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( j, _mm256_set1_epi32( 2 ) ), _mm256_setzero_si256() ) );
+
+	x = _mm256_fnmadd_ps( y, _mm256_set1_ps( MATHLITE_SINCOS_DP1 ), x );
+	x = _mm256_fnmadd_ps( y, _mm256_set1_ps( MATHLITE_SINCOS_DP2 ), x );
+	x = _mm256_fnmadd_ps( y, _mm256_set1_ps( MATHLITE_SINCOS_DP3 ), x );
+	__m256 z = _mm256_mul_ps( x, x );
+
+	__m256 c = _mm256_fmadd_ps( _mm256_set1_ps( MATHLITE_SINCOS_C0 ), z, _mm256_set1_ps( MATHLITE_SINCOS_C1 ) );
+	c = _mm256_fmadd_ps( c, z, _mm256_set1_ps( MATHLITE_SINCOS_C2 ) );
+	c = _mm256_mul_ps( _mm256_mul_ps( c, z ), z );
+	c = _mm256_add_ps( _mm256_fnmadd_ps( z, _mm256_set1_ps( 0.5f ), c ), _mm256_set1_ps( 1.0f ) );
+
+	__m256 s = _mm256_fmadd_ps( _mm256_set1_ps( MATHLITE_SINCOS_S0 ), z, _mm256_set1_ps( MATHLITE_SINCOS_S1 ) );
+	s = _mm256_fmadd_ps( s, z, _mm256_set1_ps( MATHLITE_SINCOS_S2 ) );
+	s = _mm256_fmadd_ps( _mm256_mul_ps( s, z ), x, x );
+
+	*pSin = _mm256_xor_ps( _mm256_blendv_ps( c, s, polyMask ), signSin );
+	*pCos = _mm256_xor_ps( _mm256_blendv_ps( s, c, polyMask ), signCos );
+}
+
+// Writes 8 Z rotations. Each matrix row is 4 floats so this is the SSE version
+// twice over, it just has to stay VEX encoded to avoid SSE/AVX transitions.
+MATHLITE_TARGET_AVX2 static void StoreRotateZ_AVX2( VMatrix *pDst, __m256 s, __m256 c )
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 row2 = _mm_set_ps( 0.0f, 1.0f, 0.0f, 0.0f );
+	const __m128 row3 = _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+	__m256 negS = _mm256_sub_ps( _mm256_setzero_ps(), s );
+
+	// Per lane: c0 -s0 c1 -s1 | c2 -s2 c3 -s3, and s0 c0 s1 c1 | s2 c2 s3 c3
+	__m256 row0[2] = { _mm256_unpacklo_ps( c, negS ), _mm256_unpackhi_ps( c, negS ) };
+	__m256 row1[2] = { _mm256_unpacklo_ps( s, c ), _mm256_unpackhi_ps( s, c ) };
+
+	for ( int i = 0; i < 8; ++i )
+	{
+		int nLane = i >> 2, nHalf = ( i >> 1 ) & 1;
+		__m128 r0 = nLane ? _mm256_extractf128_ps( row0[nHalf], 1 ) : _mm256_castps256_ps128( row0[nHalf] );
+		__m128 r1 = nLane ? _mm256_extractf128_ps( row1[nHalf], 1 ) : _mm256_castps256_ps128( row1[nHalf] );
+		r0 = ( i & 1 ) ? _mm_movehl_ps( zero, r0 ) : _mm_movelh_ps( r0, zero );
+		r1 = ( i & 1 ) ? _mm_movehl_ps( zero, r1 ) : _mm_movelh_ps( r1, zero );
+		_mm_storeu_ps( pDst[i].m[0], r0 );
+		_mm_storeu_ps( pDst[i].m[1], r1 );
+		_mm_storeu_ps( pDst[i].m[2], row2 );
+		_mm_storeu_ps( pDst[i].m[3], row3 );
+	}
+}
+
+MATHLITE_TARGET_AVX2 static int MatrixBuildRotateZ_AVX2( VMatrix *pDst, const float *pAngleDegrees, int nCount )
+{
+	const __m256 toRadians = _mm256_set1_ps( (float)( M_PI / 180.0 ) );
+	int nDone = nCount & ~7;
+	for ( int i = 0; i < nDone; i += 8 )
+	{
+		__m256 s, c;
+		SinCos_AVX2( _mm256_mul_ps( _mm256_loadu_ps( pAngleDegrees + i ), toRadians ), &s, &c );
+
+		StoreRotateZ_AVX2( pDst + i, s, c );
+	}
+	return nDone;
+}
+
+#else
+
+static MathLiteSIMDLevel_t DetectSIMDLevel()
+{
+	return MATHLITE_SIMD_NONE;
+}
+
+#endif // MATHLITE_BATCH_X86
+
+static int s_nSIMDLevel = -1;
+
+MathLiteSIMDLevel_t MathLiteGetSIMDLevel()
+{
+	if ( s_nSIMDLevel < 0 )
+	{
+		s_nSIMDLevel = DetectSIMDLevel();
+	}
+	return (MathLiteSIMDLevel_t)s_nSIMDLevel;
+}
+
+void MathLiteSetSIMDLevel( MathLiteSIMDLevel_t level )
+{
+	MathLiteSIMDLevel_t supported = DetectSIMDLevel();
+	s_nSIMDLevel = ( level < supported ) ? level : supported;
+}
+
+//-----------------------------------------------------------------------------
+// Batch entry points. The wide kernels do what they can and return how many,
+// narrower ones and then the scalar code pick up the rest.
+//-----------------------------------------------------------------------------
+void Vector3DMultiplyBatch( const VMatrix& src1, const Vector *pSrc, Vector *pDst, int nCount )
+{
+	int i = 0;
+#if MATHLITE_BATCH_X86
+	MathLiteSIMDLevel_t level = MathLiteGetSIMDLevel();
+	if ( level >= MATHLITE_SIMD_AVX2 )
+	{
+		i += Vector3DTransform_AVX2( src1, pSrc, pDst, nCount, false );
+	}
+	if ( level >= MATHLITE_SIMD_SSE )
+	{
+		i += Vector3DTransform_SSE( src1, pSrc + i, pDst + i, nCount - i, false );
+	}
+#endif
+	for ( ; i < nCount; ++i )
+	{
+		Vector3DMultiply( src1, pSrc[i], pDst[i] );
+	}
+}
+
+void Vector3DMultiplyPositionBatch( const VMatrix& src1, const Vector *pSrc, Vector *pDst, int nCount )
+{
+	int i = 0;
+#if MATHLITE_BATCH_X86
+	MathLiteSIMDLevel_t level = MathLiteGetSIMDLevel();
+	if ( level >= MATHLITE_SIMD_AVX2 )
+	{
+		i += Vector3DTransform_AVX2( src1, pSrc, pDst, nCount, true );
+	}
+	if ( level >= MATHLITE_SIMD_SSE )
+	{
+		i += Vector3DTransform_SSE( src1, pSrc + i, pDst + i, nCount - i, true );
+	}
+#endif
+	for ( ; i < nCount; ++i )
+	{
+		Vector3DMultiplyPosition( src1, pSrc[i], pDst[i] );
+	}
+}
+
+void Vector4DMultiplyPositionBatch( const VMatrix& src1, const Vector *pSrc, Vector4D *pDst, int nCount )
+{
+	int i = 0;
+#if MATHLITE_BATCH_X86
+	MathLiteSIMDLevel_t level = MathLiteGetSIMDLevel();
+	if ( level >= MATHLITE_SIMD_AVX2 )
+	{
+		i += Vector4DTransformPosition_AVX2( src1, pSrc, pDst, nCount );
+	}
+	if ( level >= MATHLITE_SIMD_SSE )
+	{
+		i += Vector4DTransformPosition_SSE( src1, pSrc + i, pDst + i, nCount - i );
+	}
+#endif
+	for ( ; i < nCount; ++i )
+	{
+		Vector4DMultiplyPosition( src1, pSrc[i], pDst[i] );
+	}
+}
+
+void MatrixMultiplyBatch( const VMatrix *pSrc1, const VMatrix *pSrc2, VMatrix *pDst, int nCount )
+{
+#if MATHLITE_BATCH_X86
+	MathLiteSIMDLevel_t level = MathLiteGetSIMDLevel();
+	if ( level >= MATHLITE_SIMD_AVX2 )
+	{
+		for ( int i = 0; i < nCount; ++i )
+		{
+			MatrixMultiply_AVX2( pSrc1[i], pSrc2[i], pDst[i] );
+		}
+		return;
+	}
+	if ( level >= MATHLITE_SIMD_SSE )
+	{
+		for ( int i = 0; i < nCount; ++i )
+		{
+			MatrixMultiply_SSE( pSrc1[i], pSrc2[i], pDst[i] );
+		}
+		return;
+	}
+#endif
+	for ( int i = 0; i < nCount; ++i )
+	{
+		MatrixMultiply( pSrc1[i], pSrc2[i], pDst[i] );
+	}
+}
+
+void MatrixBuildRotateZBatch( VMatrix *pDst, const float *pAngleDegrees, int nCount )
+{
+	int i = 0;
+#if MATHLITE_BATCH_X86
+	MathLiteSIMDLevel_t level = MathLiteGetSIMDLevel();
+	if ( level >= MATHLITE_SIMD_AVX2 )
+	{
+		i += MatrixBuildRotateZ_AVX2( pDst, pAngleDegrees, nCount );
+	}
+	if ( level >= MATHLITE_SIMD_SSE )
+	{
+		i += MatrixBuildRotateZ_SSE( pDst + i, pAngleDegrees + i, nCount - i );
+	}
+#endif
+	for ( ; i < nCount; ++i )
+	{
+		MatrixBuildRotateZ( pDst[i], pAngleDegrees[i] );
+	}
+}
@@ -3913,6 +3913,37 @@ bool MatrixInverseGeneral(const VMatrix& src, VMatrix& dst);
 void MatrixInverseTranspose( const VMatrix& src, VMatrix& dst );
 
 
+//-----------------------------------------------------------------------------
+// Batch transforms. Same math as the single element versions above, run over
+// arrays with SSE or AVX2+FMA picked at runtime from what the CPU supports.
+// dst may be the same array as src (in place), any other overlap is undefined.
+//-----------------------------------------------------------------------------
+enum MathLiteSIMDLevel_t
+{
+	MATHLITE_SIMD_NONE = 0,
+	MATHLITE_SIMD_SSE,
+	MATHLITE_SIMD_AVX2
+};
+
+MathLiteSIMDLevel_t MathLiteGetSIMDLevel();
+
+// Force a lower level (for testing / benchmarking), clamped to what the CPU supports
+void MathLiteSetSIMDLevel( MathLiteSIMDLevel_t level );
+
+// Directions, no translation
+void Vector3DMultiplyBatch( const VMatrix& src1, const Vector *pSrc, Vector *pDst, int nCount );
+
+// Points, adds the translation
+void Vector3DMultiplyPositionBatch( const VMatrix& src1, const Vector *pSrc, Vector *pDst, int nCount );
+void Vector4DMultiplyPositionBatch( const VMatrix& src1, const Vector *pSrc, Vector4D *pDst, int nCount );
+
+// pDst[i] = pSrc1[i] * pSrc2[i]
+void MatrixMultiplyBatch( const VMatrix *pSrc1, const VMatrix *pSrc2, VMatrix *pDst, int nCount );
+
+// pDst[i] = MatrixBuildRotateZ( pAngleDegrees[i] )
+void MatrixBuildRotateZBatch( VMatrix *pDst, const float *pAngleDegrees, int nCount );
+
+
 
 //-----------------------------------------------------------------------------
 // VMatrix inlines.
@@ -0,0 +1,286 @@
+//============ Copyright (c) Valve Corporation, All rights reserved. ============
+//
+// mathlitebench.cpp
+//	microbenchmark / regression check for the mathlite batch transforms.
+//
+//	Runs each batch kernel at every SIMD level the CPU supports, reports
+//	ns per element and the speedup over the scalar path, and checks every
+//	level's output against the scalar one (and the in place case against the
+//	out of place one).
+//
+//	usage: mathlitebench [options]
+//		-count <n>		elements per batch (default 10003, odd so the tails get run)
+//		-iters <n>		batches per kernel per level for timing (default 1000)
+//
+//	exit code is non zero if any level disagrees with the scalar code.
+//
+//===============================================================================
+
+#include "../mathlite.h"
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include <vector>
+
+static const char *g_szLevelNames[] = { "scalar", "sse", "avx2" };
+
+static double BenchTime( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+// repeatable inputs
+static unsigned int g_nRandomState = 12345;
+
+static float RandomFloat( float flMin, float flMax )
+{
+	g_nRandomState = g_nRandomState * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * (float)( g_nRandomState >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+static void RandomMatrix( VMatrix &dst )
+{
+	for ( int i = 0; i < 4; i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			dst[i][j] = RandomFloat( -2.0f, 2.0f );
+		}
+	}
+}
+
+// relative to the largest expected value, FMA and reassociation move the last bits around
+// and an element that nearly cancels to zero can't be held to its own magnitude
+static bool CloseEnough( const float *pExpected, const float *pActual, int nFloats, float *pMaxError )
+{
+	float flScale = 1.0f;
+	for ( int i = 0; i < nFloats; i++ )
+	{
+		if ( fabsf( pExpected[i] ) > flScale )
+		{
+			flScale = fabsf( pExpected[i] );
+		}
+	}
+
+	bool bOK = true;
+	for ( int i = 0; i < nFloats; i++ )
+	{
+		float flError = fabsf( pExpected[i] - pActual[i] ) / flScale;
+		if ( flError > *pMaxError )
+		{
+			*pMaxError = flError;
+		}
+		if ( !( flError <= 1e-5f ) )
+		{
+			bOK = false;
+		}
+	}
+	return bOK;
+}
+
+//===============================================================================
+
+enum EKernel
+{
+	eKernelVector3D,
+	eKernelVector3DPosition,
+	eKernelVector4DPosition,
+	eKernelMatrixMultiply,
+	eKernelRotateZ,
+
+	eKernelCount
+};
+
+static const char *g_szKernelNames[] = { "Vector3DMultiplyBatch", "Vector3DMultiplyPositionBatch", "Vector4DMultiplyPositionBatch", "MatrixMultiplyBatch", "MatrixBuildRotateZBatch" };
+
+struct BenchData_t
+{
+	int m_nCount;
+	VMatrix m_matTransform;
+	std::vector< Vector > m_vecPositions;
+	std::vector< VMatrix > m_vecMatricesA;
+	std::vector< VMatrix > m_vecMatricesB;
+	std::vector< float > m_vecAngles;
+};
+
+// run one kernel, returns the output as a flat float array
+static void RunKernel( const BenchData_t &data, EKernel eKernel, std::vector< float > *pOutput )
+{
+	int n = data.m_nCount;
+	switch ( eKernel )
+	{
+	case eKernelVector3D:
+	case eKernelVector3DPosition:
+		pOutput->resize( n * 3 );
+		if ( eKernel == eKernelVector3D )
+			Vector3DMultiplyBatch( data.m_matTransform, &data.m_vecPositions[0], (Vector *)&(*pOutput)[0], n );
+		else
+			Vector3DMultiplyPositionBatch( data.m_matTransform, &data.m_vecPositions[0], (Vector *)&(*pOutput)[0], n );
+		break;
+
+	case eKernelVector4DPosition:
+		pOutput->resize( n * 4 );
+		Vector4DMultiplyPositionBatch( data.m_matTransform, &data.m_vecPositions[0], (Vector4D *)&(*pOutput)[0], n );
+		break;
+
+	case eKernelMatrixMultiply:
+		pOutput->resize( n * 16 );
+		MatrixMultiplyBatch( &data.m_vecMatricesA[0], &data.m_vecMatricesB[0], (VMatrix *)&(*pOutput)[0], n );
+		break;
+
+	case eKernelRotateZ:
+		pOutput->resize( n * 16 );
+		MatrixBuildRotateZBatch( (VMatrix *)&(*pOutput)[0], &data.m_vecAngles[0], n );
+		break;
+
+	default:
+		break;
+	}
+}
+
+// the in place forms must match the out of place ones
+static bool CheckInPlace( const BenchData_t &data, EKernel eKernel, const std::vector< float > &expected )
+{
+	int n = data.m_nCount;
+	float flMaxError = 0.0f;
+	switch ( eKernel )
+	{
+	case eKernelVector3D:
+	case eKernelVector3DPosition:
+		{
+			std::vector< Vector > vecInPlace( data.m_vecPositions );
+			if ( eKernel == eKernelVector3D )
+				Vector3DMultiplyBatch( data.m_matTransform, &vecInPlace[0], &vecInPlace[0], n );
+			else
+				Vector3DMultiplyPositionBatch( data.m_matTransform, &vecInPlace[0], &vecInPlace[0], n );
+			return CloseEnough( &expected[0], (const float *)&vecInPlace[0], n * 3, &flMaxError ) && flMaxError == 0.0f;
+		}
+
+	case eKernelMatrixMultiply:
+		{
+			std::vector< VMatrix > vecInPlaceA( data.m_vecMatricesA );
+			std::vector< VMatrix > vecInPlaceB( data.m_vecMatricesB );
+			MatrixMultiplyBatch( &vecInPlaceA[0], &data.m_vecMatricesB[0], &vecInPlaceA[0], n );
+			MatrixMultiplyBatch( &data.m_vecMatricesA[0], &vecInPlaceB[0], &vecInPlaceB[0], n );
+			return CloseEnough( &expected[0], (const float *)&vecInPlaceA[0], n * 16, &flMaxError ) &&
+				CloseEnough( &expected[0], (const float *)&vecInPlaceB[0], n * 16, &flMaxError ) && flMaxError == 0.0f;
+		}
+
+	default:
+		return true;
+	}
+}
+
+static void Usage( void )
+{
+	fprintf( stderr, "usage: mathlitebench [-count n] [-iters n]\n" );
+}
+
+int main( int argc, char **argv )
+{
+	int nCount = 10003;
+	int iterations = 1000;
+	int failures = 0;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[i], "-count" ) && i + 1 < argc )
+		{
+			nCount = atoi( argv[++i] );
+		}
+		else if ( !strcmp( argv[i], "-iters" ) && i + 1 < argc )
+		{
+			iterations = atoi( argv[++i] );
+		}
+		else
+		{
+			Usage();
+			return 1;
+		}
+	}
+
+	if ( nCount < 1 || iterations < 1 )
+	{
+		Usage();
+		return 1;
+	}
+
+	BenchData_t data;
+	data.m_nCount = nCount;
+	RandomMatrix( data.m_matTransform );
+	data.m_vecPositions.resize( nCount );
+	data.m_vecMatricesA.resize( nCount );
+	data.m_vecMatricesB.resize( nCount );
+	data.m_vecAngles.resize( nCount );
+	for ( int i = 0; i < nCount; i++ )
+	{
+		data.m_vecPositions[i].Init( RandomFloat( -1000.0f, 1000.0f ), RandomFloat( -1000.0f, 1000.0f ), RandomFloat( -1000.0f, 1000.0f ) );
+		RandomMatrix( data.m_vecMatricesA[i] );
+		RandomMatrix( data.m_vecMatricesB[i] );
+		data.m_vecAngles[i] = RandomFloat( -3600.0f, 3600.0f );
+	}
+
+	MathLiteSIMDLevel_t maxLevel = MathLiteGetSIMDLevel();
+	printf( "%d elements, %d iterations, best level %s\n", nCount, iterations, g_szLevelNames[maxLevel] );
+
+	for ( int kernel = 0; kernel < eKernelCount; kernel++ )
+	{
+		std::vector< float > scalarOutput;
+		double flScalarSeconds = 0.0;
+
+		for ( int level = MATHLITE_SIMD_NONE; level <= maxLevel; level++ )
+		{
+			MathLiteSetSIMDLevel( (MathLiteSIMDLevel_t)level );
+
+			std::vector< float > output;
+			RunKernel( data, (EKernel)kernel, &output );
+
+			double start = BenchTime();
+			for ( int i = 0; i < iterations; i++ )
+			{
+				RunKernel( data, (EKernel)kernel, &output );
+			}
+			double flSeconds = BenchTime() - start;
+
+			float flMaxError = 0.0f;
+			bool bOK = true;
+			if ( level == MATHLITE_SIMD_NONE )
+			{
+				scalarOutput = output;
+				flScalarSeconds = flSeconds;
+			}
+			else
+			{
+				bOK = CloseEnough( &scalarOutput[0], &output[0], (int)output.size(), &flMaxError );
+			}
+
+			if ( !CheckInPlace( data, (EKernel)kernel, output ) )
+			{
+				fprintf( stderr, "%s (%s): in place result differs\n", g_szKernelNames[kernel], g_szLevelNames[level] );
+				bOK = false;
+			}
+
+			printf( "%-30s %-6s %9.2f ns/element  %6.2fx  max err %g%s\n",
+				g_szKernelNames[kernel], g_szLevelNames[level],
+				flSeconds * 1e9 / ( (double)nCount * iterations ), flScalarSeconds / flSeconds, flMaxError, bOK ? "" : "  MISMATCH" );
+
+			if ( !bOK )
+			{
+				failures++;
+			}
+		}
+	}
+
+	MathLiteSetSIMDLevel( maxLevel );
+
+	if ( failures )
+	{
+		printf( "%d failure(s)\n", failures );
+		return 1;
+	}
+
+	return 0;
+}
@@ -9,7 +9,7 @@
 #include "BaseMenu.h"
 #include <math.h>
 #include <vector>
-#include <algorithm>
+#include <set>
 
 
 //-----------------------------------------------------------------------------
@@ -26,24 +26,26 @@ public:
 	//-----------------------------------------------------------------------------
 	CFriendsListMenu( IGameEngine *pGameEngine ) : CBaseMenu<FriendsListMenuItem_t>( pGameEngine )
 	{
-		
+		m_iNextPendingItem = 0;
+		m_iNextUpdateItem = 0;
 	}
 
 	//-----------------------------------------------------------------------------
-	// Purpose: Creates friends list menu
+	// Purpose: Creates friends list menu.  Working out who goes in which section is
+	// cheap so that's done here, the persona lookups for each friend are time sliced.
 	//-----------------------------------------------------------------------------
 	void Rebuild()
 	{
-		PushSelectedItem();
-		ClearMenuItems();
+		m_VecPendingItems.clear();
+		m_iNextPendingItem = 0;
 
-		AddMenuItem( CFriendsListMenu::MenuItem_t( "Friends List", k_menuItemEmpty ) );
+		m_VecPendingItems.push_back( CFriendsListMenu::MenuItem_t( "Friends List", k_menuItemEmpty ) );
 
 		// First add pending incoming requests
 		AddFriendsByFlag( k_EFriendFlagFriendshipRequested, "Incoming Friend Requests" );
 
 		// Add each Tag group and record the users with tags
-		std::vector<CSteamID> vecTaggedSteamIDs;
+		std::set<CSteamID> setTaggedSteamIDs;
 		int nFriendsGroups = SteamFriends()->GetFriendsGroupCount();
 		for ( int iFG = 0; iFG < nFriendsGroups; iFG++ )
 		{
@@ -58,8 +60,8 @@ public:
 			const char *pszFriendsGroupName = SteamFriends()->GetFriendsGroupName( friendsGroupID );
 			if ( pszFriendsGroupName == NULL )
 				pszFriendsGroupName = "";
-			AddMenuItem( CFriendsListMenu::MenuItem_t( "", k_menuItemEmpty ) );
-			AddMenuItem( CFriendsListMenu::MenuItem_t( pszFriendsGroupName, k_menuItemEmpty ) );
+			m_VecPendingItems.push_back( CFriendsListMenu::MenuItem_t( "", k_menuItemEmpty ) );
+			m_VecPendingItems.push_back( CFriendsListMenu::MenuItem_t( pszFriendsGroupName, k_menuItemEmpty ) );
 
 			std::vector<CSteamID> vecSteamIDMembers( nFriendsGroupMemberCount );
 			SteamFriends()->GetFriendsGroupMembersList( friendsGroupID, &vecSteamIDMembers[0], nFriendsGroupMemberCount );
@@ -67,29 +69,97 @@ public:
 			{
 				const CSteamID &steamIDMember = vecSteamIDMembers[iMember];
 				AddFriendToMenu( steamIDMember );
-				vecTaggedSteamIDs.push_back( steamIDMember );
+				setTaggedSteamIDs.insert( steamIDMember );
 			}
 		}
 
 		// Add the "normal" Friends category, filtering out the ones with tags
-		AddFriendsByFlag( k_EFriendFlagImmediate, "Friends", &vecTaggedSteamIDs );
+		AddFriendsByFlag( k_EFriendFlagImmediate, "Friends", &setTaggedSteamIDs );
 
 		// Finally add the pending outgoing requests
 		AddFriendsByFlag( k_EFriendFlagRequestingFriendship, "Outgoing Friend Requests" );
 
-		PopSelectedItem();
+		BeginIncrementalRebuild();
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Queues a friend whose name or nickname changed, their entries are
+	// refreshed from BUpdateStep().  Steam sends one of these for every friend at
+	// login, so this mustn't do any lookups or search the list.
+	//-----------------------------------------------------------------------------
+	void UpdateFriend( CSteamID steamIDFriend )
+	{
+		m_setChangedFriends.insert( steamIDFriend );
+	}
+
+protected:
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Adds the next pending item, looking up the friend's name if it is one
+	//-----------------------------------------------------------------------------
+	virtual bool BRebuildStep()
+	{
+		if ( m_iNextPendingItem < m_VecPendingItems.size() )
+		{
+			const MenuItem_t &item = m_VecPendingItems[m_iNextPendingItem++];
+			if ( item.second.m_steamIDFriend.IsValid() )
+				AddRebuildMenuItem( CFriendsListMenu::MenuItem_t( GetFriendMenuText( item.second.m_steamIDFriend ), item.second ) );
+			else
+				AddRebuildMenuItem( item );
+		}
+
+		if ( m_iNextPendingItem < m_VecPendingItems.size() )
+			return false;
+
+		m_VecPendingItems.clear();
+		m_iNextPendingItem = 0;
+
+		// The new items replace the ones an update pass was part way through, start it over
+		m_setChangedFriends.insert( m_setUpdatingFriends.begin(), m_setUpdatingFriends.end() );
+		m_setUpdatingFriends.clear();
+		m_iNextUpdateItem = 0;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Purpose: Refreshes the text of changed friends, one pass over the list picks up
+	// everyone that changed before the pass started
+	//-----------------------------------------------------------------------------
+	virtual bool BUpdateStep()
+	{
+		if ( m_iNextUpdateItem == 0 )
+		{
+			if ( m_setChangedFriends.empty() )
+				return true;
+			m_setUpdatingFriends.swap( m_setChangedFriends );
+		}
+
+		if ( m_iNextUpdateItem < GetMenuItemCount() )
+		{
+			CSteamID steamIDFriend = GetMenuItem( m_iNextUpdateItem ).second.m_steamIDFriend;
+			if ( steamIDFriend.IsValid() && m_setUpdatingFriends.count( steamIDFriend ) )
+				SetMenuItemText( m_iNextUpdateItem, GetFriendMenuText( steamIDFriend ) );
+			m_iNextUpdateItem++;
+		}
+
+		if ( m_iNextUpdateItem < GetMenuItemCount() )
+			return false;
+
+		m_setUpdatingFriends.clear();
+		m_iNextUpdateItem = 0;
+		return m_setChangedFriends.empty();
 	}
 
 private:
 
-	void AddFriendsByFlag( int iFriendFlag, const char *pszName, std::vector<CSteamID> *pVecIgnoredSteamIDs = NULL )
+	void AddFriendsByFlag( int iFriendFlag, const char *pszName, std::set<CSteamID> *pSetIgnoredSteamIDs = NULL )
 	{
 		int iFriendCount = SteamFriends()->GetFriendCount( iFriendFlag );
 		if ( !iFriendCount )
 			return;
 
-		AddMenuItem( CFriendsListMenu::MenuItem_t( "", k_menuItemEmpty ) );
-		AddMenuItem( CFriendsListMenu::MenuItem_t( pszName, k_menuItemEmpty ) );
+		m_VecPendingItems.push_back( CFriendsListMenu::MenuItem_t( "", k_menuItemEmpty ) );
+		m_VecPendingItems.push_back( CFriendsListMenu::MenuItem_t( pszName, k_menuItemEmpty ) );
 
 		for ( int iFriend = 0; iFriend < iFriendCount; iFriend++ )
 		{
@@ -97,33 +167,45 @@ private:
 
 			// This mimicks the Steam client's feature where it only shows
 			// untagged friends in the canonical Friends section by default
-			if ( pVecIgnoredSteamIDs && ( std::find( pVecIgnoredSteamIDs->begin(), pVecIgnoredSteamIDs->end(), steamIDFriend ) != pVecIgnoredSteamIDs->end() ) )
+			if ( pSetIgnoredSteamIDs && pSetIgnoredSteamIDs->count( steamIDFriend ) )
 				continue;
 
 			AddFriendToMenu( steamIDFriend );
 		}
 	}
 
+	// Queues a friend, their text is filled in by BRebuildStep()
 	void AddFriendToMenu( CSteamID steamIDFriend )
 	{
 		if ( !steamIDFriend.IsValid() )
 			return;
 
 		FriendsListMenuItem_t menuItemFriend = { steamIDFriend };
+		m_VecPendingItems.push_back( CFriendsListMenu::MenuItem_t( "", menuItemFriend ) );
+	}
 
+	std::string GetFriendMenuText( CSteamID steamIDFriend )
+	{
 		char szFriendNameBuffer[512] = { '\0' };
 
 		const char *pszFriendName = SteamFriends()->GetFriendPersonaName( steamIDFriend );
-		sprintf_safe( szFriendNameBuffer, "%s", pszFriendName );
-
 		const char *pszFriendNickname = SteamFriends()->GetPlayerNickname( steamIDFriend );
 		if ( pszFriendNickname )
-		{
-			sprintf_safe( szFriendNameBuffer, "%s (%s)", szFriendNameBuffer, pszFriendNickname );
-		}
+			sprintf_safe( szFriendNameBuffer, "%s (%s)", pszFriendName, pszFriendNickname );
+		else
+			sprintf_safe( szFriendNameBuffer, "%s", pszFriendName );
 
-		AddMenuItem( CFriendsListMenu::MenuItem_t( szFriendNameBuffer, menuItemFriend ) );
+		return std::string( szFriendNameBuffer );
 	}
+
+	// Items for the rebuild in progress, friends have their text looked up as they're added
+	std::vector< MenuItem_t > m_VecPendingItems;
+	uint32 m_iNextPendingItem;
+
+	// Friends whose text needs refreshing, and the ones the update pass at m_iNextUpdateItem is refreshing
+	std::set<CSteamID> m_setChangedFriends;
+	std::set<CSteamID> m_setUpdatingFriends;
+	uint32 m_iNextUpdateItem;
 };
 
 const FriendsListMenuItem_t CFriendsListMenu::k_menuItemEmpty = { k_steamIDNil };
@@ -166,3 +248,21 @@ void CFriendsList::Show()
 	m_pFriendsListMenu->Rebuild();
 }
 
+
+//-----------------------------------------------------------------------------
+// Purpose: Keeps the friends list up to date as friends change
+//-----------------------------------------------------------------------------
+void CFriendsList::OnPersonaStateChange( PersonaStateChange_t *pCallback )
+{
+	// Friends coming or going changes which sections people are in, so that takes a rebuild
+	if ( pCallback->m_nChangeFlags & k_EPersonaChangeRelationshipChanged )
+	{
+		m_pFriendsListMenu->Rebuild();
+		return;
+	}
+
+	// Otherwise only a new name or nickname shows up in the list, and just on that friend's entries
+	if ( pCallback->m_nChangeFlags & ( k_EPersonaChangeName | k_EPersonaChangeNickname ) )
+		m_pFriendsListMenu->UpdateFriend( CSteamID( pCallback->m_ulSteamID ) );
+}
+
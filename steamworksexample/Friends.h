@@ -35,6 +35,9 @@ private:
 	IGameEngine *m_pGameEngine;
 
 	CFriendsListMenu *m_pFriendsListMenu;
+
+	// Friends changing names, or being added and removed
+	STEAM_CALLBACK( CFriendsList, OnPersonaStateChange, PersonaStateChange_t );
 };
 
 #endif // FRIENDS_H
\ No newline at end of file
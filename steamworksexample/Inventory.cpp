@@ -70,48 +70,49 @@ void CSpaceWarLocalInventory::OnSteamInventoryFullUpdate( SteamInventoryFullUpda
 
 	if ( bGotResult )
 	{
-		// For everything already in the inventory, check for update (exists in result) or removal (does not exist)
-		std::list<CSpaceWarItem *>::iterator iter;
-		for ( iter = m_listPlayerItems.begin(); iter != m_listPlayerItems.end(); /*incr at end of loop*/ )
+		// Update everything in the result that we already have and mark it as still present,
+		// anything we don't have yet is new
+		std::vector<bool> vecStillPresent( m_vecPlayerItems.size(), false );
+		std::vector<SteamItemDetails_t> vecNewItems;
+		for ( size_t i = 0; i < vecDetails.size(); i++ )
 		{
-			bool bFound = false;
-			for ( size_t i = 0; i < vecDetails.size(); i++ )
+			std::unordered_map<SteamItemInstanceID_t, uint32>::iterator iter = m_mapItemIndex.find( vecDetails[i].m_itemId );
+			if ( iter != m_mapItemIndex.end() )
 			{
-				if ( (*iter)->GetItemId() == vecDetails[i].m_itemId )
-				{
-					// Update item with matching item id
-					(*iter)->m_Details = vecDetails[i];
-
-					// Remove elements from the result vector as we process updates (fast swap-and-pop removal)
-					if ( i < vecDetails.size() - 1 )
-						vecDetails[i] = vecDetails.back();
-					vecDetails.pop_back();
-					
-					bFound = true;
-					break;
-				}
-			}
-
-			if ( !bFound )
-			{
-				// No items in the full update match the existing item. Delete current iterator and advance.
-				delete *iter;
-				iter = m_listPlayerItems.erase( iter );
+				vecStillPresent[iter->second] = true;
+				UpdateItem( iter->second, vecDetails[i] );
 			}
 			else
 			{
-				// Increment iterator without deleting.
-				++iter;
+				vecNewItems.push_back( vecDetails[i] );
 			}
 		}
 
-		// Anything remaining in the result vector is a new item, since we removed all the updates.
-		for ( size_t i = 0; i < vecDetails.size(); ++i )
+		// Drop items that weren't in the full update, keeping the rest in order
+		uint32 iWrite = 0;
+		for ( uint32 iRead = 0; iRead < m_vecPlayerItems.size(); iRead++ )
 		{
-			CSpaceWarItem *item = new CSpaceWarItem();
-			item->m_Details = vecDetails[i];
-			m_listPlayerItems.push_back( item );
+			if ( !vecStillPresent[iRead] )
+			{
+				RemoveFromDefinitionCount( m_vecPlayerItems[iRead].m_Details );
+				m_mapItemIndex.erase( m_vecPlayerItems[iRead].GetItemId() );
+				continue;
+			}
+
+			if ( iWrite != iRead )
+			{
+				m_vecPlayerItems[iWrite] = m_vecPlayerItems[iRead];
+				m_mapItemIndex[m_vecPlayerItems[iWrite].GetItemId()] = iWrite;
+			}
+			iWrite++;
 		}
+		m_vecPlayerItems.resize( iWrite );
+
+		// Then append the new ones
+		m_vecPlayerItems.reserve( m_vecPlayerItems.size() + vecNewItems.size() );
+		m_mapItemIndex.reserve( m_vecPlayerItems.size() + vecNewItems.size() );
+		for ( size_t i = 0; i < vecNewItems.size(); ++i )
+			AddOrUpdateItem( vecNewItems[i] );
 	}
 
 	// Remember that we just processed this full update to avoid doing work in ResultReady
@@ -140,56 +141,13 @@ void CSpaceWarLocalInventory::OnSteamInventoryResult( SteamInventoryResultReady_
 
 		if ( bGotResult )
 		{
-			// For everything already in the inventory, check for update or removal
-			std::list<CSpaceWarItem *>::iterator iter;
-			for ( iter = m_listPlayerItems.begin(); iter != m_listPlayerItems.end(); /*incr at end of loop*/ )
-			{
-				bool bDestroy = false;
-				for ( size_t i = 0; i < vecDetails.size(); i++ )
-				{
-					if ( (*iter)->GetItemId() == vecDetails[i].m_itemId )
-					{
-						// If flagged for removal by a partial update, remove it
-						if ( vecDetails[i].m_unFlags & k_ESteamItemRemoved )
-						{
-							bDestroy = true;
-						}
-						else
-						{
-							(*iter)->m_Details = vecDetails[i];
-						}
-
-						// Remove elements from the result vector as we process updates (fast swap-and-pop removal)
-						if ( i < vecDetails.size() - 1 )
-							vecDetails[i] = vecDetails.back();
-						vecDetails.pop_back();
-
-						break;
-					}
-				}
-
-				if ( bDestroy )
-				{
-					// Delete list element at current iterator and advance.
-					delete *iter;
-					iter = m_listPlayerItems.erase( iter );
-				}
-				else
-				{
-					// Increment iterator without deleting.
-					++iter;
-				}
-			}
-
-			// Anything remaining in the result vector is a new item, unless flagged for removal by an operation result.
+			// Apply each change, items flagged for removal by a partial update get removed
 			for ( size_t i = 0; i < vecDetails.size(); ++i )
 			{
-				if ( !( vecDetails[i].m_unFlags & k_ESteamItemRemoved ) )
-				{
-					CSpaceWarItem *item = new CSpaceWarItem();
-					item->m_Details = vecDetails[i];
-					m_listPlayerItems.push_back( item );
-				}
+				if ( vecDetails[i].m_unFlags & k_ESteamItemRemoved )
+					RemoveItem( vecDetails[i].m_itemId );
+				else
+					AddOrUpdateItem( vecDetails[i] );
 			}
 		}
 	}
@@ -264,49 +222,105 @@ void CSpaceWarLocalInventory::GrantTestItems()
 
 const CSpaceWarItem * CSpaceWarLocalInventory::GetItem( SteamItemInstanceID_t nItemId ) const
 {
-	std::list<CSpaceWarItem *>::const_iterator iter;
-	for ( iter = m_listPlayerItems.begin(); iter != m_listPlayerItems.end(); ++iter )
-	{
-		if ( (*iter)->GetItemId() == nItemId )
-			return (*iter);
-	}
-	return NULL;
+	std::unordered_map<SteamItemInstanceID_t, uint32>::const_iterator iter = m_mapItemIndex.find( nItemId );
+	if ( iter == m_mapItemIndex.end() )
+		return NULL;
+	return &m_vecPlayerItems[iter->second];
 }
 
 bool CSpaceWarLocalInventory::HasInstanceOf( SteamItemDef_t nDefinition ) const
 {
-	std::list<CSpaceWarItem *>::const_iterator iter;
-	for ( iter = m_listPlayerItems.begin(); iter != m_listPlayerItems.end(); ++iter )
+	return m_mapDefinitionCounts.find( nDefinition ) != m_mapDefinitionCounts.end();
+}
+
+uint32 CSpaceWarLocalInventory::GetNumOf( SteamItemDef_t nDefinition ) const
+{
+	std::unordered_map<SteamItemDef_t, ItemDefinitionCount_t>::const_iterator iter = m_mapDefinitionCounts.find( nDefinition );
+	if ( iter == m_mapDefinitionCounts.end() )
+		return 0;
+	return iter->second.m_unQuantity;
+}
+
+const CSpaceWarItem *  CSpaceWarLocalInventory::GetInstanceOf( SteamItemDef_t nDefinition ) const
+{
+	// Only used for player actions, so a scan is fine once we know there's something to find
+	if ( !HasInstanceOf( nDefinition ) )
+		return NULL;
+
+	for ( size_t i = 0; i < m_vecPlayerItems.size(); ++i )
 	{
-		if ( ( *iter )->GetDefinition() == nDefinition )
-			return true;
+		if ( m_vecPlayerItems[i].GetDefinition() == nDefinition )
+			return &m_vecPlayerItems[i];
 	}
-	return false;
+	return NULL;
 }
 
-uint32 CSpaceWarLocalInventory::GetNumOf( SteamItemDef_t nDefinition ) const
+//-----------------------------------------------------------------------------
+// Purpose: Update an item we have, or add it if we don't
+//-----------------------------------------------------------------------------
+void CSpaceWarLocalInventory::AddOrUpdateItem( const SteamItemDetails_t &details )
 {
-	uint32 unQuantity = 0;
-	std::list<CSpaceWarItem *>::const_iterator iter;
-	for ( iter = m_listPlayerItems.begin(); iter != m_listPlayerItems.end(); ++iter )
+	std::unordered_map<SteamItemInstanceID_t, uint32>::iterator iter = m_mapItemIndex.find( details.m_itemId );
+	if ( iter != m_mapItemIndex.end() )
 	{
-		if ( ( *iter )->GetDefinition() == nDefinition )
-		{
-			unQuantity += (*iter)->GetQuantity();
-		}
+		UpdateItem( iter->second, details );
+		return;
 	}
-	return unQuantity;
+
+	CSpaceWarItem item;
+	item.m_Details = details;
+	m_mapItemIndex[details.m_itemId] = (uint32)m_vecPlayerItems.size();
+	m_vecPlayerItems.push_back( item );
+	AddToDefinitionCount( details );
 }
 
-const CSpaceWarItem *  CSpaceWarLocalInventory::GetInstanceOf( SteamItemDef_t nDefinition ) const
+//-----------------------------------------------------------------------------
+// Purpose: Overwrite the item at iItem, which has the same instance id
+//-----------------------------------------------------------------------------
+void CSpaceWarLocalInventory::UpdateItem( uint32 iItem, const SteamItemDetails_t &details )
 {
-	std::list<CSpaceWarItem *>::const_iterator iter;
-	for ( iter = m_listPlayerItems.begin(); iter != m_listPlayerItems.end(); ++iter )
+	RemoveFromDefinitionCount( m_vecPlayerItems[iItem].m_Details );
+	m_vecPlayerItems[iItem].m_Details = details;
+	AddToDefinitionCount( details );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove an item, the last item moves into its slot
+//-----------------------------------------------------------------------------
+void CSpaceWarLocalInventory::RemoveItem( SteamItemInstanceID_t nItemId )
+{
+	std::unordered_map<SteamItemInstanceID_t, uint32>::iterator iter = m_mapItemIndex.find( nItemId );
+	if ( iter == m_mapItemIndex.end() )
+		return;
+
+	uint32 iItem = iter->second;
+	m_mapItemIndex.erase( iter );
+	RemoveFromDefinitionCount( m_vecPlayerItems[iItem].m_Details );
+
+	if ( iItem != m_vecPlayerItems.size() - 1 )
 	{
-		if ( ( *iter )->GetDefinition() == nDefinition )
-			return (*iter);
+		m_vecPlayerItems[iItem] = m_vecPlayerItems.back();
+		m_mapItemIndex[m_vecPlayerItems[iItem].GetItemId()] = iItem;
 	}
-	return NULL;
+	m_vecPlayerItems.pop_back();
+}
+
+void CSpaceWarLocalInventory::AddToDefinitionCount( const SteamItemDetails_t &details )
+{
+	ItemDefinitionCount_t &count = m_mapDefinitionCounts[details.m_iDefinition];
+	count.m_unInstances++;
+	count.m_unQuantity += details.m_unQuantity;
+}
+
+void CSpaceWarLocalInventory::RemoveFromDefinitionCount( const SteamItemDetails_t &details )
+{
+	std::unordered_map<SteamItemDef_t, ItemDefinitionCount_t>::iterator iter = m_mapDefinitionCounts.find( details.m_iDefinition );
+	if ( iter == m_mapDefinitionCounts.end() )
+		return;
+
+	iter->second.m_unQuantity -= details.m_unQuantity;
+	if ( --iter->second.m_unInstances == 0 )
+		m_mapDefinitionCounts.erase( iter );
 }
 
 void CSpaceWarLocalInventory::RefreshFromServer()
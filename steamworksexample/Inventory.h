@@ -10,7 +10,8 @@
 
 #include "SpaceWar.h"
 #include "GameEngine.h"
-#include <list>
+#include <vector>
+#include <unordered_map>
 #include <string>
 
 class CSpaceWarItem;
@@ -40,7 +41,8 @@ public:
 	void DoExchange();
 	void ModifyItemProperties();
 
-	const std::list<CSpaceWarItem *>& GetItemList() const { return m_listPlayerItems; }
+	// Items and pointers to them are only good until the next inventory update
+	const std::vector<CSpaceWarItem>& GetItemList() const { return m_vecPlayerItems; }
 	const CSpaceWarItem * GetItem( SteamItemInstanceID_t nItemId ) const;
 	const CSpaceWarItem *  GetInstanceOf( SteamItemDef_t nDefinition ) const;
 	bool HasInstanceOf( SteamItemDef_t nDefinition ) const;
@@ -55,13 +57,30 @@ private:
 	STEAM_CALLBACK( CSpaceWarLocalInventory, OnSteamInventoryResult, SteamInventoryResultReady_t, m_SteamInventoryResult );
 	STEAM_CALLBACK( CSpaceWarLocalInventory, OnSteamInventoryFullUpdate, SteamInventoryFullUpdate_t, m_SteamInventoryFullUpdate );
 
+	// Keep m_vecPlayerItems and both indexes in step
+	void AddOrUpdateItem( const SteamItemDetails_t &details );
+	void UpdateItem( uint32 iItem, const SteamItemDetails_t &details );
+	void RemoveItem( SteamItemInstanceID_t nItemId );
+	void AddToDefinitionCount( const SteamItemDetails_t &details );
+	void RemoveFromDefinitionCount( const SteamItemDetails_t &details );
+
+	// Instances and total quantity held of one item definition
+	struct ItemDefinitionCount_t
+	{
+		uint32 m_unInstances;
+		uint32 m_unQuantity;
+	};
+
 private:
 	SteamInventoryResult_t m_hPlaytimeRequestResult;
 	SteamInventoryResult_t m_hPromoRequestResult;
 	SteamInventoryResult_t m_hLastFullUpdate;
 	SteamInventoryResult_t m_hExchangeRequestResult;
 
-	std::list<CSpaceWarItem *> m_listPlayerItems;
+	// Items stored contiguously, indexed by instance id and counted by definition
+	std::vector<CSpaceWarItem> m_vecPlayerItems;
+	std::unordered_map<SteamItemInstanceID_t, uint32> m_mapItemIndex;
+	std::unordered_map<SteamItemDef_t, ItemDefinitionCount_t> m_mapDefinitionCounts;
 	SteamItemInstanceID_t m_LastDropInstanceID;
 };
 
@@ -33,7 +33,7 @@ endif
 
 INCLUDE_DIRS := $(PWD)/../public
 LIBRARY_DIRS := $(PWD)/../../client/$(ARCH_DIR)
-LIBRARY_NAMES := steam_api
+LIBRARY_NAMES := steam_api pthread
 STEAM_API := libsteam_api.so
 
 ifeq (,$(wildcard $(LIBRARY_DIRS)/$(STEAM_API)))
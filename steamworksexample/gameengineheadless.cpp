@@ -0,0 +1,77 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Main class for the game engine -- headless implementation
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "stdafx.h"
+#include "gameengineheadless.h"
+#include <chrono>
+#include <thread>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CGameEngineHeadless::CGameEngineHeadless( uint32 unSimulatedFrameMilliseconds )
+{
+	m_bShuttingDown = false;
+	m_unSimulatedFrameMilliseconds = unSimulatedFrameMilliseconds;
+	m_nViewportWidth = HEADLESS_VIEWPORT_WIDTH;
+	m_nViewportHeight = HEADLESS_VIEWPORT_HEIGHT;
+
+	// Simulated time starts at some non-zero value so "tick - 0" comparisons behave like they do at runtime
+	m_ulGameTickCount = m_unSimulatedFrameMilliseconds ? 1000 : GetWallClockMilliseconds();
+	m_ulPreviousGameTickCount = m_ulGameTickCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Milliseconds on a monotonic clock
+//-----------------------------------------------------------------------------
+uint64 CGameEngineHeadless::GetWallClockMilliseconds()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tell the game engine to update current tick count
+//-----------------------------------------------------------------------------
+void CGameEngineHeadless::UpdateGameTickCount()
+{
+	m_ulPreviousGameTickCount = m_ulGameTickCount;
+	if ( m_unSimulatedFrameMilliseconds )
+		m_ulGameTickCount += m_unSimulatedFrameMilliseconds;
+	else
+		m_ulGameTickCount = GetWallClockMilliseconds();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tell the game engine to sleep for a bit if needed to limit frame rate.  You must keep
+// calling this repeatedly until it returns false.  With a simulated clock there is never
+// anything to wait for.
+//-----------------------------------------------------------------------------
+bool CGameEngineHeadless::BSleepForFrameRateLimit( uint32 ulMaxFrameRate )
+{
+	if ( m_unSimulatedFrameMilliseconds )
+		return false;
+
+	// Frame rate limiting
+	float flDesiredFrameMilliseconds = 1000.0f/ulMaxFrameRate;
+	float flMillisecondsElapsed = (float)(GetWallClockMilliseconds() - m_ulGameTickCount);
+	if ( flMillisecondsElapsed < flDesiredFrameMilliseconds )
+	{
+		// If enough time is left sleep, otherwise just keep spinning so we don't go over the limit...
+		if ( flDesiredFrameMilliseconds - flMillisecondsElapsed > 3.0f )
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
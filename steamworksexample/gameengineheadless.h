@@ -0,0 +1,107 @@
+//========= Copyright � 1996-2008, Valve LLC, All rights reserved. ============
+//
+// Purpose: Main class for the game engine -- headless implementation with no
+//			window, renderer, input or audio.  Used to run game simulation on
+//			its own (load testing, replays).
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef GAMEENGINEHEADLESS_H
+#define GAMEENGINEHEADLESS_H
+
+#include "GameEngine.h"
+
+// Default viewport we pretend to have, positions on the wire are normalized against it
+#define HEADLESS_VIEWPORT_WIDTH 1024
+#define HEADLESS_VIEWPORT_HEIGHT 768
+
+class CGameEngineHeadless : public IGameEngine
+{
+public:
+
+	// With a non-zero step the clock is simulated and each UpdateGameTickCount() advances
+	// it by that many milliseconds, otherwise it follows the wall clock
+	CGameEngineHeadless( uint32 unSimulatedFrameMilliseconds = 0 );
+	virtual ~CGameEngineHeadless() {}
+
+	bool BReadyForUse() { return true; }
+	bool BShuttingDown() { return m_bShuttingDown; }
+	void SetBackgroundColor( short a, short r, short g, short b ) {}
+	bool StartFrame() { return true; }
+	void EndFrame() {}
+	void Shutdown() { m_bShuttingDown = true; }
+	void MessagePump() {}
+
+	int32 GetViewportWidth() { return m_nViewportWidth; }
+	int32 GetViewportHeight() { return m_nViewportHeight; }
+
+	// Pretend to be a different size window, e.g. the one a replay was recorded in
+	void SetViewportSize( int32 nWidth, int32 nHeight ) { m_nViewportWidth = nWidth; m_nViewportHeight = nHeight; }
+
+	// Nothing gets drawn, handles are all 0 (failure) so callers don't try to use them
+	bool BDrawString( HGAMEFONT hFont, RECT rect, DWORD dwColor, DWORD dwFormat, const char *pchText ) { return true; }
+	HGAMEFONT HCreateFont( int nHeight, int nFontWeight, bool bItalic, const char * pchFont ) { return 0; }
+	HGAMETEXTURE HCreateTexture( byte *pData, uint32 uWidth, uint32 uHeight, ETEXTUREFORMAT eTextureFormat = eTextureFormat_RGBA ) { return 0; }
+	bool UpdateTexture( HGAMETEXTURE texture, byte *pData, uint32 uWidth, uint32 uHeight, ETEXTUREFORMAT eTextureFormat = eTextureFormat_RGBA ) { return false; }
+	bool BDrawLine( float xPos0, float yPos0, DWORD dwColor0, float xPos1, float yPos1, DWORD dwColor1 ) { return true; }
+	bool BFlushLineBuffer() { return true; }
+	bool BDrawTransformedLines( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, float flSin, float flCos,
+		float xPos, float yPos, const DWORD *pdwOverrideColor ) { return true; }
+	bool BDrawPoint( float xPos, float yPos, DWORD dwColor ) { return true; }
+	bool BFlushPointBuffer() { return true; }
+	bool BDrawFilledRect( float xPos0, float yPos0, float xPos1, float yPos1, DWORD dwColor ) { return true; }
+	bool BDrawTexturedRect( float xPos0, float yPos0, float xPos1, float yPos1,
+		float u0, float v0, float u1, float v1, DWORD dwColor, HGAMETEXTURE hTexture ) { return true; }
+	bool BDrawTexturedQuad( float xPos0, float yPos0, float xPos1, float yPos1, float xPos2, float yPos2, float xPos3, float yPos3,
+		float u0, float v0, float u1, float v1, DWORD dwColor, HGAMETEXTURE hTexture ) { return true; }
+	bool BFlushQuadBuffer() { return true; }
+
+	// No input devices
+	bool BIsKeyDown( DWORD dwVK ) { return false; }
+	bool BGetFirstKeyDown( DWORD *pdwVK ) { return false; }
+	bool BIsSteamInputDeviceActive() { return false; }
+	bool BIsControllerActionActive( ECONTROLLERDIGITALACTION dwAction ) { return false; }
+	void FindActiveSteamInputDevice() {}
+	void GetControllerAnalogAction( ECONTROLLERANALOGACTION dwAction, float *x, float *y ) { *x = 0.0f; *y = 0.0f; }
+	void SetSteamControllerActionSet( ECONTROLLERACTIONSET dwActionSet ) {}
+	void ActivateSteamControllerActionSetLayer( ECONTROLLERACTIONSET dwActionSet ) {}
+	void DeactivateSteamControllerActionSetLayer( ECONTROLLERACTIONSET dwActionSet ) {}
+	bool BIsActionSetLayerActive( ECONTROLLERACTIONSET dwActionSetLayer ) { return false; }
+	const char *GetTextStringForControllerOriginDigital( ECONTROLLERACTIONSET dwActionSet, ECONTROLLERDIGITALACTION dwDigitalAction ) { return ""; }
+	const char *GetTextStringForControllerOriginAnalog( ECONTROLLERACTIONSET dwActionSet, ECONTROLLERANALOGACTION dwDigitalAction ) { return ""; }
+	void SetControllerColor( uint8 nColorR, uint8 nColorG, uint8 nColorB, unsigned int nFlags ) {}
+	void SetTriggerEffect( bool bEnabled ) {}
+	void TriggerControllerVibration( unsigned short nLeftSpeed, unsigned short nRightSpeed ) {}
+	void TriggerControllerHaptics( ESteamControllerPad ePad, unsigned short usOnMicroSec, unsigned short usOffMicroSec, unsigned short usRepeat ) {}
+
+	// Game clock
+	uint64 GetGameTickCount() { return m_ulGameTickCount; }
+	void UpdateGameTickCount();
+	bool BSleepForFrameRateLimit( uint32 ulMaxFrameRate );
+	uint64 GetGameTicksFrameDelta() { return m_ulGameTickCount - m_ulPreviousGameTickCount; }
+	bool BGameEngineHasFocus() { return true; }
+
+	// Jump the simulated clock, for callers that drive it from recorded ticks
+	void SetGameTickCount( uint64 ulTickCount, uint64 ulFrameDelta ) { m_ulGameTickCount = ulTickCount; m_ulPreviousGameTickCount = ulTickCount - ulFrameDelta; }
+
+	// No audio, voice data is dropped
+	HGAMEVOICECHANNEL HCreateVoiceChannel() { return 0; }
+	void DestroyVoiceChannel( HGAMEVOICECHANNEL hChannel ) {}
+	bool AddVoiceData( HGAMEVOICECHANNEL hChannel, const uint8 *pVoiceData, uint32 uLength ) { return false; }
+
+private:
+
+	// Milliseconds on the wall clock
+	uint64 GetWallClockMilliseconds();
+
+	bool m_bShuttingDown;
+	uint32 m_unSimulatedFrameMilliseconds;
+	int32 m_nViewportWidth;
+	int32 m_nViewportHeight;
+
+	uint64 m_ulGameTickCount;
+	uint64 m_ulPreviousGameTickCount;
+};
+
+#endif // GAMEENGINEHEADLESS_H
@@ -14,6 +14,7 @@
 
 #include "glstringosx.h"
 #include "gameengineosx.h"
+#include "Profiler.h"
 
 #include "steam/isteamdualsense.h"
 
@@ -1172,6 +1173,8 @@ bool CGameEngineGL::BDrawLine( float xPos0, float yPos0, DWORD dwColor0, float x
 //-----------------------------------------------------------------------------
 bool CGameEngineGL::BFlushLineBuffer()
 {
+	PROFILE_SCOPE( "CGameEngineGL::BFlushLineBuffer" );
+
 	#if DX9MODE
 		// If the vert buffer isn't already locked into memory, then there is nothing to flush
 		if ( m_pLineVertexes == NULL )
@@ -1304,6 +1307,8 @@ bool CGameEngineGL::BDrawPoint( float xPos, float yPos, DWORD dwColor )
 //-----------------------------------------------------------------------------
 bool CGameEngineGL::BFlushPointBuffer()
 {
+	PROFILE_SCOPE( "CGameEngineGL::BFlushPointBuffer" );
+
 	#if DX9MODE
 		#if 1
 			// If the vert buffer isn't already locked into memory, then there is nothing to flush
@@ -1751,6 +1756,8 @@ bool CGameEngineGL::BDrawTexturedQuad( float xPos0, float yPos0, float xPos1, fl
 //-----------------------------------------------------------------------------
 bool CGameEngineGL::BFlushQuadBuffer()
 {
+	PROFILE_SCOPE( "CGameEngineGL::BFlushQuadBuffer" );
+
 	#if DX9MODE
 		// If the vert buffer isn't already locked into memory, then there is nothing to flush
 		if ( m_pQuadVertexes == NULL )
@@ -14,7 +14,12 @@
 
 #include <GL/glew.h>
 
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
 #include "gameenginesdl.h"
+#include "Profiler.h"
 
 #include "steam/isteamdualsense.h"
 
@@ -101,7 +106,13 @@ CGameEngineGL::CGameEngineGL( )
 	m_hTextureWhite = 0;
 	m_nNextFontHandle = 1;
 	m_nNextTextureHandle = 1;
-	m_hLastTexture = 0;
+	m_uLastTextureID = 0;
+
+	m_nNextScrollingPointsHandle = 1;
+	m_uScrollingPointProgram = 0;
+	m_nScrollUniform = -1;
+	m_nWrapHeightUniform = -1;
+	m_bScrollingPointProgramFailed = false;
 
 	m_rgflPointsData = new GLfloat[ 3*POINT_BUFFER_TOTAL_SIZE ];
 	m_rgflPointsColorData = new GLubyte[ 4*POINT_BUFFER_TOTAL_SIZE ];
@@ -220,6 +231,12 @@ void CGameEngineGL::Shutdown()
 
 	m_MapStrings.clear();
 	m_MapTextures.clear();
+	m_vecAtlasPages.clear();
+	m_uLastTextureID = 0;
+
+	// GL objects went with the context
+	m_MapScrollingPoints.clear();
+	m_uScrollingPointProgram = 0;
 
 	m_dwLinesToFlush = 0;
 	m_dwPointsToFlush = 0;
@@ -513,11 +530,99 @@ bool CGameEngineGL::BDrawLine( float xPos0, float yPos0, DWORD dwColor0, float x
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Draw a block of lines, rotating and translating the vertexes as they go
+// into the line buffer.  Vertex positions are written as x, y, 1 floats and colors
+// as RGBA bytes, same as BDrawLine.
+//-----------------------------------------------------------------------------
+bool CGameEngineGL::BDrawTransformedLines( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, float flSin, float flCos,
+	float xPos, float yPos, const DWORD *pdwOverrideColor )
+{
+	if ( m_bShuttingDown )
+		return false;
+
+	uint32 cLines = cVertexes / 2;
+	while ( cLines )
+	{
+		// Check if we are out of room and need to flush the buffer
+		if ( m_dwLinesToFlush == LINE_BUFFER_TOTAL_SIZE )
+		{
+			BFlushLineBuffer();
+		}
+
+		uint32 cBatch = MIN( cLines, (uint32)( LINE_BUFFER_TOTAL_SIZE - m_dwLinesToFlush ) );
+		uint32 cBatchVertexes = cBatch * 2;
+		const VectorEntityVertex_t *pIn = pVertexes;
+		GLfloat *pflOut = &m_rgflLinesData[ m_dwLinesToFlush*6 ];
+		GLubyte *pubColorOut = &m_rgflLinesColorData[ m_dwLinesToFlush*8 ];
+		uint32 i = 0;
+
+#if defined( __SSE2__ )
+		// 4 vertexes (3 registers) at a time: x0 y0 c0 x1 | y1 c1 x2 y2 | c2 x3 y3 c3
+		__m128 vSin = _mm_set1_ps( flSin ), vCos = _mm_set1_ps( flCos );
+		__m128 vXPos = _mm_set1_ps( xPos ), vYPos = _mm_set1_ps( yPos ), vOne = _mm_set1_ps( 1.0f );
+		__m128i vOverrideColor = _mm_set1_epi32( pdwOverrideColor ? (int)*pdwOverrideColor : 0 );
+		__m128i vMaskAG = _mm_set1_epi32( (int)0xff00ff00 ), vMaskB = _mm_set1_epi32( 0xff );
+		for ( ; i + 4 <= cBatchVertexes; i += 4, pIn += 4, pflOut += 12, pubColorOut += 16 )
+		{
+			const float *pflIn = &pIn->x;
+			__m128 a = _mm_loadu_ps( pflIn ), b = _mm_loadu_ps( pflIn + 4 ), c = _mm_loadu_ps( pflIn + 8 );
+
+			// Deinterleave into x, y and colors
+			__m128 x2y2 = _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 1, 3, 2 ) );
+			__m128 y0c0 = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 0, 2, 1 ) );
+			__m128 x = _mm_shuffle_ps( a, x2y2, _MM_SHUFFLE( 2, 0, 3, 0 ) );
+			__m128 y = _mm_shuffle_ps( y0c0, x2y2, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+			__m128 col = _mm_shuffle_ps( y0c0, c, _MM_SHUFFLE( 3, 0, 3, 1 ) );
+
+			// Same operation order as the scalar loop below
+			__m128 xPrime = _mm_add_ps( _mm_sub_ps( _mm_mul_ps( vCos, x ), _mm_mul_ps( vSin, y ) ), vXPos );
+			__m128 yPrime = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vSin, x ), _mm_mul_ps( vCos, y ) ), vYPos );
+
+			// Back out as x, y, 1
+			__m128 xy = _mm_shuffle_ps( xPrime, yPrime, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+			__m128 yOne = _mm_shuffle_ps( yPrime, vOne, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+			__m128 oneX = _mm_shuffle_ps( vOne, xPrime, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+			_mm_storeu_ps( pflOut, _mm_shuffle_ps( xy, oneX, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			_mm_storeu_ps( pflOut + 4, _mm_shuffle_ps( yOne, xy, _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+			_mm_storeu_ps( pflOut + 8, _mm_shuffle_ps( oneX, yOne, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+
+			// ARGB dwords to RGBA bytes is a swap of the red and blue bytes
+			__m128i argb = pdwOverrideColor ? vOverrideColor : _mm_castps_si128( col );
+			__m128i rgba = _mm_or_si128( _mm_and_si128( argb, vMaskAG ),
+				_mm_or_si128( _mm_and_si128( _mm_srli_epi32( argb, 16 ), vMaskB ), _mm_slli_epi32( _mm_and_si128( argb, vMaskB ), 16 ) ) );
+			_mm_storeu_si128( (__m128i *)pubColorOut, rgba );
+		}
+#endif
+
+		for ( ; i < cBatchVertexes; ++i, ++pIn, pflOut += 3, pubColorOut += 4 )
+		{
+			DWORD dwColor = pdwOverrideColor ? *pdwOverrideColor : pIn->color;
+			pflOut[0] = flCos*pIn->x - flSin*pIn->y + xPos;
+			pflOut[1] = flSin*pIn->x + flCos*pIn->y + yPos;
+			pflOut[2] = 1.0;
+			pubColorOut[0] = COLOR_RED( dwColor );
+			pubColorOut[1] = COLOR_GREEN( dwColor );
+			pubColorOut[2] = COLOR_BLUE( dwColor );
+			pubColorOut[3] = COLOR_ALPHA( dwColor );
+		}
+
+		m_dwLinesToFlush += cBatch;
+		pVertexes += cBatchVertexes;
+		cLines -= cBatch;
+	}
+
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Flush batched lines to the screen
 //-----------------------------------------------------------------------------
 bool CGameEngineGL::BFlushLineBuffer()
 {
+	PROFILE_SCOPE( "CGameEngineGL::BFlushLineBuffer" );
+
 	if ( !m_rgflLinesColorData || !m_rgflLinesData || m_bShuttingDown )
 		return false;
 
@@ -570,6 +675,8 @@ bool CGameEngineGL::BDrawPoint( float xPos, float yPos, DWORD dwColor )
 //-----------------------------------------------------------------------------
 bool CGameEngineGL::BFlushPointBuffer()
 {
+	PROFILE_SCOPE( "CGameEngineGL::BFlushPointBuffer" );
+
 	if ( !m_rgflPointsColorData || !m_rgflPointsData || m_bShuttingDown )
 		return false;
 
@@ -586,6 +693,185 @@ bool CGameEngineGL::BFlushPointBuffer()
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Build the program used by BDrawScrollingPoints.  Only the y position
+// is animated, everything else is the same as the fixed function point path.
+//-----------------------------------------------------------------------------
+static const char *k_pchScrollingPointVertexShader =
+	"uniform float flScroll;\n"
+	"uniform float flWrapHeight;\n"
+	"void main()\n"
+	"{\n"
+	"	// z holds the point's speed\n"
+	"	float y = mod( gl_Vertex.y - flScroll * gl_Vertex.z, flWrapHeight );\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4( gl_Vertex.x, y, 1.0, 1.0 );\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"}\n";
+
+static const char *k_pchScrollingPointFragmentShader =
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = gl_Color;\n"
+	"}\n";
+
+static GLuint CompileShader( GLenum eType, const char *pchSource )
+{
+	GLuint uShader = glCreateShader( eType );
+	glShaderSource( uShader, 1, &pchSource, NULL );
+	glCompileShader( uShader );
+
+	GLint nCompiled = 0;
+	glGetShaderiv( uShader, GL_COMPILE_STATUS, &nCompiled );
+	if ( !nCompiled )
+	{
+		char rgchLog[1024];
+		glGetShaderInfoLog( uShader, sizeof( rgchLog ), NULL, rgchLog );
+		OutputDebugString( "Scrolling point shader failed to compile: " );
+		OutputDebugString( rgchLog );
+		OutputDebugString( "\n" );
+		glDeleteShader( uShader );
+		return 0;
+	}
+	return uShader;
+}
+
+bool CGameEngineGL::BInitScrollingPointProgram()
+{
+	if ( m_uScrollingPointProgram )
+		return true;
+
+	if ( m_bScrollingPointProgramFailed || !GLEW_VERSION_2_0 )
+		return false;
+
+	// Don't keep retrying every frame if it doesn't work
+	m_bScrollingPointProgramFailed = true;
+
+	GLuint uVertexShader = CompileShader( GL_VERTEX_SHADER, k_pchScrollingPointVertexShader );
+	GLuint uFragmentShader = CompileShader( GL_FRAGMENT_SHADER, k_pchScrollingPointFragmentShader );
+	if ( !uVertexShader || !uFragmentShader )
+	{
+		glDeleteShader( uVertexShader );
+		glDeleteShader( uFragmentShader );
+		return false;
+	}
+
+	GLuint uProgram = glCreateProgram();
+	glAttachShader( uProgram, uVertexShader );
+	glAttachShader( uProgram, uFragmentShader );
+	glLinkProgram( uProgram );
+
+	// The program holds on to them
+	glDeleteShader( uVertexShader );
+	glDeleteShader( uFragmentShader );
+
+	GLint nLinked = 0;
+	glGetProgramiv( uProgram, GL_LINK_STATUS, &nLinked );
+	if ( !nLinked )
+	{
+		char rgchLog[1024];
+		glGetProgramInfoLog( uProgram, sizeof( rgchLog ), NULL, rgchLog );
+		OutputDebugString( "Scrolling point shader failed to link: " );
+		OutputDebugString( rgchLog );
+		OutputDebugString( "\n" );
+		glDeleteProgram( uProgram );
+		return false;
+	}
+
+	m_uScrollingPointProgram = uProgram;
+	m_nScrollUniform = glGetUniformLocation( uProgram, "flScroll" );
+	m_nWrapHeightUniform = glGetUniformLocation( uProgram, "flWrapHeight" );
+	m_bScrollingPointProgramFailed = false;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Upload a static set of points into a vertex buffer
+//-----------------------------------------------------------------------------
+HGAMEVERTBUF CGameEngineGL::HCreateScrollingPoints( const ScrollingPointVertex_t *pPoints, uint32 cPoints )
+{
+	if ( m_bShuttingDown || !cPoints || !BInitScrollingPointProgram() )
+		return 0;
+
+	// Same layout, but GL wants the colors as RGBA bytes
+	std::vector<ScrollingPointVertex_t> vecUpload( pPoints, pPoints + cPoints );
+	for ( uint32 i = 0; i < cPoints; ++i )
+	{
+		DWORD dwColor = vecUpload[i].color;
+		GLubyte *pubColor = (GLubyte *)&vecUpload[i].color;
+		pubColor[0] = COLOR_RED( dwColor );
+		pubColor[1] = COLOR_GREEN( dwColor );
+		pubColor[2] = COLOR_BLUE( dwColor );
+		pubColor[3] = COLOR_ALPHA( dwColor );
+	}
+
+	ScrollingPointsData_t PointsData;
+	PointsData.m_cPoints = cPoints;
+	glGenBuffers( 1, &PointsData.m_uBufferID );
+	glBindBuffer( GL_ARRAY_BUFFER, PointsData.m_uBufferID );
+	glBufferData( GL_ARRAY_BUFFER, cPoints * sizeof( ScrollingPointVertex_t ), &vecUpload[0], GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	HGAMEVERTBUF hPoints = m_nNextScrollingPointsHandle;
+	++m_nNextScrollingPointsHandle;
+	m_MapScrollingPoints[hPoints] = PointsData;
+
+	return hPoints;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Draw a static point set with one draw call, the shader does the scrolling
+//-----------------------------------------------------------------------------
+bool CGameEngineGL::BDrawScrollingPoints( HGAMEVERTBUF hPoints, float flScroll, float flWrapHeight )
+{
+	PROFILE_SCOPE( "CGameEngineGL::BDrawScrollingPoints" );
+
+	if ( m_bShuttingDown )
+		return false;
+
+	std::map<HGAMEVERTBUF, ScrollingPointsData_t>::iterator iter = m_MapScrollingPoints.find( hPoints );
+	if ( iter == m_MapScrollingPoints.end() || !m_uScrollingPointProgram )
+	{
+		OutputDebugString( "BDrawScrollingPoints called with invalid hPoints value\n" );
+		return false;
+	}
+
+	// Keep ordering with anything already batched
+	BFlushPointBuffer();
+
+	glUseProgram( m_uScrollingPointProgram );
+	glUniform1f( m_nScrollUniform, flScroll );
+	glUniform1f( m_nWrapHeightUniform, flWrapHeight );
+
+	glBindBuffer( GL_ARRAY_BUFFER, iter->second.m_uBufferID );
+	glVertexPointer( 3, GL_FLOAT, sizeof( ScrollingPointVertex_t ), (const void *)0 );
+	glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof( ScrollingPointVertex_t ), (const void *)offsetof( ScrollingPointVertex_t, color ) );
+	glDrawArrays( GL_POINTS, 0, iter->second.m_cPoints );
+
+	// The other batches use client side arrays and fixed function
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glUseProgram( 0 );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Free a static point set
+//-----------------------------------------------------------------------------
+void CGameEngineGL::ReleaseScrollingPoints( HGAMEVERTBUF hPoints )
+{
+	std::map<HGAMEVERTBUF, ScrollingPointsData_t>::iterator iter = m_MapScrollingPoints.find( hPoints );
+	if ( iter == m_MapScrollingPoints.end() )
+		return;
+
+	if ( !m_bShuttingDown )
+		glDeleteBuffers( 1, &iter->second.m_uBufferID );
+	m_MapScrollingPoints.erase( iter );
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Draw a filled quad
 //-----------------------------------------------------------------------------
@@ -621,14 +907,19 @@ bool CGameEngineGL::BDrawTexturedRect( float xPos0, float yPos0, float xPos1, fl
 	}
 
 	// Check if we are out of room and need to flush the buffer, or if our texture is changing
-	// then we also need to flush the buffer.
-	if ( m_dwQuadsToFlush == QUAD_BUFFER_TOTAL_SIZE || m_hLastTexture != hTexture )
+	// then we also need to flush the buffer.  Textures sharing an atlas page don't count as a change.
+	const TextureData_t &texData = iter->second;
+	if ( m_dwQuadsToFlush == QUAD_BUFFER_TOTAL_SIZE || m_uLastTextureID != texData.m_uTextureID )
 	{
 		BFlushQuadBuffer();
+		m_uLastTextureID = texData.m_uTextureID;
 	}
 
-	// Bind the new texture
-	glBindTexture( GL_TEXTURE_2D, iter->second.m_uTextureID );
+	// Remap the caller's UVs into the texture's rect on its page
+	u0 = texData.m_flU0 + u0 * ( texData.m_flU1 - texData.m_flU0 );
+	u1 = texData.m_flU0 + u1 * ( texData.m_flU1 - texData.m_flU0 );
+	v0 = texData.m_flV0 + v0 * ( texData.m_flV1 - texData.m_flV0 );
+	v1 = texData.m_flV0 + v1 * ( texData.m_flV1 - texData.m_flV0 );
 
 	DWORD dwOffset = m_dwQuadsToFlush*12;
 	m_rgflQuadsData[dwOffset] = xPos0;
@@ -697,14 +988,19 @@ bool CGameEngineGL::BDrawTexturedQuad( float xPos0, float yPos0, float xPos1, fl
 	}
 
 	// Check if we are out of room and need to flush the buffer, or if our texture is changing
-	// then we also need to flush the buffer.
-	if ( m_dwQuadsToFlush == QUAD_BUFFER_TOTAL_SIZE || m_hLastTexture != hTexture )
+	// then we also need to flush the buffer.  Textures sharing an atlas page don't count as a change.
+	const TextureData_t &texData = iter->second;
+	if ( m_dwQuadsToFlush == QUAD_BUFFER_TOTAL_SIZE || m_uLastTextureID != texData.m_uTextureID )
 	{
 		BFlushQuadBuffer();
+		m_uLastTextureID = texData.m_uTextureID;
 	}
 
-	// Bind the new texture
-	glBindTexture( GL_TEXTURE_2D, iter->second.m_uTextureID );
+	// Remap the caller's UVs into the texture's rect on its page
+	u0 = texData.m_flU0 + u0 * ( texData.m_flU1 - texData.m_flU0 );
+	u1 = texData.m_flU0 + u1 * ( texData.m_flU1 - texData.m_flU0 );
+	v0 = texData.m_flV0 + v0 * ( texData.m_flV1 - texData.m_flV0 );
+	v1 = texData.m_flV0 + v1 * ( texData.m_flV1 - texData.m_flV0 );
 
 	DWORD dwOffset = m_dwQuadsToFlush*12;
 	m_rgflQuadsData[dwOffset] = xPos0;
@@ -760,12 +1056,16 @@ bool CGameEngineGL::BDrawTexturedQuad( float xPos0, float yPos0, float xPos1, fl
 //-----------------------------------------------------------------------------
 bool CGameEngineGL::BFlushQuadBuffer()
 {
+	PROFILE_SCOPE( "CGameEngineGL::BFlushQuadBuffer" );
+
 	if ( !m_rgflPointsColorData || !m_rgflPointsData || m_bShuttingDown )
 		return false;
 
 	if ( m_dwQuadsToFlush )
 	{
+		// Bind here rather than when the quads were queued, texture creation in between may have changed the binding
 		glEnable( GL_TEXTURE_2D );
+		glBindTexture( GL_TEXTURE_2D, m_uLastTextureID );
 		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
 
 		glColorPointer( 4, GL_UNSIGNED_BYTE, 0, m_rgflQuadsColorData );
@@ -795,21 +1095,34 @@ HGAMETEXTURE CGameEngineGL::HCreateTexture( byte *pRGBAData, uint32 uWidth, uint
 	TexData.m_uWidth = uWidth;
 	TexData.m_uHeight = uHeight;
 	TexData.m_uTextureID = 0;
-
-	glEnable( GL_TEXTURE_2D );
-	glGenTextures( 1, &TexData.m_uTextureID );
-	glBindTexture( GL_TEXTURE_2D, TexData.m_uTextureID );
-
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 1.0 );
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-
-	// build our texture mipmaps
-	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, uWidth, uHeight, 0, eTextureFormat == eTextureFormat_RGBA ? GL_RGBA : GL_BGRA, GL_UNSIGNED_BYTE, (void *)pRGBAData );
-	glDisable( GL_TEXTURE_2D );
+	TexData.m_nAtlasPage = -1;
+	TexData.m_uAtlasX = TexData.m_uAtlasY = 0;
+	TexData.m_uAtlasWidth = uWidth;
+	TexData.m_uAtlasHeight = uHeight;
+	TexData.m_flU0 = TexData.m_flV0 = 0.0f;
+	TexData.m_flU1 = TexData.m_flV1 = 1.0f;
+
+	if ( uWidth <= TEXTURE_ATLAS_MAX_ENTRY_SIZE && uHeight <= TEXTURE_ATLAS_MAX_ENTRY_SIZE && BAllocateFromAtlas( uWidth, uHeight, &TexData ) )
+	{
+		UploadToAtlas( TexData, pRGBAData, eTextureFormat );
+	}
+	else
+	{
+		glEnable( GL_TEXTURE_2D );
+		glGenTextures( 1, &TexData.m_uTextureID );
+		glBindTexture( GL_TEXTURE_2D, TexData.m_uTextureID );
+
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 1.0 );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+		// build our texture mipmaps
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, uWidth, uHeight, 0, eTextureFormat == eTextureFormat_RGBA ? GL_RGBA : GL_BGRA, GL_UNSIGNED_BYTE, (void *)pRGBAData );
+		glDisable( GL_TEXTURE_2D );
+	}
 
 	int nHandle = m_nNextTextureHandle;
 	++m_nNextTextureHandle;
@@ -835,8 +1148,36 @@ bool CGameEngineGL::UpdateTexture( HGAMETEXTURE texture, byte *pRGBAData, uint32
 		return false;
 	}
 
+	TextureData_t &texData = iter->second;
+	if ( texData.m_nAtlasPage >= 0 )
+	{
+		if ( texData.m_uAtlasWidth == uWidth && texData.m_uAtlasHeight == uHeight )
+		{
+			// Same size, just overwrite the slot
+			UploadToAtlas( texData, pRGBAData, eTextureFormat );
+			return true;
+		}
+
+		// Size changed, give it its own texture from here on (the old slot is simply abandoned)
+		BFlushQuadBuffer();
+		texData.m_nAtlasPage = -1;
+		texData.m_flU0 = texData.m_flV0 = 0.0f;
+		texData.m_flU1 = texData.m_flV1 = 1.0f;
+
+		glEnable( GL_TEXTURE_2D );
+		glGenTextures( 1, &texData.m_uTextureID );
+		glBindTexture( GL_TEXTURE_2D, texData.m_uTextureID );
+
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 1.0 );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	}
+
 	glEnable( GL_TEXTURE_2D );
-	glBindTexture( GL_TEXTURE_2D, iter->second.m_uTextureID );
+	glBindTexture( GL_TEXTURE_2D, texData.m_uTextureID );
 
 	// build our texture mipmaps
 	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, uWidth, uHeight, 0, eTextureFormat == eTextureFormat_RGBA ? GL_RGBA : GL_BGRA, GL_UNSIGNED_BYTE, (void *)pRGBAData );
@@ -846,6 +1187,123 @@ bool CGameEngineGL::UpdateTexture( HGAMETEXTURE texture, byte *pRGBAData, uint32
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Find space for a small texture in one of the atlas pages.  Entries get
+//			a one texel gutter so linear filtering never picks up a neighbor.
+//-----------------------------------------------------------------------------
+bool CGameEngineGL::BAllocateFromAtlas( uint32 uWidth, uint32 uHeight, TextureData_t *pTexData )
+{
+	uint32 uPaddedWidth = uWidth + 2;
+	uint32 uPaddedHeight = uHeight + 2;
+
+	for ( int iPass = 0; iPass < 2; ++iPass )
+	{
+		for ( size_t iPage = 0; iPage < m_vecAtlasPages.size(); ++iPage )
+		{
+			AtlasPage_t &page = m_vecAtlasPages[iPage];
+
+			// Best fit among the existing shelves: the shortest one it fits on
+			AtlasShelf_t *pBestShelf = NULL;
+			for ( size_t iShelf = 0; iShelf < page.m_vecShelves.size(); ++iShelf )
+			{
+				AtlasShelf_t &shelf = page.m_vecShelves[iShelf];
+				if ( shelf.m_uHeight < uPaddedHeight || shelf.m_uNextX + uPaddedWidth > TEXTURE_ATLAS_PAGE_SIZE )
+					continue;
+				if ( !pBestShelf || shelf.m_uHeight < pBestShelf->m_uHeight )
+					pBestShelf = &shelf;
+			}
+
+			// Otherwise open a new shelf at the bottom of the page
+			if ( !pBestShelf && page.m_uNextShelfY + uPaddedHeight <= TEXTURE_ATLAS_PAGE_SIZE )
+			{
+				AtlasShelf_t shelf;
+				shelf.m_uY = page.m_uNextShelfY;
+				shelf.m_uHeight = uPaddedHeight;
+				shelf.m_uNextX = 0;
+				page.m_vecShelves.push_back( shelf );
+				page.m_uNextShelfY += uPaddedHeight;
+				pBestShelf = &page.m_vecShelves.back();
+			}
+
+			if ( !pBestShelf )
+				continue;
+
+			pTexData->m_uTextureID = page.m_uTextureID;
+			pTexData->m_nAtlasPage = (int)iPage;
+			pTexData->m_uAtlasX = pBestShelf->m_uNextX + 1;
+			pTexData->m_uAtlasY = pBestShelf->m_uY + 1;
+			pTexData->m_uAtlasWidth = uWidth;
+			pTexData->m_uAtlasHeight = uHeight;
+			pTexData->m_flU0 = (float)pTexData->m_uAtlasX / TEXTURE_ATLAS_PAGE_SIZE;
+			pTexData->m_flV0 = (float)pTexData->m_uAtlasY / TEXTURE_ATLAS_PAGE_SIZE;
+			pTexData->m_flU1 = (float)( pTexData->m_uAtlasX + uWidth ) / TEXTURE_ATLAS_PAGE_SIZE;
+			pTexData->m_flV1 = (float)( pTexData->m_uAtlasY + uHeight ) / TEXTURE_ATLAS_PAGE_SIZE;
+
+			pBestShelf->m_uNextX += uPaddedWidth;
+			return true;
+		}
+
+		// Nothing had room, add a page and go around once more
+		if ( iPass > 0 || m_vecAtlasPages.size() >= TEXTURE_ATLAS_MAX_PAGES )
+			break;
+
+		AtlasPage_t page;
+		page.m_uNextShelfY = 0;
+		page.m_uTextureID = 0;
+
+		glEnable( GL_TEXTURE_2D );
+		glGenTextures( 1, &page.m_uTextureID );
+		glBindTexture( GL_TEXTURE_2D, page.m_uTextureID );
+
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 1.0 );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+		glDisable( GL_TEXTURE_2D );
+
+		m_vecAtlasPages.push_back( page );
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Copy texels into an atlas slot, replicating the edges into the gutter
+//-----------------------------------------------------------------------------
+void CGameEngineGL::UploadToAtlas( const TextureData_t &texData, byte *pRGBAData, ETEXTUREFORMAT eTextureFormat )
+{
+	uint32 uWidth = texData.m_uAtlasWidth;
+	uint32 uHeight = texData.m_uAtlasHeight;
+	uint32 uPaddedWidth = uWidth + 2;
+	uint32 uPaddedHeight = uHeight + 2;
+
+	byte *pPadded = new byte[ uPaddedWidth * uPaddedHeight * 4 ];
+	for ( uint32 y = 0; y < uPaddedHeight; ++y )
+	{
+		uint32 ySrc = ( y == 0 ) ? 0 : ( y > uHeight ? uHeight - 1 : y - 1 );
+		byte *pDstRow = pPadded + y * uPaddedWidth * 4;
+		byte *pSrcRow = pRGBAData + ySrc * uWidth * 4;
+
+		memcpy( pDstRow + 4, pSrcRow, uWidth * 4 );
+		memcpy( pDstRow, pSrcRow, 4 );
+		memcpy( pDstRow + ( uPaddedWidth - 1 ) * 4, pSrcRow + ( uWidth - 1 ) * 4, 4 );
+	}
+
+	glEnable( GL_TEXTURE_2D );
+	glBindTexture( GL_TEXTURE_2D, texData.m_uTextureID );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, texData.m_uAtlasX - 1, texData.m_uAtlasY - 1, uPaddedWidth, uPaddedHeight,
+		eTextureFormat == eTextureFormat_RGBA ? GL_RGBA : GL_BGRA, GL_UNSIGNED_BYTE, (void *)pPadded );
+	glDisable( GL_TEXTURE_2D );
+
+	delete[] pPadded;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Creates a new font
 //-----------------------------------------------------------------------------
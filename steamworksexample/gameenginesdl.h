@@ -28,6 +28,7 @@ typedef unsigned char byte;
 #include <string>
 #include <set>
 #include <map>
+#include <vector>
 
 
 
@@ -61,6 +62,15 @@ typedef unsigned char byte;
 // can finish using the data before we wrap around and discard it.
 #define QUAD_BUFFER_BATCH_SIZE 250
 
+// Textures up to this size (in either dimension) get packed into shared atlas pages,
+// so quads using different small textures (strings, avatars, icons) can go out in one draw.
+#define TEXTURE_ATLAS_MAX_ENTRY_SIZE 256
+
+// Size of each atlas page, and how many pages we are willing to create before falling
+// back to individual textures.
+#define TEXTURE_ATLAS_PAGE_SIZE 1024
+#define TEXTURE_ATLAS_MAX_PAGES 4
+
 
 
 class CVoiceContext;
@@ -119,12 +129,21 @@ public:
 	// Flush the line buffer
 	bool BFlushLineBuffer();
 
+	// Rotate and translate a block of vertexes straight into the line buffer
+	bool BDrawTransformedLines( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, float flSin, float flCos,
+		float xPos, float yPos, const DWORD *pdwOverrideColor );
+
 	// Draw a point, the engine itself will manage batching these (although you can explicitly flush if you need to)
 	bool BDrawPoint( float xPos, float yPos, DWORD dwColor );
 
 	// Flush the point buffer
 	bool BFlushPointBuffer();
 
+	// Static point sets, scrolled in a vertex shader
+	HGAMEVERTBUF HCreateScrollingPoints( const ScrollingPointVertex_t *pPoints, uint32 cPoints );
+	bool BDrawScrollingPoints( HGAMEVERTBUF hPoints, float flScroll, float flWrapHeight );
+	void ReleaseScrollingPoints( HGAMEVERTBUF hPoints );
+
 	// Draw a filled quad
 	bool BDrawFilledRect( float xPos0, float yPos0, float xPos1, float yPos1, DWORD dwColor );
 
@@ -226,6 +245,17 @@ public:
 
 	void UpdateKey( uint32_t vkKey, int nDown );
 
+	struct TextureData_t;
+
+	// Find room for a texture in an atlas page, creating a page if needed
+	bool BAllocateFromAtlas( uint32 uWidth, uint32 uHeight, TextureData_t *pTexData );
+
+	// Copy texels into a texture's atlas slot
+	void UploadToAtlas( const TextureData_t &texData, byte *pRGBAData, ETEXTUREFORMAT eTextureFormat );
+
+	// Compile and link the scrolling point shader on first use, false if GL 2.0 isn't there or it failed
+	bool BInitScrollingPointProgram();
+
 	// Tracks whether the engine is ready for use
 	bool m_bEngineReadyForUse;
 
@@ -282,13 +312,51 @@ public:
 	{
 		uint32 m_uWidth;
 		uint32 m_uHeight;
-		GLuint m_uTextureID;
+		GLuint m_uTextureID;		// atlas page texture if m_nAtlasPage >= 0
+
+		// Where the texture lives inside m_uTextureID.  Caller UVs get remapped into this rect.
+		int m_nAtlasPage;
+		uint32 m_uAtlasX;
+		uint32 m_uAtlasY;
+		uint32 m_uAtlasWidth;
+		uint32 m_uAtlasHeight;
+		float m_flU0, m_flV0, m_flU1, m_flV1;
 	};
 	std::map<HGAMETEXTURE, TextureData_t> m_MapTextures;
 	HGAMETEXTURE m_nNextTextureHandle;
 
-	// Last bound texture, used to know when we must flush
-	HGAMETEXTURE m_hLastTexture;
+	// Map of handles to static scrolling point sets
+	struct ScrollingPointsData_t
+	{
+		GLuint m_uBufferID;
+		uint32 m_cPoints;
+	};
+	std::map<HGAMEVERTBUF, ScrollingPointsData_t> m_MapScrollingPoints;
+	HGAMEVERTBUF m_nNextScrollingPointsHandle;
+
+	// Program which does the scrolling, and its uniforms
+	GLuint m_uScrollingPointProgram;
+	GLint m_nScrollUniform;
+	GLint m_nWrapHeightUniform;
+	bool m_bScrollingPointProgramFailed;
+
+	// Shelf packed atlas pages, each shelf is a row of entries filled left to right
+	struct AtlasShelf_t
+	{
+		uint32 m_uY;
+		uint32 m_uHeight;
+		uint32 m_uNextX;
+	};
+	struct AtlasPage_t
+	{
+		GLuint m_uTextureID;
+		uint32 m_uNextShelfY;
+		std::vector<AtlasShelf_t> m_vecShelves;
+	};
+	std::vector<AtlasPage_t> m_vecAtlasPages;
+
+	// GL texture the pending quads draw with, used to know when we must flush
+	GLuint m_uLastTextureID;
 
 	// Map of button state, translated to VK for win32.
 	std::set< DWORD > m_SetKeysDown;
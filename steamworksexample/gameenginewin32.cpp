@@ -8,6 +8,7 @@
 #include "stdafx.h"
 #include "GameEngineWin32.h"
 #include <map>
+#include <emmintrin.h>
 #include "steam\isteaminput.h"
 #include "steam\isteamdualsense.h"
 
@@ -1041,6 +1042,39 @@ bool CGameEngineWin32::BDrawLine( float xPos0, float yPos0, DWORD dwColor0, floa
 	if ( m_bDeviceLost )
 		return true; // Fail silently in this case
 
+	// Check if we are out of room and need to flush the buffer
+	if ( m_dwLinesToFlush == LINE_BUFFER_BATCH_SIZE )
+	{
+		BFlushLineBuffer();
+	}
+
+	if ( !BLockLineBuffer() )
+		return false;
+
+	LineVertex_t *pVertData = &m_pLineVertexes[ m_dwLineBufferBatchPos*2+m_dwLinesToFlush*2 ];
+	pVertData[0].rhw = 1.0;
+	pVertData[0].z = 1.0;
+	pVertData[0].x = xPos0;
+	pVertData[0].y = yPos0;
+	pVertData[0].color = dwColor0;
+
+	pVertData[1].rhw = 1.0;
+	pVertData[1].z = 1.0;
+	pVertData[1].x = xPos1;
+	pVertData[1].y = yPos1;
+	pVertData[1].color = dwColor1;
+
+	++m_dwLinesToFlush;
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Create the line buffer if needed and lock the current batch into memory
+//-----------------------------------------------------------------------------
+bool CGameEngineWin32::BLockLineBuffer()
+{
 	if ( !m_hLineBuffer )
 	{
 		// Create the line buffer
@@ -1053,12 +1087,6 @@ bool CGameEngineWin32::BDrawLine( float xPos0, float yPos0, DWORD dwColor0, floa
 		}
 	}
 
-	// Check if we are out of room and need to flush the buffer
-	if ( m_dwLinesToFlush == LINE_BUFFER_BATCH_SIZE )
-	{
-		BFlushLineBuffer();
-	}
-
 	// Set FVF
 	if ( !BSetFVF( D3DFVF_XYZRHW | D3DFVF_DIFFUSE ) )
 		return false;
@@ -1074,20 +1102,85 @@ bool CGameEngineWin32::BDrawLine( float xPos0, float yPos0, DWORD dwColor0, floa
 		}
 	}
 
-	LineVertex_t *pVertData = &m_pLineVertexes[ m_dwLineBufferBatchPos*2+m_dwLinesToFlush*2 ];
-	pVertData[0].rhw = 1.0;
-	pVertData[0].z = 1.0;
-	pVertData[0].x = xPos0;
-	pVertData[0].y = yPos0;
-	pVertData[0].color = dwColor0;
+	return true;
+}
 
-	pVertData[1].rhw = 1.0;
-	pVertData[1].z = 1.0;
-	pVertData[1].x = xPos1;
-	pVertData[1].y = yPos1;
-	pVertData[1].color = dwColor1;
 
-	++m_dwLinesToFlush;
+//-----------------------------------------------------------------------------
+// Purpose: Draw a block of lines, rotating and translating the vertexes as they
+// are written into the locked line buffer
+//-----------------------------------------------------------------------------
+bool CGameEngineWin32::BDrawTransformedLines( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, float flSin, float flCos,
+	float xPos, float yPos, const DWORD *pdwOverrideColor )
+{
+	if ( !m_pD3D9Device )
+		return false;
+
+	if ( m_bDeviceLost )
+		return true; // Fail silently in this case
+
+	uint32 cLines = cVertexes / 2;
+	while ( cLines )
+	{
+		// Check if we are out of room and need to flush the buffer
+		if ( m_dwLinesToFlush == LINE_BUFFER_BATCH_SIZE )
+		{
+			BFlushLineBuffer();
+		}
+
+		if ( !BLockLineBuffer() )
+			return false;
+
+		uint32 cBatch = MIN( cLines, (uint32)( LINE_BUFFER_BATCH_SIZE - m_dwLinesToFlush ) );
+		uint32 cBatchVertexes = cBatch * 2;
+		const VectorEntityVertex_t *pIn = pVertexes;
+		LineVertex_t *pVertData = &m_pLineVertexes[ m_dwLineBufferBatchPos*2+m_dwLinesToFlush*2 ];
+		uint32 i = 0;
+
+		// 4 vertexes (3 registers) at a time: x0 y0 c0 x1 | y1 c1 x2 y2 | c2 x3 y3 c3
+		__m128 vSin = _mm_set1_ps( flSin ), vCos = _mm_set1_ps( flCos );
+		__m128 vXPos = _mm_set1_ps( xPos ), vYPos = _mm_set1_ps( yPos ), vOne = _mm_set1_ps( 1.0f );
+		for ( ; i + 4 <= cBatchVertexes; i += 4, pIn += 4, pVertData += 4 )
+		{
+			const float *pflIn = &pIn->x;
+			__m128 a = _mm_loadu_ps( pflIn ), b = _mm_loadu_ps( pflIn + 4 ), c = _mm_loadu_ps( pflIn + 8 );
+
+			// Deinterleave into x and y, the colors get copied as is below
+			__m128 x2y2 = _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 1, 3, 2 ) );
+			__m128 y0c0 = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 0, 2, 1 ) );
+			__m128 x = _mm_shuffle_ps( a, x2y2, _MM_SHUFFLE( 2, 0, 3, 0 ) );
+			__m128 y = _mm_shuffle_ps( y0c0, x2y2, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+
+			// Same operation order as the scalar loop below
+			__m128 xPrime = _mm_add_ps( _mm_sub_ps( _mm_mul_ps( vCos, x ), _mm_mul_ps( vSin, y ) ), vXPos );
+			__m128 yPrime = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vSin, x ), _mm_mul_ps( vCos, y ) ), vYPos );
+
+			// x, y, z, rhw for each vertex in one store
+			__m128 xy01 = _mm_unpacklo_ps( xPrime, yPrime ), xy23 = _mm_unpackhi_ps( xPrime, yPrime );
+			_mm_storeu_ps( &pVertData[0].x, _mm_movelh_ps( xy01, vOne ) );
+			_mm_storeu_ps( &pVertData[1].x, _mm_movehl_ps( vOne, xy01 ) );
+			_mm_storeu_ps( &pVertData[2].x, _mm_movelh_ps( xy23, vOne ) );
+			_mm_storeu_ps( &pVertData[3].x, _mm_movehl_ps( vOne, xy23 ) );
+
+			for ( int j = 0; j < 4; ++j )
+			{
+				pVertData[j].color = pdwOverrideColor ? *pdwOverrideColor : pIn[j].color;
+			}
+		}
+
+		for ( ; i < cBatchVertexes; ++i, ++pIn, ++pVertData )
+		{
+			pVertData->x = flCos*pIn->x - flSin*pIn->y + xPos;
+			pVertData->y = flSin*pIn->x + flCos*pIn->y + yPos;
+			pVertData->z = 1.0;
+			pVertData->rhw = 1.0;
+			pVertData->color = pdwOverrideColor ? *pdwOverrideColor : pIn->color;
+		}
+
+		m_dwLinesToFlush += cBatch;
+		pVertexes += cBatchVertexes;
+		cLines -= cBatch;
+	}
 
 	return true;
 }
@@ -138,6 +138,10 @@ public:
 	// Flush the line buffer
 	bool BFlushLineBuffer();
 
+	// Rotate and translate a block of vertexes straight into the line buffer
+	bool BDrawTransformedLines( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, float flSin, float flCos,
+		float xPos, float yPos, const DWORD *pdwOverrideColor );
+
 	// Draw a point, the engine itself will manage batching these (although you can explicitly flush if you need to)
 	bool BDrawPoint( float xPos, float yPos, DWORD dwColor );
 
@@ -270,6 +274,9 @@ private:
 	// Lock an entire vertex buffer with the specified flags
 	bool BLockEntireVertexBuffer( HGAMEVERTBUF hVertBuf, void **ppVoid, DWORD dwFlags );
 
+	// Make sure the line buffer exists and is locked into m_pLineVertexes
+	bool BLockLineBuffer();
+
 	// Unlock a vertex buffer
 	bool BUnlockVertexBuffer( HGAMEVERTBUF hVertBuf );
 